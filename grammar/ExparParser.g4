@@ -9,43 +9,33 @@ options {
 }
 
 // ============================================================================
+// The alternatives are listed from the tightest to the loosest binding.
 value
-    : value_unary
-    | value_function_call
+    : value_function_call
     | value_scope
     | value_atom
-    | value value_operator value;
-value_unary
-    : (PLUS | MINUS) value;
+    | <assoc = right> value (POWER_OPERATOR | CARET) value
+    | (PLUS | MINUS | EXCLAMATION_MARK) value
+    | value (STAR | SLASH | PERCENT) value
+    | value (PLUS | MINUS) value
+    | value (BITWISE_SHIFT_LEFT | BITWISE_SHIFT_RIGHT) value
+    | value (LESS_THAN | LESS_THAN_EQUAL | GREATER_THAN | GREATER_THAN_EQUAL) value
+    | value (LOGIC_EQUAL | LOGIC_NOT_EQUAL) value
+    | value LOGIC_BITWISE_AND value
+    | value LOGIC_XOR value
+    | value LOGIC_BITWISE_OR value
+    | value LOGIC_AND value
+    | value LOGIC_OR value
+    | <assoc = right> value QUESTION_MARK value COLON value
+    | <assoc = right> value EQUAL value
+    ;
 value_function_call
-    : ID OPEN_ROUND (value COMMA?)+ CLOSE_ROUND;
+    : ID OPEN_ROUND (value COMMA?)* CLOSE_ROUND;
 value_scope
     : (OPEN_ROUND | OPEN_CURLY | APEX | OPEN_SQUARE) (value COMMA?)+ (CLOSE_ROUND | CLOSE_CURLY | APEX | CLOSE_SQUARE);
-value_operator
-    : EQUAL
-    
-    | PLUS | MINUS | STAR | SLASH
-
-    | LOGIC_AND | LOGIC_BITWISE_AND
-    | LOGIC_OR  | LOGIC_BITWISE_OR
-
-    | LOGIC_EQUAL | LOGIC_NOT_EQUAL
-
-    | LOGIC_XOR
-
-    | LESS_THAN    | LESS_THAN_EQUAL
-    | GREATER_THAN | GREATER_THAN_EQUAL
-
-    | EXCLAMATION_MARK
-
-    | BITWISE_SHIFT_LEFT | BITWISE_SHIFT_RIGHT
-
-    | POWER_OPERATOR | CARET
-
-    | PERCENT
-    ;
 value_atom
     : NUMBER
+    | COMPLEX
     | ID
     | PERCENTAGE
     ;
\ No newline at end of file
@@ -0,0 +1,58 @@
+/// @file   array.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+#include "functions.hpp"
+
+#include <map>
+
+namespace expar
+{
+/// @brief The type used for arrays of real values.
+using Array = std::vector<double>;
+
+/// @brief Evaluates an expression over arrays of real numbers, walking the
+///        tree once: each node produces a contiguous array and operations
+///        run over whole arrays. Operators and functions work element by
+///        element, and single values are repeated to match the length of
+///        the other operands (operands of other, different lengths are an
+///        error). The functions sum, prod, min, max and mean of one array,
+///        and dot of two arrays, reduce them to a single value, unless the
+///        registry defines them with that number of arguments.
+class ArrayEvaluator : public StaticVisitor<ArrayEvaluator, Array> {
+public:
+    /// @brief Construct a new evaluator.
+    /// @param _bindings the value of each variable.
+    /// @param _registry the functions which can be called.
+    ArrayEvaluator(const std::map<std::string, Array> &_bindings,
+                   const FunctionRegistry &_registry = FunctionRegistry::standard());
+
+    /// @brief Returns the value of the expression.
+    Array evaluate(AstNode *node);
+
+    Array visit(AstBinary &e);
+    Array visit(AstUnary &e);
+    Array visit(AstConditional &e);
+    Array visit(AstScope &e);
+    Array visit(AstArray &e);
+    Array visit(AstFunction &e);
+    Array visit(AstVariable &e);
+    Array visit(AstNumber &e);
+
+private:
+    /// The value of the variables.
+    const std::map<std::string, Array> &bindings;
+    /// The functions, looked up at each call.
+    const FunctionRegistry &registry;
+
+    /// @brief Applies the operator of the node to the value of its left
+    ///        operand and to its right operand.
+    Array operate(AstBinary &e, Array l);
+
+    /// @brief Computes the reductions, returns false if the call is not one.
+    bool reduce(AstFunction &e, Array &result);
+};
+
+} // namespace expar
@@ -0,0 +1,65 @@
+/// @file   bitwise.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <climits>
+
+namespace expar::bitwise
+{
+/// @brief Converts the operand of a bitwise operator to an integer, dropping
+///        the fractional part. NaN gives zero, values beyond the range of a
+///        64-bit integer (infinities included) give its limits.
+inline long long to_integer(double value)
+{
+    if (value != value)
+        return 0;
+    if (value >= 9223372036854775808.)
+        return LLONG_MAX;
+    if (value < -9223372036854775808.)
+        return LLONG_MIN;
+    return static_cast<long long>(value);
+}
+
+/// @brief Shifts the bits of the value to the left, or to the right for a
+///        negative count. The bits shifted out are lost, so counts of 64 or
+///        more give zero (or the sign, to the right).
+inline long long shift(long long value, long long count)
+{
+    if (count <= -64)
+        return (value < 0) ? -1 : 0;
+    if (count < 0)
+        return value >> -count;
+    if (count >= 64)
+        return 0;
+    // Shifting the unsigned value avoids overflowing a negative one.
+    return static_cast<long long>(static_cast<unsigned long long>(value) << count);
+}
+
+/// @brief The bitwise operators, as the Evaluator applies them.
+template <typename T>
+inline T bor(T l, T r)
+{
+    return static_cast<T>(to_integer(l) | to_integer(r));
+}
+
+template <typename T>
+inline T band(T l, T r)
+{
+    return static_cast<T>(to_integer(l) & to_integer(r));
+}
+
+template <typename T>
+inline T bsl(T l, T r)
+{
+    return static_cast<T>(shift(to_integer(l), to_integer(r)));
+}
+
+template <typename T>
+inline T bsr(T l, T r)
+{
+    long long count = to_integer(r);
+    return static_cast<T>(shift(to_integer(l), (count == LLONG_MIN) ? LLONG_MAX : -count));
+}
+
+} // namespace expar::bitwise
@@ -0,0 +1,134 @@
+/// @file   codegen.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+namespace expar
+{
+/// @brief Signature of a generated expression, the inputs are given in the
+///        same order of the variables used during the generation.
+using NativeFunction = double (*)(const double *);
+
+/// @brief Signature of the generated function which evaluates all the
+///        expressions at once, writing the results in order.
+using NativeKernel = void (*)(const double *, double *);
+
+/// @brief Emits a C++ translation unit for a set of expressions. For each
+///        expression i, it defines the C function `expar_expression_<i>`
+///        (a NativeFunction), plus the fused `expar_evaluate_all`
+///        (a NativeKernel). The operators give the same results of the
+///        Evaluator, but the functions are the ones of the C library:
+///        sqrt, exp, log, sin and cos can then differ in the last bits from
+///        the standard registry, which uses the vmath kernels.
+class CodeGenerator {
+public:
+    /// @brief Construct a new generator.
+    /// @param _variables the variables, their position is the index of the
+    ///                   corresponding input.
+    CodeGenerator(std::vector<std::string> _variables);
+
+    /// @brief Returns the source code for the given expressions.
+    std::string generate(const std::vector<AstNode *> &expressions) const;
+
+    /// @brief Returns the C++ expression computing the given expression,
+    ///        which calls the helpers of the translation unit for the
+    ///        bitwise operators.
+    std::string generate(AstNode *expression) const;
+
+private:
+    /// The variables.
+    std::vector<std::string> variables;
+};
+
+/// @brief Returns the default directory of the native modules, private to
+///        the user: `$XDG_CACHE_HOME/expar`, or `$HOME/.cache/expar`, or a
+///        directory named after the user id in the temporary directory.
+std::string default_cache_dir();
+
+/// @brief How native modules are built.
+struct NativeOptions {
+    /// The compiler.
+    std::string compiler = "c++";
+    /// The compilation flags. Contracting products and sums into fused
+    /// multiply-adds would round differently from the other evaluations.
+    std::string flags = "-O3 -march=native -ffp-contract=off -fno-math-errno -shared -fPIC";
+    /// Where the sources and the shared objects are kept. The directory is
+    /// created with mode 0700, and cached objects are loaded only when both
+    /// the directory and the object belong to the user and cannot be written
+    /// by anyone else.
+    std::string cache_dir = default_cache_dir();
+};
+
+/// @brief A shared object, built from generated code, loaded in memory.
+class NativeModule {
+public:
+    /// @brief Unloads the module.
+    ~NativeModule();
+
+    NativeModule(const NativeModule &) = delete;
+    NativeModule &operator=(const NativeModule &) = delete;
+
+    /// @brief Returns the number of expressions.
+    inline std::size_t size() const
+    {
+        return functions.size();
+    }
+
+    /// @brief Returns the function evaluating the i-th expression.
+    inline NativeFunction get_function(std::size_t index) const
+    {
+        return functions.at(index);
+    }
+
+    /// @brief Returns the function evaluating all the expressions.
+    inline NativeKernel get_kernel() const
+    {
+        return kernel;
+    }
+
+    /// @brief Returns the path of the shared object.
+    inline const std::string &get_path() const
+    {
+        return path;
+    }
+
+    /// @brief Checks if the shared object was already in the cache.
+    inline bool is_cached() const
+    {
+        return cached;
+    }
+
+private:
+    friend NativeModule *compile_native(const std::vector<AstNode *> &,
+                                        const std::vector<std::string> &,
+                                        const NativeOptions &);
+
+    NativeModule(std::string _path, bool _cached, void *_handle);
+
+    /// The path of the shared object.
+    std::string path;
+    /// If the shared object was already in the cache.
+    bool cached;
+    /// The handle returned by dlopen.
+    void *handle;
+    /// The functions, one for each expression.
+    std::vector<NativeFunction> functions;
+    /// The function which evaluates all the expressions.
+    NativeKernel kernel;
+};
+
+/// @brief Generates, builds and loads the native code for the given
+///        expressions. The shared object is named after the hash of the
+///        source and of the build command, if it is already in the cache
+///        the build is skipped.
+/// @param expressions the expressions.
+/// @param variables   the variables, in input order.
+/// @param options     how the code is built.
+/// @return The loaded module, which must be deleted by the caller.
+NativeModule *compile_native(const std::vector<AstNode *> &expressions,
+                             const std::vector<std::string> &variables,
+                             const NativeOptions &options = NativeOptions());
+
+} // namespace expar
@@ -0,0 +1,143 @@
+/// @file   complex.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+#include <complex>
+#include <map>
+
+namespace expar
+{
+/// @brief The type used for complex values.
+using Complex = std::complex<double>;
+
+/// @brief Evaluates an expression over the complex numbers, walking the tree.
+class ComplexEvaluator : public ExpBaseVisitor {
+public:
+    /// @brief Construct a new evaluator.
+    /// @param _bindings the value of each variable.
+    ComplexEvaluator(const std::map<std::string, Complex> &_bindings);
+
+    /// @brief Returns the value of the expression.
+    Complex evaluate(AstNode *node);
+
+    void visit(AstBinary &e) override;
+    void visit(AstUnary &e) override;
+    void visit(AstConditional &e) override;
+    void visit(AstScope &e) override;
+    void visit(AstArray &e) override;
+    void visit(AstFunction &e) override;
+    void visit(AstVariable &e) override;
+    void visit(AstNumber &e) override;
+
+private:
+    /// The value of the variables.
+    const std::map<std::string, Complex> &bindings;
+    /// The value of the last visited node.
+    Complex value;
+
+    /// @brief Applies the operator of the node to the value of its left
+    ///        operand, the last one computed, and to its right operand.
+    void combine(AstBinary &e);
+};
+
+/// @brief An expression compiled for the repeated evaluation over the
+///        complex numbers, e.g., along a frequency sweep. Batches are
+///        processed in chunks of points, keeping real and imaginary parts
+///        in separate contiguous arrays so that the arithmetic runs on
+///        full SIMD registers.
+class ComplexProgram {
+public:
+    /// @brief Compiles the expression.
+    /// @param node      the expression.
+    /// @param variables the variables, their position is the index of the
+    ///                  corresponding input.
+    ComplexProgram(AstNode *node, std::vector<std::string> variables);
+
+    /// @brief Returns the variables, in input order.
+    inline const std::vector<std::string> &get_variables() const
+    {
+        return variables;
+    }
+
+    /// @brief Evaluates the expression on a single point.
+    /// @param values the value of each variable.
+    /// @return The value of the expression.
+    Complex evaluate(const Complex *values) const;
+
+    /// @brief Evaluates the expression on a batch of points, split layout.
+    /// @param count  the number of points.
+    /// @param re     for each variable, the array of its real parts.
+    /// @param im     for each variable, the array of its imaginary parts,
+    ///               or NULL if the variable is real.
+    /// @param out_re the real part of the results.
+    /// @param out_im the imaginary part of the results.
+    void evaluate(std::size_t count,
+                  const double *const *re,
+                  const double *const *im,
+                  double *out_re,
+                  double *out_im) const;
+
+    /// @brief Evaluates the expression on a batch of points, interleaved
+    ///        layout (i.e., arrays of std::complex<double>).
+    /// @param count  the number of points.
+    /// @param values for each variable, the array of its values.
+    /// @param out    the results.
+    void evaluate(std::size_t count,
+                  const Complex *const *values,
+                  Complex *out) const;
+
+    /// @brief The operations of the program.
+    enum Code {
+        c_const,
+        c_load,
+        c_add,
+        c_sub,
+        c_mul,
+        c_div,
+        c_pow,
+        c_neg,
+        c_eq,
+        c_neq,
+        c_real,
+        c_imag,
+        c_conj,
+        c_abs,
+        c_arg,
+        c_sqrt,
+        c_exp,
+        c_log,
+        c_log10,
+        c_sin,
+        c_cos,
+        c_tan,
+        c_sinh,
+        c_cosh,
+        c_tanh
+    };
+
+    /// @brief A single operation, working on the top of the stack.
+    struct Instruction {
+        Code code;
+        std::size_t index;
+        Complex constant;
+    };
+
+private:
+    /// The variables.
+    std::vector<std::string> variables;
+    /// The operations, in postfix order.
+    std::vector<Instruction> code;
+    /// The maximum depth of the stack.
+    std::size_t depth;
+
+    /// @brief Evaluates a chunk of points, the inputs are split.
+    void evaluate_chunk(std::size_t count,
+                        const double *const *re,
+                        const double *const *im,
+                        double *stack) const;
+};
+
+} // namespace expar
@@ -1,40 +1,121 @@
 #pragma once
 
 #include "enums.hpp"
+#include <initializer_list>
 #include <vector>
 
 namespace expar
 {
+class AstNode;
 class AstBinary;
 class AstUnary;
+class AstConditional;
 class AstScope;
+class AstArray;
 class AstFunction;
 class AstVariable;
 class AstNumber;
 
 class ExpVisitor {
 public:
-    virtual void visit(AstBinary &e)   = 0;
-    virtual void visit(AstUnary &e)    = 0;
-    virtual void visit(AstScope &e)    = 0;
-    virtual void visit(AstFunction &e) = 0;
-    virtual void visit(AstVariable &e) = 0;
-    virtual void visit(AstNumber &e)   = 0;
+    virtual void visit(AstBinary &e)      = 0;
+    virtual void visit(AstUnary &e)       = 0;
+    virtual void visit(AstConditional &e) = 0;
+    virtual void visit(AstScope &e)       = 0;
+    virtual void visit(AstArray &e)       = 0;
+    virtual void visit(AstFunction &e)    = 0;
+    virtual void visit(AstVariable &e)    = 0;
+    virtual void visit(AstNumber &e)      = 0;
 };
 
+/// @brief Visits all the nodes, left to right, by recursion: an override
+///        which calls the visit of the base class sees the children visited
+///        before the call returns. The native stack grows with the depth of
+///        the tree, use ExpWalker for trees of any depth.
 class ExpBaseVisitor : public ExpVisitor {
 public:
     void visit(AstBinary &e) override;
     void visit(AstUnary &e) override;
+    void visit(AstConditional &e) override;
     void visit(AstScope &e) override;
+    void visit(AstArray &e) override;
     void visit(AstFunction &e) override;
     void visit(AstVariable &e) override;
     void visit(AstNumber &e) override;
 };
 
+/// @brief Visits all the nodes, parents before children and left to right.
+///        The visits only schedule the children, which are visited once
+///        the outermost visit returns, so that the native stack does not
+///        grow with the depth of the tree. An override which calls the
+///        visit of the base class must then do its work before the call,
+///        since the children are not visited yet when the call returns.
+class ExpWalker : public ExpVisitor {
+public:
+    void visit(AstBinary &e) override;
+    void visit(AstUnary &e) override;
+    void visit(AstConditional &e) override;
+    void visit(AstScope &e) override;
+    void visit(AstArray &e) override;
+    void visit(AstFunction &e) override;
+    void visit(AstVariable &e) override;
+    void visit(AstNumber &e) override;
+
+private:
+    /// The nodes waiting to be visited, the next one is at the back.
+    std::vector<AstNode *> pending;
+    /// If a visit of the base class is already walking the tree.
+    bool walking = false;
+
+    /// @brief Schedules the children (given in order) and, unless another
+    ///        visit is already doing it, visits the pending nodes.
+    void walk(std::initializer_list<AstNode *> children);
+
+    /// @brief Visits the pending nodes.
+    void walk();
+};
+
+/// @brief Deletes the children of the node, and all their descendants,
+///        without recursion. The links to the children are cleared.
+/// @param node the node.
+void delete_children(AstNode *node);
+
+/// @brief Appends to the vector the links from the node to its children,
+///        in order, so that the children can be replaced.
+/// @param node  the node.
+/// @param links where the links are appended.
+void links_of(AstNode *node, std::vector<AstNode **> &links);
+
+/// @brief Copies the node and all its descendants, positions included,
+///        without recursion.
+/// @param node the node.
+/// @return The copy.
+AstNode *clone(AstNode *node);
+
+/// @brief Collects the chain of left operands which starts at the node
+///        (e.g. the additions of a + b + c), so that the visits can walk it
+///        without recursion. Assignments end the chain.
+/// @param node  the first node of the chain.
+/// @param chain where the nodes of the chain are appended, outermost first.
+/// @return The left operand of the innermost node of the chain.
+AstNode *left_chain(AstBinary *node, std::vector<AstBinary *> &chain);
+
 class AstNode {
 public:
-    AstNode()                          = default;
+    /// Position of the first character of the node in the source text.
+    std::size_t begin = 0;
+    /// Position past the last character of the node in the source text.
+    std::size_t end = 0;
+
+    /// The concrete type of the node.
+    const NodeKind kind;
+
+    AstNode(NodeKind _kind)
+        : kind(_kind)
+    {
+        // Nothing to do.
+    }
+
     virtual ~AstNode()                 = default;
     virtual void accept(ExpVisitor &v) = 0;
 };
@@ -48,7 +129,8 @@ public:
     AstBinary(Operator _type,
               AstNode *_left,
               AstNode *_right)
-        : type(_type),
+        : AstNode(node_binary),
+          type(_type),
           left(_left),
           right(_right)
     {
@@ -57,8 +139,7 @@ public:
 
     ~AstBinary() override
     {
-        delete left;
-        delete right;
+        delete_children(this);
     }
 
     inline void accept(ExpVisitor &v) override
@@ -74,14 +155,15 @@ public:
 
     AstUnary(Operator _type,
              AstNode *_right)
-        : type(_type),
+        : AstNode(node_unary),
+          type(_type),
           right(_right)
     {
         // Nothing to do.
     }
     ~AstUnary() override
     {
-        delete right;
+        delete_children(this);
     }
     inline void accept(ExpVisitor &v) override
     {
@@ -89,6 +171,38 @@ public:
     }
 };
 
+/// @brief The conditional `condition ? if_true : if_false`, also written
+///        `if(condition, if_true, if_false)`. Only the selected branch is
+///        evaluated, except by batch evaluations, which compute both and
+///        select the results point by point.
+class AstConditional : public AstNode {
+public:
+    AstNode *condition;
+    AstNode *if_true;
+    AstNode *if_false;
+
+    AstConditional(AstNode *_condition,
+                   AstNode *_if_true,
+                   AstNode *_if_false)
+        : AstNode(node_conditional),
+          condition(_condition),
+          if_true(_if_true),
+          if_false(_if_false)
+    {
+        // Nothing to do.
+    }
+
+    ~AstConditional() override
+    {
+        delete_children(this);
+    }
+
+    inline void accept(ExpVisitor &v) override
+    {
+        v.visit(*this);
+    }
+};
+
 class AstScope : public AstNode {
 public:
     ScopeType type;
@@ -96,7 +210,8 @@ public:
 
     AstScope(ScopeType _type,
              AstNode *_content)
-        : type(_type),
+        : AstNode(node_scope),
+          type(_type),
           content(_content)
     {
         // Nothing to do.
@@ -104,7 +219,31 @@ public:
 
     ~AstScope() override
     {
-        delete content;
+        delete_children(this);
+    }
+
+    inline void accept(ExpVisitor &v) override
+    {
+        v.visit(*this);
+    }
+};
+
+/// @brief The array `[a, b, c]`, whose elements are evaluated in order.
+///        Elements which are arrays themselves are concatenated.
+class AstArray : public AstNode {
+public:
+    std::vector<AstNode *> content;
+
+    AstArray(std::vector<AstNode *> _content)
+        : AstNode(node_array),
+          content(std::move(_content))
+    {
+        // Nothing to do.
+    }
+
+    ~AstArray() override
+    {
+        delete_children(this);
     }
 
     inline void accept(ExpVisitor &v) override
@@ -120,7 +259,8 @@ public:
 
     AstFunction(std::string _name,
                 std::vector<AstNode *> _content)
-        : name(std::move(_name)),
+        : AstNode(node_function),
+          name(std::move(_name)),
           content(std::move(_content))
     {
         // Nothing to do.
@@ -128,9 +268,7 @@ public:
 
     ~AstFunction() override
     {
-        for (auto it = content.begin(); it != content.begin(); ++it) {
-            delete *it;
-        }
+        delete_children(this);
     }
 
     inline void accept(ExpVisitor &v) override
@@ -144,7 +282,8 @@ public:
     std::string name;
 
     AstVariable(std::string _name)
-        : name(std::move(_name))
+        : AstNode(node_variable),
+          name(std::move(_name))
     {
         // Nothing to do.
     }
@@ -160,9 +299,12 @@ public:
 class AstNumber : public AstNode {
 public:
     double value;
+    bool imaginary;
 
-    AstNumber(double _value)
-        : value(_value)
+    AstNumber(double _value, bool _imaginary = false)
+        : AstNode(node_number),
+          value(_value),
+          imaginary(_imaginary)
     {
         // Nothing to do.
     }
@@ -175,6 +317,42 @@ public:
     }
 };
 
+/// @brief A visitor dispatched on the kind of the node instead of through
+///        virtual calls, so that the compiler can inline the traversal, and
+///        whose visits return a value. The derived class provides a
+///        `Result visit(AstX &)` for each type of node, and calls dispatch()
+///        on the children.
+/// @tparam Derived the derived class.
+/// @tparam Result  the type returned by the visits.
+template <typename Derived, typename Result = void>
+class StaticVisitor {
+public:
+    /// @brief Calls the visit of the derived class for the given node.
+    inline Result dispatch(AstNode *node)
+    {
+        auto &self = static_cast<Derived &>(*this);
+        switch (node->kind) {
+        case node_binary:
+            return self.visit(static_cast<AstBinary &>(*node));
+        case node_unary:
+            return self.visit(static_cast<AstUnary &>(*node));
+        case node_conditional:
+            return self.visit(static_cast<AstConditional &>(*node));
+        case node_scope:
+            return self.visit(static_cast<AstScope &>(*node));
+        case node_array:
+            return self.visit(static_cast<AstArray &>(*node));
+        case node_function:
+            return self.visit(static_cast<AstFunction &>(*node));
+        case node_variable:
+            return self.visit(static_cast<AstVariable &>(*node));
+        case node_number:
+        default:
+            return self.visit(static_cast<AstNumber &>(*node));
+        }
+    }
+};
+
 class Factory {
 public:
     /// @brief Construct a new Factory.
@@ -190,19 +368,29 @@ public:
         return new AstUnary(type, right);
     }
 
+    AstConditional *astConditional(AstNode *condition, AstNode *if_true, AstNode *if_false)
+    {
+        return new AstConditional(condition, if_true, if_false);
+    }
+
     AstScope *astScope(ScopeType type, AstNode *content)
     {
         return new AstScope(type, content);
     }
 
+    AstArray *astArray(std::vector<AstNode *> content)
+    {
+        return new AstArray(std::move(content));
+    }
+
     AstVariable *astVariable(std::string name)
     {
         return new AstVariable(name);
     }
 
-    AstNumber *astNumber(double value)
+    AstNumber *astNumber(double value, bool imaginary = false)
     {
-        return new AstNumber(value);
+        return new AstNumber(value, imaginary);
     }
 };
 
@@ -0,0 +1,27 @@
+/// @file   derivative.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+namespace expar
+{
+/// @brief Returns the derivative of the expression with respect to a
+///        variable, as a new expression. Comparisons, logical and bitwise
+///        operators, and functions like floor and sign are taken as
+///        constant where they are defined, conditionals differentiate
+///        their branches, and arrays their elements. Functions are
+///        differentiated as the standard ones of the same name; other
+///        functions (pwl and table included) are reported as errors,
+///        before anything is built. Terms known to be zero are left out.
+/// @param node     the expression.
+/// @param variable the variable.
+/// @return The derivative, which must be deleted by the caller.
+AstNode *differentiate(AstNode *node, const std::string &variable);
+
+/// @brief Checks if the expression can be differentiated (see
+///        differentiate()).
+bool is_differentiable(AstNode *node);
+
+} // namespace expar
@@ -0,0 +1,146 @@
+/// @file   engine.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "codegen.hpp"
+#include "program.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace expar
+{
+/// @brief The ways an Engine evaluates an expression, from the cheapest to
+///        prepare to the fastest to run.
+enum Tier {
+    tier_tree,     ///< Walking the tree, with an Evaluator.
+    tier_bytecode, ///< Running the compiled Program.
+    tier_native    ///< Calling the native code.
+};
+
+/// @brief How an Engine promotes its expressions.
+struct EngineOptions {
+    /// The evaluations after which an expression is compiled to bytecode
+    /// (zero compiles it when it is added).
+    std::uint64_t bytecode_threshold = 8;
+    /// The evaluations after which an expression is compiled to native code.
+    std::uint64_t native_threshold = 1000000;
+    /// If native code is used at all.
+    bool native = true;
+    /// How native modules are built.
+    NativeOptions native_options = NativeOptions();
+    /// If the promotions are carried out by a background thread, otherwise
+    /// by the thread whose evaluation reaches the threshold.
+    bool background = true;
+};
+
+/// @brief Evaluates many expressions, each one in the cheapest way for how
+///        often it is evaluated. Expressions start by walking the tree, and
+///        their evaluations are counted: past the thresholds they are
+///        compiled to bytecode and then to native code, usually by a
+///        background thread, while the evaluations go on with the previous
+///        tier. The new code is published atomically, and kept until the
+///        engine is destroyed. Expressions which cannot be compiled stay in
+///        the tier they reached, and native code is only used with the
+///        standard functions.
+///        The tiers agree up to the rounding of the functions of the C
+///        library used by native code (see CodeGenerator). Evaluations
+///        can run in parallel, but not together with add().
+class Engine {
+public:
+    /// @brief Construct a new engine.
+    /// @param _variables the variables, their position is the index of the
+    ///                   corresponding input.
+    /// @param _options   how the expressions are promoted.
+    /// @param _registry  the functions which can be called, which must
+    ///                   outlive the engine.
+    Engine(std::vector<std::string> _variables,
+           EngineOptions _options             = EngineOptions(),
+           const FunctionRegistry &_registry = FunctionRegistry::standard());
+
+    /// @brief Stops the background thread and releases the code.
+    ~Engine();
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    /// @brief Adds an expression, the engine keeps a copy of it.
+    /// @param expression the expression.
+    /// @return The index of the expression.
+    std::size_t add(AstNode *expression);
+
+    /// @brief Evaluates an expression.
+    /// @param index  the index of the expression.
+    /// @param values the value of each variable.
+    /// @return The value of the expression.
+    double evaluate(std::size_t index, const double *values);
+
+    /// @brief Returns the tier currently used by an expression.
+    Tier get_tier(std::size_t index) const;
+
+    /// @brief Returns how many times an expression was evaluated, up to its
+    ///        promotion to native code.
+    std::uint64_t get_evaluations(std::size_t index) const;
+
+    /// @brief Waits for the pending promotions to complete.
+    void wait();
+
+private:
+    /// @brief An expression, with its compiled code.
+    struct Entry {
+        /// The expression.
+        AstNode *expression = nullptr;
+        /// The evaluations so far.
+        std::atomic<std::uint64_t> evaluations{ 0 };
+        /// The bytecode, once compiled.
+        std::atomic<const Program *> program{ nullptr };
+        /// The native code, once compiled.
+        std::atomic<NativeFunction> native{ nullptr };
+        /// Owns the bytecode.
+        std::unique_ptr<Program> owned;
+    };
+
+    /// @brief A request of promotion.
+    struct Job {
+        Entry *entry;
+        Tier tier;
+    };
+
+    /// The variables.
+    std::vector<std::string> variables;
+    /// How the expressions are promoted.
+    EngineOptions options;
+    /// The functions which can be called.
+    const FunctionRegistry &registry;
+    /// The expressions.
+    std::vector<std::unique_ptr<Entry>> entries;
+    /// The native modules, kept until the engine is destroyed.
+    std::vector<std::unique_ptr<NativeModule>> modules;
+    /// The requests of promotion, and the ones being carried out.
+    std::deque<Job> jobs;
+    std::size_t running;
+    /// Protects the jobs and the modules.
+    std::mutex mutex;
+    /// Signals new jobs, and completed ones.
+    std::condition_variable changed;
+    /// If the background thread must stop.
+    bool stopping;
+    /// The background thread.
+    std::thread worker;
+
+    /// @brief Requests the promotion of an expression.
+    void promote(Entry &entry, Tier tier);
+
+    /// @brief Carries out the promotions.
+    void run(std::vector<Job> batch);
+
+    /// @brief The loop of the background thread.
+    void serve();
+};
+
+} // namespace expar
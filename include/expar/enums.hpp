@@ -53,6 +53,23 @@ std::string operator_to_plain_string(Operator op);
 /// @return The operator.
 Operator plain_string_to_operator(const std::string &s);
 
+/// @brief Return how tightly the operator binds its operands, following
+///        the grammar (e.g. op_mult binds tighter than op_plus).
+/// @param op    the operator.
+/// @param unary if the operator is used as a prefix (e.g. -x).
+/// @return The precedence, higher values bind tighter, 0 for op_none.
+unsigned operator_precedence(Operator op, bool unary = false);
+
+/// @brief How tightly the conditional (c ? a : b) binds, between op_or and
+///        op_assign.
+constexpr unsigned conditional_precedence = 2;
+
+/// @brief Check if the binary operator groups from the right (e.g. a^b^c is
+///        a^(b^c)).
+/// @param op the operator.
+/// @return **true** for right associative operators.
+bool operator_is_right_associative(Operator op);
+
 /// @brief Which kind of symbols are used for declaring a scope.
 enum ScopeType {
     scp_none,   ///< No scope type.
@@ -73,6 +90,23 @@ std::string scopetype_to_plain_string(ScopeType scp);
 /// @return The type of scope.
 ScopeType plain_string_to_scopetype(const std::string &s);
 
+/// @brief The concrete type of a node of the tree.
+enum NodeKind {
+    node_binary,      ///< AstBinary
+    node_unary,       ///< AstUnary
+    node_conditional, ///< AstConditional
+    node_scope,       ///< AstScope
+    node_array,       ///< AstArray
+    node_function,    ///< AstFunction
+    node_variable,    ///< AstVariable
+    node_number       ///< AstNumber
+};
+
+/// @brief Return the string representation of the given kind of node enum name (e.g. node_binary returns "node_binary").
+/// @param kind the kind of node.
+/// @return The string representation of given kind of node.
+std::string nodekind_to_plain_string(NodeKind kind);
+
 /// @brief International System of Units (SI)
 enum SiPrefix {
     si_yotta, ///< Y  10e24
@@ -0,0 +1,106 @@
+/// @file   evaluator.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+#include "functions.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <map>
+#include <vector>
+
+namespace expar
+{
+/// @brief Applies a binary operator to the values of its operands, as the
+///        Evaluator does (the assignment excluded).
+double apply(Operator op, double l, double r);
+
+/// @brief Applies a prefix operator to the value of its operand, as the
+///        Evaluator does.
+double apply(Operator op, double value);
+
+/// @brief Calls a function on the values of its arguments, as the Evaluator
+///        does: pwl and table interpolate their breakpoints, and the random
+///        functions give their nominal value (unless registered).
+/// @param name     the name of the function.
+/// @param args     the values of the arguments.
+/// @param count    the number of arguments.
+/// @param registry the functions which can be called.
+double call(const std::string &name, const double *args, std::size_t count, const FunctionRegistry &registry);
+
+/// @brief Evaluates an expression over the real numbers, walking the tree.
+///        Logical and comparison operators return 1 or 0, bitwise operators
+///        work on the values truncated to integers.
+class Evaluator : public StaticVisitor<Evaluator, double> {
+public:
+    /// @brief Construct a new evaluator.
+    /// @param _bindings the value of each variable.
+    /// @param _registry the functions which can be called.
+    /// @param _profile  where the time spent on each node is recorded (if
+    ///                  any), which slows down the evaluation.
+    Evaluator(const std::map<std::string, double> &_bindings,
+              const FunctionRegistry &_registry = FunctionRegistry::standard(),
+              Profile *_profile                 = nullptr);
+
+    /// @brief Returns the value of the expression.
+    inline double evaluate(AstNode *node)
+    {
+        if (node == nullptr)
+            Evaluator::null_node();
+        if (!stats::is_enabled() && !trace::is_enabled())
+            return this->descend(node);
+        std::uint64_t started = stats::now();
+        double value          = this->descend(node);
+        std::uint64_t ended   = stats::now();
+        if (stats::is_enabled()) {
+            auto &counters = stats::local();
+            counters.evaluations.add(1);
+            counters.evaluation_ns.add(ended - started);
+        }
+        if (trace::is_enabled())
+            trace::record("evaluate", started, ended);
+        return value;
+    }
+
+    double visit(AstBinary &e);
+    double visit(AstUnary &e);
+    double visit(AstConditional &e);
+    double visit(AstScope &e);
+    double visit(AstArray &e);
+    double visit(AstFunction &e);
+    double visit(AstVariable &e);
+    double visit(AstNumber &e);
+
+private:
+    /// The value of the variables.
+    const std::map<std::string, double> &bindings;
+    /// The functions, looked up at each call.
+    const FunctionRegistry &registry;
+    /// Where the time spent on each node is recorded.
+    Profile *profile;
+    /// The time spent on the children of the node being measured.
+    std::uint64_t children_ns;
+    /// The chains of left operands being evaluated, innermost at the back.
+    std::vector<AstBinary *> chain;
+
+    /// @brief Evaluates a node, measuring it when profiling.
+    inline double descend(AstNode *node)
+    {
+        return profile ? this->measure(node) : this->dispatch(node);
+    }
+
+    /// @brief Evaluates a node, and records its time in the profile.
+    double measure(AstNode *node);
+
+    /// @brief Applies the operator of the node to the value of its left
+    ///        operand and to its right operand, evaluated when needed.
+    double combine(AstBinary &e, double l);
+
+    /// @brief Reports an attempt to evaluate a NULL node.
+    static void null_node();
+};
+
+} // namespace expar
@@ -0,0 +1,110 @@
+/// @file   functions.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace expar
+{
+/// @brief The maximum number of arguments of a function.
+constexpr std::size_t max_arity = 8;
+
+/// @brief A function which can be called from an expression.
+struct Function {
+    /// The number of arguments.
+    std::size_t arity;
+    /// If true, the result depends only on the arguments, so calls with
+    /// constant arguments can be folded and calls can be memoized.
+    bool pure;
+    /// The implementation, when it is a plain function of one argument.
+    double (*unary)(double);
+    /// The implementation, when it is a plain function of two arguments.
+    double (*binary)(double, double);
+    /// The implementation on arrays of a function of one argument, if any,
+    /// which receives the number of values, the values and the results.
+    void (*batch)(std::size_t, const double *, double *);
+    /// The implementation for any number of arguments, which receives the
+    /// state and the array of the arguments.
+    double (*call)(const void *, const double *);
+    /// The state of the implementation (e.g., a callable object).
+    std::shared_ptr<const void> state;
+
+    /// @brief Calls the function.
+    /// @param args the arguments, there must be arity of them.
+    inline double invoke(const double *args) const
+    {
+        return call(state.get(), args);
+    }
+};
+
+/// @brief The functions which can be called from expressions, by name.
+///        Names are resolved once when an expression is compiled, which
+///        also checks the number of arguments.
+class FunctionRegistry {
+public:
+    /// @brief Construct an empty registry.
+    FunctionRegistry();
+
+    /// @brief Returns the registry with the standard mathematical functions
+    ///        (sqrt, cbrt, exp, log, log2, log10, abs, sin, cos, tan, asin,
+    ///        acos, atan, sinh, cosh, tanh, floor, ceil, round, trunc, sign,
+    ///        pow, atan2, hypot, fmod, min and max).
+    static const FunctionRegistry &standard();
+
+    /// @brief Adds (or replaces) a function of one argument.
+    void add(const std::string &name, double (*function)(double), bool pure = true);
+
+    /// @brief Adds (or replaces) a function of one argument, together with
+    ///        its version on arrays, which must give the same results.
+    void add(const std::string &name,
+             double (*function)(double),
+             void (*batch)(std::size_t, const double *, double *),
+             bool pure = true);
+
+    /// @brief Adds (or replaces) a function of two arguments.
+    void add(const std::string &name, double (*function)(double, double), bool pure = true);
+
+    /// @brief Adds (or replaces) a callable object taking Arity doubles.
+    ///        The object is stored once, calls never allocate.
+    /// @tparam Arity    the number of arguments.
+    /// @tparam Callable the type of the object.
+    /// @param name     the name used in the expressions.
+    /// @param callable the object.
+    /// @param pure     if the result depends only on the arguments.
+    template <std::size_t Arity, typename Callable>
+    void add(const std::string &name, Callable callable, bool pure = true)
+    {
+        static_assert(Arity <= max_arity, "Too many arguments!");
+        Function function{};
+        function.arity = Arity;
+        function.pure  = pure;
+        function.call  = [](const void *state, const double *args) {
+            return FunctionRegistry::apply(*static_cast<const Callable *>(state), args, std::make_index_sequence<Arity>());
+        };
+        function.state = std::make_shared<const Callable>(std::move(callable));
+        functions[name] = std::move(function);
+    }
+
+    /// @brief Returns the function with the given name, NULL if unknown.
+    const Function *find(const std::string &name) const;
+
+    /// @brief Returns the function with the given name, and checks that it
+    ///        takes the given number of arguments.
+    const Function &bind(const std::string &name, std::size_t arity) const;
+
+private:
+    /// The functions.
+    std::map<std::string, Function> functions;
+
+    template <typename Callable, std::size_t... Index>
+    static inline double apply(const Callable &callable, const double *args, std::index_sequence<Index...>)
+    {
+        return callable(args[Index]...);
+    }
+};
+
+} // namespace expar
@@ -0,0 +1,188 @@
+/// @file   interval.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+#include <map>
+
+namespace expar
+{
+/// @brief A closed interval [lower, upper] over the extended reals.
+struct Interval {
+    double lower; ///< The lower bound.
+    double upper; ///< The upper bound.
+
+    /// @brief Construct the degenerate interval [0, 0].
+    Interval()
+        : lower(0.),
+          upper(0.)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct the degenerate interval [value, value].
+    Interval(double value)
+        : lower(value),
+          upper(value)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct the interval [_lower, _upper].
+    Interval(double _lower, double _upper)
+        : lower(_lower),
+          upper(_upper)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Checks if the interval contains a single value.
+    inline bool is_point() const
+    {
+        return lower == upper;
+    }
+
+    /// @brief Checks if the interval is exactly [value, value].
+    inline bool is_point(double value) const
+    {
+        return (lower == value) && (upper == value);
+    }
+
+    /// @brief Checks if the given value lies inside the interval.
+    inline bool contains(double value) const
+    {
+        return (lower <= value) && (value <= upper);
+    }
+
+    /// @brief Returns the width of the interval.
+    inline double width() const
+    {
+        return upper - lower;
+    }
+};
+
+/// @brief How an expression behaves w.r.t. one of its variables.
+enum Monotonicity {
+    mono_constant,   ///< The expression does not depend on the variable.
+    mono_increasing, ///< The expression is non-decreasing.
+    mono_decreasing, ///< The expression is non-increasing.
+    mono_unknown     ///< Nothing can be said.
+};
+
+/// @brief Return the string representation of the given monotonicity (e.g. mono_constant returns "mono_constant").
+/// @param mono the monotonicity.
+/// @return The string representation of given monotonicity.
+std::string monotonicity_to_plain_string(Monotonicity mono);
+
+/// @brief Interval arithmetic with outward rounding. Every operation returns
+///        an interval which is guaranteed to enclose the exact result, the
+///        bounds are moved one ulp outwards after each inexact operation.
+namespace interval
+{
+/// @brief Returns the interval [-inf, +inf].
+Interval entire();
+
+/// @brief Returns the smallest interval containing both a and b.
+Interval hull(const Interval &a, const Interval &b);
+
+Interval add(const Interval &a, const Interval &b);
+Interval sub(const Interval &a, const Interval &b);
+Interval mul(const Interval &a, const Interval &b);
+Interval div(const Interval &a, const Interval &b);
+Interval neg(const Interval &a);
+Interval mod(const Interval &a, const Interval &b);
+Interval pow(const Interval &a, const Interval &b);
+Interval sqr(const Interval &a);
+Interval sqrt(const Interval &a);
+Interval exp(const Interval &a);
+Interval log(const Interval &a);
+Interval log10(const Interval &a);
+Interval abs(const Interval &a);
+Interval sin(const Interval &a);
+Interval cos(const Interval &a);
+Interval tan(const Interval &a);
+Interval atan(const Interval &a);
+Interval sinh(const Interval &a);
+Interval cosh(const Interval &a);
+Interval tanh(const Interval &a);
+Interval floor(const Interval &a);
+Interval ceil(const Interval &a);
+Interval min(const Interval &a, const Interval &b);
+Interval max(const Interval &a, const Interval &b);
+
+/// @brief Evaluates a binary operator (comparisons and logic operators
+///        return subsets of [0, 1]).
+Interval apply(Operator op, const Interval &a, const Interval &b);
+
+/// @brief Evaluates a unary operator.
+Interval apply(Operator op, const Interval &a);
+
+} // namespace interval
+
+/// @brief Evaluates an expression over boxes of variable ranges. If a
+///        variable name is given, the enclosure of the derivative w.r.t.
+///        that variable is computed alongside the value (forward mode).
+class IntervalEvaluator : public ExpBaseVisitor {
+public:
+    /// @brief Construct a new evaluator.
+    /// @param _ranges the range of each variable.
+    /// @param _wrt    the variable to differentiate against (optional).
+    IntervalEvaluator(const std::map<std::string, Interval> &_ranges,
+                      std::string _wrt = "");
+
+    /// @brief Returns the enclosure of the expression.
+    Interval evaluate(AstNode *node);
+
+    /// @brief Returns the enclosure of the derivative computed by the last
+    ///        call to evaluate.
+    inline const Interval &get_derivative() const
+    {
+        return slope;
+    }
+
+    void visit(AstBinary &e) override;
+    void visit(AstUnary &e) override;
+    void visit(AstConditional &e) override;
+    void visit(AstScope &e) override;
+    void visit(AstArray &e) override;
+    void visit(AstFunction &e) override;
+    void visit(AstVariable &e) override;
+    void visit(AstNumber &e) override;
+
+private:
+    /// The range of the variables.
+    const std::map<std::string, Interval> &ranges;
+    /// The variable we are differentiating against.
+    std::string wrt;
+    /// The value of the last visited node.
+    Interval value;
+    /// The derivative of the last visited node.
+    Interval slope;
+
+    /// @brief Applies the operator of the node to the value and derivative
+    ///        of its left operand, the last ones computed, and to its right
+    ///        operand.
+    void combine(AstBinary &e);
+};
+
+/// @brief The result of a range analysis.
+struct RangeAnalysis {
+    /// The bounds of the expression.
+    Interval bounds;
+    /// The monotonicity of the expression w.r.t. each variable.
+    std::map<std::string, Monotonicity> monotonicity;
+};
+
+/// @brief Computes bounds and per-variable monotonicity of an expression.
+///        The bounds are tightened by pinning each monotone variable to
+///        the endpoint of its range which minimizes (maximizes) the
+///        expression, which removes most of the overestimation due to
+///        repeated variables.
+/// @param node   the expression.
+/// @param ranges the range of each variable.
+/// @return The bounds and the monotonicity.
+RangeAnalysis analyze_range(AstNode *node, const std::map<std::string, Interval> &ranges);
+
+} // namespace expar
@@ -0,0 +1,121 @@
+/// @file   kernel.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "program.hpp"
+
+namespace expar
+{
+/// @brief Many expressions over the same variables, compiled together into
+///        a single program with one output for each expression. The
+///        expressions become a graph where equal subexpressions, within an
+///        expression or across them, are computed once: each variable is
+///        loaded once, and each constant, operation and call of a pure
+///        function on the same operands is shared (operands of commutative
+///        operators are matched in any order). Calls of pure functions on
+///        constants are folded, and the operations whose values are not
+///        needed are dropped. The operations then run in order over a set
+///        of registers, which are reused once their values are no longer
+///        needed, and each output is written as soon as it is computed.
+///        Both the branches of a conditional and both the operands of the
+///        logical operators are computed, and the results selected, on
+///        single points as well as on batches; calls of impure functions
+///        are never shared. The random functions return their nominal value.
+class Kernel {
+public:
+    /// @brief Compiles the expressions.
+    /// @param expressions the expressions, their position is the index of
+    ///                    the corresponding output.
+    /// @param variables   the variables, their position is the index of the
+    ///                    corresponding input.
+    /// @param registry    the functions which can be called.
+    Kernel(const std::vector<AstNode *> &expressions,
+           std::vector<std::string> variables,
+           const FunctionRegistry &registry = FunctionRegistry::standard());
+
+    /// @brief Returns the variables, in input order.
+    inline const std::vector<std::string> &get_variables() const
+    {
+        return variables;
+    }
+
+    /// @brief Returns the number of outputs.
+    inline std::size_t get_outputs() const
+    {
+        return outputs;
+    }
+
+    /// @brief Evaluates the expressions on a single point.
+    /// @param values the value of each variable.
+    /// @param out    the value of each expression.
+    void evaluate(const double *values, double *out) const;
+
+    /// @brief Evaluates the expressions on a batch of points.
+    /// @param count  the number of points.
+    /// @param values for each variable, the array of its values.
+    /// @param out    the results, as one array of count values for each
+    ///               expression, one after the other (the value of the i-th
+    ///               expression on the j-th point is out[i * count + j]).
+    void evaluate(std::size_t count, const double *const *values, double *out) const;
+
+    /// @brief A single operation, which reads its operands from registers
+    ///        and writes its result to a register.
+    struct Step {
+        /// The operation, among the ones of a Program except for the jumps
+        /// and the random functions.
+        Program::Code code;
+        /// The variable for p_load, the function for the calls, the table
+        /// for p_table, the number of breakpoints for p_pwl.
+        std::size_t index;
+        /// The value for p_const, the exponent for p_ipow.
+        double constant;
+        /// Where the operands begin among the operands of the kernel.
+        std::size_t first;
+        /// The number of operands (the condition and the two branches, for
+        /// p_select).
+        std::size_t arity;
+        /// The register of the result.
+        std::size_t target;
+    };
+
+    /// @brief Returns the operations, in order.
+    inline const std::vector<Step> &get_steps() const
+    {
+        return steps;
+    }
+
+    /// @brief Returns the number of registers.
+    inline std::size_t get_registers() const
+    {
+        return registers;
+    }
+
+private:
+    /// The variables.
+    std::vector<std::string> variables;
+    /// The functions which are called.
+    std::vector<Function> functions;
+    /// The tables which are looked up.
+    std::vector<Table> tables;
+    /// The operations, in order.
+    std::vector<Step> steps;
+    /// The registers of the operands of each operation.
+    std::vector<std::size_t> operands;
+    /// The outputs written after each operation, as pairs of operation and
+    /// output, in the order of the operations.
+    std::vector<std::pair<std::size_t, std::size_t>> writes;
+    /// The number of registers.
+    std::size_t registers;
+    /// The largest number of operands of an operation.
+    std::size_t width;
+    /// The number of outputs.
+    std::size_t outputs;
+
+    /// @brief Evaluates a chunk of points, the registers hold chunk_size
+    ///        values each, and args has room for the operands of any
+    ///        operation.
+    void evaluate_chunk(std::size_t count, const double *const *values, double *storage, double *args, double *out, std::size_t stride) const;
+};
+
+} // namespace expar
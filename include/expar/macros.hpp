@@ -0,0 +1,72 @@
+/// @file   macros.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+#include <map>
+
+namespace expar
+{
+/// @brief The default number of nodes which the expansion of the calls can
+///        add to an expression.
+constexpr std::size_t default_expansion_budget = 100000;
+
+/// @brief Functions written as expressions of their parameters (e.g., the
+///        `.func` of SPICE decks). Instead of being called, they are
+///        expanded: each call is replaced by a copy of the body where the
+///        parameters are replaced by the arguments, so that the result is
+///        a single expression, which is compiled (and optimized) as a whole.
+class MacroTable {
+public:
+    /// @brief Construct an empty table.
+    MacroTable();
+
+    /// @brief Deletes the bodies of the functions.
+    ~MacroTable();
+
+    MacroTable(const MacroTable &)            = delete;
+    MacroTable &operator=(const MacroTable &) = delete;
+
+    /// @brief Defines (or redefines) a function from its text, written as
+    ///        `name(a, b, ...) = body`.
+    /// @param definition the text.
+    void define(const std::string &definition);
+
+    /// @brief Defines (or redefines) a function.
+    /// @param name       the name.
+    /// @param parameters the names of the parameters.
+    /// @param body       the body, which the table takes ownership of.
+    void define(const std::string &name, std::vector<std::string> parameters, AstNode *body);
+
+    /// @brief Checks if there is a function with the given name.
+    bool contains(const std::string &name) const;
+
+    /// @brief Replaces the calls to the functions of the table, also those
+    ///        made by the bodies and by the arguments, without recursion.
+    ///        The calls made by a body are expanded after its parameters
+    ///        are replaced, so names which are not parameters keep their
+    ///        meaning. The tree is modified in place, and calls to other functions
+    ///        are left untouched. Functions which call themselves (also
+    ///        indirectly) and expansions adding more than budget nodes are
+    ///        reported as errors, in which case the expression is deleted.
+    /// @param node   the expression.
+    /// @param budget the number of nodes the expansion can add.
+    /// @return The expanded expression, which replaces node.
+    AstNode *expand(AstNode *node, std::size_t budget = default_expansion_budget) const;
+
+    /// @brief A function of the table.
+    struct Macro {
+        /// The names of the parameters.
+        std::vector<std::string> parameters;
+        /// The body.
+        AstNode *body;
+    };
+
+private:
+    /// The functions.
+    std::map<std::string, Macro> macros;
+};
+
+} // namespace expar
@@ -1,8 +1,100 @@
+#pragma once
 
 #include "core.hpp"
 
 namespace expar::parser
 {
-AstNode *parse(const std::string &str);
+/// @brief The default limit on how deep brackets, prefix operators and
+///        right-associative operators can be nested.
+constexpr std::size_t default_max_depth = 1000;
 
-} // namespace expar::parser
\ No newline at end of file
+/// @brief Parses the text.
+/// @param str       the text.
+/// @param max_depth the limit on how deep brackets, prefix operators and
+///                  right-associative operators can be nested, deeper
+///                  expressions are rejected before they are parsed (chains
+///                  of left-associative operators have no limit).
+/// @return The expression, which must be deleted by the caller.
+AstNode *parse(const std::string &str, std::size_t max_depth = default_max_depth);
+
+/// @brief Parses a text holding many expressions, one for each line or
+///        separated by semicolons (see scan::split), so that each one can be
+///        lexed and parsed on its own.
+/// @param text      the text.
+/// @param threads   how many threads parse the expressions.
+/// @param max_depth the limit on the nesting of each expression (see parse).
+/// @return The expressions, in order, which must be deleted by the caller.
+///         The positions of their nodes are within the whole text.
+std::vector<AstNode *> parse_all(const std::string &text,
+                                 std::size_t threads   = 1,
+                                 std::size_t max_depth = default_max_depth);
+
+/// @brief A token of the source text.
+struct Token {
+    /// The type of token (see ExparLexer).
+    std::size_t type;
+    /// Position of the first character.
+    std::size_t begin;
+    /// Position past the last character.
+    std::size_t end;
+};
+
+/// @brief A replacement of a portion of the source text.
+struct TextEdit {
+    /// Where the edit starts.
+    std::size_t offset;
+    /// How many characters are removed.
+    std::size_t removed;
+    /// The text inserted in their place.
+    std::string inserted;
+};
+
+/// @brief The result of a parse, which can be kept up to date with the
+///        edits of the source text (see reparse).
+class ParseResult {
+public:
+    /// The source text.
+    std::string text;
+    /// The tokens of the source text.
+    std::vector<Token> tokens;
+    /// The expression.
+    AstNode *root;
+    /// The limit on the nesting of the expression (see parse).
+    std::size_t max_depth;
+
+    ParseResult()
+        : text(),
+          tokens(),
+          root(nullptr),
+          max_depth(default_max_depth)
+    {
+        // Nothing to do.
+    }
+
+    ~ParseResult()
+    {
+        delete root;
+    }
+
+    ParseResult(const ParseResult &) = delete;
+    ParseResult &operator=(const ParseResult &) = delete;
+};
+
+/// @brief Parses the text, keeping what is needed for incremental updates.
+/// @param str the text.
+/// @param result where the result is stored.
+void parse(const std::string &str, ParseResult &result);
+
+/// @brief Applies an edit to the text and updates the tree. Only the tokens
+///        around the edit are lexed again, and only the innermost bracketed
+///        construct (or the single atom) enclosing them is parsed again,
+///        the rest of the tree is reused. When the edit changes the shape of
+///        the surrounding expression everything is parsed again.
+/// @param result the result of a previous parse, which is updated.
+/// @param edit the edit.
+/// @return The nodes which are new or have different children, the nodes
+///         which are not listed are unchanged (their position in the text
+///         might have shifted).
+std::vector<AstNode *> reparse(ParseResult &result, const TextEdit &edit);
+
+} // namespace expar::parser
@@ -0,0 +1,111 @@
+/// @file   profile.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <unordered_map>
+
+namespace expar
+{
+/// @brief The time spent evaluating each node of a set of expressions, as
+///        measured by an Evaluator given the profile. The time of a node
+///        includes the one of its children, its self time does not (both
+///        include the cost of reading the clock). Only the expressions
+///        added to the profile are reported, with their name, and their
+///        nodes with the path from the root and the text they were parsed
+///        from; the nodes of other expressions are never read, as they may
+///        be gone by then. A profile is updated by a single thread at a time.
+class Profile {
+public:
+    /// @brief Construct an empty profile.
+    Profile();
+
+    /// @brief Adds an expression, so that its nodes are reported by name.
+    /// @param node the expression, which must outlive the profile.
+    /// @param name the name of the expression.
+    /// @param text the text the expression was parsed from (if any).
+    void add(AstNode *node, std::string name, std::string text = std::string());
+
+    /// @brief Records an evaluation of the node.
+    /// @param node     the node.
+    /// @param total_ns the time, including the children, in nanoseconds.
+    /// @param self_ns  the time, excluding the children, in nanoseconds.
+    inline void record(AstNode *node, std::uint64_t total_ns, std::uint64_t self_ns)
+    {
+        Counters &counters = nodes[node];
+        counters.calls += 1;
+        counters.total_ns += total_ns;
+        counters.self_ns += self_ns;
+    }
+
+    /// @brief A node, with its measures.
+    struct HotSpot {
+        /// The name of the expression.
+        std::string expression;
+        /// The path from the root, as the labels of the nodes separated by
+        /// `/`, each child preceded by its position among its siblings (e.g.,
+        /// `+/1:sin()/0:x` is the argument of sin in `y + sin(x)`).
+        std::string path;
+        /// The text of the node (empty if not known).
+        std::string text;
+        /// The evaluations of the node.
+        std::uint64_t calls;
+        /// The time, including the children, in nanoseconds.
+        std::uint64_t total_ns;
+        /// The time, excluding the children, in nanoseconds.
+        std::uint64_t self_ns;
+    };
+
+    /// @brief Returns the nodes which took the most self time, in order.
+    /// @param count the maximum number of nodes.
+    std::vector<HotSpot> hot_spots(std::size_t count = std::numeric_limits<std::size_t>::max()) const;
+
+    /// @brief Returns the expressions which took the most time, in order.
+    /// @param count the maximum number of expressions.
+    std::vector<HotSpot> expressions(std::size_t count = std::numeric_limits<std::size_t>::max()) const;
+
+    /// @brief Writes a report of the expressions and of the nodes which took
+    ///        the most time.
+    /// @param stream where the report is written.
+    /// @param count  the number of expressions, and of nodes, reported.
+    void report(std::ostream &stream, std::size_t count = 20) const;
+
+    /// @brief Writes the self time of the nodes as folded stacks (one line
+    ///        of `expression;frame;...;frame nanoseconds` for each node),
+    ///        the input of flame graph tools.
+    void folded(std::ostream &stream) const;
+
+    /// @brief Forgets the measures, keeping the expressions.
+    void clear();
+
+private:
+    /// @brief The measures of a node.
+    struct Counters {
+        std::uint64_t calls    = 0;
+        std::uint64_t total_ns = 0;
+        std::uint64_t self_ns  = 0;
+    };
+
+    /// @brief An expression added to the profile.
+    struct Root {
+        AstNode *node;
+        std::string name;
+        std::string text;
+    };
+
+    /// The measures of each node.
+    std::unordered_map<AstNode *, Counters> nodes;
+    /// The expressions.
+    std::vector<Root> roots;
+
+    /// @brief Returns the measured nodes of the expressions, with their
+    ///        expression, path and text, as folded frames when folded is set.
+    std::vector<HotSpot> collect(bool folded) const;
+};
+
+} // namespace expar
@@ -0,0 +1,288 @@
+/// @file   program.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+#include "functions.hpp"
+#include "random.hpp"
+#include "table.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace expar
+{
+/// @brief An expression compiled for the repeated evaluation over the real
+///        numbers. Variables are resolved to input positions and functions
+///        are bound once, when compiling, and calls of pure functions on
+///        constant arguments are folded. Calls of `pwl` and `table` (unless
+///        the registry defines them) with constant breakpoints become
+///        lookups in a Table. Batches are processed in chunks of points,
+///        each operation running over a contiguous array. On a single
+///        point, conditionals and the logical operators skip the operands
+///        they do not need; on batches, both sides are computed and the
+///        results are selected point by point, without branches. Batches
+///        can also be evaluated in single precision, or stored in single
+///        precision and computed in double. Evaluations on single points
+///        can skip the calls of pure functions whose arguments repeat, by
+///        keeping their results in a Memo. The random functions (see
+///        random::Distribution) return their nominal value, unless the
+///        points are samples of a Monte Carlo run.
+class Program {
+public:
+    /// @brief Compiles the expression.
+    /// @param node      the expression.
+    /// @param variables the variables, their position is the index of the
+    ///                  corresponding input.
+    /// @param registry  the functions which can be called.
+    Program(AstNode *node,
+            std::vector<std::string> variables,
+            const FunctionRegistry &registry = FunctionRegistry::standard());
+
+    /// @brief Returns the variables, in input order.
+    inline const std::vector<std::string> &get_variables() const
+    {
+        return variables;
+    }
+
+    /// @brief Evaluates the expression on a single point.
+    /// @param values the value of each variable.
+    /// @return The value of the expression.
+    double evaluate(const double *values) const;
+
+    /// @brief Evaluates the expression on a batch of points.
+    /// @param count  the number of points.
+    /// @param values for each variable, the array of its values.
+    /// @param out    the results.
+    void evaluate(std::size_t count, const double *const *values, double *out) const;
+
+    /// @brief Evaluates the expression on a single point, as a sample of a
+    ///        Monte Carlo run, where the random functions add their
+    ///        deviations (the other evaluations return their nominal value).
+    /// @param values the value of each variable.
+    /// @param sample the sample.
+    /// @return The value of the expression.
+    double evaluate(const double *values, const random::Sample &sample) const;
+
+    /// @brief Evaluates the expression on a batch of samples of a Monte Carlo
+    ///        run, the i-th point being the sample first.index + i. The
+    ///        results are the same of the evaluations of each sample alone.
+    /// @param count  the number of points.
+    /// @param values for each variable, the array of its values.
+    /// @param out    the results.
+    /// @param first  the sample of the first point.
+    void evaluate(std::size_t count, const double *const *values, double *out, const random::Sample &first) const;
+
+    /// @brief The precision of the evaluation on single precision batches.
+    enum Precision {
+        prec_single, ///< Values are computed in single precision.
+        prec_mixed   ///< Values are stored in single precision, but computed
+                     ///< in double precision.
+    };
+
+    /// @brief Evaluates the expression on a batch of points, in single
+    ///        precision. Calls of functions are computed in double precision
+    ///        and their results are rounded.
+    /// @param count     the number of points.
+    /// @param values    for each variable, the array of its values.
+    /// @param out       the results.
+    /// @param precision the precision of the computation.
+    void evaluate(std::size_t count,
+                  const float *const *values,
+                  float *out,
+                  Precision precision = prec_single) const;
+
+    /// @brief The difference between evaluations in different precisions.
+    struct PrecisionError {
+        /// The maximum absolute difference.
+        double absolute;
+        /// The maximum difference relative to the value in double precision.
+        double relative;
+    };
+
+    /// @brief Estimates the error of the evaluation in single precision on a
+    ///        sample of points, by comparing it with the one in double
+    ///        precision. The points are rounded to single precision first,
+    ///        as if they were stored that way.
+    /// @param count     the number of points.
+    /// @param values    for each variable, the array of its values.
+    /// @param precision the precision to assess.
+    /// @return The maximum errors over the sample, where the two evaluations
+    ///         disagree on a value being a number, the error is infinite.
+    PrecisionError estimate_error(std::size_t count, const double *const *values, Precision precision) const;
+
+    /// @brief The operations of the program.
+    enum Code {
+        p_const,
+        p_load,
+        p_add,
+        p_sub,
+        p_mul,
+        p_div,
+        p_mod,
+        p_pow,
+        p_ipow,
+        p_neg,
+        p_not,
+        p_eq,
+        p_neq,
+        p_lt,
+        p_gt,
+        p_le,
+        p_ge,
+        p_and,
+        p_or,
+        p_xor,
+        p_bor,
+        p_band,
+        p_bsl,
+        p_bsr,
+        p_call1,
+        p_call2,
+        p_call,
+        p_table,
+        p_pwl,
+        p_if,
+        p_else,
+        p_select,
+        p_and_then,
+        p_or_else,
+        p_gauss,
+        p_agauss,
+        p_unif,
+        p_aunif
+    };
+
+    /// @brief A single operation, working on the top of the stack.
+    struct Instruction {
+        Code code;
+        /// The variable for p_load, the function for the calls, the table
+        /// for p_table, the number of breakpoints for p_pwl, the position
+        /// where single points continue for the jumps (p_if, p_else,
+        /// p_and_then and p_or_else), the call site for the random
+        /// functions.
+        std::size_t index;
+        /// The value for p_const, the exponent for p_ipow.
+        double constant;
+    };
+
+    /// @brief Returns the operations, in postfix order.
+    inline const std::vector<Instruction> &get_code() const
+    {
+        return code;
+    }
+
+    /// @brief The caches of the calls of pure functions of a program, used
+    ///        by the evaluations on single points. Each call keeps its last
+    ///        results, keyed on the bits of the arguments, so that calls
+    ///        whose arguments did not change since a previous evaluation
+    ///        are skipped. The hit rate of each call is measured over a
+    ///        window of lookups: where it stays below the minimum, caching
+    ///        is suspended for a growing number of calls, then tried again.
+    ///        A memo is not shared between threads.
+    class Memo {
+    public:
+        /// @brief Builds the caches for the calls of the program.
+        /// @param program      the program.
+        /// @param entries      the results kept by each call.
+        /// @param min_hit_rate the hit rate below which caching is suspended.
+        Memo(const Program &program, std::size_t entries = 4, double min_hit_rate = 0.25);
+
+        /// @brief Returns the number of lookups, excluding the calls made
+        ///        while caching was suspended.
+        inline std::size_t get_lookups() const
+        {
+            return lookups;
+        }
+
+        /// @brief Returns the number of calls which were skipped.
+        inline std::size_t get_hits() const
+        {
+            return hits;
+        }
+
+        /// @brief Returns the number of calls whose caching is suspended.
+        std::size_t get_suspended() const;
+
+    private:
+        friend class Program;
+
+        /// @brief The cache of a single call.
+        struct Site {
+            /// The number of arguments.
+            std::size_t arity;
+            /// The bits of the arguments of each entry.
+            std::vector<std::uint64_t> keys;
+            /// The result of each entry.
+            std::vector<double> results;
+            /// The entries in use.
+            std::size_t used;
+            /// The entry replaced by the next result.
+            std::size_t next;
+            /// The lookups and the hits in the current window.
+            std::size_t window_lookups, window_hits;
+            /// The calls left before caching is tried again, and how many
+            /// calls the next suspension lasts.
+            std::size_t suspended, backoff;
+        };
+
+        /// The program.
+        const Program *program;
+        /// The cache of each instruction, -1 for those without one.
+        std::vector<std::size_t> site_of;
+        /// The caches.
+        std::vector<Site> sites;
+        /// The hit rate below which caching is suspended.
+        double min_hit_rate;
+        /// The totals over all the caches.
+        std::size_t lookups, hits;
+
+        /// @brief Looks up the result of the call at the given position.
+        /// @return true if it was found, and stored into result.
+        bool find(std::size_t position, const double *args, double &result);
+
+        /// @brief Stores the result of the call at the given position.
+        void store(std::size_t position, const double *args, double result);
+    };
+
+    /// @brief Evaluates the expression on a single point, skipping the calls
+    ///        of pure functions whose results are in the memo.
+    /// @param values the value of each variable.
+    /// @param memo   the caches, built for this program.
+    /// @return The value of the expression.
+    double evaluate(const double *values, Memo &memo) const;
+
+private:
+    /// The variables.
+    std::vector<std::string> variables;
+    /// The functions which are called.
+    std::vector<Function> functions;
+    /// The tables which are looked up.
+    std::vector<Table> tables;
+    /// The operations, in postfix order.
+    std::vector<Instruction> code;
+    /// The maximum depth of the stack.
+    std::size_t depth;
+
+    /// @brief Evaluates a single point, using the memo when Memoize is set,
+    ///        and drawing the deviations when there is a sample.
+    template <bool Memoize>
+    double evaluate_point(const double *values, Memo *memo, const random::Sample *sample) const;
+
+    /// @brief Evaluates a chunk of points, computing with values of type T.
+    ///        The points array has room for the breakpoints of the largest
+    ///        piecewise-linear function. When there is a sample, it is the
+    ///        one of the first point.
+    template <typename T, typename Input>
+    void evaluate_chunk(std::size_t count, const Input *const *values, T *stack, double *points, const random::Sample *sample) const;
+
+    /// @brief Evaluates a batch of points, computing with values of type T.
+    template <typename T, typename Input, typename Output>
+    void evaluate_batch(std::size_t count,
+                        const Input *const *values,
+                        Output *out,
+                        const random::Sample *sample = nullptr) const;
+};
+
+} // namespace expar
@@ -0,0 +1,98 @@
+/// @file   random.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace expar::random
+{
+/// @brief A sample of a Monte Carlo run. The draws of a call of the random
+///        functions depend only on the seed, the index of the sample and
+///        the call site (the position of the call among the random calls
+///        of the expression, in reading order), so that they are the same
+///        whatever the order, the threads or the batches in which the
+///        samples are evaluated.
+struct Sample {
+    /// The seed of the run.
+    std::uint64_t seed = 0;
+    /// The index of the sample.
+    std::uint64_t index = 0;
+};
+
+/// @brief The random functions (unless the registry defines them):
+///        `gauss(value, relative, sigmas)` and
+///        `agauss(value, absolute, sigmas)` add a normal deviation whose
+///        standard deviation is the variation divided by sigmas,
+///        `unif(value, relative)` and `aunif(value, absolute)` add a
+///        uniform deviation within the variation. The relative variations
+///        are multiplied by the value. Without a sample, they return the
+///        value itself.
+enum Distribution {
+    dist_gauss,  ///< Relative normal deviation.
+    dist_agauss, ///< Absolute normal deviation.
+    dist_unif,   ///< Relative uniform deviation.
+    dist_aunif   ///< Absolute uniform deviation.
+};
+
+/// @brief Finds the random function with the given name and arity.
+/// @return true if found, and stored into distribution.
+bool find(const std::string &name, std::size_t arity, Distribution &distribution);
+
+/// @brief Applies the deviation to the value.
+/// @param distribution the distribution.
+/// @param args         the arguments of the call.
+/// @param draw         the draw, normal or uniform in [-1, 1).
+inline double apply(Distribution distribution, const double *args, double draw)
+{
+    switch (distribution) {
+    case dist_gauss:
+        return args[0] * (1. + args[1] * draw / args[2]);
+    case dist_agauss:
+        return args[0] + args[1] * draw / args[2];
+    case dist_unif:
+        return args[0] * (1. + args[1] * draw);
+    default:
+        return args[0] + args[1] * draw;
+    }
+}
+
+/// @brief The Philox 4x32 generator, with 10 rounds: a bijection of the
+///        counter under the key, whose outputs pass as random.
+/// @param counter the counter, replaced by the output.
+/// @param key     the key.
+inline void philox(std::uint32_t counter[4], const std::uint32_t key[2])
+{
+    std::uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+        std::uint64_t p0 = std::uint64_t(0xD2511F53) * counter[0];
+        std::uint64_t p1 = std::uint64_t(0xCD9E8D57) * counter[2];
+        std::uint32_t x0 = static_cast<std::uint32_t>(p1 >> 32) ^ counter[1] ^ k0;
+        std::uint32_t x2 = static_cast<std::uint32_t>(p0 >> 32) ^ counter[3] ^ k1;
+        counter[0] = x0, counter[1] = static_cast<std::uint32_t>(p1);
+        counter[2] = x2, counter[3] = static_cast<std::uint32_t>(p0);
+        k0 += 0x9E3779B9, k1 += 0xBB67AE85;
+    }
+}
+
+/// @brief Returns the draw of a call site for a sample.
+/// @param distribution the distribution, which selects a normal draw or a
+///                     uniform one in [-1, 1).
+/// @param seed         the seed of the run.
+/// @param sample       the index of the sample.
+/// @param site         the call site.
+double draw(Distribution distribution, std::uint64_t seed, std::uint64_t sample, std::uint64_t site);
+
+/// @brief Computes the draws of a call site for consecutive samples, the
+///        same of draw() for each of them.
+/// @param distribution the distribution.
+/// @param seed         the seed of the run.
+/// @param first        the index of the first sample.
+/// @param site         the call site.
+/// @param count        the number of samples.
+/// @param out          the draws.
+void draw(Distribution distribution, std::uint64_t seed, std::uint64_t first, std::uint64_t site, std::size_t count, double *out);
+
+} // namespace expar::random
@@ -0,0 +1,60 @@
+/// @file   scan.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace expar::scan
+{
+/// @brief The number of bytes classified together.
+constexpr std::size_t block_size = 64;
+
+/// @brief The classes of the bytes of a block, one bit for each byte (the
+///        lowest bit is the first byte).
+struct Block {
+    /// Spaces, tabs and carriage returns.
+    std::uint64_t whitespace;
+    /// Line feeds.
+    std::uint64_t newlines;
+    /// The digits.
+    std::uint64_t digits;
+    /// Letters, underscores, dollars, at signs and pound signs.
+    std::uint64_t identifiers;
+    /// Any other printable character (operators, brackets and punctuation).
+    std::uint64_t operators;
+    /// The semicolons, which are also operators.
+    std::uint64_t semicolons;
+    /// The slashes, which are also operators.
+    std::uint64_t slashes;
+};
+
+/// @brief Classifies a block of bytes, with AVX2 or SSE2 when available.
+/// @param data  the bytes.
+/// @param count how many bytes, at most block_size. The missing ones are
+///              classified as whitespace.
+/// @return The classes of the bytes.
+Block classify(const char *data, std::size_t count);
+
+/// @brief A portion of the text.
+struct Span {
+    /// Position of the first character.
+    std::size_t begin;
+    /// Position past the last character.
+    std::size_t end;
+};
+
+/// @brief Splits a text holding many expressions, separated by newlines or
+///        semicolons. Comments (from `//` to the end of the line) are left
+///        out, as is the trailing whitespace, and expressions made
+///        only of whitespace are dropped. The text is classified a block at
+///        a time, and only the separators and the comments are visited one
+///        by one.
+/// @param text the text.
+/// @return The expressions, in order.
+std::vector<Span> split(const std::string &text);
+
+} // namespace expar::scan
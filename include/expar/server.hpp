@@ -0,0 +1,164 @@
+/// @file   server.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "program.hpp"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace expar
+{
+/// @brief Keeps compiled expressions for the processes of the host, which
+///        connect through a Unix domain socket. Expressions are compiled once,
+///        the first time any client asks for them, and shared by all the
+///        clients. Each client maps a shared memory region, where it writes
+///        the inputs of its batches and the server writes their outputs,
+///        so that values are never sent through the socket.
+class Server {
+public:
+    /// @brief Construct a new server, listening on the given socket (an
+    ///        existing socket file is replaced).
+    /// @param _path     the path of the socket.
+    /// @param _registry the functions which can be called, which must
+    ///                  outlive the server.
+    Server(std::string _path, const FunctionRegistry &_registry = FunctionRegistry::standard());
+
+    /// @brief Stops the server and removes the socket, run() must have
+    ///        returned.
+    ~Server();
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    /// @brief Serves the clients, until stop() is called or clients can no
+    ///        longer be accepted (which is logged). Each client is served by
+    ///        its own thread, which is joined once the client leaves.
+    void run();
+
+    /// @brief Makes run() return, and disconnects the clients. Can be called
+    ///        from any thread.
+    void stop();
+
+    /// @brief Returns the number of expressions compiled so far.
+    std::size_t size() const;
+
+private:
+    /// The path of the socket.
+    std::string path;
+    /// The functions which can be called.
+    const FunctionRegistry &registry;
+    /// The listening socket.
+    int listener;
+    /// If the server is stopping.
+    bool stopping;
+    /// The compiled expressions, and their index by text and variables.
+    std::vector<std::unique_ptr<Program>> programs;
+    std::map<std::string, std::size_t> index;
+    /// The sockets of the clients, and their threads by the number of the
+    /// client.
+    std::set<int> clients;
+    std::map<std::size_t, std::thread> threads;
+    /// The clients which left, whose threads can be joined.
+    std::vector<std::size_t> finished;
+    /// The number of clients served so far.
+    std::size_t served;
+    /// Protects the expressions and the clients.
+    mutable std::mutex mutex;
+
+    /// @brief Serves a client, until it disconnects.
+    void serve(int client, std::size_t id);
+
+    /// @brief Returns the index of the expression, compiling it if needed.
+    std::size_t compile(const std::string &text, const std::vector<std::string> &variables);
+
+    /// @brief Returns the compiled expression.
+    const Program &get(std::size_t id) const;
+};
+
+/// @brief Connects to a Server, with the same interface of a Program. The
+///        batches go through a ring buffer in shared memory: submit()
+///        queues them without waiting, and flush() collects their outputs
+///        in order; a batch which does not fit waits for the older ones.
+class Client {
+public:
+    /// @brief Connects to the server.
+    /// @param path      the path of the socket.
+    /// @param _capacity the bytes of the ring buffer, which must fit the
+    ///                  inputs and the outputs of any batch.
+    Client(const std::string &path, std::size_t _capacity = 1 << 20);
+
+    /// @brief Disconnects from the server.
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    /// @brief Compiles an expression, or finds the one already compiled.
+    /// @param text      the expression.
+    /// @param variables the variables, their position is the index of the
+    ///                  corresponding input.
+    /// @return The identifier of the expression.
+    std::size_t compile(const std::string &text, const std::vector<std::string> &variables);
+
+    /// @brief Evaluates the expression on a single point.
+    /// @param id     the identifier of the expression.
+    /// @param values the value of each variable.
+    /// @return The value of the expression.
+    double evaluate(std::size_t id, const double *values);
+
+    /// @brief Evaluates the expression on a batch of points.
+    /// @param id     the identifier of the expression.
+    /// @param count  the number of points.
+    /// @param values for each variable, the array of its values.
+    /// @param out    the results.
+    void evaluate(std::size_t id, std::size_t count, const double *const *values, double *out);
+
+    /// @brief Queues the evaluation of a batch, the results are written to
+    ///        out by flush(), or by a later submit().
+    void submit(std::size_t id, std::size_t count, const double *const *values, double *out);
+
+    /// @brief Waits for the queued batches.
+    void flush();
+
+private:
+    /// @brief A batch being evaluated.
+    struct Pending {
+        /// Where the batch begins in the ring buffer.
+        std::size_t offset;
+        /// The bytes of the batch.
+        std::size_t size;
+        /// Where the outputs are in the ring buffer.
+        std::size_t output;
+        /// The number of points.
+        std::size_t count;
+        /// Where the outputs are copied.
+        double *out;
+    };
+
+    /// The socket.
+    int socket;
+    /// The shared memory.
+    char *memory;
+    std::size_t capacity;
+    /// The number of variables of each expression.
+    std::map<std::size_t, std::size_t> arity;
+    /// The batches being evaluated, oldest first.
+    std::deque<Pending> pending;
+    /// Where the next batch is written.
+    std::size_t head;
+
+    /// @brief Collects the outputs of the oldest batch.
+    void receive();
+
+    /// @brief Returns where a batch of the given bytes can be written,
+    ///        waiting for older batches if needed.
+    std::size_t reserve(std::size_t size);
+};
+
+} // namespace expar
@@ -0,0 +1,106 @@
+/// @file   solver.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "program.hpp"
+
+#include <limits>
+#include <memory>
+
+namespace expar
+{
+/// @brief How a Solver looks for the roots.
+struct SolverOptions {
+    /// The maximum number of iterations.
+    std::size_t max_iterations = 100;
+    /// A root is found when |f(x) - target| <= tolerance (1 + |target|)...
+    double tolerance = 1e-12;
+    /// ...or when the step is at most step_tolerance (1 + |x|).
+    double step_tolerance = 1e-14;
+    /// The interval known to hold the roots, used when the expression has
+    /// opposite signs at its ends (NaN when there is none).
+    double lower = std::numeric_limits<double>::quiet_NaN();
+    double upper = std::numeric_limits<double>::quiet_NaN();
+};
+
+/// @brief The outcome of the search of a root.
+enum SolverStatus {
+    solve_converged, ///< The root was found.
+    solve_stalled,   ///< The iterations ran out.
+    solve_failed     ///< The method broke down (e.g., a zero derivative,
+                     ///< with no interval to fall back to).
+};
+
+/// @brief What happened while solving a batch.
+struct SolverStats {
+    /// The points where the root was found.
+    std::size_t converged = 0;
+    /// The points where the iterations ran out.
+    std::size_t stalled = 0;
+    /// The points where the method broke down.
+    std::size_t failed = 0;
+    /// The iterations over the batch.
+    std::size_t iterations = 0;
+    /// The evaluations of the expression, and of its derivative, summed
+    /// over the points.
+    std::size_t evaluations = 0;
+    /// The Newton steps, and the bisections which replaced them.
+    std::size_t newton_steps = 0;
+    std::size_t bisections = 0;
+};
+
+/// @brief Finds the values of a variable for which an expression takes
+///        each of many targets, all at once. Newton's method runs over the
+///        whole batch, with the expression and its derivative (computed
+///        from the expression, or by finite differences when the
+///        expression cannot be differentiated) evaluated for all the points
+///        still going at each iteration. Where the residual changes sign,
+///        either at the ends of the given interval or between two
+///        iterations, the root is kept bracketed, and steps leaving the
+///        bracket are replaced by bisections.
+class Solver {
+public:
+    /// @brief Prepares the solver.
+    /// @param expression  the expression.
+    /// @param variable    the variable to solve for.
+    /// @param _parameters the other variables, which have a value for each
+    ///                    point.
+    /// @param registry    the functions which can be called.
+    Solver(AstNode *expression,
+           std::string variable,
+           std::vector<std::string> _parameters = {},
+           const FunctionRegistry &registry     = FunctionRegistry::standard());
+
+    /// @brief Checks if the derivative is computed from the expression.
+    inline bool has_derivative() const
+    {
+        return derivative != nullptr;
+    }
+
+    /// @brief Solves f(x) = target for each point.
+    /// @param count      the number of points.
+    /// @param targets    the target of each point.
+    /// @param roots      the initial guess of each point, replaced by the
+    ///                   root (or the last iterate).
+    /// @param values     for each parameter, the array of its values.
+    /// @param options    how the roots are searched.
+    /// @param status     if given, the outcome for each point.
+    /// @return The statistics of the batch.
+    SolverStats solve(std::size_t count,
+                      const double *targets,
+                      double *roots,
+                      const double *const *values  = nullptr,
+                      const SolverOptions &options = SolverOptions(),
+                      SolverStatus *status         = nullptr) const;
+
+private:
+    /// The number of parameters.
+    std::size_t parameters;
+    /// The expression.
+    std::unique_ptr<Program> function;
+    /// Its derivative, if the expression can be differentiated.
+    std::unique_ptr<Program> derivative;
+};
+
+} // namespace expar
@@ -0,0 +1,34 @@
+/// @file   specialize.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+#include "functions.hpp"
+
+#include <map>
+
+namespace expar
+{
+/// @brief Specializes an expression for the variables whose value is known
+///        (e.g., the parameters fixed for a whole run), leaving a residual
+///        expression of the other ones. The known variables are replaced by
+///        their values, which are folded through the operators, the
+///        conditionals and the calls of pure functions, so that only the
+///        work depending on the other variables is left. Multiplying or
+///        dividing by one, subtracting zero and raising to one are dropped,
+///        since they give back the same value. The targets of assignments
+///        are never replaced, and calls of the random functions are never
+///        dropped (with the conditionals and logical operators around them),
+///        so that the residual expression draws the same deviations. The
+///        expression is left untouched, and the tree is walked without
+///        recursion.
+/// @param node     the expression.
+/// @param bindings the value of the known variables.
+/// @param registry the functions which can be called.
+/// @return The residual expression, which must be deleted by the caller.
+AstNode *specialize(AstNode *node,
+                    const std::map<std::string, double> &bindings,
+                    const FunctionRegistry &registry = FunctionRegistry::standard());
+
+} // namespace expar
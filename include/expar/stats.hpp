@@ -0,0 +1,114 @@
+/// @file   stats.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "enums.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace expar
+{
+/// @brief The number of kinds of node (see NodeKind).
+constexpr std::size_t node_kinds = node_number + 1;
+
+/// @brief A counter which is updated by a single thread, and can be read by
+///        any thread at any time. Updates are plain loads and stores, so
+///        they cost the same as on an ordinary integer.
+class Counter {
+public:
+    Counter()
+        : value(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Adds to the counter, only the owner thread can do it.
+    inline void add(std::uint64_t amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /// @brief Returns the value of the counter.
+    inline std::uint64_t get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> value;
+};
+
+/// @brief The quantities which are measured, T is the type of each one.
+template <typename T>
+struct BasicStatistics {
+    /// Number of parsed texts.
+    T parses;
+    /// Number of tokens lexed.
+    T tokens;
+    /// Number of rules in the parse trees.
+    T parse_tree_nodes;
+    /// Number of nodes built, for each NodeKind.
+    T ast_nodes[node_kinds];
+    /// Bytes taken by the nodes built, without the strings and vectors they
+    /// own (e.g., the names and the arguments of the functions).
+    T node_bytes;
+    /// Time spent lexing, in nanoseconds.
+    T lexing_ns;
+    /// Time spent parsing, in nanoseconds.
+    T parsing_ns;
+    /// Time spent building the trees, in nanoseconds.
+    T building_ns;
+    /// Number of evaluations.
+    T evaluations;
+    /// Time spent evaluating, in nanoseconds.
+    T evaluation_ns;
+};
+
+/// @brief A snapshot of the statistics.
+using Statistics = BasicStatistics<std::uint64_t>;
+
+namespace stats
+{
+/// Whether the statistics are collected, use is_enabled().
+extern std::atomic<bool> active;
+
+/// @brief Turns the collection of the statistics on or off. When off, the
+///        only cost left is checking this flag.
+void enable(bool enabled = true);
+
+/// @brief Checks if the statistics are collected.
+inline bool is_enabled()
+{
+    return active.load(std::memory_order_relaxed);
+}
+
+/// @brief Returns the counters of the calling thread.
+BasicStatistics<Counter> &local();
+
+/// @brief Returns the statistics of all the threads (including the ones
+///        which have ended) since the last reset.
+Statistics snapshot();
+
+/// @brief Starts counting from zero again.
+void reset();
+
+/// @brief Adds the second statistics to the first one.
+void merge(Statistics &into, const Statistics &from);
+
+/// @brief Returns the statistics as lines of `name value`.
+std::string to_string(const Statistics &statistics);
+
+/// @brief Returns a timestamp, in nanoseconds.
+inline std::uint64_t now()
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count());
+}
+
+} // namespace stats
+
+} // namespace expar
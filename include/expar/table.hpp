@@ -0,0 +1,98 @@
+/// @file   table.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace expar
+{
+/// @brief A piecewise-linear function, given by its breakpoints, as used by
+///        the `pwl(x, x1, y1, x2, y2, ...)` and `table(...)` functions.
+///        Outside the breakpoints the first and last values are kept. The
+///        breakpoints are stored in contiguous arrays with the slope of
+///        each segment. Breakpoints on a uniform grid are indexed directly,
+///        the others are found by a branchless binary search.
+class Table {
+public:
+    /// @brief Builds the table.
+    /// @param _xs the abscissas, in non-decreasing order (equal abscissas
+    ///            give a step).
+    /// @param _ys the values.
+    Table(std::vector<double> _xs, std::vector<double> _ys);
+
+    /// @brief Builds the table from interleaved breakpoints.
+    /// @param points the breakpoints, as x1, y1, x2, y2, ...
+    /// @param count  the number of breakpoints.
+    static Table from_points(const double *points, std::size_t count);
+
+    /// @brief Returns the value at the given abscissa.
+    inline double lookup(double x) const
+    {
+        if (!(x > xs.front()))
+            return ys.front();
+        if (!(x < xs.back()))
+            return ys.back();
+        std::size_t k = this->segment(x);
+        return ys[k] + slopes[k] * (x - xs[k]);
+    }
+
+    /// @brief Returns the values at the given abscissas. The segment of the
+    ///        previous point is tried first, so sweeps going through the
+    ///        breakpoints in order rarely search.
+    /// @param count the number of points.
+    /// @param x     the abscissas.
+    /// @param out   the values.
+    void lookup(std::size_t count, const double *x, double *out) const;
+
+    /// @brief Returns the value at the given abscissa, for breakpoints known
+    ///        only when evaluating (no table is built). The breakpoints are
+    ///        checked, and the value is rounded, as in a table.
+    /// @param x      the abscissa.
+    /// @param points the breakpoints, as x1, y1, x2, y2, ...
+    /// @param count  the number of breakpoints.
+    static double interpolate(double x, const double *points, std::size_t count);
+
+    /// @brief Checks if the breakpoints are on a uniform grid.
+    inline bool is_uniform() const
+    {
+        return uniform;
+    }
+
+private:
+    /// The abscissas.
+    std::vector<double> xs;
+    /// The values.
+    std::vector<double> ys;
+    /// The slope of each segment.
+    std::vector<double> slopes;
+    /// If the abscissas are equally spaced.
+    bool uniform;
+    /// The inverse of the spacing, for uniform grids.
+    double inverse_step;
+
+    /// @brief Returns the segment k such that xs[k] <= x < xs[k + 1], for
+    ///        x strictly inside the breakpoints.
+    inline std::size_t segment(double x) const
+    {
+        std::size_t last = xs.size() - 2;
+        if (uniform) {
+            auto k = static_cast<std::size_t>((x - xs[0]) * inverse_step);
+            // Rounding can land one segment off.
+            k = (k > last) ? last : k;
+            k = (xs[k] > x) ? k - 1 : k;
+            return ((k < last) && (xs[k + 1] <= x)) ? k + 1 : k;
+        }
+        const double *base = xs.data();
+        std::size_t n      = last + 1;
+        while (n > 1) {
+            std::size_t half = n / 2;
+            base             = (base[half] <= x) ? base + half : base;
+            n -= half;
+        }
+        return static_cast<std::size_t>(base - xs.data());
+    }
+};
+
+} // namespace expar
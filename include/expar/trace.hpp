@@ -0,0 +1,88 @@
+/// @file   trace.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "stats.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace expar::trace
+{
+/// The number of events kept by each thread, older ones are overwritten.
+constexpr std::size_t events_per_thread = 8192;
+
+/// The number of threads whose events are kept. The events of a thread
+/// which has ended are kept until they are dumped (or cleared), unless
+/// there are more threads than this.
+constexpr std::size_t max_rings = 256;
+
+/// Whether the events are recorded, use is_enabled().
+extern std::atomic<bool> active;
+
+/// @brief Turns the recording of the events on or off. When off, the only
+///        cost left is checking this flag.
+void enable(bool enabled = true);
+
+/// @brief Checks if the events are recorded.
+inline bool is_enabled()
+{
+    return active.load(std::memory_order_relaxed);
+}
+
+/// @brief Records an event of the calling thread, without locks.
+/// @param name  the name of the event, it must outlive the trace (e.g., a
+///              string literal).
+/// @param begin the start, in nanoseconds (see stats::now()).
+/// @param end   the end, in nanoseconds.
+void record(const char *name, std::uint64_t begin, std::uint64_t end);
+
+/// @brief Writes the events of all the threads (including the ones which
+///        have ended) as Chrome trace-event JSON, which can be loaded in
+///        chrome://tracing or Perfetto. Events being recorded while
+///        writing can be missed, and the oldest events of a thread are
+///        left out once the thread overwrites them.
+void dump(std::ostream &stream);
+
+/// @brief Returns the events as Chrome trace-event JSON.
+std::string dump();
+
+/// @brief Forgets the events recorded so far.
+void clear();
+
+/// @brief Records an event which lasts as long as the object.
+class Scope {
+public:
+    /// @brief Starts the event, if the events are recorded.
+    /// @param _name the name of the event (see record()).
+    inline Scope(const char *_name)
+        : name(_name),
+          begin(is_enabled() ? stats::now() : 0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Ends the event.
+    inline ~Scope()
+    {
+        this->finish();
+    }
+
+    /// @brief Ends the event before the end of the scope.
+    inline void finish()
+    {
+        if (begin) {
+            record(name, begin, stats::now());
+            begin = 0;
+        }
+    }
+
+private:
+    const char *name;
+    std::uint64_t begin;
+};
+
+} // namespace expar::trace
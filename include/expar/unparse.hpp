@@ -0,0 +1,27 @@
+/// @file   unparse.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include "core.hpp"
+
+namespace expar
+{
+/// @brief Writes the text of the expression at the end of the buffer. Only
+///        the parentheses required by the precedence of the operators are
+///        added (the scopes in the tree are always kept), and numbers are
+///        written in the shortest form which reads back to the same value.
+///        Nothing is allocated besides the growth of the buffer (and of a
+///        work stack kept by each thread), so reusing the same buffer
+///        (e.g., after a clear) avoids any allocation. Trees of any depth
+///        are written without recursion.
+/// @param node   the expression.
+/// @param buffer where the text is appended.
+void unparse(AstNode *node, std::string &buffer);
+
+/// @brief Returns the text of the expression (see the other overload).
+/// @param node the expression.
+/// @return The text.
+std::string unparse(AstNode *node);
+
+} // namespace expar
@@ -0,0 +1,46 @@
+/// @file   vmath.hpp
+/// @author Enrico Fraccaroli
+
+#pragma once
+
+#include <cstddef>
+
+namespace expar::vmath
+{
+/// @brief The accuracy of the math kernels, measured in units in the last
+///        place (ULP) of the result. Where no cheaper approximation exists
+///        within the bound of a tier, the tier uses the more accurate one.
+enum Accuracy {
+    acc_exact, ///< The C library, correctly rounded in most cases.
+    acc_ulp1,  ///< At most 1 ULP.
+    acc_ulp4   ///< At most 4 ULP.
+};
+
+/// @brief Checks if the kernels process four values at a time with AVX2,
+///        i.e., if the library was built with EXPAR_AVX2.
+bool has_avx2();
+
+/// @brief The kernels on a single value. Arguments outside the range of the
+///        polynomial approximations (e.g., results which overflow or are
+///        subnormal, huge angles, NaN and infinities) are handed to the C
+///        library, so special values follow the standard.
+double exp(double x, Accuracy accuracy = acc_ulp1);
+double log(double x, Accuracy accuracy = acc_ulp1);
+double sqrt(double x, Accuracy accuracy = acc_ulp1);
+double sin(double x, Accuracy accuracy = acc_ulp1);
+double cos(double x, Accuracy accuracy = acc_ulp1);
+/// @brief With acc_ulp4, pow is computed as exp(y * log(x)) when the result
+///        is within [e^-2, e^2]; otherwise, and in the other tiers, it is the
+///        one of the C library.
+double pow(double x, double y, Accuracy accuracy = acc_ulp1);
+
+/// @brief The kernels on arrays, out can be the same array of the input.
+///        They give the same results of the kernels on a single value.
+void exp(std::size_t count, const double *x, double *out, Accuracy accuracy = acc_ulp1);
+void log(std::size_t count, const double *x, double *out, Accuracy accuracy = acc_ulp1);
+void sqrt(std::size_t count, const double *x, double *out, Accuracy accuracy = acc_ulp1);
+void sin(std::size_t count, const double *x, double *out, Accuracy accuracy = acc_ulp1);
+void cos(std::size_t count, const double *x, double *out, Accuracy accuracy = acc_ulp1);
+void pow(std::size_t count, const double *x, const double *y, double *out, Accuracy accuracy = acc_ulp1);
+
+} // namespace expar::vmath
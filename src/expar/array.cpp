@@ -0,0 +1,285 @@
+/// @file   array.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/array.hpp"
+#include "expar/bitwise.hpp"
+#include "expar/random.hpp"
+#include "expar/table.hpp"
+#include "expar/trace.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+/// @brief Returns the length of the result of an operation on arrays of
+///        the given lengths, where single values are repeated.
+static inline std::size_t length_of(std::size_t a, std::size_t b)
+{
+    if ((a == b) || (b == 1))
+        return a;
+    if (a == 1)
+        return b;
+    _error("Cannot combine arrays of %lu and %lu elements!", a, b);
+    return 0;
+}
+
+/// @brief Applies the operation element by element, repeating single
+///        values. The result is stored in one of the operands.
+template <typename Operation>
+static inline Array combine(Array l, Array r, Operation operation)
+{
+    std::size_t count = length_of(l.size(), r.size());
+    if (l.size() == count) {
+        if (r.size() == count) {
+            for (std::size_t i = 0; i < count; ++i)
+                l[i] = operation(l[i], r[i]);
+        } else {
+            double b = r[0];
+            for (std::size_t i = 0; i < count; ++i)
+                l[i] = operation(l[i], b);
+        }
+        return l;
+    }
+    double a = l[0];
+    for (std::size_t i = 0; i < count; ++i)
+        r[i] = operation(a, r[i]);
+    return r;
+}
+
+/// @brief Applies the operation to each element.
+template <typename Operation>
+static inline Array apply(Array x, Operation operation)
+{
+    for (auto &value : x)
+        value = operation(value);
+    return x;
+}
+
+ArrayEvaluator::ArrayEvaluator(const std::map<std::string, Array> &_bindings, const FunctionRegistry &_registry)
+    : bindings(_bindings),
+      registry(_registry)
+{
+    // Nothing to do.
+}
+
+Array ArrayEvaluator::evaluate(AstNode *node)
+{
+    if (node == nullptr)
+        return Array();
+    trace::Scope scope("evaluate");
+    return this->dispatch(node);
+}
+
+Array ArrayEvaluator::visit(AstBinary &e)
+{
+    if (e.type == op_assign)
+        return this->dispatch(e.right);
+    // The chain of left operands is walked down without recursion, then
+    // evaluated from the innermost one out.
+    std::vector<AstBinary *> chain;
+    Array value = this->dispatch(left_chain(&e, chain));
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        value = this->operate(**it, std::move(value));
+    return value;
+}
+
+Array ArrayEvaluator::operate(AstBinary &e, Array l)
+{
+    // Both operands of the logical operators are computed, since the other
+    // elements might need the right one.
+    Array r = this->dispatch(e.right);
+    switch (e.type) {
+    case op_plus:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return a + b; });
+    case op_minus:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return a - b; });
+    case op_mult:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return a * b; });
+    case op_div:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return a / b; });
+    case op_pow:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return std::pow(a, b); });
+    case op_mod:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return std::fmod(a, b); });
+    case op_eq:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a == b) ? 1. : 0.; });
+    case op_neq:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a != b) ? 1. : 0.; });
+    case op_lt:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a < b) ? 1. : 0.; });
+    case op_gt:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a > b) ? 1. : 0.; });
+    case op_le:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a <= b) ? 1. : 0.; });
+    case op_ge:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return (a >= b) ? 1. : 0.; });
+    case op_and:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return ((a != 0.) && (b != 0.)) ? 1. : 0.; });
+    case op_or:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return ((a != 0.) || (b != 0.)) ? 1. : 0.; });
+    case op_xor:
+        return combine(std::move(l), std::move(r), [](double a, double b) { return ((a != 0.) != (b != 0.)) ? 1. : 0.; });
+    case op_bor:
+        return combine(std::move(l), std::move(r), bitwise::bor<double>);
+    case op_band:
+        return combine(std::move(l), std::move(r), bitwise::band<double>);
+    case op_bsl:
+        return combine(std::move(l), std::move(r), bitwise::bsl<double>);
+    case op_bsr:
+        return combine(std::move(l), std::move(r), bitwise::bsr<double>);
+    default:
+        break;
+    }
+    _error("Cannot evaluate binary operator '%s'!", operator_to_string(e.type).c_str());
+    return Array();
+}
+
+Array ArrayEvaluator::visit(AstUnary &e)
+{
+    Array value = this->dispatch(e.right);
+    if (e.type == op_plus)
+        return value;
+    if (e.type == op_minus)
+        return apply(std::move(value), [](double x) { return -x; });
+    if (e.type == op_not)
+        return apply(std::move(value), [](double x) { return (x == 0.) ? 1. : 0.; });
+    _error("Cannot evaluate unary operator '%s'!", operator_to_string(e.type).c_str());
+    return Array();
+}
+
+Array ArrayEvaluator::visit(AstConditional &e)
+{
+    Array condition = this->dispatch(e.condition);
+    // A single condition selects a branch, which is the only one computed.
+    if (condition.size() == 1)
+        return this->dispatch((condition[0] != 0.) ? e.if_true : e.if_false);
+    Array a = this->dispatch(e.if_true);
+    Array b = this->dispatch(e.if_false);
+    length_of(length_of(condition.size(), a.size()), b.size());
+    // Single values are read at each position.
+    std::size_t step_a = (a.size() == 1) ? 0 : 1, step_b = (b.size() == 1) ? 0 : 1;
+    for (std::size_t i = 0; i < condition.size(); ++i)
+        condition[i] = (condition[i] != 0.) ? a[i * step_a] : b[i * step_b];
+    return condition;
+}
+
+Array ArrayEvaluator::visit(AstScope &e)
+{
+    return this->dispatch(e.content);
+}
+
+Array ArrayEvaluator::visit(AstArray &e)
+{
+    Array result;
+    for (auto element : e.content) {
+        Array value = this->dispatch(element);
+        result.insert(result.end(), value.begin(), value.end());
+    }
+    return result;
+}
+
+Array ArrayEvaluator::visit(AstFunction &e)
+{
+    Array result;
+    if (this->reduce(e, result))
+        return result;
+    if (((e.name == "pwl") || (e.name == "table")) && (registry.find(e.name) == nullptr)) {
+        if ((e.content.size() < 3) || (e.content.size() % 2 == 0))
+            _error("Function '%s' expects the abscissa and pairs of breakpoints, received %lu arguments!",
+                   e.name.c_str(), e.content.size());
+        std::vector<double> points(e.content.size() - 1);
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            Array point = this->dispatch(e.content[i + 1]);
+            if (point.size() != 1)
+                _error("The breakpoints of '%s' must be single values!", e.name.c_str());
+            points[i] = point[0];
+        }
+        return apply(this->dispatch(e.content[0]), [&points](double x) {
+            return Table::interpolate(x, points.data(), points.size() / 2);
+        });
+    }
+    // Outside of Monte Carlo runs, random functions give their nominal value.
+    random::Distribution distribution;
+    if (random::find(e.name, e.content.size(), distribution) && (registry.find(e.name) == nullptr))
+        return this->dispatch(e.content[0]);
+    const Function &function = registry.bind(e.name, e.content.size());
+    if (function.unary) {
+        result = this->dispatch(e.content[0]);
+        if (function.batch)
+            function.batch(result.size(), result.data(), result.data());
+        else
+            result = apply(std::move(result), function.unary);
+        return result;
+    }
+    if (function.binary)
+        return combine(this->dispatch(e.content[0]), this->dispatch(e.content[1]), function.binary);
+    std::vector<Array> args(function.arity);
+    std::size_t count = 1;
+    for (std::size_t k = 0; k < function.arity; ++k) {
+        args[k] = this->dispatch(e.content[k]);
+        count   = length_of(count, args[k].size());
+    }
+    double values[max_arity];
+    result.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (std::size_t k = 0; k < function.arity; ++k)
+            values[k] = args[k][(args[k].size() == 1) ? 0 : i];
+        result[i] = function.invoke(values);
+    }
+    return result;
+}
+
+Array ArrayEvaluator::visit(AstVariable &e)
+{
+    auto it = bindings.find(e.name);
+    if (it == bindings.end())
+        _error("There is no value for variable '%s'!", e.name.c_str());
+    return it->second;
+}
+
+Array ArrayEvaluator::visit(AstNumber &e)
+{
+    if (e.imaginary)
+        _error("Cannot evaluate the imaginary number %gi over the real numbers!", e.value);
+    return Array(1, e.value);
+}
+
+bool ArrayEvaluator::reduce(AstFunction &e, Array &result)
+{
+    bool single = (e.content.size() == 1) &&
+                  ((e.name == "sum") || (e.name == "prod") || (e.name == "min") || (e.name == "max") || (e.name == "mean"));
+    bool pair   = (e.content.size() == 2) && (e.name == "dot");
+    if (!single && !pair)
+        return false;
+    const Function *function = registry.find(e.name);
+    if (function && (function->arity == e.content.size()))
+        return false;
+    Array x = this->dispatch(e.content[0]);
+    if (pair)
+        x = combine(std::move(x), this->dispatch(e.content[1]), [](double a, double b) { return a * b; });
+    if (x.empty() && ((e.name == "min") || (e.name == "max")))
+        _error("Function '%s' cannot reduce an empty array!", e.name.c_str());
+    double value = (e.name == "prod") ? 1. : 0.;
+    if (e.name == "prod") {
+        for (double element : x)
+            value *= element;
+    } else if (e.name == "min") {
+        value = x[0];
+        for (double element : x)
+            value = std::fmin(value, element);
+    } else if (e.name == "max") {
+        value = x[0];
+        for (double element : x)
+            value = std::fmax(value, element);
+    } else {
+        for (double element : x)
+            value += element;
+        if (e.name == "mean")
+            value /= static_cast<double>(x.size());
+    }
+    result.assign(1, value);
+    return true;
+}
+
+} // namespace expar
@@ -0,0 +1,445 @@
+/// @file   codegen.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/codegen.hpp"
+#include "expar/trace.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <thread>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace expar
+{
+/// @brief Writes the C++ code of an expression.
+class CodeWriter : public StaticVisitor<CodeWriter> {
+public:
+    CodeWriter(const std::vector<std::string> &_variables, std::ostream &_out)
+        : variables(_variables),
+          out(_out)
+    {
+        // Nothing to do.
+    }
+
+    void visit(AstBinary &e)
+    {
+        if (e.type == op_assign) {
+            this->dispatch(e.right);
+            return;
+        }
+        // The chain of left operands is walked down without recursion: what
+        // comes before the left operands is written outermost first, the
+        // rest innermost first.
+        std::vector<AstBinary *> chain;
+        AstNode *node = left_chain(&e, chain);
+        for (auto link : chain)
+            out << syntax_of(link->type).before;
+        this->dispatch(node);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            Syntax syntax = syntax_of((*it)->type);
+            out << syntax.between;
+            this->dispatch((*it)->right);
+            out << syntax.after;
+        }
+    }
+
+    void visit(AstUnary &e)
+    {
+        if (e.type == op_plus) {
+            this->dispatch(e.right);
+        } else if (e.type == op_minus) {
+            out << "(-";
+            this->dispatch(e.right);
+            out << ")";
+        } else if (e.type == op_not) {
+            out << "((";
+            this->dispatch(e.right);
+            out << " == 0.0) ? 1.0 : 0.0)";
+        } else {
+            _error("Cannot generate code for unary operator '%s'!", operator_to_string(e.type).c_str());
+        }
+    }
+
+    void visit(AstConditional &e)
+    {
+        out << "((";
+        this->dispatch(e.condition);
+        out << " != 0.0) ? ";
+        this->dispatch(e.if_true);
+        out << " : ";
+        this->dispatch(e.if_false);
+        out << ")";
+    }
+
+    void visit(AstScope &e)
+    {
+        this->dispatch(e.content);
+    }
+
+    void visit(AstArray &e)
+    {
+        if (e.content.size() != 1)
+            _error("Cannot generate code for an array of %lu elements!", e.content.size());
+        this->dispatch(e.content[0]);
+    }
+
+    void visit(AstFunction &e)
+    {
+        static const std::map<std::string, std::pair<std::string, std::size_t>> functions = {
+            { "sqrt", { "std::sqrt", 1 } },
+            { "exp", { "std::exp", 1 } },
+            { "log", { "std::log", 1 } },
+            { "log10", { "std::log10", 1 } },
+            { "abs", { "std::fabs", 1 } },
+            { "sin", { "std::sin", 1 } },
+            { "cos", { "std::cos", 1 } },
+            { "tan", { "std::tan", 1 } },
+            { "atan", { "std::atan", 1 } },
+            { "sinh", { "std::sinh", 1 } },
+            { "cosh", { "std::cosh", 1 } },
+            { "tanh", { "std::tanh", 1 } },
+            { "floor", { "std::floor", 1 } },
+            { "ceil", { "std::ceil", 1 } },
+            { "pow", { "std::pow", 2 } },
+            { "atan2", { "std::atan2", 2 } },
+            { "min", { "std::fmin", 2 } },
+            { "max", { "std::fmax", 2 } },
+        };
+        auto it = functions.find(e.name);
+        if (it == functions.end())
+            _error("Cannot generate code for unknown function '%s'!", e.name.c_str());
+        if (e.content.size() != it->second.second)
+            _error("Function '%s' expects %lu arguments, received %lu!", e.name.c_str(), it->second.second, e.content.size());
+        this->call(it->second.first, e.content);
+    }
+
+    void visit(AstVariable &e)
+    {
+        auto it = std::find(variables.begin(), variables.end(), e.name);
+        if (it == variables.end())
+            _error("There is no input for variable '%s'!", e.name.c_str());
+        out << "x[" << (it - variables.begin()) << "]";
+    }
+
+    void visit(AstNumber &e)
+    {
+        if (e.imaginary)
+            _error("Cannot generate code for the imaginary number %gi!", e.value);
+        if (std::isinf(e.value)) {
+            out << ((e.value < 0) ? "(-HUGE_VAL)" : "HUGE_VAL");
+        } else if (std::isnan(e.value)) {
+            out << "NAN";
+        } else {
+            // Hexadecimal literals are exact.
+            char buffer[64];
+            std::snprintf(buffer, sizeof(buffer), "%a", e.value);
+            out << "(" << buffer << ")";
+        }
+    }
+
+private:
+    const std::vector<std::string> &variables;
+    std::ostream &out;
+
+    /// @brief How a binary operator is written, around its operands.
+    struct Syntax {
+        /// The text before the left operand.
+        std::string before;
+        /// The text between the operands.
+        std::string between;
+        /// The text after the right operand.
+        std::string after;
+    };
+
+    static Syntax syntax_of(Operator type)
+    {
+        switch (type) {
+        case op_plus:
+        case op_minus:
+        case op_mult:
+        case op_div:
+            return { "(", " " + operator_to_string(type) + " ", ")" };
+        case op_pow:
+            return { "std::pow(", ", ", ")" };
+        case op_mod:
+            return { "std::fmod(", ", ", ")" };
+        case op_eq:
+        case op_neq:
+        case op_lt:
+        case op_gt:
+        case op_le:
+        case op_ge:
+            return { "((", " " + operator_to_string(type) + " ", ") ? 1.0 : 0.0)" };
+        case op_and:
+        case op_or:
+            return { "(((", " != 0.0) " + operator_to_string(type) + " (", " != 0.0)) ? 1.0 : 0.0)" };
+        case op_xor:
+            return { "(((", " != 0.0) != (", " != 0.0)) ? 1.0 : 0.0)" };
+        case op_bor:
+            return { "expar_bor(", ", ", ")" };
+        case op_band:
+            return { "expar_band(", ", ", ")" };
+        case op_bsl:
+            return { "expar_bsl(", ", ", ")" };
+        case op_bsr:
+            return { "expar_bsr(", ", ", ")" };
+        default:
+            _error("Cannot generate code for binary operator '%s'!", operator_to_string(type).c_str());
+        }
+        return {};
+    }
+
+    void call(const std::string &name, const std::vector<AstNode *> &args)
+    {
+        out << name << "(";
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            if (i > 0)
+                out << ", ";
+            this->dispatch(args[i]);
+        }
+        out << ")";
+    }
+};
+
+CodeGenerator::CodeGenerator(std::vector<std::string> _variables)
+    : variables(std::move(_variables))
+{
+    // Nothing to do.
+}
+
+std::string CodeGenerator::generate(AstNode *expression) const
+{
+    if (expression == nullptr)
+        _error("Cannot generate code for a NULL node!");
+    std::ostringstream ss;
+    CodeWriter writer(variables, ss);
+    writer.dispatch(expression);
+    return ss.str();
+}
+
+/// @brief The bitwise operators of the generated code, a copy of the ones
+///        in bitwise.hpp, which the generated code cannot include.
+static const char *const bitwise_source =
+    "static inline long long expar_integer(double value)\n"
+    "{\n"
+    "    if (value != value)\n"
+    "        return 0;\n"
+    "    if (value >= 9223372036854775808.)\n"
+    "        return LLONG_MAX;\n"
+    "    if (value < -9223372036854775808.)\n"
+    "        return LLONG_MIN;\n"
+    "    return static_cast<long long>(value);\n"
+    "}\n\n"
+    "static inline long long expar_shift(long long value, long long count)\n"
+    "{\n"
+    "    if (count <= -64)\n"
+    "        return (value < 0) ? -1 : 0;\n"
+    "    if (count < 0)\n"
+    "        return value >> -count;\n"
+    "    if (count >= 64)\n"
+    "        return 0;\n"
+    "    return static_cast<long long>(static_cast<unsigned long long>(value) << count);\n"
+    "}\n\n"
+    "static inline double expar_bor(double l, double r)\n"
+    "{\n"
+    "    return static_cast<double>(expar_integer(l) | expar_integer(r));\n"
+    "}\n\n"
+    "static inline double expar_band(double l, double r)\n"
+    "{\n"
+    "    return static_cast<double>(expar_integer(l) & expar_integer(r));\n"
+    "}\n\n"
+    "static inline double expar_bsl(double l, double r)\n"
+    "{\n"
+    "    return static_cast<double>(expar_shift(expar_integer(l), expar_integer(r)));\n"
+    "}\n\n"
+    "static inline double expar_bsr(double l, double r)\n"
+    "{\n"
+    "    long long count = expar_integer(r);\n"
+    "    return static_cast<double>(expar_shift(expar_integer(l), (count == LLONG_MIN) ? LLONG_MAX : -count));\n"
+    "}\n\n";
+
+std::string CodeGenerator::generate(const std::vector<AstNode *> &expressions) const
+{
+    std::ostringstream ss;
+    ss << "// Generated by expar, do not edit.\n";
+    ss << "// Inputs:\n";
+    for (std::size_t i = 0; i < variables.size(); ++i)
+        ss << "//   x[" << i << "] : " << variables[i] << "\n";
+    ss << "#include <climits>\n";
+    ss << "#include <cmath>\n";
+    ss << "#include <cstddef>\n\n";
+    ss << bitwise_source;
+    ss << "extern \"C\" {\n\n";
+    ss << "std::size_t expar_size()\n{\n    return " << expressions.size() << ";\n}\n\n";
+    for (std::size_t i = 0; i < expressions.size(); ++i) {
+        ss << "double expar_expression_" << i << "(const double *x)\n{\n";
+        ss << "    return " << this->generate(expressions[i]) << ";\n}\n\n";
+    }
+    // The fused function repeats the expressions (instead of calling them),
+    // so that the compiler can share the common work.
+    ss << "void expar_evaluate_all(const double *x, double *out)\n{\n";
+    for (std::size_t i = 0; i < expressions.size(); ++i)
+        ss << "    out[" << i << "] = " << this->generate(expressions[i]) << ";\n";
+    ss << "}\n\n";
+    ss << "} // extern \"C\"\n";
+    return ss.str();
+}
+
+/// @brief 64-bit FNV-1a hash.
+static inline std::uint64_t fnv1a(const std::string &text, std::uint64_t hash = 14695981039346656037ULL)
+{
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string default_cache_dir()
+{
+    const char *cache = std::getenv("XDG_CACHE_HOME");
+    if (cache && (cache[0] == '/'))
+        return (std::filesystem::path(cache) / "expar").string();
+    const char *home = std::getenv("HOME");
+    if (home && (home[0] == '/'))
+        return (std::filesystem::path(home) / ".cache" / "expar").string();
+    std::error_code error;
+    std::filesystem::path temporary = std::filesystem::temp_directory_path(error);
+    if (error)
+        temporary = "/tmp";
+    return (temporary / ("expar-" + std::to_string(geteuid()))).string();
+}
+
+/// @brief Returns if the file belongs to the user and cannot be written by
+///        anyone else.
+static inline bool is_private(const std::filesystem::path &path)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return false;
+    return (status.st_uid == geteuid()) && ((status.st_mode & (S_IWGRP | S_IWOTH)) == 0);
+}
+
+/// @brief Creates the cache directory (the last component with mode 0700),
+///        and checks that it can be trusted.
+static inline void prepare_cache(const std::filesystem::path &directory)
+{
+    std::error_code error;
+    if (directory.has_parent_path())
+        std::filesystem::create_directories(directory.parent_path(), error);
+    if (error || ((mkdir(directory.c_str(), 0700) != 0) && (errno != EEXIST)))
+        _error("Cannot create the cache directory '%s'!", directory.c_str());
+    if (!std::filesystem::is_directory(directory) || !is_private(directory))
+        _error("The cache directory '%s' must belong to the user, and be writable only by the user!", directory.c_str());
+}
+
+NativeModule::NativeModule(std::string _path, bool _cached, void *_handle)
+    : path(std::move(_path)),
+      cached(_cached),
+      handle(_handle),
+      functions(),
+      kernel(nullptr)
+{
+    // Nothing to do.
+}
+
+NativeModule::~NativeModule()
+{
+    if (handle)
+        dlclose(handle);
+}
+
+NativeModule *compile_native(const std::vector<AstNode *> &expressions,
+                             const std::vector<std::string> &variables,
+                             const NativeOptions &options)
+{
+    trace::Scope scope("compile native");
+    std::string source = CodeGenerator(variables).generate(expressions);
+    // The name depends on everything which affects the binary.
+    char name[32];
+    std::snprintf(name, sizeof(name), "expar_%016llx",
+                  static_cast<unsigned long long>(fnv1a(options.compiler + " " + options.flags, fnv1a(source))));
+    std::filesystem::path directory(options.cache_dir.empty() ? default_cache_dir() : options.cache_dir);
+    prepare_cache(directory);
+    std::filesystem::path library = directory / (std::string(name) + ".so");
+    bool cached                   = std::filesystem::exists(library);
+    // Objects planted by someone else are never loaded.
+    if (cached && !is_private(library))
+        _error("The cached module '%s' must belong to the user, and be writable only by the user!", library.c_str());
+    if (!cached) {
+        // Each build writes its own source and object, and renames them into
+        // place when done, so that concurrent builds of the same module (from
+        // other processes, or other threads of this one) never compile a
+        // partially written source or load a partially written object.
+        static std::atomic<std::uint64_t> builds(0);
+        std::string unique = std::string(name) + "." + std::to_string(getpid()) + "." +
+                             std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+                             std::to_string(builds.fetch_add(1));
+        std::filesystem::path source_file = directory / (unique + ".cpp");
+        std::filesystem::path temporary   = directory / (unique + ".tmp");
+        auto discard                      = [&]() {
+            std::error_code ignored;
+            std::filesystem::remove(source_file, ignored);
+            std::filesystem::remove(temporary, ignored);
+        };
+        {
+            std::ofstream stream(source_file);
+            stream << source;
+            stream.close();
+            if (!stream) {
+                discard();
+                _error("Cannot write the source of the native module '%s'!", source_file.c_str());
+            }
+        }
+        std::string command = options.compiler + " " + options.flags + " -o '" + temporary.string() + "' '" + source_file.string() + "'";
+        _debug("Building native module: %s", command.c_str());
+        if (std::system(command.c_str()) != 0) {
+            discard();
+            _error("Failed to build native module: %s", command.c_str());
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, library, error);
+        if (error) {
+            discard();
+            _error("Cannot move native module to '%s'!", library.c_str());
+        }
+        // The source is kept next to the object, for inspection.
+        std::filesystem::rename(source_file, directory / (std::string(name) + ".cpp"), error);
+        if (error)
+            discard();
+    }
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+        _error("Cannot load native module '%s': %s", library.c_str(), dlerror());
+    auto module = new NativeModule(library.string(), cached, handle);
+    for (std::size_t i = 0; i < expressions.size(); ++i) {
+        std::string symbol = "expar_expression_" + std::to_string(i);
+        auto function      = reinterpret_cast<NativeFunction>(dlsym(handle, symbol.c_str()));
+        if (function == nullptr) {
+            delete module;
+            _error("Cannot find '%s' in native module '%s'!", symbol.c_str(), library.c_str());
+        }
+        module->functions.emplace_back(function);
+    }
+    module->kernel = reinterpret_cast<NativeKernel>(dlsym(handle, "expar_evaluate_all"));
+    if (module->kernel == nullptr) {
+        delete module;
+        _error("Cannot find 'expar_evaluate_all' in native module '%s'!", library.c_str());
+    }
+    return module;
+}
+
+} // namespace expar
@@ -0,0 +1,570 @@
+/// @file   complex.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/complex.hpp"
+#include "expar/trace.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace expar
+{
+/// @brief The functions of one argument, by name.
+static const std::map<std::string, ComplexProgram::Code> functions = {
+    { "real", ComplexProgram::c_real },
+    { "imag", ComplexProgram::c_imag },
+    { "conj", ComplexProgram::c_conj },
+    { "abs", ComplexProgram::c_abs },
+    { "arg", ComplexProgram::c_arg },
+    { "phase", ComplexProgram::c_arg },
+    { "sqrt", ComplexProgram::c_sqrt },
+    { "exp", ComplexProgram::c_exp },
+    { "log", ComplexProgram::c_log },
+    { "log10", ComplexProgram::c_log10 },
+    { "sin", ComplexProgram::c_sin },
+    { "cos", ComplexProgram::c_cos },
+    { "tan", ComplexProgram::c_tan },
+    { "sinh", ComplexProgram::c_sinh },
+    { "cosh", ComplexProgram::c_cosh },
+    { "tanh", ComplexProgram::c_tanh },
+};
+
+/// @brief Applies a function of one argument to a value.
+static inline Complex apply_code(ComplexProgram::Code code, const Complex &a)
+{
+    switch (code) {
+    case ComplexProgram::c_real:
+        return a.real();
+    case ComplexProgram::c_imag:
+        return a.imag();
+    case ComplexProgram::c_conj:
+        return std::conj(a);
+    case ComplexProgram::c_abs:
+        return std::abs(a);
+    case ComplexProgram::c_arg:
+        return std::arg(a);
+    case ComplexProgram::c_sqrt:
+        return std::sqrt(a);
+    case ComplexProgram::c_exp:
+        return std::exp(a);
+    case ComplexProgram::c_log:
+        return std::log(a);
+    case ComplexProgram::c_log10:
+        return std::log10(a);
+    case ComplexProgram::c_sin:
+        return std::sin(a);
+    case ComplexProgram::c_cos:
+        return std::cos(a);
+    case ComplexProgram::c_tan:
+        return std::tan(a);
+    case ComplexProgram::c_sinh:
+        return std::sinh(a);
+    case ComplexProgram::c_cosh:
+        return std::cosh(a);
+    case ComplexProgram::c_tanh:
+        return std::tanh(a);
+    default:
+        return a;
+    }
+}
+
+ComplexEvaluator::ComplexEvaluator(const std::map<std::string, Complex> &_bindings)
+    : bindings(_bindings),
+      value()
+{
+    // Nothing to do.
+}
+
+Complex ComplexEvaluator::evaluate(AstNode *node)
+{
+    if (node == nullptr)
+        _error("Cannot evaluate a NULL node!");
+    node->accept(*this);
+    return value;
+}
+
+void ComplexEvaluator::visit(AstBinary &e)
+{
+    // The chain of left operands is walked down without recursion, then
+    // evaluated from the innermost one out.
+    std::vector<AstBinary *> chain;
+    this->evaluate(left_chain(&e, chain));
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        this->combine(**it);
+}
+
+void ComplexEvaluator::combine(AstBinary &e)
+{
+    Complex a = value;
+    Complex b = this->evaluate(e.right);
+    switch (e.type) {
+    case op_assign:
+        value = b;
+        break;
+    case op_plus:
+        value = a + b;
+        break;
+    case op_minus:
+        value = a - b;
+        break;
+    case op_mult:
+        value = a * b;
+        break;
+    case op_div:
+        value = a / b;
+        break;
+    case op_pow:
+        value = std::pow(a, b);
+        break;
+    case op_eq:
+        value = (a == b) ? 1. : 0.;
+        break;
+    case op_neq:
+        value = (a != b) ? 1. : 0.;
+        break;
+    default:
+        _error("Cannot evaluate binary operator '%s' on complex values!", operator_to_string(e.type).c_str());
+    }
+}
+
+void ComplexEvaluator::visit(AstUnary &e)
+{
+    Complex a = this->evaluate(e.right);
+    if (e.type == op_plus)
+        value = a;
+    else if (e.type == op_minus)
+        value = Complex() - a;
+    else
+        _error("Cannot evaluate unary operator '%s' on complex values!", operator_to_string(e.type).c_str());
+}
+
+void ComplexEvaluator::visit(AstConditional &e)
+{
+    this->evaluate((this->evaluate(e.condition) != Complex()) ? e.if_true : e.if_false);
+}
+
+void ComplexEvaluator::visit(AstScope &e)
+{
+    this->evaluate(e.content);
+}
+
+void ComplexEvaluator::visit(AstArray &e)
+{
+    if (e.content.size() != 1)
+        _error("Cannot evaluate an array of %lu elements as a single value!", e.content.size());
+    this->evaluate(e.content[0]);
+}
+
+void ComplexEvaluator::visit(AstFunction &e)
+{
+    if (e.name == "pow") {
+        if (e.content.size() != 2)
+            _error("Function 'pow' expects 2 arguments, received %lu!", e.content.size());
+        Complex a = this->evaluate(e.content[0]);
+        Complex b = this->evaluate(e.content[1]);
+        value     = std::pow(a, b);
+        return;
+    }
+    auto it = functions.find(e.name);
+    if (it == functions.end())
+        _error("Unknown function '%s'!", e.name.c_str());
+    if (e.content.size() != 1)
+        _error("Function '%s' expects 1 argument, received %lu!", e.name.c_str(), e.content.size());
+    value = apply_code(it->second, this->evaluate(e.content[0]));
+}
+
+void ComplexEvaluator::visit(AstVariable &e)
+{
+    auto it = bindings.find(e.name);
+    if (it == bindings.end())
+        _error("There is no value for variable '%s'!", e.name.c_str());
+    value = it->second;
+}
+
+void ComplexEvaluator::visit(AstNumber &e)
+{
+    value = e.imaginary ? Complex(0., e.value) : Complex(e.value, 0.);
+}
+
+/// @brief Number of points evaluated together.
+static const std::size_t chunk_size = 256;
+
+/// @brief Translates the expression into a ComplexProgram.
+class ComplexCompiler : public ExpBaseVisitor {
+public:
+    ComplexCompiler(const std::vector<std::string> &_variables,
+                    std::vector<ComplexProgram::Instruction> &_code)
+        : variables(_variables),
+          code(_code),
+          depth(0),
+          max_depth(0)
+    {
+        // Nothing to do.
+    }
+
+    std::size_t get_max_depth() const
+    {
+        return max_depth;
+    }
+
+    void visit(AstBinary &e) override
+    {
+        // The value of an assignment is the one of its right-hand side.
+        if (e.type == op_assign) {
+            e.right->accept(*this);
+            return;
+        }
+        // The chain of left operands is walked down without recursion, then
+        // compiled from the innermost one out.
+        std::vector<AstBinary *> chain;
+        left_chain(&e, chain)->accept(*this);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            this->complete(**it);
+    }
+
+    void visit(AstUnary &e) override
+    {
+        e.right->accept(*this);
+        if (e.type == op_minus)
+            this->emit(ComplexProgram::c_neg);
+        else if (e.type != op_plus)
+            _error("Cannot evaluate unary operator '%s' on complex values!", operator_to_string(e.type).c_str());
+    }
+
+    void visit(AstConditional &) override
+    {
+        _error("Cannot compile conditionals on complex values!");
+    }
+
+    void visit(AstScope &e) override
+    {
+        e.content->accept(*this);
+    }
+
+    void visit(AstArray &e) override
+    {
+        if (e.content.size() != 1)
+            _error("Cannot compile an array of %lu elements as a single value!", e.content.size());
+        e.content[0]->accept(*this);
+    }
+
+    void visit(AstFunction &e) override
+    {
+        if (e.name == "pow") {
+            if (e.content.size() != 2)
+                _error("Function 'pow' expects 2 arguments, received %lu!", e.content.size());
+            e.content[0]->accept(*this);
+            e.content[1]->accept(*this);
+            this->emit(ComplexProgram::c_pow, 1);
+            --depth;
+            return;
+        }
+        auto it = functions.find(e.name);
+        if (it == functions.end())
+            _error("Unknown function '%s'!", e.name.c_str());
+        if (e.content.size() != 1)
+            _error("Function '%s' expects 1 argument, received %lu!", e.name.c_str(), e.content.size());
+        e.content[0]->accept(*this);
+        this->emit(it->second);
+    }
+
+    void visit(AstVariable &e) override
+    {
+        auto it = std::find(variables.begin(), variables.end(), e.name);
+        if (it == variables.end())
+            _error("There is no input for variable '%s'!", e.name.c_str());
+        this->emit(ComplexProgram::c_load, static_cast<std::size_t>(it - variables.begin()));
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+    void visit(AstNumber &e) override
+    {
+        this->emit(ComplexProgram::c_const, 0, e.imaginary ? Complex(0., e.value) : Complex(e.value, 0.));
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+private:
+    const std::vector<std::string> &variables;
+    std::vector<ComplexProgram::Instruction> &code;
+    std::size_t depth;
+    std::size_t max_depth;
+
+    inline void emit(ComplexProgram::Code op, std::size_t index = 0, Complex constant = Complex())
+    {
+        code.emplace_back(ComplexProgram::Instruction{ op, index, constant });
+    }
+
+    /// @brief Compiles the operator of the node, once its left operand is.
+    void complete(AstBinary &e)
+    {
+        // Integer powers are computed by repeated multiplication.
+        auto exponent = dynamic_cast<AstNumber *>(e.right);
+        if ((e.type == op_pow) && exponent && !exponent->imaginary &&
+            (std::trunc(exponent->value) == exponent->value) && (std::abs(exponent->value) <= 64)) {
+            this->emit(ComplexProgram::c_pow, 0, exponent->value);
+            return;
+        }
+        e.right->accept(*this);
+        if (e.type == op_plus)
+            this->emit(ComplexProgram::c_add);
+        else if (e.type == op_minus)
+            this->emit(ComplexProgram::c_sub);
+        else if (e.type == op_mult)
+            this->emit(ComplexProgram::c_mul);
+        else if (e.type == op_div)
+            this->emit(ComplexProgram::c_div);
+        else if (e.type == op_pow)
+            this->emit(ComplexProgram::c_pow, 1);
+        else if (e.type == op_eq)
+            this->emit(ComplexProgram::c_eq);
+        else if (e.type == op_neq)
+            this->emit(ComplexProgram::c_neq);
+        else
+            _error("Cannot evaluate binary operator '%s' on complex values!", operator_to_string(e.type).c_str());
+        --depth;
+    }
+};
+
+/// @brief Raises a complex value to an integer power.
+static inline void ipow(double &re, double &im, long n)
+{
+    double base_re = re, base_im = im, r_re = 1., r_im = 0., t;
+    for (long k = (n < 0) ? -n : n; k; k >>= 1) {
+        if (k & 1) {
+            t    = r_re * base_re - r_im * base_im;
+            r_im = r_re * base_im + r_im * base_re;
+            r_re = t;
+        }
+        t       = base_re * base_re - base_im * base_im;
+        base_im = 2. * base_re * base_im;
+        base_re = t;
+    }
+    if (n < 0) {
+        t    = r_re * r_re + r_im * r_im;
+        r_re = r_re / t;
+        r_im = -r_im / t;
+    }
+    re = r_re;
+    im = r_im;
+}
+
+ComplexProgram::ComplexProgram(AstNode *node, std::vector<std::string> _variables)
+    : variables(std::move(_variables)),
+      code(),
+      depth(0)
+{
+    if (node == nullptr)
+        _error("Cannot compile a NULL node!");
+    trace::Scope scope("compile");
+    ComplexCompiler compiler(variables, code);
+    node->accept(compiler);
+    depth = compiler.get_max_depth();
+}
+
+Complex ComplexProgram::evaluate(const Complex *values) const
+{
+    std::vector<Complex> stack(depth);
+    std::size_t top = 0;
+    for (const auto &instruction : code) {
+        switch (instruction.code) {
+        case c_const:
+            stack[top++] = instruction.constant;
+            break;
+        case c_load:
+            stack[top++] = values[instruction.index];
+            break;
+        case c_add:
+            --top, stack[top - 1] += stack[top];
+            break;
+        case c_sub:
+            --top, stack[top - 1] -= stack[top];
+            break;
+        case c_mul:
+            --top, stack[top - 1] *= stack[top];
+            break;
+        case c_div:
+            --top, stack[top - 1] /= stack[top];
+            break;
+        case c_pow:
+            if (instruction.index) {
+                --top, stack[top - 1] = std::pow(stack[top - 1], stack[top]);
+            } else {
+                double re = stack[top - 1].real(), im = stack[top - 1].imag();
+                ipow(re, im, static_cast<long>(instruction.constant.real()));
+                stack[top - 1] = Complex(re, im);
+            }
+            break;
+        case c_neg:
+            stack[top - 1] = Complex() - stack[top - 1];
+            break;
+        case c_eq:
+            --top, stack[top - 1] = (stack[top - 1] == stack[top]) ? 1. : 0.;
+            break;
+        case c_neq:
+            --top, stack[top - 1] = (stack[top - 1] != stack[top]) ? 1. : 0.;
+            break;
+        default:
+            stack[top - 1] = apply_code(instruction.code, stack[top - 1]);
+            break;
+        }
+    }
+    return stack[0];
+}
+
+void ComplexProgram::evaluate_chunk(std::size_t count,
+                                    const double *const *re,
+                                    const double *const *im,
+                                    double *stack) const
+{
+    // The slot k of the stack keeps the real parts at (2 * k) and the
+    // imaginary parts at (2 * k + 1), each one is chunk_size long.
+    auto real_of = [stack](std::size_t slot) { return stack + (2 * slot) * chunk_size; };
+    auto imag_of = [stack](std::size_t slot) { return stack + (2 * slot + 1) * chunk_size; };
+    std::size_t top = 0;
+    for (const auto &instruction : code) {
+        // The operation works on [a, b] for binary and on [b] for unary.
+        double *a_re = (top > 1) ? real_of(top - 2) : nullptr;
+        double *a_im = (top > 1) ? imag_of(top - 2) : nullptr;
+        double *b_re = (top > 0) ? real_of(top - 1) : nullptr;
+        double *b_im = (top > 0) ? imag_of(top - 1) : nullptr;
+        switch (instruction.code) {
+        case c_const:
+            std::fill(real_of(top), real_of(top) + count, instruction.constant.real());
+            std::fill(imag_of(top), imag_of(top) + count, instruction.constant.imag());
+            ++top;
+            break;
+        case c_load:
+            std::copy(re[instruction.index], re[instruction.index] + count, real_of(top));
+            if (im[instruction.index])
+                std::copy(im[instruction.index], im[instruction.index] + count, imag_of(top));
+            else
+                std::fill(imag_of(top), imag_of(top) + count, 0.);
+            ++top;
+            break;
+        case c_add:
+            for (std::size_t i = 0; i < count; ++i) {
+                a_re[i] += b_re[i];
+                a_im[i] += b_im[i];
+            }
+            --top;
+            break;
+        case c_sub:
+            for (std::size_t i = 0; i < count; ++i) {
+                a_re[i] -= b_re[i];
+                a_im[i] -= b_im[i];
+            }
+            --top;
+            break;
+        case c_mul:
+            for (std::size_t i = 0; i < count; ++i) {
+                double r = a_re[i] * b_re[i] - a_im[i] * b_im[i];
+                a_im[i]  = a_re[i] * b_im[i] + a_im[i] * b_re[i];
+                a_re[i]  = r;
+            }
+            --top;
+            break;
+        case c_div:
+            // Textbook division, without the rescaling of std::complex,
+            // which is accurate as long as |b|^2 does not overflow.
+            for (std::size_t i = 0; i < count; ++i) {
+                double d = b_re[i] * b_re[i] + b_im[i] * b_im[i];
+                double r = (a_re[i] * b_re[i] + a_im[i] * b_im[i]) / d;
+                a_im[i]  = (a_im[i] * b_re[i] - a_re[i] * b_im[i]) / d;
+                a_re[i]  = r;
+            }
+            --top;
+            break;
+        case c_pow:
+            if (instruction.index) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    Complex r = std::pow(Complex(a_re[i], a_im[i]), Complex(b_re[i], b_im[i]));
+                    a_re[i]   = r.real();
+                    a_im[i]   = r.imag();
+                }
+                --top;
+            } else {
+                auto n = static_cast<long>(instruction.constant.real());
+                for (std::size_t i = 0; i < count; ++i)
+                    ipow(b_re[i], b_im[i], n);
+            }
+            break;
+        case c_neg:
+            // Subtract from zero, so that the negation of a real value
+            // keeps a positive zero imaginary part (e.g., sqrt(-1) = i).
+            for (std::size_t i = 0; i < count; ++i) {
+                b_re[i] = 0. - b_re[i];
+                b_im[i] = 0. - b_im[i];
+            }
+            break;
+        case c_eq:
+        case c_neq:
+            for (std::size_t i = 0; i < count; ++i) {
+                bool equal = (a_re[i] == b_re[i]) && (a_im[i] == b_im[i]);
+                a_re[i]    = (equal == (instruction.code == c_eq)) ? 1. : 0.;
+                a_im[i]    = 0.;
+            }
+            --top;
+            break;
+        default:
+            for (std::size_t i = 0; i < count; ++i) {
+                Complex r = apply_code(instruction.code, Complex(b_re[i], b_im[i]));
+                b_re[i]   = r.real();
+                b_im[i]   = r.imag();
+            }
+            break;
+        }
+    }
+}
+
+void ComplexProgram::evaluate(std::size_t count,
+                              const double *const *re,
+                              const double *const *im,
+                              double *out_re,
+                              double *out_im) const
+{
+    trace::Scope scope("evaluate");
+    std::vector<double> stack(2 * depth * chunk_size);
+    std::vector<const double *> chunk_re(variables.size()), chunk_im(variables.size());
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t n = std::min(chunk_size, count - begin);
+        for (std::size_t v = 0; v < variables.size(); ++v) {
+            chunk_re[v] = re[v] + begin;
+            chunk_im[v] = im[v] ? (im[v] + begin) : nullptr;
+        }
+        this->evaluate_chunk(n, chunk_re.data(), chunk_im.data(), stack.data());
+        std::copy(stack.data(), stack.data() + n, out_re + begin);
+        std::copy(stack.data() + chunk_size, stack.data() + chunk_size + n, out_im + begin);
+    }
+}
+
+void ComplexProgram::evaluate(std::size_t count,
+                              const Complex *const *values,
+                              Complex *out) const
+{
+    trace::Scope scope("evaluate");
+    std::vector<double> stack(2 * depth * chunk_size);
+    // The inputs are split into real and imaginary parts chunk by chunk.
+    std::vector<double> inputs(2 * variables.size() * chunk_size);
+    std::vector<const double *> chunk_re(variables.size()), chunk_im(variables.size());
+    for (std::size_t v = 0; v < variables.size(); ++v) {
+        chunk_re[v] = inputs.data() + (2 * v) * chunk_size;
+        chunk_im[v] = inputs.data() + (2 * v + 1) * chunk_size;
+    }
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t n = std::min(chunk_size, count - begin);
+        for (std::size_t v = 0; v < variables.size(); ++v) {
+            double *split_re = inputs.data() + (2 * v) * chunk_size;
+            double *split_im = split_re + chunk_size;
+            for (std::size_t i = 0; i < n; ++i) {
+                split_re[i] = values[v][begin + i].real();
+                split_im[i] = values[v][begin + i].imag();
+            }
+        }
+        this->evaluate_chunk(n, chunk_re.data(), chunk_im.data(), stack.data());
+        for (std::size_t i = 0; i < n; ++i)
+            out[begin + i] = Complex(stack[i], stack[chunk_size + i]);
+    }
+}
+
+} // namespace expar
@@ -14,15 +14,29 @@ void ExpBaseVisitor::visit(AstUnary &e)
     e.right->accept(*this);
 }
 
+void ExpBaseVisitor::visit(AstConditional &e)
+{
+    e.condition->accept(*this);
+    e.if_true->accept(*this);
+    e.if_false->accept(*this);
+}
+
 void ExpBaseVisitor::visit(AstScope &e)
 {
-    e.content->accept(*this);
+    if (e.content)
+        e.content->accept(*this);
+}
+
+void ExpBaseVisitor::visit(AstArray &e)
+{
+    for (auto element : e.content)
+        element->accept(*this);
 }
 
 void ExpBaseVisitor::visit(AstFunction &e)
 {
-    for (auto it = e.content.begin(); it != e.content.begin(); ++it)
-        (*it)->accept(*this);
+    for (auto argument : e.content)
+        argument->accept(*this);
 }
 
 void ExpBaseVisitor::visit(AstVariable &e)
@@ -35,4 +49,240 @@ void ExpBaseVisitor::visit(AstNumber &e)
     // Nothing to do.
 }
 
-} // namespace expar
\ No newline at end of file
+void ExpWalker::visit(AstBinary &e)
+{
+    this->walk({ e.left, e.right });
+}
+
+void ExpWalker::visit(AstUnary &e)
+{
+    this->walk({ e.right });
+}
+
+void ExpWalker::visit(AstConditional &e)
+{
+    this->walk({ e.condition, e.if_true, e.if_false });
+}
+
+void ExpWalker::visit(AstScope &e)
+{
+    this->walk({ e.content });
+}
+
+void ExpWalker::visit(AstArray &e)
+{
+    // Scheduled in reverse, so that the first element is visited first.
+    for (auto it = e.content.rbegin(); it != e.content.rend(); ++it)
+        pending.emplace_back(*it);
+    this->walk();
+}
+
+void ExpWalker::visit(AstFunction &e)
+{
+    // Scheduled in reverse, so that the first argument is visited first.
+    for (auto it = e.content.rbegin(); it != e.content.rend(); ++it)
+        pending.emplace_back(*it);
+    this->walk();
+}
+
+void ExpWalker::visit(AstVariable &e)
+{
+    // Nothing to do.
+}
+
+void ExpWalker::visit(AstNumber &e)
+{
+    // Nothing to do.
+}
+
+void ExpWalker::walk(std::initializer_list<AstNode *> children)
+{
+    for (auto it = std::rbegin(children); it != std::rend(children); ++it)
+        pending.emplace_back(*it);
+    this->walk();
+}
+
+void ExpWalker::walk()
+{
+    if (walking)
+        return;
+    // If a visit throws, the nodes left behind belong to the abandoned walk,
+    // and the next one has to start afresh.
+    struct Reset {
+        ExpWalker &visitor;
+        ~Reset()
+        {
+            visitor.pending.clear();
+            visitor.walking = false;
+        }
+    } reset{ *this };
+    walking = true;
+    while (!pending.empty()) {
+        AstNode *node = pending.back();
+        pending.pop_back();
+        if (node)
+            node->accept(*this);
+    }
+}
+
+/// @brief Moves the link to the child at the end of the vector.
+static inline void detach(AstNode *&child, std::vector<AstNode *> &nodes)
+{
+    if (child) {
+        nodes.emplace_back(child);
+        child = nullptr;
+    }
+}
+
+/// @brief Moves the children of the node at the end of the vector, leaving
+///        the node without children.
+static inline void detach_children(AstNode *node, std::vector<AstNode *> &nodes)
+{
+    switch (node->kind) {
+    case node_binary: {
+        auto binary = static_cast<AstBinary *>(node);
+        detach(binary->left, nodes);
+        detach(binary->right, nodes);
+        break;
+    }
+    case node_unary:
+        detach(static_cast<AstUnary *>(node)->right, nodes);
+        break;
+    case node_conditional: {
+        auto conditional = static_cast<AstConditional *>(node);
+        detach(conditional->condition, nodes);
+        detach(conditional->if_true, nodes);
+        detach(conditional->if_false, nodes);
+        break;
+    }
+    case node_scope:
+        detach(static_cast<AstScope *>(node)->content, nodes);
+        break;
+    case node_array:
+        for (auto &element : static_cast<AstArray *>(node)->content)
+            detach(element, nodes);
+        break;
+    case node_function:
+        for (auto &argument : static_cast<AstFunction *>(node)->content)
+            detach(argument, nodes);
+        break;
+    default:
+        break;
+    }
+}
+
+void delete_children(AstNode *node)
+{
+    std::vector<AstNode *> nodes;
+    detach_children(node, nodes);
+    // Each node is emptied before being deleted, so its destructor does not
+    // go any deeper.
+    while (!nodes.empty()) {
+        AstNode *next = nodes.back();
+        nodes.pop_back();
+        detach_children(next, nodes);
+        delete next;
+    }
+}
+
+void links_of(AstNode *node, std::vector<AstNode **> &links)
+{
+    switch (node->kind) {
+    case node_binary:
+        links.emplace_back(&static_cast<AstBinary *>(node)->left);
+        links.emplace_back(&static_cast<AstBinary *>(node)->right);
+        break;
+    case node_unary:
+        links.emplace_back(&static_cast<AstUnary *>(node)->right);
+        break;
+    case node_conditional:
+        links.emplace_back(&static_cast<AstConditional *>(node)->condition);
+        links.emplace_back(&static_cast<AstConditional *>(node)->if_true);
+        links.emplace_back(&static_cast<AstConditional *>(node)->if_false);
+        break;
+    case node_scope:
+        links.emplace_back(&static_cast<AstScope *>(node)->content);
+        break;
+    case node_array:
+        for (auto &element : static_cast<AstArray *>(node)->content)
+            links.emplace_back(&element);
+        break;
+    case node_function:
+        for (auto &argument : static_cast<AstFunction *>(node)->content)
+            links.emplace_back(&argument);
+        break;
+    default:
+        break;
+    }
+}
+
+/// @brief Copies the node alone, the links to the children are left empty.
+static inline AstNode *copy_of(AstNode *node)
+{
+    AstNode *result = nullptr;
+    switch (node->kind) {
+    case node_binary:
+        result = new AstBinary(static_cast<AstBinary *>(node)->type, nullptr, nullptr);
+        break;
+    case node_unary:
+        result = new AstUnary(static_cast<AstUnary *>(node)->type, nullptr);
+        break;
+    case node_conditional:
+        result = new AstConditional(nullptr, nullptr, nullptr);
+        break;
+    case node_scope:
+        result = new AstScope(static_cast<AstScope *>(node)->type, nullptr);
+        break;
+    case node_array:
+        result = new AstArray(std::vector<AstNode *>(static_cast<AstArray *>(node)->content.size(), nullptr));
+        break;
+    case node_function:
+        result = new AstFunction(static_cast<AstFunction *>(node)->name,
+                                 std::vector<AstNode *>(static_cast<AstFunction *>(node)->content.size(), nullptr));
+        break;
+    case node_variable:
+        result = new AstVariable(static_cast<AstVariable *>(node)->name);
+        break;
+    case node_number:
+    default:
+        result = new AstNumber(static_cast<AstNumber *>(node)->value, static_cast<AstNumber *>(node)->imaginary);
+        break;
+    }
+    result->begin = node->begin;
+    result->end   = node->end;
+    return result;
+}
+
+AstNode *clone(AstNode *node)
+{
+    if (node == nullptr)
+        return nullptr;
+    AstNode *root = nullptr;
+    // The nodes to copy, with the link which receives the copy.
+    std::vector<std::pair<AstNode *, AstNode **>> pending(1, { node, &root });
+    std::vector<AstNode **> sources, targets;
+    while (!pending.empty()) {
+        auto next = pending.back();
+        pending.pop_back();
+        *next.second = copy_of(next.first);
+        sources.clear(), targets.clear();
+        links_of(next.first, sources);
+        links_of(*next.second, targets);
+        for (std::size_t i = 0; i < sources.size(); ++i)
+            if (*sources[i])
+                pending.emplace_back(*sources[i], targets[i]);
+    }
+    return root;
+}
+
+AstNode *left_chain(AstBinary *node, std::vector<AstBinary *> &chain)
+{
+    chain.emplace_back(node);
+    while ((node->left->kind == node_binary) && (static_cast<AstBinary *>(node->left)->type != op_assign)) {
+        node = static_cast<AstBinary *>(node->left);
+        chain.emplace_back(node);
+    }
+    return node->left;
+}
+
+} // namespace expar
@@ -0,0 +1,377 @@
+/// @file   derivative.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/derivative.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+#include <set>
+
+namespace expar
+{
+/// @brief The functions which can be differentiated, with their arity.
+static const std::set<std::pair<std::string, std::size_t>> &differentiable()
+{
+    static const std::set<std::pair<std::string, std::size_t>> functions = {
+        { "sqrt", 1 }, { "cbrt", 1 }, { "exp", 1 }, { "log", 1 }, { "log2", 1 }, { "log10", 1 },
+        { "abs", 1 }, { "sin", 1 }, { "cos", 1 }, { "tan", 1 }, { "asin", 1 }, { "acos", 1 },
+        { "atan", 1 }, { "sinh", 1 }, { "cosh", 1 }, { "tanh", 1 }, { "floor", 1 }, { "ceil", 1 },
+        { "round", 1 }, { "trunc", 1 }, { "sign", 1 }, { "pow", 2 }, { "atan2", 2 }, { "hypot", 2 },
+        { "fmod", 2 }, { "min", 2 }, { "max", 2 },
+    };
+    return functions;
+}
+
+/// @brief Returns the function which cannot be differentiated, if any.
+static AstFunction *find_not_differentiable(AstNode *node)
+{
+    std::vector<AstNode **> links;
+    std::vector<AstNode *> pending(1, node);
+    while (!pending.empty()) {
+        AstNode *next = pending.back();
+        pending.pop_back();
+        if (next == nullptr)
+            continue;
+        if (next->kind == node_function) {
+            auto function = static_cast<AstFunction *>(next);
+            if (differentiable().count({ function->name, function->content.size() }) == 0)
+                return function;
+        }
+        links.clear();
+        links_of(next, links);
+        for (auto link : links)
+            pending.emplace_back(*link);
+    }
+    return nullptr;
+}
+
+/// @brief Checks if the node is the given real number.
+static inline bool is_value(AstNode *node, double value)
+{
+    return (node->kind == node_number) && !static_cast<AstNumber *>(node)->imaginary &&
+           (static_cast<AstNumber *>(node)->value == value);
+}
+
+/// @brief Returns the real value of the node, if it is a number.
+static inline bool value_of(AstNode *node, double &value)
+{
+    if ((node->kind != node_number) || static_cast<AstNumber *>(node)->imaginary)
+        return false;
+    value = static_cast<AstNumber *>(node)->value;
+    return true;
+}
+
+/// @brief Builds the derivative, the nodes of the expression are copied and
+///        never modified. The helpers take ownership of their arguments,
+///        and fold the terms which are zero or one.
+class Differentiator : public StaticVisitor<Differentiator, AstNode *> {
+public:
+    Differentiator(const std::string &_variable)
+        : variable(_variable)
+    {
+        // Nothing to do.
+    }
+
+    AstNode *visit(AstBinary &e)
+    {
+        switch (e.type) {
+        case op_assign:
+            return this->dispatch(e.right);
+        case op_plus:
+        case op_minus:
+        case op_mult:
+        case op_div:
+            break;
+        case op_pow:
+            return this->power(e.left, e.right);
+        case op_mod:
+            return this->modulo(e.left, e.right);
+        default:
+            // Comparisons, logical and bitwise operators.
+            return number(0.);
+        }
+        // The chain of left operands (e.g. of a + b + c) is walked down
+        // without recursion, then differentiated from the innermost one out.
+        std::vector<AstBinary *> chain(1, &e);
+        AstNode *node = e.left;
+        while (is_arithmetic(node)) {
+            chain.emplace_back(static_cast<AstBinary *>(node));
+            node = static_cast<AstBinary *>(node)->left;
+        }
+        AstNode *du = this->dispatch(node);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            du = rule(**it, du, this->dispatch((*it)->right));
+        return du;
+    }
+
+    AstNode *visit(AstUnary &e)
+    {
+        if (e.type == op_minus)
+            return neg(this->dispatch(e.right));
+        if (e.type == op_plus)
+            return this->dispatch(e.right);
+        return number(0.);
+    }
+
+    AstNode *visit(AstConditional &e)
+    {
+        AstNode *a = this->dispatch(e.if_true), *b = this->dispatch(e.if_false);
+        if (is_value(a, 0.) && is_value(b, 0.)) {
+            delete b;
+            return a;
+        }
+        return new AstConditional(clone(e.condition), a, b);
+    }
+
+    AstNode *visit(AstScope &e)
+    {
+        return this->dispatch(e.content);
+    }
+
+    AstNode *visit(AstArray &e)
+    {
+        std::vector<AstNode *> content;
+        for (auto element : e.content)
+            content.emplace_back(this->dispatch(element));
+        return new AstArray(std::move(content));
+    }
+
+    AstNode *visit(AstFunction &e)
+    {
+        if (e.content.size() == 2) {
+            AstNode *a = e.content[0], *b = e.content[1];
+            if (e.name == "pow")
+                return this->power(a, b);
+            if (e.name == "fmod")
+                return this->modulo(a, b);
+            if ((e.name == "min") || (e.name == "max")) {
+                AstNode *da = this->dispatch(a), *db = this->dispatch(b);
+                if (is_value(da, 0.) && is_value(db, 0.)) {
+                    delete db;
+                    return da;
+                }
+                return new AstConditional(new AstBinary((e.name == "min") ? op_le : op_ge, clone(a), clone(b)), da, db);
+            }
+            if (e.name == "atan2") {
+                // (b a' - a b') / (a^2 + b^2)
+                return div(sub(mul(clone(b), this->dispatch(a)), mul(clone(a), this->dispatch(b))),
+                           add(pow(clone(a), number(2.)), pow(clone(b), number(2.))));
+            }
+            // hypot: (a a' + b b') / hypot(a, b)
+            return div(add(mul(clone(a), this->dispatch(a)), mul(clone(b), this->dispatch(b))), clone(&e));
+        }
+        AstNode *u = e.content[0], *du = this->dispatch(u);
+        if (is_value(du, 0.))
+            return du;
+        const std::string &f = e.name;
+        AstNode *outer       = nullptr;
+        if (f == "sqrt")
+            outer = div(number(0.5), clone(&e));
+        else if (f == "cbrt")
+            outer = div(number(1.), mul(number(3.), pow(clone(&e), number(2.))));
+        else if (f == "exp")
+            outer = clone(&e);
+        else if (f == "log")
+            outer = div(number(1.), clone(u));
+        else if (f == "log2")
+            outer = div(number(1.), mul(clone(u), number(std::log(2.))));
+        else if (f == "log10")
+            outer = div(number(1.), mul(clone(u), number(std::log(10.))));
+        else if (f == "abs")
+            outer = call("sign", clone(u));
+        else if (f == "sin")
+            outer = call("cos", clone(u));
+        else if (f == "cos")
+            outer = neg(call("sin", clone(u)));
+        else if (f == "tan")
+            outer = div(number(1.), pow(call("cos", clone(u)), number(2.)));
+        else if ((f == "asin") || (f == "acos"))
+            outer = div(number((f == "asin") ? 1. : -1.), call("sqrt", sub(number(1.), pow(clone(u), number(2.)))));
+        else if (f == "atan")
+            outer = div(number(1.), add(number(1.), pow(clone(u), number(2.))));
+        else if (f == "sinh")
+            outer = call("cosh", clone(u));
+        else if (f == "cosh")
+            outer = call("sinh", clone(u));
+        else if (f == "tanh")
+            outer = sub(number(1.), pow(clone(&e), number(2.)));
+        else
+            // floor, ceil, round, trunc and sign.
+            outer = number(0.);
+        return mul(outer, du);
+    }
+
+    AstNode *visit(AstVariable &e)
+    {
+        return number((e.name == variable) ? 1. : 0.);
+    }
+
+    AstNode *visit(AstNumber &)
+    {
+        return number(0.);
+    }
+
+private:
+    /// The variable.
+    const std::string &variable;
+
+    /// @brief Checks if the node applies one of the arithmetic operators,
+    ///        whose derivative needs the one of the left operand.
+    static inline bool is_arithmetic(AstNode *node)
+    {
+        if (node->kind != node_binary)
+            return false;
+        Operator type = static_cast<AstBinary *>(node)->type;
+        return (type == op_plus) || (type == op_minus) || (type == op_mult) || (type == op_div);
+    }
+
+    /// @brief The derivative of u + v, u - v, u v or u / v, given du and dv.
+    static AstNode *rule(AstBinary &e, AstNode *du, AstNode *dv)
+    {
+        if (e.type == op_plus)
+            return add(du, dv);
+        if (e.type == op_minus)
+            return sub(du, dv);
+        if (e.type == op_mult)
+            return add(mul(du, clone(e.right)), mul(clone(e.left), dv));
+        if (is_value(dv, 0.)) {
+            delete dv;
+            return div(du, clone(e.right));
+        }
+        return div(sub(mul(du, clone(e.right)), mul(clone(e.left), dv)), pow(clone(e.right), number(2.)));
+    }
+
+    /// @brief The derivative of u^v.
+    AstNode *power(AstNode *u, AstNode *v)
+    {
+        AstNode *du = this->dispatch(u), *dv = this->dispatch(v);
+        if (is_value(dv, 0.)) {
+            // v u^(v - 1) u'
+            delete dv;
+            return mul(mul(clone(v), pow(clone(u), sub(clone(v), number(1.)))), du);
+        }
+        // u^v (v' log(u) + v u' / u)
+        return mul(pow(clone(u), clone(v)), add(mul(dv, call("log", clone(u))), div(mul(clone(v), du), clone(u))));
+    }
+
+    /// @brief The derivative of fmod(u, v), that is u' - trunc(u / v) v'.
+    AstNode *modulo(AstNode *u, AstNode *v)
+    {
+        AstNode *du = this->dispatch(u), *dv = this->dispatch(v);
+        return sub(du, mul(call("trunc", div(clone(u), clone(v))), dv));
+    }
+
+    static inline AstNode *number(double value)
+    {
+        return new AstNumber(value);
+    }
+
+    static inline AstNode *call(const std::string &name, AstNode *argument)
+    {
+        return new AstFunction(name, { argument });
+    }
+
+    /// @brief Builds the binary operation, computing it if both operands
+    ///        are numbers.
+    static inline AstNode *binary(Operator type, AstNode *a, AstNode *b)
+    {
+        double x, y;
+        if (value_of(a, x) && value_of(b, y) && (type != op_pow)) {
+            delete a;
+            delete b;
+            if (type == op_plus)
+                return number(x + y);
+            if (type == op_minus)
+                return number(x - y);
+            if (type == op_mult)
+                return number(x * y);
+            return number(x / y);
+        }
+        return new AstBinary(type, a, b);
+    }
+
+    static inline AstNode *add(AstNode *a, AstNode *b)
+    {
+        if (is_value(a, 0.)) {
+            delete a;
+            return b;
+        }
+        if (is_value(b, 0.)) {
+            delete b;
+            return a;
+        }
+        return binary(op_plus, a, b);
+    }
+
+    static inline AstNode *sub(AstNode *a, AstNode *b)
+    {
+        if (is_value(b, 0.)) {
+            delete b;
+            return a;
+        }
+        if (is_value(a, 0.)) {
+            delete a;
+            return neg(b);
+        }
+        return binary(op_minus, a, b);
+    }
+
+    static inline AstNode *mul(AstNode *a, AstNode *b)
+    {
+        // Zero terms of derivatives are dropped, whatever the other factor.
+        if (is_value(a, 0.) || is_value(b, 1.)) {
+            delete b;
+            return a;
+        }
+        if (is_value(b, 0.) || is_value(a, 1.)) {
+            delete a;
+            return b;
+        }
+        return binary(op_mult, a, b);
+    }
+
+    static inline AstNode *div(AstNode *a, AstNode *b)
+    {
+        if (is_value(a, 0.) || is_value(b, 1.)) {
+            delete b;
+            return a;
+        }
+        return binary(op_div, a, b);
+    }
+
+    static inline AstNode *pow(AstNode *a, AstNode *b)
+    {
+        if (is_value(b, 1.)) {
+            delete b;
+            return a;
+        }
+        return binary(op_pow, a, b);
+    }
+
+    static inline AstNode *neg(AstNode *a)
+    {
+        double x;
+        if (value_of(a, x)) {
+            delete a;
+            return number(-x);
+        }
+        return new AstUnary(op_minus, a);
+    }
+};
+
+AstNode *differentiate(AstNode *node, const std::string &variable)
+{
+    if (node == nullptr)
+        _error("Cannot differentiate a NULL node!");
+    if (AstFunction *function = find_not_differentiable(node))
+        _error("Cannot differentiate function '%s' with %lu arguments!", function->name.c_str(),
+               function->content.size());
+    return Differentiator(variable).dispatch(node);
+}
+
+bool is_differentiable(AstNode *node)
+{
+    return (node != nullptr) && (find_not_differentiable(node) == nullptr);
+}
+
+} // namespace expar
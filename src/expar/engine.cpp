@@ -0,0 +1,173 @@
+/// @file   engine.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/engine.hpp"
+#include "expar/evaluator.hpp"
+#include "logging.hpp"
+
+namespace expar
+{
+Engine::Engine(std::vector<std::string> _variables, EngineOptions _options, const FunctionRegistry &_registry)
+    : variables(std::move(_variables)),
+      options(std::move(_options)),
+      registry(_registry),
+      entries(),
+      modules(),
+      jobs(),
+      running(0),
+      mutex(),
+      changed(),
+      stopping(false),
+      worker()
+{
+    // Native code calls the standard functions.
+    if (&registry != &FunctionRegistry::standard())
+        options.native = false;
+    if (options.background)
+        worker = std::thread(&Engine::serve, this);
+}
+
+Engine::~Engine()
+{
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    for (auto &entry : entries)
+        delete entry->expression;
+}
+
+std::size_t Engine::add(AstNode *expression)
+{
+    if (expression == nullptr)
+        _error("Cannot add an empty expression!");
+    auto entry        = std::make_unique<Entry>();
+    entry->expression = clone(expression);
+    entries.emplace_back(std::move(entry));
+    Entry &added = *entries.back();
+    if (options.bytecode_threshold == 0)
+        this->promote(added, tier_bytecode);
+    if (options.native && (options.native_threshold == 0))
+        this->promote(added, tier_native);
+    return entries.size() - 1;
+}
+
+double Engine::evaluate(std::size_t index, const double *values)
+{
+    Entry &entry = *entries.at(index);
+    NativeFunction native = entry.native.load(std::memory_order_acquire);
+    if (native)
+        return native(values);
+    std::uint64_t evaluations = entry.evaluations.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (evaluations == options.bytecode_threshold)
+        this->promote(entry, tier_bytecode);
+    if (options.native && (evaluations == options.native_threshold))
+        this->promote(entry, tier_native);
+    const Program *program = entry.program.load(std::memory_order_acquire);
+    if (program)
+        return program->evaluate(values);
+    std::map<std::string, double> bindings;
+    for (std::size_t i = 0; i < variables.size(); ++i)
+        bindings[variables[i]] = values[i];
+    return Evaluator(bindings, registry).evaluate(entry.expression);
+}
+
+Tier Engine::get_tier(std::size_t index) const
+{
+    const Entry &entry = *entries.at(index);
+    if (entry.native.load(std::memory_order_acquire))
+        return tier_native;
+    if (entry.program.load(std::memory_order_acquire))
+        return tier_bytecode;
+    return tier_tree;
+}
+
+std::uint64_t Engine::get_evaluations(std::size_t index) const
+{
+    return entries.at(index)->evaluations.load(std::memory_order_relaxed);
+}
+
+void Engine::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return jobs.empty() && (running == 0); });
+}
+
+void Engine::promote(Entry &entry, Tier tier)
+{
+    if (!worker.joinable()) {
+        this->run({ Job{ &entry, tier } });
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.emplace_back(Job{ &entry, tier });
+    }
+    changed.notify_all();
+}
+
+void Engine::run(std::vector<Job> batch)
+{
+    // The expressions which can become native, built in a single module.
+    std::vector<Entry *> natives;
+    std::vector<AstNode *> expressions;
+    CodeGenerator generator(variables);
+    for (const Job &job : batch) {
+        Entry &entry = *job.entry;
+        if (job.tier == tier_bytecode) {
+            if (entry.program.load(std::memory_order_acquire))
+                continue;
+            try {
+                entry.owned = std::make_unique<Program>(entry.expression, variables, registry);
+                entry.program.store(entry.owned.get(), std::memory_order_release);
+            } catch (const std::exception &e) {
+                _warning("Expression %p stays on the tree: %s", static_cast<void *>(entry.expression), e.what());
+            }
+        } else if (entry.native.load(std::memory_order_acquire) == nullptr) {
+            try {
+                generator.generate(entry.expression);
+                natives.emplace_back(&entry);
+                expressions.emplace_back(entry.expression);
+            } catch (const std::exception &e) {
+                _debug("Expression %p cannot become native: %s", static_cast<void *>(entry.expression), e.what());
+            }
+        }
+    }
+    if (expressions.empty())
+        return;
+    try {
+        std::unique_ptr<NativeModule> module(compile_native(expressions, variables, options.native_options));
+        for (std::size_t i = 0; i < natives.size(); ++i)
+            natives[i]->native.store(module->get_function(i), std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex);
+        modules.emplace_back(std::move(module));
+    } catch (const std::exception &e) {
+        _warning("Cannot compile %lu expressions to native code: %s", expressions.size(), e.what());
+    }
+}
+
+void Engine::serve()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+            return;
+        // The pending requests are carried out together, so that the native
+        // ones share a single compilation.
+        std::vector<Job> batch(jobs.begin(), jobs.end());
+        jobs.clear();
+        running = batch.size();
+        lock.unlock();
+        this->run(std::move(batch));
+        lock.lock();
+        running = 0;
+        changed.notify_all();
+    }
+}
+
+} // namespace expar
@@ -197,6 +197,55 @@ Operator plain_string_to_operator(const std::string &s)
     return op_none;
 }
 
+unsigned operator_precedence(Operator op, bool unary)
+{
+    if (unary)
+        return (op == op_none) ? 0 : 13;
+    switch (op) {
+    case op_pow:
+        return 14;
+    case op_mult:
+    case op_div:
+    case op_mod:
+        return 12;
+    case op_plus:
+    case op_minus:
+        return 11;
+    case op_bsl:
+    case op_bsr:
+        return 10;
+    case op_lt:
+    case op_gt:
+    case op_le:
+    case op_ge:
+        return 9;
+    case op_eq:
+    case op_neq:
+        return 8;
+    case op_band:
+        return 7;
+    case op_xor:
+        return 6;
+    case op_bor:
+        return 5;
+    case op_and:
+        return 4;
+    case op_or:
+        return 3;
+    case op_assign:
+        return 1;
+    case op_not:
+    case op_none:
+    default:
+        return 0;
+    }
+}
+
+bool operator_is_right_associative(Operator op)
+{
+    return (op == op_pow) || (op == op_assign);
+}
+
 std::string scopetype_to_plain_string(ScopeType scp)
 {
     if (scp == scp_round)
@@ -227,6 +276,27 @@ ScopeType plain_string_to_scopetype(const std::string &s)
     return scp_none;
 }
 
+std::string nodekind_to_plain_string(NodeKind kind)
+{
+    if (kind == node_binary)
+        return "node_binary";
+    if (kind == node_unary)
+        return "node_unary";
+    if (kind == node_conditional)
+        return "node_conditional";
+    if (kind == node_scope)
+        return "node_scope";
+    if (kind == node_array)
+        return "node_array";
+    if (kind == node_function)
+        return "node_function";
+    if (kind == node_variable)
+        return "node_variable";
+    if (kind == node_number)
+        return "node_number";
+    return "node_none";
+}
+
 std::string siprefix_to_plain_string(SiPrefix op)
 {
     if (op == si_yotta)
@@ -0,0 +1,220 @@
+/// @file   evaluator.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/evaluator.hpp"
+#include "expar/bitwise.hpp"
+#include "expar/random.hpp"
+#include "expar/table.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+double apply(Operator op, double l, double r)
+{
+    switch (op) {
+    case op_plus:
+        return l + r;
+    case op_minus:
+        return l - r;
+    case op_mult:
+        return l * r;
+    case op_div:
+        return l / r;
+    case op_pow:
+        return std::pow(l, r);
+    case op_mod:
+        return std::fmod(l, r);
+    case op_eq:
+        return (l == r) ? 1. : 0.;
+    case op_neq:
+        return (l != r) ? 1. : 0.;
+    case op_lt:
+        return (l < r) ? 1. : 0.;
+    case op_gt:
+        return (l > r) ? 1. : 0.;
+    case op_le:
+        return (l <= r) ? 1. : 0.;
+    case op_ge:
+        return (l >= r) ? 1. : 0.;
+    case op_and:
+        return ((l != 0.) && (r != 0.)) ? 1. : 0.;
+    case op_or:
+        return ((l != 0.) || (r != 0.)) ? 1. : 0.;
+    case op_xor:
+        return ((l != 0.) != (r != 0.)) ? 1. : 0.;
+    case op_bor:
+        return bitwise::bor(l, r);
+    case op_band:
+        return bitwise::band(l, r);
+    case op_bsl:
+        return bitwise::bsl(l, r);
+    case op_bsr:
+        return bitwise::bsr(l, r);
+    default:
+        break;
+    }
+    _error("Cannot evaluate binary operator '%s'!", operator_to_string(op).c_str());
+    return 0.;
+}
+
+double apply(Operator op, double value)
+{
+    if (op == op_plus)
+        return value;
+    if (op == op_minus)
+        return -value;
+    if (op == op_not)
+        return (value == 0.) ? 1. : 0.;
+    _error("Cannot evaluate unary operator '%s'!", operator_to_string(op).c_str());
+    return 0.;
+}
+
+double call(const std::string &name, const double *args, std::size_t count, const FunctionRegistry &registry)
+{
+    if (((name == "pwl") || (name == "table")) && (registry.find(name) == nullptr)) {
+        if ((count < 3) || (count % 2 == 0))
+            _error("Function '%s' expects the abscissa and pairs of breakpoints, received %lu arguments!",
+                   name.c_str(), count);
+        return Table::interpolate(args[0], args + 1, (count - 1) / 2);
+    }
+    random::Distribution distribution;
+    if (random::find(name, count, distribution) && (registry.find(name) == nullptr))
+        return args[0];
+    const Function &function = registry.bind(name, count);
+    if (function.unary)
+        return function.unary(args[0]);
+    if (function.binary)
+        return function.binary(args[0], args[1]);
+    return function.invoke(args);
+}
+
+Evaluator::Evaluator(const std::map<std::string, double> &_bindings, const FunctionRegistry &_registry, Profile *_profile)
+    : bindings(_bindings),
+      registry(_registry),
+      profile(_profile),
+      children_ns(0)
+{
+    // Nothing to do.
+}
+
+void Evaluator::null_node()
+{
+    _error("Cannot evaluate a NULL node!");
+}
+
+double Evaluator::measure(AstNode *node)
+{
+    // The time of the siblings measured so far, restored on the way out with
+    // the time of this node added.
+    std::uint64_t siblings_ns = children_ns;
+    children_ns               = 0;
+    std::uint64_t started     = stats::now();
+    double value;
+    try {
+        value = this->dispatch(node);
+    } catch (...) {
+        children_ns = siblings_ns;
+        throw;
+    }
+    std::uint64_t elapsed = stats::now() - started;
+    profile->record(node, elapsed, (elapsed > children_ns) ? (elapsed - children_ns) : 0);
+    children_ns = siblings_ns + elapsed;
+    return value;
+}
+
+double Evaluator::visit(AstBinary &e)
+{
+    if (e.type == op_assign)
+        return this->descend(e.right);
+    // The chain of left operands is walked down without recursion, then its
+    // operators are applied from the innermost one out.
+    std::size_t base      = chain.size();
+    AstNode *node         = left_chain(&e, chain);
+    std::uint64_t started = profile ? stats::now() : 0;
+    try {
+        double value = this->descend(node);
+        while (chain.size() > base + 1) {
+            AstBinary *link = chain.back();
+            chain.pop_back();
+            value = this->combine(*link, value);
+            // The nodes below the first one are measured as descend would,
+            // they have no siblings measured before them.
+            if (profile) {
+                std::uint64_t elapsed = stats::now() - started;
+                profile->record(link, elapsed, (elapsed > children_ns) ? (elapsed - children_ns) : 0);
+                children_ns = elapsed;
+            }
+        }
+        chain.pop_back();
+        return this->combine(e, value);
+    } catch (...) {
+        chain.resize(base);
+        throw;
+    }
+}
+
+double Evaluator::combine(AstBinary &e, double l)
+{
+    // The right operand of the logical operators is skipped when it cannot
+    // change the result.
+    if (e.type == op_and)
+        return ((l != 0.) && (this->descend(e.right) != 0.)) ? 1. : 0.;
+    if (e.type == op_or)
+        return ((l != 0.) || (this->descend(e.right) != 0.)) ? 1. : 0.;
+    return apply(e.type, l, this->descend(e.right));
+}
+
+double Evaluator::visit(AstUnary &e)
+{
+    return apply(e.type, this->descend(e.right));
+}
+
+double Evaluator::visit(AstConditional &e)
+{
+    return (this->descend(e.condition) != 0.) ? this->descend(e.if_true) : this->descend(e.if_false);
+}
+
+double Evaluator::visit(AstScope &e)
+{
+    return this->descend(e.content);
+}
+
+double Evaluator::visit(AstArray &e)
+{
+    if (e.content.size() != 1)
+        _error("Cannot evaluate an array of %lu elements as a single value!", e.content.size());
+    return this->descend(e.content[0]);
+}
+
+double Evaluator::visit(AstFunction &e)
+{
+    // Outside of Monte Carlo runs, random functions give their nominal value.
+    random::Distribution distribution;
+    if (random::find(e.name, e.content.size(), distribution) && (registry.find(e.name) == nullptr))
+        return this->descend(e.content[0]);
+    double buffer[max_arity];
+    std::vector<double> many((e.content.size() > max_arity) ? e.content.size() : 0);
+    double *args = many.empty() ? buffer : many.data();
+    for (std::size_t i = 0; i < e.content.size(); ++i)
+        args[i] = this->descend(e.content[i]);
+    return call(e.name, args, e.content.size(), registry);
+}
+
+double Evaluator::visit(AstVariable &e)
+{
+    auto it = bindings.find(e.name);
+    if (it == bindings.end())
+        _error("There is no value for variable '%s'!", e.name.c_str());
+    return it->second;
+}
+
+double Evaluator::visit(AstNumber &e)
+{
+    if (e.imaginary)
+        _error("Cannot evaluate the imaginary number %gi over the real numbers!", e.value);
+    return e.value;
+}
+
+} // namespace expar
@@ -0,0 +1,103 @@
+/// @file   functions.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/functions.hpp"
+#include "expar/vmath.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+FunctionRegistry::FunctionRegistry()
+    : functions()
+{
+    // Nothing to do.
+}
+
+const FunctionRegistry &FunctionRegistry::standard()
+{
+    static const FunctionRegistry registry = []() {
+        FunctionRegistry result;
+        result.add(
+            "sqrt", [](double x) { return vmath::sqrt(x); },
+            [](std::size_t count, const double *x, double *out) { vmath::sqrt(count, x, out); });
+        result.add("cbrt", [](double x) { return std::cbrt(x); });
+        result.add(
+            "exp", [](double x) { return vmath::exp(x); },
+            [](std::size_t count, const double *x, double *out) { vmath::exp(count, x, out); });
+        result.add(
+            "log", [](double x) { return vmath::log(x); },
+            [](std::size_t count, const double *x, double *out) { vmath::log(count, x, out); });
+        result.add("log2", [](double x) { return std::log2(x); });
+        result.add("log10", [](double x) { return std::log10(x); });
+        result.add("abs", [](double x) { return std::fabs(x); });
+        result.add(
+            "sin", [](double x) { return vmath::sin(x); },
+            [](std::size_t count, const double *x, double *out) { vmath::sin(count, x, out); });
+        result.add(
+            "cos", [](double x) { return vmath::cos(x); },
+            [](std::size_t count, const double *x, double *out) { vmath::cos(count, x, out); });
+        result.add("tan", [](double x) { return std::tan(x); });
+        result.add("asin", [](double x) { return std::asin(x); });
+        result.add("acos", [](double x) { return std::acos(x); });
+        result.add("atan", [](double x) { return std::atan(x); });
+        result.add("sinh", [](double x) { return std::sinh(x); });
+        result.add("cosh", [](double x) { return std::cosh(x); });
+        result.add("tanh", [](double x) { return std::tanh(x); });
+        result.add("floor", [](double x) { return std::floor(x); });
+        result.add("ceil", [](double x) { return std::ceil(x); });
+        result.add("round", [](double x) { return std::round(x); });
+        result.add("trunc", [](double x) { return std::trunc(x); });
+        result.add("sign", [](double x) { return (x > 0.) ? 1. : ((x < 0.) ? -1. : 0.); });
+        result.add("pow", [](double x, double y) { return std::pow(x, y); });
+        result.add("atan2", [](double x, double y) { return std::atan2(x, y); });
+        result.add("hypot", [](double x, double y) { return std::hypot(x, y); });
+        result.add("fmod", [](double x, double y) { return std::fmod(x, y); });
+        result.add("min", [](double x, double y) { return std::fmin(x, y); });
+        result.add("max", [](double x, double y) { return std::fmax(x, y); });
+        return result;
+    }();
+    return registry;
+}
+
+void FunctionRegistry::add(const std::string &name, double (*function)(double), bool pure)
+{
+    this->add<1>(name, function, pure);
+    functions[name].unary = function;
+}
+
+void FunctionRegistry::add(const std::string &name,
+                           double (*function)(double),
+                           void (*batch)(std::size_t, const double *, double *),
+                           bool pure)
+{
+    this->add(name, function, pure);
+    functions[name].batch = batch;
+}
+
+void FunctionRegistry::add(const std::string &name, double (*function)(double, double), bool pure)
+{
+    this->add<2>(name, function, pure);
+    functions[name].binary = function;
+}
+
+const Function *FunctionRegistry::find(const std::string &name) const
+{
+    auto it = functions.find(name);
+    if (it == functions.end())
+        return nullptr;
+    return &it->second;
+}
+
+const Function &FunctionRegistry::bind(const std::string &name, std::size_t arity) const
+{
+    auto function = this->find(name);
+    if (function == nullptr)
+        _error("Unknown function '%s'!", name.c_str());
+    if (function->arity != arity)
+        _error("Function '%s' expects %lu arguments, received %lu!", name.c_str(), function->arity, arity);
+    return *function;
+}
+
+} // namespace expar
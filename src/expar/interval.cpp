@@ -0,0 +1,724 @@
+/// @file   interval.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/interval.hpp"
+#include "expar/bitwise.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace expar
+{
+std::string monotonicity_to_plain_string(Monotonicity mono)
+{
+    if (mono == mono_constant)
+        return "mono_constant";
+    if (mono == mono_increasing)
+        return "mono_increasing";
+    if (mono == mono_decreasing)
+        return "mono_decreasing";
+    return "mono_unknown";
+}
+
+namespace interval
+{
+static const double infinity = std::numeric_limits<double>::infinity();
+static const double pi       = 3.14159265358979323846;
+
+/// @brief Moves the value one ulp towards -inf. Zero is left untouched,
+///        since sums and differences which round to zero are exact, while
+///        products and quotients take care of their own underflow.
+static inline double down(double x)
+{
+    if (std::isnan(x))
+        return -infinity;
+    if (std::isinf(x) || (x == 0.))
+        return x;
+    return std::nextafter(x, -infinity);
+}
+
+/// @brief Moves the value one ulp towards +inf (see down).
+static inline double up(double x)
+{
+    if (std::isnan(x))
+        return infinity;
+    if (std::isinf(x) || (x == 0.))
+        return x;
+    return std::nextafter(x, infinity);
+}
+
+/// @brief Builds the interval enclosing [lower, upper], rounding outwards.
+static inline Interval outward(double lower, double upper)
+{
+    return Interval(down(lower), up(upper));
+}
+
+/// @brief Product where 0 * inf is 0, as required by interval arithmetic.
+static inline double product(double a, double b)
+{
+    if ((a == 0.) || (b == 0.))
+        return 0.;
+    return a * b;
+}
+
+/// @brief Builds the enclosure of a set of products or quotients, widening
+///        the bounds which underflowed to zero.
+static inline Interval enclose(const double (&values)[4], bool underflow)
+{
+    double lower = *std::min_element(values, values + 4);
+    double upper = *std::max_element(values, values + 4);
+    if (underflow) {
+        lower = std::min(lower, -std::numeric_limits<double>::denorm_min());
+        upper = std::max(upper, std::numeric_limits<double>::denorm_min());
+    }
+    return outward(lower, upper);
+}
+
+/// @brief Truth value of an interval: 1 if surely true, 0 if surely false,
+///        -1 if undecided.
+static inline int truth(const Interval &a)
+{
+    if (a.is_point(0.))
+        return 0;
+    if (!a.contains(0.))
+        return 1;
+    return -1;
+}
+
+static inline Interval boolean(int value)
+{
+    if (value < 0)
+        return Interval(0., 1.);
+    return Interval(value);
+}
+
+Interval entire()
+{
+    return Interval(-infinity, infinity);
+}
+
+Interval hull(const Interval &a, const Interval &b)
+{
+    return Interval(std::min(a.lower, b.lower), std::max(a.upper, b.upper));
+}
+
+Interval add(const Interval &a, const Interval &b)
+{
+    if (a.is_point(0.))
+        return b;
+    if (b.is_point(0.))
+        return a;
+    return outward(a.lower + b.lower, a.upper + b.upper);
+}
+
+Interval sub(const Interval &a, const Interval &b)
+{
+    if (b.is_point(0.))
+        return a;
+    return outward(a.lower - b.upper, a.upper - b.lower);
+}
+
+Interval mul(const Interval &a, const Interval &b)
+{
+    if (a.is_point(0.) || b.is_point(0.))
+        return Interval(0.);
+    if (a.is_point(1.))
+        return b;
+    if (b.is_point(1.))
+        return a;
+    double p[4] = {
+        product(a.lower, b.lower),
+        product(a.lower, b.upper),
+        product(a.upper, b.lower),
+        product(a.upper, b.upper)
+    };
+    bool underflow = ((p[0] == 0.) && (a.lower != 0.) && (b.lower != 0.)) ||
+                     ((p[1] == 0.) && (a.lower != 0.) && (b.upper != 0.)) ||
+                     ((p[2] == 0.) && (a.upper != 0.) && (b.lower != 0.)) ||
+                     ((p[3] == 0.) && (a.upper != 0.) && (b.upper != 0.));
+    return enclose(p, underflow);
+}
+
+Interval div(const Interval &a, const Interval &b)
+{
+    if (b.contains(0.))
+        return entire();
+    if (a.is_point(0.))
+        return Interval(0.);
+    if (b.is_point(1.))
+        return a;
+    double q[4] = {
+        a.lower / b.lower,
+        a.lower / b.upper,
+        a.upper / b.lower,
+        a.upper / b.upper
+    };
+    bool underflow = ((q[0] == 0.) && (a.lower != 0.) && std::isfinite(b.lower)) ||
+                     ((q[1] == 0.) && (a.lower != 0.) && std::isfinite(b.upper)) ||
+                     ((q[2] == 0.) && (a.upper != 0.) && std::isfinite(b.lower)) ||
+                     ((q[3] == 0.) && (a.upper != 0.) && std::isfinite(b.upper));
+    return enclose(q, underflow);
+}
+
+Interval neg(const Interval &a)
+{
+    return Interval(-a.upper, -a.lower);
+}
+
+Interval mod(const Interval &a, const Interval &b)
+{
+    if (a.is_point() && b.is_point())
+        return outward(std::fmod(a.lower, b.lower), std::fmod(a.lower, b.lower));
+    double limit = std::max(std::abs(b.lower), std::abs(b.upper));
+    // The result has the sign of the dividend and is smaller than the divisor.
+    if (a.lower >= 0.)
+        return Interval(0., std::min(a.upper, limit));
+    if (a.upper <= 0.)
+        return Interval(std::max(a.lower, -limit), 0.);
+    return Interval(std::max(a.lower, -limit), std::min(a.upper, limit));
+}
+
+/// @brief Raises the interval to an integer power.
+static Interval ipow(const Interval &a, long n)
+{
+    if (n == 0)
+        return Interval(1.);
+    if (n < 0)
+        return div(Interval(1.), ipow(a, -n));
+    double lo = std::pow(a.lower, static_cast<double>(n));
+    double hi = std::pow(a.upper, static_cast<double>(n));
+    if (n % 2)
+        return outward(lo, hi);
+    // Even powers are symmetric, with the minimum in zero.
+    if (a.contains(0.))
+        return Interval(0., up(std::max(lo, hi)));
+    return outward(std::min(lo, hi), std::max(lo, hi));
+}
+
+Interval pow(const Interval &a, const Interval &b)
+{
+    if (b.is_point() && (std::trunc(b.lower) == b.lower) && (std::abs(b.lower) < 1e9))
+        return ipow(a, static_cast<long>(b.lower));
+    if (a.lower < 0.)
+        return entire();
+    // For positive bases, a^b = exp(b * log(a)).
+    return exp(mul(b, log(a)));
+}
+
+Interval sqr(const Interval &a)
+{
+    return ipow(a, 2);
+}
+
+Interval sqrt(const Interval &a)
+{
+    if (a.upper < 0.)
+        return entire();
+    return Interval(std::max(0., down(std::sqrt(std::max(0., a.lower)))), up(std::sqrt(a.upper)));
+}
+
+Interval exp(const Interval &a)
+{
+    return Interval(std::max(0., down(std::exp(a.lower))), up(std::exp(a.upper)));
+}
+
+Interval log(const Interval &a)
+{
+    if (a.upper <= 0.)
+        return entire();
+    if (a.lower <= 0.)
+        return Interval(-infinity, up(std::log(a.upper)));
+    return outward(std::log(a.lower), std::log(a.upper));
+}
+
+Interval log10(const Interval &a)
+{
+    if (a.upper <= 0.)
+        return entire();
+    if (a.lower <= 0.)
+        return Interval(-infinity, up(std::log10(a.upper)));
+    return outward(std::log10(a.lower), std::log10(a.upper));
+}
+
+Interval abs(const Interval &a)
+{
+    if (a.lower >= 0.)
+        return a;
+    if (a.upper <= 0.)
+        return neg(a);
+    return Interval(0., std::max(-a.lower, a.upper));
+}
+
+/// @brief Checks if the interval contains (offset + k * period) for some k.
+static inline bool contains_periodic(const Interval &a, double offset, double period)
+{
+    // Be conservative about the rounding error of the multiples of pi.
+    double slack = 1e-12 * (1. + std::abs(a.lower) + std::abs(a.upper));
+    double k     = std::ceil((a.lower - slack - offset) / period);
+    return (offset + k * period) <= (a.upper + slack);
+}
+
+/// @brief Clamps a trigonometric enclosure to [-1, 1].
+static inline Interval clamp_unit(const Interval &a)
+{
+    return Interval(std::max(-1., a.lower), std::min(1., a.upper));
+}
+
+Interval sin(const Interval &a)
+{
+    if (!std::isfinite(a.lower) || !std::isfinite(a.upper) || (a.width() >= 2 * pi))
+        return Interval(-1., 1.);
+    double lo = std::min(std::sin(a.lower), std::sin(a.upper));
+    double hi = std::max(std::sin(a.lower), std::sin(a.upper));
+    Interval result = outward(lo, hi);
+    if (contains_periodic(a, pi / 2, 2 * pi))
+        result.upper = 1.;
+    if (contains_periodic(a, -pi / 2, 2 * pi))
+        result.lower = -1.;
+    return clamp_unit(result);
+}
+
+Interval cos(const Interval &a)
+{
+    if (!std::isfinite(a.lower) || !std::isfinite(a.upper) || (a.width() >= 2 * pi))
+        return Interval(-1., 1.);
+    double lo = std::min(std::cos(a.lower), std::cos(a.upper));
+    double hi = std::max(std::cos(a.lower), std::cos(a.upper));
+    Interval result = outward(lo, hi);
+    if (contains_periodic(a, 0., 2 * pi))
+        result.upper = 1.;
+    if (contains_periodic(a, pi, 2 * pi))
+        result.lower = -1.;
+    return clamp_unit(result);
+}
+
+Interval tan(const Interval &a)
+{
+    if (!std::isfinite(a.lower) || !std::isfinite(a.upper) || (a.width() >= pi))
+        return entire();
+    if (contains_periodic(a, pi / 2, pi))
+        return entire();
+    return outward(std::tan(a.lower), std::tan(a.upper));
+}
+
+Interval atan(const Interval &a)
+{
+    return outward(std::atan(a.lower), std::atan(a.upper));
+}
+
+Interval sinh(const Interval &a)
+{
+    return outward(std::sinh(a.lower), std::sinh(a.upper));
+}
+
+Interval cosh(const Interval &a)
+{
+    Interval m = abs(a);
+    return Interval(std::max(1., down(std::cosh(m.lower))), up(std::cosh(m.upper)));
+}
+
+Interval tanh(const Interval &a)
+{
+    return clamp_unit(outward(std::tanh(a.lower), std::tanh(a.upper)));
+}
+
+Interval floor(const Interval &a)
+{
+    return Interval(std::floor(a.lower), std::floor(a.upper));
+}
+
+Interval ceil(const Interval &a)
+{
+    return Interval(std::ceil(a.lower), std::ceil(a.upper));
+}
+
+Interval min(const Interval &a, const Interval &b)
+{
+    return Interval(std::min(a.lower, b.lower), std::min(a.upper, b.upper));
+}
+
+Interval max(const Interval &a, const Interval &b)
+{
+    return Interval(std::max(a.lower, b.lower), std::max(a.upper, b.upper));
+}
+
+/// @brief Evaluates a bitwise operator, which is only possible on points.
+static Interval bitwise(Operator op, const Interval &a, const Interval &b)
+{
+    if (!a.is_point() || !b.is_point())
+        return entire();
+    if (op == op_bor)
+        return Interval(bitwise::bor(a.lower, b.lower));
+    if (op == op_band)
+        return Interval(bitwise::band(a.lower, b.lower));
+    if (op == op_bsl)
+        return Interval(bitwise::bsl(a.lower, b.lower));
+    return Interval(bitwise::bsr(a.lower, b.lower));
+}
+
+Interval apply(Operator op, const Interval &a, const Interval &b)
+{
+    switch (op) {
+    case op_assign:
+        return b;
+    case op_plus:
+        return add(a, b);
+    case op_minus:
+        return sub(a, b);
+    case op_mult:
+        return mul(a, b);
+    case op_div:
+        return div(a, b);
+    case op_mod:
+        return mod(a, b);
+    case op_pow:
+        return pow(a, b);
+    case op_or:
+        if ((truth(a) == 1) || (truth(b) == 1))
+            return boolean(1);
+        if ((truth(a) == 0) && (truth(b) == 0))
+            return boolean(0);
+        return boolean(-1);
+    case op_and:
+        if ((truth(a) == 0) || (truth(b) == 0))
+            return boolean(0);
+        if ((truth(a) == 1) && (truth(b) == 1))
+            return boolean(1);
+        return boolean(-1);
+    case op_xor:
+        if ((truth(a) < 0) || (truth(b) < 0))
+            return boolean(-1);
+        return boolean(truth(a) != truth(b));
+    case op_eq:
+        if (a.is_point() && b.is_point(a.lower))
+            return boolean(1);
+        if ((a.upper < b.lower) || (b.upper < a.lower))
+            return boolean(0);
+        return boolean(-1);
+    case op_neq:
+        if (a.is_point() && b.is_point(a.lower))
+            return boolean(0);
+        if ((a.upper < b.lower) || (b.upper < a.lower))
+            return boolean(1);
+        return boolean(-1);
+    case op_lt:
+        if (a.upper < b.lower)
+            return boolean(1);
+        if (a.lower >= b.upper)
+            return boolean(0);
+        return boolean(-1);
+    case op_le:
+        if (a.upper <= b.lower)
+            return boolean(1);
+        if (a.lower > b.upper)
+            return boolean(0);
+        return boolean(-1);
+    case op_gt:
+        return apply(op_lt, b, a);
+    case op_ge:
+        return apply(op_le, b, a);
+    case op_bor:
+    case op_band:
+    case op_bsl:
+    case op_bsr:
+        return bitwise(op, a, b);
+    case op_not:
+    case op_none:
+    default:
+        _error("Cannot evaluate binary operator '%s' on intervals!", operator_to_string(op).c_str());
+        return entire();
+    }
+}
+
+Interval apply(Operator op, const Interval &a)
+{
+    if (op == op_plus)
+        return a;
+    if (op == op_minus)
+        return neg(a);
+    if (op == op_not) {
+        int t = truth(a);
+        return boolean((t < 0) ? -1 : !t);
+    }
+    _error("Cannot evaluate unary operator '%s' on intervals!", operator_to_string(op).c_str());
+    return entire();
+}
+
+} // namespace interval
+
+IntervalEvaluator::IntervalEvaluator(const std::map<std::string, Interval> &_ranges,
+                                     std::string _wrt)
+    : ranges(_ranges),
+      wrt(std::move(_wrt)),
+      value(),
+      slope()
+{
+    // Nothing to do.
+}
+
+/// @brief Derivative of a^b, given the derivatives of a and b.
+static inline Interval pow_slope(const Interval &a, const Interval &da,
+                                 const Interval &b, const Interval &db,
+                                 const Interval &ab)
+{
+    using namespace interval;
+    // (a^n)' = n * a^(n - 1) * a'
+    if (db.is_point(0.))
+        return mul(mul(b, pow(a, sub(b, Interval(1.)))), da);
+    // (a^b)' = a^b * (b' * log(a) + b * a' / a)
+    return mul(ab, add(mul(db, log(a)), div(mul(b, da), a)));
+}
+
+Interval IntervalEvaluator::evaluate(AstNode *node)
+{
+    if (node == nullptr)
+        _error("Cannot evaluate a NULL node!");
+    node->accept(*this);
+    return value;
+}
+
+void IntervalEvaluator::visit(AstBinary &e)
+{
+    // The chain of left operands is walked down without recursion, then
+    // evaluated from the innermost one out.
+    std::vector<AstBinary *> chain;
+    this->evaluate(left_chain(&e, chain));
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        this->combine(**it);
+}
+
+void IntervalEvaluator::combine(AstBinary &e)
+{
+    using namespace interval;
+    Interval a = value, da = slope;
+    Interval b = this->evaluate(e.right), db = slope;
+    value = apply(e.type, a, b);
+    // The derivative of an expression whose operands do not depend on the
+    // variable is zero, whatever the operator is.
+    if (da.is_point(0.) && db.is_point(0.)) {
+        slope = Interval(0.);
+        return;
+    }
+    switch (e.type) {
+    case op_assign:
+        slope = db;
+        break;
+    case op_plus:
+        slope = add(da, db);
+        break;
+    case op_minus:
+        slope = sub(da, db);
+        break;
+    case op_mult:
+        slope = add(mul(da, b), mul(a, db));
+        break;
+    case op_div:
+        // (a / b)' = (a' - (a / b) * b') / b
+        slope = div(sub(da, mul(div(a, b), db)), b);
+        break;
+    case op_pow:
+        slope = pow_slope(a, da, b, db, value);
+        break;
+    default:
+        // Comparisons, logic and bitwise operators are piecewise constant,
+        // their derivative is zero unless the result can switch.
+        slope = value.is_point() ? Interval(0.) : entire();
+        break;
+    }
+}
+
+void IntervalEvaluator::visit(AstUnary &e)
+{
+    Interval a  = this->evaluate(e.right);
+    Interval da = slope;
+    value       = interval::apply(e.type, a);
+    if (e.type == op_minus)
+        slope = interval::neg(da);
+    else if (e.type == op_not)
+        slope = (da.is_point(0.) || value.is_point()) ? Interval(0.) : interval::entire();
+}
+
+void IntervalEvaluator::visit(AstConditional &e)
+{
+    int condition = interval::truth(this->evaluate(e.condition));
+    if (condition == 1) {
+        this->evaluate(e.if_true);
+    } else if (condition == 0) {
+        this->evaluate(e.if_false);
+    } else {
+        // Both branches can be taken, and the result can jump between them.
+        Interval a = this->evaluate(e.if_true);
+        Interval b = this->evaluate(e.if_false);
+        value      = interval::hull(a, b);
+        slope      = interval::entire();
+    }
+}
+
+void IntervalEvaluator::visit(AstScope &e)
+{
+    this->evaluate(e.content);
+}
+
+void IntervalEvaluator::visit(AstArray &e)
+{
+    if (e.content.size() != 1)
+        _error("Cannot evaluate an array of %lu elements as a single value!", e.content.size());
+    this->evaluate(e.content[0]);
+}
+
+void IntervalEvaluator::visit(AstFunction &e)
+{
+    using namespace interval;
+    std::vector<Interval> args, slopes;
+    for (auto it : e.content) {
+        args.emplace_back(this->evaluate(it));
+        slopes.emplace_back(slope);
+    }
+    auto check_arity = [&](std::size_t arity) {
+        if (args.size() != arity)
+            _error("Function '%s' expects %lu arguments, received %lu!", e.name.c_str(), arity, args.size());
+    };
+    if ((e.name == "min") || (e.name == "max")) {
+        check_arity(2);
+        const Interval &a = args[0], &b = args[1];
+        bool first_wins, second_wins;
+        if (e.name == "min") {
+            value       = min(a, b);
+            first_wins  = a.upper <= b.lower;
+            second_wins = b.upper <= a.lower;
+        } else {
+            value       = max(a, b);
+            first_wins  = a.lower >= b.upper;
+            second_wins = b.lower >= a.upper;
+        }
+        if (first_wins)
+            slope = slopes[0];
+        else if (second_wins)
+            slope = slopes[1];
+        else
+            slope = hull(slopes[0], slopes[1]);
+        return;
+    }
+    if (e.name == "pow") {
+        check_arity(2);
+        value = pow(args[0], args[1]);
+        if (slopes[0].is_point(0.) && slopes[1].is_point(0.))
+            slope = Interval(0.);
+        else
+            slope = pow_slope(args[0], slopes[0], args[1], slopes[1], value);
+        return;
+    }
+    check_arity(1);
+    const Interval &a = args[0], &da = slopes[0];
+    Interval dfa;
+    if (e.name == "sqrt") {
+        value = sqrt(a);
+        dfa   = div(Interval(0.5), value);
+    } else if (e.name == "exp") {
+        value = exp(a);
+        dfa   = value;
+    } else if (e.name == "log") {
+        value = log(a);
+        dfa   = div(Interval(1.), a);
+    } else if (e.name == "log10") {
+        value = log10(a);
+        dfa   = div(Interval(1.), mul(a, Interval(2.302585092994045, 2.3025850929940459)));
+    } else if (e.name == "abs") {
+        value = abs(a);
+        dfa   = (a.lower >= 0.) ? Interval(1.) : (a.upper <= 0.) ? Interval(-1.) : Interval(-1., 1.);
+    } else if (e.name == "sin") {
+        value = sin(a);
+        dfa   = cos(a);
+    } else if (e.name == "cos") {
+        value = cos(a);
+        dfa   = neg(sin(a));
+    } else if (e.name == "tan") {
+        value = tan(a);
+        dfa   = add(Interval(1.), sqr(value));
+    } else if (e.name == "atan") {
+        value = atan(a);
+        dfa   = div(Interval(1.), add(Interval(1.), sqr(a)));
+    } else if (e.name == "sinh") {
+        value = sinh(a);
+        dfa   = cosh(a);
+    } else if (e.name == "cosh") {
+        value = cosh(a);
+        dfa   = sinh(a);
+    } else if (e.name == "tanh") {
+        value = tanh(a);
+        dfa   = sub(Interval(1.), sqr(value));
+    } else if ((e.name == "floor") || (e.name == "ceil")) {
+        value = (e.name == "floor") ? floor(a) : ceil(a);
+        dfa   = value.is_point() ? Interval(0.) : entire();
+    } else {
+        _error("Unknown function '%s'!", e.name.c_str());
+    }
+    slope = da.is_point(0.) ? Interval(0.) : mul(dfa, da);
+}
+
+void IntervalEvaluator::visit(AstVariable &e)
+{
+    auto it = ranges.find(e.name);
+    if (it == ranges.end())
+        _error("There is no range for variable '%s'!", e.name.c_str());
+    value = it->second;
+    slope = Interval((e.name == wrt) ? 1. : 0.);
+}
+
+void IntervalEvaluator::visit(AstNumber &e)
+{
+    if (e.imaginary)
+        _error("Cannot evaluate the imaginary number %gi on intervals!", e.value);
+    value = Interval(e.value);
+    slope = Interval(0.);
+}
+
+/// @brief Classifies the enclosure of a derivative.
+static inline Monotonicity to_monotonicity(const Interval &slope)
+{
+    if (slope.is_point(0.))
+        return mono_constant;
+    if (slope.lower >= 0.)
+        return mono_increasing;
+    if (slope.upper <= 0.)
+        return mono_decreasing;
+    return mono_unknown;
+}
+
+RangeAnalysis analyze_range(AstNode *node, const std::map<std::string, Interval> &ranges)
+{
+    RangeAnalysis result;
+    result.bounds = IntervalEvaluator(ranges).evaluate(node);
+    // Compute the monotonicity w.r.t. each variable.
+    std::map<std::string, Interval> lower_corner(ranges), upper_corner(ranges);
+    bool refine = false;
+    for (const auto &range : ranges) {
+        IntervalEvaluator evaluator(ranges, range.first);
+        evaluator.evaluate(node);
+        Monotonicity mono                = to_monotonicity(evaluator.get_derivative());
+        result.monotonicity[range.first] = mono;
+        if (range.second.is_point())
+            continue;
+        // Pin the variable to the endpoints where the extrema lie.
+        if ((mono == mono_increasing) || (mono == mono_constant)) {
+            lower_corner[range.first] = Interval(range.second.lower);
+            upper_corner[range.first] = Interval(range.second.upper);
+            refine                    = true;
+        } else if (mono == mono_decreasing) {
+            lower_corner[range.first] = Interval(range.second.upper);
+            upper_corner[range.first] = Interval(range.second.lower);
+            refine                    = true;
+        }
+    }
+    if (refine) {
+        double lower = IntervalEvaluator(lower_corner).evaluate(node).lower;
+        double upper = IntervalEvaluator(upper_corner).evaluate(node).upper;
+        result.bounds.lower = std::max(result.bounds.lower, lower);
+        result.bounds.upper = std::min(result.bounds.upper, upper);
+    }
+    return result;
+}
+
+} // namespace expar
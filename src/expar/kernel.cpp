@@ -0,0 +1,589 @@
+/// @file   kernel.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/kernel.hpp"
+#include "expar/trace.hpp"
+#include "logging.hpp"
+#include "operations.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace expar
+{
+/// @brief Number of points evaluated together.
+static const std::size_t chunk_size = 256;
+
+/// @brief Applies a binary operation over a chunk.
+template <Program::Code code>
+static inline void binary_loop(std::size_t count, double *out, const double *a, const double *b)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = binary<code>(a[i], b[i]);
+}
+
+/// @brief Applies an operation to its operands, on a single point.
+static inline double apply(const Kernel::Step &step,
+                           const double *args,
+                           const std::vector<Function> &functions,
+                           const std::vector<Table> &tables)
+{
+    switch (step.code) {
+    case Program::p_const:
+        return step.constant;
+    case Program::p_add:
+        return binary<Program::p_add>(args[0], args[1]);
+    case Program::p_sub:
+        return binary<Program::p_sub>(args[0], args[1]);
+    case Program::p_mul:
+        return binary<Program::p_mul>(args[0], args[1]);
+    case Program::p_div:
+        return binary<Program::p_div>(args[0], args[1]);
+    case Program::p_mod:
+        return binary<Program::p_mod>(args[0], args[1]);
+    case Program::p_pow:
+        return binary<Program::p_pow>(args[0], args[1]);
+    case Program::p_ipow:
+        return ipow(args[0], static_cast<long>(step.constant));
+    case Program::p_neg:
+        return -args[0];
+    case Program::p_not:
+        return (args[0] == 0.) ? 1. : 0.;
+    case Program::p_eq:
+        return binary<Program::p_eq>(args[0], args[1]);
+    case Program::p_neq:
+        return binary<Program::p_neq>(args[0], args[1]);
+    case Program::p_lt:
+        return binary<Program::p_lt>(args[0], args[1]);
+    case Program::p_gt:
+        return binary<Program::p_gt>(args[0], args[1]);
+    case Program::p_le:
+        return binary<Program::p_le>(args[0], args[1]);
+    case Program::p_ge:
+        return binary<Program::p_ge>(args[0], args[1]);
+    case Program::p_and:
+        return binary<Program::p_and>(args[0], args[1]);
+    case Program::p_or:
+        return binary<Program::p_or>(args[0], args[1]);
+    case Program::p_xor:
+        return binary<Program::p_xor>(args[0], args[1]);
+    case Program::p_bor:
+        return binary<Program::p_bor>(args[0], args[1]);
+    case Program::p_band:
+        return binary<Program::p_band>(args[0], args[1]);
+    case Program::p_bsl:
+        return binary<Program::p_bsl>(args[0], args[1]);
+    case Program::p_bsr:
+        return binary<Program::p_bsr>(args[0], args[1]);
+    case Program::p_call1:
+        return functions[step.index].unary(args[0]);
+    case Program::p_call2:
+        return functions[step.index].binary(args[0], args[1]);
+    case Program::p_call:
+        return functions[step.index].invoke(args);
+    case Program::p_table:
+        return tables[step.index].lookup(args[0]);
+    case Program::p_pwl:
+        return Table::interpolate(args[0], args + 1, step.index);
+    case Program::p_select:
+        return (args[0] != 0.) ? args[1] : args[2];
+    default:
+        break;
+    }
+    _error("Operation %d cannot be part of a kernel!", static_cast<int>(step.code));
+    return 0.;
+}
+
+/// @brief Returns if the operands of the operation can be swapped.
+static inline bool is_commutative(Program::Code code)
+{
+    return (code == Program::p_add) || (code == Program::p_mul) || (code == Program::p_eq) ||
+           (code == Program::p_neq) || (code == Program::p_and) || (code == Program::p_or) ||
+           (code == Program::p_xor) || (code == Program::p_bor) || (code == Program::p_band);
+}
+
+/// @brief Translates the expressions into a graph of values, where each
+///        value is an operation on the values before it. Equal values are
+///        built once.
+class KernelCompiler : public StaticVisitor<KernelCompiler, std::size_t> {
+public:
+    /// The operations, with the values of their operands in place of the
+    /// registers.
+    std::vector<Kernel::Step> values;
+    /// The operands of the operations.
+    std::vector<std::size_t> operands;
+
+    KernelCompiler(const std::vector<std::string> &_variables,
+                   const FunctionRegistry &_registry,
+                   std::vector<Function> &_functions,
+                   std::vector<Table> &_tables)
+        : values(),
+          operands(),
+          variables(_variables),
+          registry(_registry),
+          functions(_functions),
+          tables(_tables),
+          bound(),
+          found(),
+          built()
+    {
+        // Nothing to do.
+    }
+
+    std::size_t visit(AstBinary &e)
+    {
+        // The value of an assignment is the one of its right-hand side.
+        if (e.type == op_assign)
+            return this->dispatch(e.right);
+        // The chain of left operands is walked down without recursion, then
+        // built from the innermost one out.
+        std::vector<AstBinary *> chain;
+        std::size_t value = this->dispatch(left_chain(&e, chain));
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            AstBinary &link = **it;
+            // Exact powers need no call to std::pow.
+            if ((link.type == op_pow) && is_exact_power(link.right))
+                value = this->build(Program::p_ipow, 0, static_cast<AstNumber *>(link.right)->value, { value });
+            else
+                value = this->build(code_of(link.type), 0, 0., { value, this->dispatch(link.right) });
+        }
+        return value;
+    }
+
+    std::size_t visit(AstUnary &e)
+    {
+        std::size_t value = this->dispatch(e.right);
+        if (e.type == op_minus)
+            return this->build(Program::p_neg, 0, 0., { value });
+        if (e.type == op_not)
+            return this->build(Program::p_not, 0, 0., { value });
+        if (e.type != op_plus)
+            _error("Cannot compile unary operator '%s'!", operator_to_string(e.type).c_str());
+        return value;
+    }
+
+    std::size_t visit(AstConditional &e)
+    {
+        std::size_t condition = this->dispatch(e.condition);
+        // A constant condition selects the branch right away.
+        if (values[condition].code == Program::p_const)
+            return this->dispatch((values[condition].constant != 0.) ? e.if_true : e.if_false);
+        std::size_t if_true  = this->dispatch(e.if_true);
+        std::size_t if_false = this->dispatch(e.if_false);
+        return this->build(Program::p_select, 0, 0., { condition, if_true, if_false });
+    }
+
+    std::size_t visit(AstScope &e)
+    {
+        return this->dispatch(e.content);
+    }
+
+    std::size_t visit(AstArray &e)
+    {
+        if (e.content.size() != 1)
+            _error("Cannot compile an array of %lu elements as a single value!", e.content.size());
+        return this->dispatch(e.content[0]);
+    }
+
+    std::size_t visit(AstFunction &e)
+    {
+        if (((e.name == "pwl") || (e.name == "table")) && (registry.find(e.name) == nullptr))
+            return this->compile_table(e);
+        // The random functions return their nominal value.
+        random::Distribution distribution;
+        if (random::find(e.name, e.content.size(), distribution) && (registry.find(e.name) == nullptr))
+            return this->dispatch(e.content[0]);
+        const Function &function = registry.bind(e.name, e.content.size());
+        std::vector<std::size_t> arguments;
+        for (auto argument : e.content)
+            arguments.emplace_back(this->dispatch(argument));
+        // Calls of pure functions on constants are computed right away.
+        if (function.pure && this->are_constant(arguments)) {
+            double args[max_arity];
+            for (std::size_t i = 0; i < arguments.size(); ++i)
+                args[i] = values[arguments[i]].constant;
+            return this->constant(function.invoke(args));
+        }
+        Program::Code code = function.unary ? Program::p_call1 : function.binary ? Program::p_call2 : Program::p_call;
+        return this->build(code, this->index_of(function), 0., arguments, function.pure);
+    }
+
+    std::size_t visit(AstVariable &e)
+    {
+        auto it = std::find(variables.begin(), variables.end(), e.name);
+        if (it == variables.end())
+            _error("There is no input for variable '%s'!", e.name.c_str());
+        return this->build(Program::p_load, static_cast<std::size_t>(it - variables.begin()), 0., {});
+    }
+
+    std::size_t visit(AstNumber &e)
+    {
+        if (e.imaginary)
+            _error("Cannot compile the imaginary number %gi over the real numbers!", e.value);
+        return this->constant(e.value);
+    }
+
+private:
+    /// @brief What identifies a value: the operation, its index, the bits of
+    ///        its constant and its operands.
+    using Key = std::tuple<int, std::size_t, std::uint64_t, std::vector<std::size_t>>;
+
+    const std::vector<std::string> &variables;
+    const FunctionRegistry &registry;
+    std::vector<Function> &functions;
+    std::vector<Table> &tables;
+    /// The position of the functions already in the kernel.
+    std::map<const Function *, std::size_t> bound;
+    /// The values built so far, which can be shared.
+    std::map<Key, std::size_t> found;
+    /// The tables built so far, by their breakpoints.
+    std::map<std::vector<double>, std::size_t> built;
+
+    /// @brief Returns the value of a constant.
+    inline std::size_t constant(double value)
+    {
+        return this->build(Program::p_const, 0, value, {});
+    }
+
+    /// @brief Returns if all the values are constants.
+    inline bool are_constant(const std::vector<std::size_t> &arguments) const
+    {
+        return std::all_of(arguments.begin(), arguments.end(), [this](std::size_t value) {
+            return values[value].code == Program::p_const;
+        });
+    }
+
+    /// @brief Returns the value of an operation, the one already built if
+    ///        there is one, or its result if the operands are constants.
+    inline std::size_t build(Program::Code code,
+                             std::size_t index,
+                             double constant,
+                             std::vector<std::size_t> arguments,
+                             bool pure = true)
+    {
+        Kernel::Step step{ code, index, constant, 0, arguments.size(), 0 };
+        if (pure && (code != Program::p_const) && (code != Program::p_load) && this->are_constant(arguments)) {
+            std::vector<double> args(arguments.size());
+            for (std::size_t i = 0; i < arguments.size(); ++i)
+                args[i] = values[arguments[i]].constant;
+            return this->constant(apply(step, args.data(), functions, tables));
+        }
+        if (is_commutative(code))
+            std::sort(arguments.begin(), arguments.end());
+        Key key;
+        if (pure) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &constant, sizeof(bits));
+            key     = Key(static_cast<int>(code), index, bits, arguments);
+            auto it = found.find(key);
+            if (it != found.end())
+                return it->second;
+        }
+        step.first = operands.size();
+        operands.insert(operands.end(), arguments.begin(), arguments.end());
+        values.emplace_back(step);
+        if (pure)
+            found.emplace(std::move(key), values.size() - 1);
+        return values.size() - 1;
+    }
+
+    /// @brief Compiles a piecewise-linear function, `pwl(x, x1, y1, ...)`.
+    inline std::size_t compile_table(AstFunction &e)
+    {
+        if ((e.content.size() < 3) || (e.content.size() % 2 == 0))
+            _error("Function '%s' expects the abscissa and pairs of breakpoints, received %lu arguments!",
+                   e.name.c_str(), e.content.size());
+        std::vector<std::size_t> arguments;
+        for (auto argument : e.content)
+            arguments.emplace_back(this->dispatch(argument));
+        std::size_t count = (e.content.size() - 1) / 2;
+        std::vector<std::size_t> breakpoints(arguments.begin() + 1, arguments.end());
+        if (!this->are_constant(breakpoints))
+            return this->build(Program::p_pwl, count, 0., arguments);
+        // Constant breakpoints become a table, built once for all the calls
+        // with the same breakpoints.
+        std::vector<double> points(2 * count);
+        for (std::size_t i = 0; i < points.size(); ++i)
+            points[i] = values[breakpoints[i]].constant;
+        auto it = built.find(points);
+        if (it == built.end()) {
+            tables.emplace_back(Table::from_points(points.data(), count));
+            it = built.emplace(points, tables.size() - 1).first;
+        }
+        return this->build(Program::p_table, it->second, 0., { arguments[0] });
+    }
+
+    /// @brief Returns the position of the function inside the kernel, which
+    ///        keeps its own copy of each function it calls.
+    inline std::size_t index_of(const Function &function)
+    {
+        auto it = bound.find(&function);
+        if (it != bound.end())
+            return it->second;
+        functions.emplace_back(function);
+        bound[&function] = functions.size() - 1;
+        return functions.size() - 1;
+    }
+};
+
+Kernel::Kernel(const std::vector<AstNode *> &expressions, std::vector<std::string> _variables, const FunctionRegistry &registry)
+    : variables(std::move(_variables)),
+      functions(),
+      tables(),
+      steps(),
+      operands(),
+      writes(),
+      registers(0),
+      width(0),
+      outputs(expressions.size())
+{
+    trace::Scope scope("compile");
+    KernelCompiler compiler(variables, registry, functions, tables);
+    std::vector<std::size_t> results;
+    for (auto expression : expressions) {
+        if (expression == nullptr)
+            _error("Cannot compile a NULL node!");
+        results.emplace_back(compiler.dispatch(expression));
+    }
+    const std::vector<Step> &values = compiler.values;
+    // Only the values which lead to an output are computed, and each one
+    // keeps its register up to its last use.
+    std::vector<bool> needed(values.size(), false);
+    for (std::size_t result : results)
+        needed[result] = true;
+    for (std::size_t value = values.size(); value > 0; --value) {
+        if (!needed[value - 1])
+            continue;
+        const Step &step = values[value - 1];
+        for (std::size_t k = 0; k < step.arity; ++k)
+            needed[compiler.operands[step.first + k]] = true;
+    }
+    std::vector<std::size_t> last_use(values.size(), 0);
+    for (std::size_t value = 0; value < values.size(); ++value) {
+        last_use[value] = std::max(last_use[value], value);
+        if (!needed[value])
+            continue;
+        for (std::size_t k = 0; k < values[value].arity; ++k)
+            last_use[compiler.operands[values[value].first + k]] = value;
+    }
+    // The outputs of each value.
+    std::vector<std::pair<std::size_t, std::size_t>> produced;
+    for (std::size_t output = 0; output < results.size(); ++output)
+        produced.emplace_back(results[output], output);
+    std::sort(produced.begin(), produced.end());
+    std::vector<std::size_t> register_of(values.size(), 0);
+    std::vector<std::size_t> available;
+    auto release = [&available](std::size_t reg) { available.emplace_back(reg); };
+    auto next    = produced.begin();
+    for (std::size_t value = 0; value < values.size(); ++value) {
+        if (!needed[value])
+            continue;
+        Step step  = values[value];
+        step.first = operands.size();
+        for (std::size_t k = 0; k < step.arity; ++k)
+            operands.emplace_back(register_of[compiler.operands[values[value].first + k]]);
+        width = std::max(width, step.arity);
+        // The registers of the operands used for the last time can hold the
+        // result (each operation reads all its operands before writing).
+        for (std::size_t k = 0; k < step.arity; ++k) {
+            std::size_t operand = compiler.operands[values[value].first + k];
+            bool repeated       = false;
+            for (std::size_t j = 0; j < k; ++j)
+                repeated |= (compiler.operands[values[value].first + j] == operand);
+            if (!repeated && (last_use[operand] == value))
+                release(register_of[operand]);
+        }
+        if (available.empty()) {
+            step.target = registers++;
+        } else {
+            step.target = available.back();
+            available.pop_back();
+        }
+        register_of[value] = step.target;
+        for (; (next != produced.end()) && (next->first == value); ++next)
+            writes.emplace_back(steps.size(), next->second);
+        // Values computed only for the outputs are released right away.
+        if (last_use[value] == value)
+            release(step.target);
+        steps.emplace_back(step);
+    }
+}
+
+void Kernel::evaluate(const double *values, double *out) const
+{
+    // Small kernels keep their registers in place.
+    double local[256];
+    std::vector<double> heap;
+    double *reg = local;
+    if (registers > 256) {
+        heap.resize(registers);
+        reg = heap.data();
+    }
+    double local_args[16];
+    std::vector<double> heap_args;
+    double *args = local_args;
+    if (width > 16) {
+        heap_args.resize(width);
+        args = heap_args.data();
+    }
+    auto write = writes.begin();
+    for (std::size_t position = 0; position < steps.size(); ++position) {
+        const Step &step = steps[position];
+        if (step.code == Program::p_load) {
+            reg[step.target] = values[step.index];
+        } else {
+            for (std::size_t k = 0; k < step.arity; ++k)
+                args[k] = reg[operands[step.first + k]];
+            reg[step.target] = apply(step, args, functions, tables);
+        }
+        for (; (write != writes.end()) && (write->first == position); ++write)
+            out[write->second] = reg[step.target];
+    }
+}
+
+void Kernel::evaluate_chunk(std::size_t count, const double *const *values, double *storage, double *args, double *out, std::size_t stride) const
+{
+    auto slot  = [storage](std::size_t index) { return storage + index * chunk_size; };
+    auto write = writes.begin();
+    for (std::size_t position = 0; position < steps.size(); ++position) {
+        const Step &step = steps[position];
+        const std::size_t *operand = operands.data() + step.first;
+        double *r                  = slot(step.target);
+        const double *a            = (step.arity > 0) ? slot(operand[0]) : nullptr;
+        const double *b            = (step.arity > 1) ? slot(operand[1]) : nullptr;
+        switch (step.code) {
+        case Program::p_const:
+            std::fill(r, r + count, step.constant);
+            break;
+        case Program::p_load:
+            std::copy(values[step.index], values[step.index] + count, r);
+            break;
+        case Program::p_add:
+            binary_loop<Program::p_add>(count, r, a, b);
+            break;
+        case Program::p_sub:
+            binary_loop<Program::p_sub>(count, r, a, b);
+            break;
+        case Program::p_mul:
+            binary_loop<Program::p_mul>(count, r, a, b);
+            break;
+        case Program::p_div:
+            binary_loop<Program::p_div>(count, r, a, b);
+            break;
+        case Program::p_mod:
+            binary_loop<Program::p_mod>(count, r, a, b);
+            break;
+        case Program::p_pow:
+            binary_loop<Program::p_pow>(count, r, a, b);
+            break;
+        case Program::p_ipow: {
+            auto n = static_cast<long>(step.constant);
+            for (std::size_t i = 0; i < count; ++i)
+                r[i] = ipow(a[i], n);
+            break;
+        }
+        case Program::p_neg:
+            for (std::size_t i = 0; i < count; ++i)
+                r[i] = -a[i];
+            break;
+        case Program::p_not:
+            for (std::size_t i = 0; i < count; ++i)
+                r[i] = (a[i] == 0.) ? 1. : 0.;
+            break;
+        case Program::p_eq:
+            binary_loop<Program::p_eq>(count, r, a, b);
+            break;
+        case Program::p_neq:
+            binary_loop<Program::p_neq>(count, r, a, b);
+            break;
+        case Program::p_lt:
+            binary_loop<Program::p_lt>(count, r, a, b);
+            break;
+        case Program::p_gt:
+            binary_loop<Program::p_gt>(count, r, a, b);
+            break;
+        case Program::p_le:
+            binary_loop<Program::p_le>(count, r, a, b);
+            break;
+        case Program::p_ge:
+            binary_loop<Program::p_ge>(count, r, a, b);
+            break;
+        case Program::p_and:
+            binary_loop<Program::p_and>(count, r, a, b);
+            break;
+        case Program::p_or:
+            binary_loop<Program::p_or>(count, r, a, b);
+            break;
+        case Program::p_xor:
+            binary_loop<Program::p_xor>(count, r, a, b);
+            break;
+        case Program::p_bor:
+            binary_loop<Program::p_bor>(count, r, a, b);
+            break;
+        case Program::p_band:
+            binary_loop<Program::p_band>(count, r, a, b);
+            break;
+        case Program::p_bsl:
+            binary_loop<Program::p_bsl>(count, r, a, b);
+            break;
+        case Program::p_bsr:
+            binary_loop<Program::p_bsr>(count, r, a, b);
+            break;
+        case Program::p_call1: {
+            const Function &function = functions[step.index];
+            if (function.batch) {
+                function.batch(count, a, r);
+            } else {
+                for (std::size_t i = 0; i < count; ++i)
+                    r[i] = function.unary(a[i]);
+            }
+            break;
+        }
+        case Program::p_call2: {
+            auto function = functions[step.index].binary;
+            for (std::size_t i = 0; i < count; ++i)
+                r[i] = function(a[i], b[i]);
+            break;
+        }
+        case Program::p_table:
+            tables[step.index].lookup(count, a, r);
+            break;
+        case Program::p_select: {
+            const double *c = slot(operand[2]);
+            for (std::size_t i = 0; i < count; ++i)
+                r[i] = (a[i] != 0.) ? b[i] : c[i];
+            break;
+        }
+        default:
+            // Calls of many arguments and piecewise-linear functions gather
+            // their operands point by point.
+            for (std::size_t i = 0; i < count; ++i) {
+                for (std::size_t k = 0; k < step.arity; ++k)
+                    args[k] = slot(operand[k])[i];
+                r[i] = apply(step, args, functions, tables);
+            }
+            break;
+        }
+        for (; (write != writes.end()) && (write->first == position); ++write)
+            std::copy(r, r + count, out + write->second * stride);
+    }
+}
+
+void Kernel::evaluate(std::size_t count, const double *const *values, double *out) const
+{
+    trace::Scope scope("evaluate");
+    std::vector<double> storage(registers * chunk_size);
+    std::vector<double> args(width);
+    std::vector<const double *> chunk(variables.size());
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t n = std::min(chunk_size, count - begin);
+        for (std::size_t v = 0; v < variables.size(); ++v)
+            chunk[v] = values[v] + begin;
+        this->evaluate_chunk(n, chunk.data(), storage.data(), args.data(), out + begin, count);
+    }
+}
+
+} // namespace expar
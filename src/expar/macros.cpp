@@ -0,0 +1,230 @@
+/// @file   macros.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/macros.hpp"
+#include "expar/parser.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace expar
+{
+/// @brief Returns the number of nodes of the expression.
+static std::size_t size_of(AstNode *node)
+{
+    std::size_t size = 0;
+    std::vector<AstNode **> links;
+    std::vector<AstNode *> pending(1, node);
+    while (!pending.empty()) {
+        AstNode *next = pending.back();
+        pending.pop_back();
+        if (next == nullptr)
+            continue;
+        ++size;
+        links.clear();
+        links_of(next, links);
+        for (auto link : links)
+            pending.emplace_back(*link);
+    }
+    return size;
+}
+
+/// @brief The state of an expansion.
+class Expansion {
+public:
+    Expansion(const std::map<std::string, MacroTable::Macro> &_macros, std::size_t _budget)
+        : macros(_macros),
+          chains(),
+          budget(_budget),
+          added(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Expands the calls inside the tree, in place.
+    void walk(AstNode *&root)
+    {
+        // The arguments of a call are expanded before the call itself, so
+        // they are substituted without calls left. Each link comes with the
+        // chain of calls which produced it, so that functions calling
+        // themselves are found.
+        std::vector<Pending> pending(1, Pending{ &root, none, false });
+        std::vector<AstNode **> links;
+        while (!pending.empty()) {
+            Pending next = pending.back();
+            pending.pop_back();
+            AstNode *node = *next.link;
+            if (node == nullptr)
+                continue;
+            links.clear();
+            links_of(node, links);
+            if (node->kind == node_function) {
+                auto call = static_cast<AstFunction *>(node);
+                auto it   = macros.find(call->name);
+                if ((it != macros.end()) && !next.ready) {
+                    pending.emplace_back(Pending{ next.link, next.chain, true });
+                    for (auto argument : links)
+                        pending.emplace_back(Pending{ argument, next.chain, false });
+                    continue;
+                }
+                if (it != macros.end()) {
+                    for (std::size_t c = next.chain; c != none; c = chains[c].second)
+                        if (*chains[c].first == it->first)
+                            _error("Function '%s' calls itself!", it->first.c_str());
+                    chains.emplace_back(&it->first, next.chain);
+                    // The calls made by the body are expanded after the
+                    // substitution, so the link is visited again.
+                    *next.link = this->instantiate(it->first, it->second, call);
+                    delete call;
+                    pending.emplace_back(Pending{ next.link, chains.size() - 1, false });
+                    continue;
+                }
+            }
+            for (auto child : links)
+                pending.emplace_back(Pending{ child, next.chain, false });
+        }
+    }
+
+private:
+    /// The chain without calls.
+    static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+    /// @brief A link waiting to be expanded.
+    struct Pending {
+        /// The link.
+        AstNode **link;
+        /// The call which produced the node.
+        std::size_t chain;
+        /// If the arguments of the call are already expanded.
+        bool ready;
+    };
+
+    const std::map<std::string, MacroTable::Macro> &macros;
+    /// The calls expanded so far, as the function and the call which
+    /// produced it.
+    std::vector<std::pair<const std::string *, std::size_t>> chains;
+    /// The number of nodes which can be added.
+    std::size_t budget;
+    /// The number of nodes added so far.
+    std::size_t added;
+
+    /// @brief Returns a copy of the body where the parameters are replaced
+    ///        by copies of the arguments of the call. The calls inside the
+    ///        body are expanded afterwards, so that the parameters never
+    ///        capture the names used by the functions it calls.
+    AstNode *instantiate(const std::string &name, const MacroTable::Macro &macro, AstFunction *call)
+    {
+        if (call->content.size() != macro.parameters.size())
+            _error("Function '%s' expects %lu arguments, received %lu!",
+                   name.c_str(), macro.parameters.size(), call->content.size());
+        AstNode *result = clone(macro.body);
+        std::vector<AstNode **> pending(1, &result);
+        while (!pending.empty()) {
+            AstNode **link = pending.back();
+            pending.pop_back();
+            AstNode *node = *link;
+            if (node == nullptr)
+                continue;
+            this->add(1, result);
+            if (node->kind == node_variable) {
+                auto &parameters = macro.parameters;
+                auto it          = std::find(parameters.begin(), parameters.end(), static_cast<AstVariable *>(node)->name);
+                if (it != parameters.end()) {
+                    AstNode *argument = call->content[static_cast<std::size_t>(it - parameters.begin())];
+                    *link             = clone(argument);
+                    delete node;
+                    this->add(size_of(argument) - 1, result);
+                    continue;
+                }
+            }
+            // The nodes of the body take the position of the call.
+            node->begin = call->begin;
+            node->end   = call->end;
+            links_of(node, pending);
+        }
+        return result;
+    }
+
+    /// @brief Counts the nodes added, the partial copy is deleted when the
+    ///        budget is exceeded.
+    inline void add(std::size_t nodes, AstNode *copy)
+    {
+        added += nodes;
+        if (added > budget) {
+            delete copy;
+            _error("Expanding the calls adds more than %lu nodes!", budget);
+        }
+    }
+};
+
+MacroTable::MacroTable()
+    : macros()
+{
+    // Nothing to do.
+}
+
+MacroTable::~MacroTable()
+{
+    for (auto &macro : macros)
+        delete macro.second.body;
+}
+
+void MacroTable::define(const std::string &definition)
+{
+    AstNode *node = parser::parse(definition);
+    auto equal    = static_cast<AstBinary *>(node);
+    if ((node->kind != node_binary) || (equal->type != op_assign) || (equal->left->kind != node_function)) {
+        delete node;
+        _error("The definition '%s' is not written as 'name(a, b, ...) = body'!", definition.c_str());
+    }
+    auto head = static_cast<AstFunction *>(equal->left);
+    std::vector<std::string> parameters;
+    for (auto parameter : head->content) {
+        if (parameter->kind != node_variable) {
+            delete node;
+            _error("The parameters of '%s' must be names!", definition.c_str());
+        }
+        parameters.emplace_back(static_cast<AstVariable *>(parameter)->name);
+    }
+    std::string name = head->name;
+    AstNode *body    = equal->right;
+    equal->right     = nullptr;
+    delete node;
+    this->define(name, std::move(parameters), body);
+}
+
+void MacroTable::define(const std::string &name, std::vector<std::string> parameters, AstNode *body)
+{
+    if (body == nullptr)
+        _error("The body of '%s' is NULL!", name.c_str());
+    for (std::size_t i = 0; i < parameters.size(); ++i) {
+        if (std::find(parameters.begin() + static_cast<std::ptrdiff_t>(i) + 1, parameters.end(), parameters[i]) != parameters.end()) {
+            delete body;
+            _error("Parameter '%s' of '%s' is repeated!", parameters[i].c_str(), name.c_str());
+        }
+    }
+    auto it = macros.find(name);
+    if (it != macros.end())
+        delete it->second.body;
+    macros[name] = Macro{ std::move(parameters), body };
+}
+
+bool MacroTable::contains(const std::string &name) const
+{
+    return macros.find(name) != macros.end();
+}
+
+AstNode *MacroTable::expand(AstNode *node, std::size_t budget) const
+{
+    Expansion expansion(macros, budget);
+    try {
+        expansion.walk(node);
+    } catch (...) {
+        delete node;
+        throw;
+    }
+    return node;
+}
+
+} // namespace expar
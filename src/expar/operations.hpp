@@ -0,0 +1,135 @@
+/// @file   operations.hpp
+/// @author Enrico Fraccaroli
+/// @brief  The operations shared by the programs and the kernels, which are
+///         not part of the interface of the library.
+
+#pragma once
+
+#include "expar/bitwise.hpp"
+#include "expar/program.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+/// @brief Applies a binary operation, with the same semantics of the
+///        Evaluator.
+template <Program::Code code, typename T>
+inline T binary(T l, T r)
+{
+    if constexpr (code == Program::p_add)
+        return l + r;
+    else if constexpr (code == Program::p_sub)
+        return l - r;
+    else if constexpr (code == Program::p_mul)
+        return l * r;
+    else if constexpr (code == Program::p_div)
+        return l / r;
+    else if constexpr (code == Program::p_mod)
+        return std::fmod(l, r);
+    else if constexpr (code == Program::p_pow)
+        return std::pow(l, r);
+    else if constexpr (code == Program::p_eq)
+        return (l == r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_neq)
+        return (l != r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_lt)
+        return (l < r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_gt)
+        return (l > r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_le)
+        return (l <= r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_ge)
+        return (l >= r) ? T(1) : T(0);
+    else if constexpr (code == Program::p_and)
+        return ((l != 0) && (r != 0)) ? T(1) : T(0);
+    else if constexpr (code == Program::p_or)
+        return ((l != 0) || (r != 0)) ? T(1) : T(0);
+    else if constexpr (code == Program::p_xor)
+        return ((l != 0) != (r != 0)) ? T(1) : T(0);
+    else if constexpr (code == Program::p_bor)
+        return bitwise::bor(l, r);
+    else if constexpr (code == Program::p_band)
+        return bitwise::band(l, r);
+    else if constexpr (code == Program::p_bsl)
+        return bitwise::bsl(l, r);
+    else
+        return bitwise::bsr(l, r);
+}
+
+/// @brief Checks if the exponent is 0 or 1, whose power is exact and then
+///        has the same bits when computed by ipow or by std::pow. Any other
+///        exponent is left to std::pow, as in the Evaluator, since std::pow
+///        does not always round x^2 or 1/x as a multiplication does.
+inline bool is_exact_power(const AstNode *exponent)
+{
+    if ((exponent->kind != node_number) || static_cast<const AstNumber *>(exponent)->imaginary)
+        return false;
+    double value = static_cast<const AstNumber *>(exponent)->value;
+    return (value == 0.) || (value == 1.);
+}
+
+/// @brief Raises a value to an integer power, by repeated multiplication.
+template <typename T>
+inline T ipow(T x, long n)
+{
+    T result = 1;
+    for (long k = (n < 0) ? -n : n; k; k >>= 1) {
+        if (k & 1)
+            result *= x;
+        x *= x;
+    }
+    return (n < 0) ? (1 / result) : result;
+}
+
+/// @brief The binary operators, and their operation.
+inline Program::Code code_of(Operator op)
+{
+    switch (op) {
+    case op_plus:
+        return Program::p_add;
+    case op_minus:
+        return Program::p_sub;
+    case op_mult:
+        return Program::p_mul;
+    case op_div:
+        return Program::p_div;
+    case op_mod:
+        return Program::p_mod;
+    case op_pow:
+        return Program::p_pow;
+    case op_eq:
+        return Program::p_eq;
+    case op_neq:
+        return Program::p_neq;
+    case op_lt:
+        return Program::p_lt;
+    case op_gt:
+        return Program::p_gt;
+    case op_le:
+        return Program::p_le;
+    case op_ge:
+        return Program::p_ge;
+    case op_and:
+        return Program::p_and;
+    case op_or:
+        return Program::p_or;
+    case op_xor:
+        return Program::p_xor;
+    case op_bor:
+        return Program::p_bor;
+    case op_band:
+        return Program::p_band;
+    case op_bsl:
+        return Program::p_bsl;
+    case op_bsr:
+        return Program::p_bsr;
+    default:
+        break;
+    }
+    _error("Cannot compile binary operator '%s'!", operator_to_string(op).c_str());
+    return Program::p_add;
+}
+
+} // namespace expar
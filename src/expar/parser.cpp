@@ -1,10 +1,17 @@
 
 #include "expar/parser.hpp"
+#include "expar/scan.hpp"
+#include "expar/stats.hpp"
+#include "expar/trace.hpp"
 #include "antlr4-runtime.h"
 #include "ExparParserBaseVisitor.h"
 #include "ExparLexer.h"
 #include "logging.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+
 namespace expar::parser
 {
 /// @brief Helper function to cast a pointer of type **Base** to a pointer
@@ -43,6 +50,15 @@ inline double to_number(ExparParser::Value_atomContext *ctx)
         ss >> value;
         return value;
     }
+    if (ctx->COMPLEX()) {
+        // Drop the trailing imaginary unit.
+        std::string text = ctx->COMPLEX()->toString();
+        std::stringstream ss;
+        ss << text.substr(0, text.size() - 1);
+        double value;
+        ss >> value;
+        return value;
+    }
     _error("Cannot type expression number!");
     return 0;
 }
@@ -69,235 +85,680 @@ inline ScopeType to_scope(ExparParser::Value_scopeContext *ctx)
     return scp_none;
 }
 
-inline Operator to_operator(ExparParser::Value_unaryContext *ctx)
-{
-    if (ctx->PLUS())
-        return op_plus;
-    if (ctx->MINUS())
-        return op_minus;
-    _error("Cannot type operator of unary operation!");
-    return op_none;
-}
-
-inline Operator to_operator(ExparParser::Value_operatorContext *ctx)
+inline Operator to_operator(antlr4::Token *token)
 {
-    // : EQUAL
-    // | PLUS | MINUS | STAR | SLASH
-    // | LOGIC_AND | LOGIC_BITWISE_AND
-    // | LOGIC_OR  | LOGIC_BITWISE_OR
-    // | LOGIC_EQUAL | LOGIC_NOT_EQUAL
-    // | LOGIC_XOR
-    // | LESS_THAN    | LESS_THEN_EQUAL
-    // | GREATER_THAN | GREATER_THEN_EQUAL
-    // | EXCLAMATION_MARK
-    // | BITWISE_SHIFT_LEFT | BITWISE_SHIFT_RIGHT
-    // | POWER_OPERATOR | CARET
-    // | PERCENT
-    if (ctx->EQUAL())
+    switch (token->getType()) {
+    case ExparLexer::EQUAL:
         return op_assign;
-    if (ctx->PLUS())
+    case ExparLexer::PLUS:
         return op_plus;
-    if (ctx->MINUS())
+    case ExparLexer::MINUS:
         return op_minus;
-    if (ctx->STAR())
+    case ExparLexer::STAR:
         return op_mult;
-    if (ctx->SLASH())
+    case ExparLexer::SLASH:
         return op_div;
-    if (ctx->LOGIC_AND())
+    case ExparLexer::LOGIC_AND:
         return op_and;
-    if (ctx->LOGIC_BITWISE_AND())
+    case ExparLexer::LOGIC_BITWISE_AND:
         return op_band;
-    if (ctx->LOGIC_OR())
+    case ExparLexer::LOGIC_OR:
         return op_or;
-    if (ctx->LOGIC_BITWISE_OR())
+    case ExparLexer::LOGIC_BITWISE_OR:
         return op_bor;
-    if (ctx->LOGIC_EQUAL())
+    case ExparLexer::LOGIC_EQUAL:
         return op_eq;
-    if (ctx->LOGIC_NOT_EQUAL())
+    case ExparLexer::LOGIC_NOT_EQUAL:
         return op_neq;
-    if (ctx->LOGIC_XOR())
+    case ExparLexer::LOGIC_XOR:
         return op_xor;
-    if (ctx->LESS_THAN())
+    case ExparLexer::LESS_THAN:
         return op_lt;
-    if (ctx->LESS_THAN_EQUAL())
+    case ExparLexer::LESS_THAN_EQUAL:
         return op_le;
-    if (ctx->GREATER_THAN())
-        return op_lt;
-    if (ctx->GREATER_THAN_EQUAL())
+    case ExparLexer::GREATER_THAN:
+        return op_gt;
+    case ExparLexer::GREATER_THAN_EQUAL:
         return op_ge;
-    if (ctx->EXCLAMATION_MARK())
+    case ExparLexer::EXCLAMATION_MARK:
         return op_not;
-    if (ctx->BITWISE_SHIFT_LEFT())
+    case ExparLexer::BITWISE_SHIFT_LEFT:
         return op_bsl;
-    if (ctx->BITWISE_SHIFT_RIGHT())
+    case ExparLexer::BITWISE_SHIFT_RIGHT:
         return op_bsr;
-    if (ctx->POWER_OPERATOR() || ctx->CARET())
+    case ExparLexer::POWER_OPERATOR:
+    case ExparLexer::CARET:
         return op_pow;
-    if (ctx->PERCENT())
+    case ExparLexer::PERCENT:
         return op_mod;
-    _error("Cannot type operator of binary operation!");
+    default:
+        break;
+    }
+    _error("Cannot type operator '%s'!", token->getText().c_str());
     return op_none;
 }
 
+/// @brief Returns the bytes taken by the node itself, its children and the
+///        memory owned by its strings and vectors excluded.
+static inline std::size_t footprint_of(AstNode *node)
+{
+    switch (node->kind) {
+    case node_binary:
+        return sizeof(AstBinary);
+    case node_unary:
+        return sizeof(AstUnary);
+    case node_conditional:
+        return sizeof(AstConditional);
+    case node_scope:
+        return sizeof(AstScope);
+    case node_array:
+        return sizeof(AstArray);
+    case node_function:
+        return sizeof(AstFunction);
+    case node_variable:
+        return sizeof(AstVariable);
+    case node_number:
+        return sizeof(AstNumber);
+    }
+    return sizeof(AstNode);
+}
+
 class ExparVisitor : public ExparParserVisitor {
 public:
-    antlrcpp::Any visitValue(ExparParser::ValueContext *ctx) override
+    /// @brief Construct a new visitor.
+    /// @param _offset position of the parsed text inside the whole source.
+    ExparVisitor(std::size_t _offset = 0)
+        : root(nullptr),
+          visited(0),
+          built(),
+          bytes(0),
+          offset(_offset),
+          parent(nullptr),
+          pending()
     {
-        // :    value_unary
-        // |    value_function_call
-        // |    value_scope
-        // |    value_atom
-        // | -> value value_operator value
-        if (ctx->value().size() == 2 && ctx->value_operator()) {
-            auto node = new AstBinary(op_none, nullptr, nullptr);
-            this->add_to_parent(node);
-            this->push(node);
-            auto result = visitChildren(ctx);
-            this->pop();
-            return result;
+        // Nothing to do.
+    }
+
+    /// @brief Builds the expression. The parse tree is walked with an
+    ///        explicit stack, since long chains of operators produce parse
+    ///        trees as deep as the number of operators.
+    AstNode *build(antlr4::tree::ParseTree *tree)
+    {
+        pending.emplace_back(tree, nullptr);
+        while (!pending.empty()) {
+            auto next = pending.back();
+            pending.pop_back();
+            ++visited;
+            parent = next.second;
+            next.first->accept(this);
         }
-        return visitChildren(ctx);
+        return root;
     }
 
-    antlrcpp::Any visitValue_unary(ExparParser::Value_unaryContext *ctx) override
+    antlrcpp::Any visitValue(ExparParser::ValueContext *ctx) override
     {
-        auto node = new AstUnary(to_operator(ctx), nullptr);
+        // :    value_function_call
+        // |    value_scope
+        // |    value_atom
+        // | -> (PLUS | MINUS | EXCLAMATION_MARK) value
+        // | -> value <operator> value
+        // | -> value QUESTION_MARK value COLON value
+        AstNode *node = nullptr;
+        if (ctx->value().size() == 3) {
+            node = new AstConditional(nullptr, nullptr, nullptr);
+        } else if (ctx->value().size() == 2) {
+            auto symbol = to<antlr4::tree::TerminalNode>(ctx->children[1]);
+            assert(symbol && "The operator of a binary operation is not a token!");
+            node = new AstBinary(to_operator(symbol->getSymbol()), nullptr, nullptr);
+        } else if (ctx->value().size() == 1) {
+            node = new AstUnary(to_operator(ctx->getStart()), nullptr);
+        } else {
+            this->schedule(ctx, parent);
+            return nullptr;
+        }
+        this->locate(node, ctx);
         this->add_to_parent(node);
-        this->push(node);
-        auto result = visitChildren(ctx);
-        this->pop();
-        return result;
+        this->schedule(ctx, node);
+        return nullptr;
     }
 
     antlrcpp::Any visitValue_function_call(ExparParser::Value_function_callContext *ctx) override
     {
         assert(ctx->ID() && "There is a function without ID!");
-        auto node = new AstFunction(ctx->ID()->toString(), {});
+        // The call if(condition, if_true, if_false) is a conditional.
+        AstNode *node;
+        if ((ctx->ID()->toString() == "if") && (ctx->value().size() == 3))
+            node = new AstConditional(nullptr, nullptr, nullptr);
+        else
+            node = new AstFunction(ctx->ID()->toString(), {});
+        this->locate(node, ctx);
         this->add_to_parent(node);
-        this->push(node);
-        auto result = visitChildren(ctx);
-        this->pop();
-        return result;
+        this->schedule(ctx, node);
+        return nullptr;
     }
 
     antlrcpp::Any visitValue_scope(ExparParser::Value_scopeContext *ctx) override
     {
-        auto node = new AstScope(to_scope(ctx), nullptr);
+        // Square brackets build arrays, of any number of elements.
+        AstNode *node;
+        if (ctx->OPEN_SQUARE())
+            node = new AstArray({});
+        else
+            node = new AstScope(to_scope(ctx), nullptr);
+        this->locate(node, ctx);
         this->add_to_parent(node);
-        this->push(node);
-        auto result = visitChildren(ctx);
-        this->pop();
-        return result;
-    }
-
-    antlrcpp::Any visitValue_operator(ExparParser::Value_operatorContext *ctx) override
-    {
-        auto parent = this->get_back();
-        assert(parent && "There is no parent!");
-        auto binary = to<AstBinary>(parent);
-        if (binary) {
-            binary->type = to_operator(ctx);
-        } else {
-            auto unary = to<AstUnary>(parent);
-            if (unary) {
-                unary->type = to_operator(ctx);
-            } else {
-                perror("Parent node is not a binary/unary operator!");
-                exit(1);
-            }
-        }
-        return visitChildren(ctx);
+        this->schedule(ctx, node);
+        return nullptr;
     }
 
     antlrcpp::Any visitValue_atom(ExparParser::Value_atomContext *ctx) override
     {
-        if (ctx->NUMBER()) {
-            auto leaf = new AstNumber(to_number(ctx));
-            this->add_to_parent(leaf);
-        } else {
-            auto leaf = new AstVariable(to_string(ctx));
-            this->add_to_parent(leaf);
-        }
-        return visitChildren(ctx);
+        AstNode *leaf;
+        if (ctx->NUMBER() || ctx->COMPLEX())
+            leaf = new AstNumber(to_number(ctx), ctx->COMPLEX() != nullptr);
+        else
+            leaf = new AstVariable(to_string(ctx));
+        this->locate(leaf, ctx);
+        this->add_to_parent(leaf);
+        return nullptr;
     }
 
     AstNode *root;
+    /// The number of rules visited.
+    std::size_t visited;
+    /// The number of nodes built, for each kind.
+    std::size_t built[node_kinds];
+    /// The bytes taken by the nodes built (see footprint_of).
+    std::size_t bytes;
 
 private:
-    std::vector<AstNode *> stack;
+    std::size_t offset;
+    /// The node which receives the nodes built by the current visit.
+    AstNode *parent;
+    /// The parse trees still to visit, with the node which receives them.
+    std::vector<std::pair<antlr4::tree::ParseTree *, AstNode *>> pending;
 
-    inline AstNode *get_back() const
+    inline void locate(AstNode *node, antlr4::ParserRuleContext *ctx)
     {
-        if (stack.empty())
-            return nullptr;
-        return stack.back();
+        ++built[node->kind];
+        bytes += footprint_of(node);
+        node->begin = offset + ctx->getStart()->getStartIndex();
+        node->end   = node->begin;
+        if (ctx->getStop() && (ctx->getStop()->getStopIndex() >= ctx->getStart()->getStartIndex()))
+            node->end = offset + ctx->getStop()->getStopIndex() + 1;
     }
 
-    inline void push(AstNode *node)
+    /// @brief Schedules the rules below the context, so that they are
+    ///        visited in order and their nodes are given to the owner.
+    inline void schedule(antlr4::ParserRuleContext *ctx, AstNode *owner)
     {
-        if (node == nullptr)
-            _error("Executing push and receiving a NULL node!");
-        stack.emplace_back(node);
-    }
-
-    inline AstNode *pop()
-    {
-        auto node = this->get_back();
-        if (node == nullptr)
-            _error("Executing pop and receiving a NULL node!");
-        stack.pop_back();
-        return node;
+        for (auto it = ctx->children.rbegin(); it != ctx->children.rend(); ++it)
+            if (is_a<antlr4::ParserRuleContext>(*it))
+                pending.emplace_back(*it, owner);
     }
 
     inline void add_to_parent(AstNode *node)
     {
-        AstNode *parent = this->get_back();
-        if (parent) {
-            auto unary = to<AstUnary>(parent);
-            if (unary) {
-                unary->right = node;
-                return;
-            }
-            auto binary = to<AstBinary>(parent);
-            if (binary) {
-                if (!binary->left)
-                    binary->left = node;
-                else if (!binary->right)
-                    binary->right = node;
-                return;
-            }
-            auto function = to<AstFunction>(parent);
-            if (function) {
-                function->content.emplace_back(node);
-                return;
-            }
-            auto scope = to<AstScope>(parent);
-            if (scope) {
-                scope->content = node;
-                return;
-            }
-        } else {
+        if (parent == nullptr) {
             root = node;
+        } else if (parent->kind == node_unary) {
+            static_cast<AstUnary *>(parent)->right = node;
+        } else if (parent->kind == node_binary) {
+            auto binary = static_cast<AstBinary *>(parent);
+            if (!binary->left)
+                binary->left = node;
+            else if (!binary->right)
+                binary->right = node;
+        } else if (parent->kind == node_conditional) {
+            auto conditional = static_cast<AstConditional *>(parent);
+            if (!conditional->condition)
+                conditional->condition = node;
+            else if (!conditional->if_true)
+                conditional->if_true = node;
+            else if (!conditional->if_false)
+                conditional->if_false = node;
+        } else if (parent->kind == node_function) {
+            static_cast<AstFunction *>(parent)->content.emplace_back(node);
+        } else if (parent->kind == node_scope) {
+            static_cast<AstScope *>(parent)->content = node;
+        } else if (parent->kind == node_array) {
+            static_cast<AstArray *>(parent)->content.emplace_back(node);
         }
     }
 };
 
-AstNode *parse(const std::string &str)
+/// @brief Returns how deep the parser has to recurse to read the tokens.
+///        Chains of left-associative operators are read in a loop, while
+///        each bracket, prefix operator and right-associative operator
+///        nests until the end of its operand. The estimate never falls
+///        below the actual depth.
+static std::size_t nesting_of(const std::vector<antlr4::Token *> &tokens)
+{
+    // For each open bracket: the operators still waiting for the end of
+    // their operand, and the assignments and conditionals (which only end
+    // with the bracket).
+    std::vector<std::pair<std::size_t, std::size_t>> levels(1, { 0, 0 });
+    std::vector<std::size_t> brackets;
+    std::size_t depth = 0, maximum = 0, previous = ExparLexer::EQUAL;
+    for (auto token : tokens) {
+        if (token->getChannel() != antlr4::Token::DEFAULT_CHANNEL)
+            continue;
+        std::size_t type = token->getType();
+        bool operand     = (previous == ExparLexer::ID) || (previous == ExparLexer::NUMBER) ||
+                       (previous == ExparLexer::COMPLEX) || (previous == ExparLexer::PERCENTAGE) ||
+                       (previous == ExparLexer::CLOSE_ROUND) || (previous == ExparLexer::CLOSE_SQUARE) ||
+                       (previous == ExparLexer::CLOSE_CURLY);
+        bool closing = (type == ExparLexer::CLOSE_ROUND) || (type == ExparLexer::CLOSE_SQUARE) ||
+                       (type == ExparLexer::CLOSE_CURLY) ||
+                       ((type == ExparLexer::APEX) && !brackets.empty() && (brackets.back() == ExparLexer::APEX));
+        if (closing) {
+            if (!brackets.empty()) {
+                depth -= levels.back().first + levels.back().second + 1;
+                levels.pop_back();
+                brackets.pop_back();
+            }
+            // The closing apex is an operand, like the other brackets.
+            previous = ExparLexer::CLOSE_ROUND;
+            continue;
+        }
+        if ((type == ExparLexer::OPEN_ROUND) || (type == ExparLexer::OPEN_SQUARE) ||
+            (type == ExparLexer::OPEN_CURLY) || (type == ExparLexer::APEX)) {
+            levels.emplace_back(0, 0);
+            brackets.emplace_back(type);
+            depth += 1;
+        } else if (!operand && ((type == ExparLexer::PLUS) || (type == ExparLexer::MINUS) || (type == ExparLexer::EXCLAMATION_MARK))) {
+            levels.back().first += 1;
+            depth += 1;
+        } else if ((type == ExparLexer::POWER_OPERATOR) || (type == ExparLexer::CARET)) {
+            levels.back().first += 1;
+            depth += 1;
+        } else if ((type == ExparLexer::EQUAL) || (type == ExparLexer::QUESTION_MARK)) {
+            levels.back().second += 1;
+            depth += 1;
+        } else if (type == ExparLexer::COMMA) {
+            depth -= levels.back().first + levels.back().second;
+            levels.back() = { 0, 0 };
+        } else if (operand) {
+            // Any other binary operator binds looser than the prefix and
+            // power operators, which are then complete.
+            depth -= levels.back().first;
+            levels.back().first = 0;
+        }
+        maximum  = std::max(maximum, depth);
+        previous = type;
+    }
+    return maximum;
+}
+
+/// @brief Parses the text.
+/// @param str      the text.
+/// @param offset   position of the text inside the whole source, which is
+///                 added to the position of the nodes.
+/// @param max_depth the limit on the nesting of the expression.
+/// @param tokens   if not NULL, where the tokens are stored.
+/// @param complete if not NULL, set to true if the whole text is a single
+///                 expression without syntax errors.
+/// @return The expression.
+static AstNode *build(const std::string &str, std::size_t offset, std::size_t max_depth, std::vector<Token> *tokens, bool *complete)
 {
+    trace::Scope whole("parse");
     _debug("Reading stream...");
+    trace::Scope reading("input stream");
     antlr4::ANTLRInputStream input(str);
+    reading.finish();
     _debug("Building the lexer...");
+    trace::Scope lexing("lexer");
     ExparLexer lexer(&input);
+    if (complete)
+        lexer.removeErrorListeners();
+    lexing.finish();
     _debug("Generating the tokens...");
-    antlr4::CommonTokenStream tokens(&lexer);
-    tokens.fill();
+    antlr4::CommonTokenStream stream(&lexer);
+    // Timestamps are taken only when the statistics are collected.
+    const bool measure    = stats::is_enabled();
+    std::uint64_t started = measure ? stats::now() : 0;
+    trace::Scope filling("tokens.fill");
+    stream.fill();
+    filling.finish();
+    std::uint64_t lexed = measure ? stats::now() : 0;
+    if (tokens) {
+        for (auto token : stream.getTokens()) {
+            if (token->getType() != antlr4::Token::EOF) {
+                tokens->emplace_back(Token{
+                    token->getType(),
+                    offset + token->getStartIndex(),
+                    offset + token->getStopIndex() + 1 });
+            }
+        }
+    }
+    std::size_t depth = nesting_of(stream.getTokens());
+    if (depth > max_depth)
+        _error("The expression is nested %lu levels deep, the limit is %lu!", depth, max_depth);
     _debug("Initializing the parser...");
-    ExparParser parser(&tokens);
+    trace::Scope parsing("parser");
+    ExparParser parser(&stream);
+    if (complete)
+        parser.removeErrorListeners();
     _debug("Parsing the equation...");
-    ExparVisitor visitor;
-    parser.value()->accept(&visitor);
+    auto tree = parser.value();
+    parsing.finish();
+    std::uint64_t parsed = measure ? stats::now() : 0;
+    trace::Scope visiting("visitor");
+    ExparVisitor visitor(offset);
+    visitor.build(tree);
+    visiting.finish();
+    if (measure) {
+        auto &counters = stats::local();
+        counters.parses.add(1);
+        counters.tokens.add(stream.getTokens().size() - 1);
+        counters.parse_tree_nodes.add(visitor.visited);
+        for (std::size_t kind = 0; kind < node_kinds; ++kind)
+            counters.ast_nodes[kind].add(visitor.built[kind]);
+        counters.node_bytes.add(visitor.bytes);
+        counters.lexing_ns.add(lexed - started);
+        counters.parsing_ns.add(parsed - lexed);
+        counters.building_ns.add(stats::now() - parsed);
+    }
+    if (complete)
+        *complete = (lexer.getNumberOfSyntaxErrors() == 0) &&
+                    (parser.getNumberOfSyntaxErrors() == 0) &&
+                    (stream.LA(1) == antlr4::Token::EOF);
     _debug("Returning the result...");
     return visitor.root;
 }
 
+AstNode *parse(const std::string &str, std::size_t max_depth)
+{
+    return build(str, 0, max_depth, nullptr, nullptr);
+}
+
+std::vector<AstNode *> parse_all(const std::string &text, std::size_t threads, std::size_t max_depth)
+{
+    trace::Scope scope("parse_all");
+    std::vector<scan::Span> spans = scan::split(text);
+    std::vector<AstNode *> roots(spans.size(), nullptr);
+    // Each worker parses a contiguous range of expressions.
+    auto work = [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+            roots[i] = build(text.substr(spans[i].begin, spans[i].end - spans[i].begin), spans[i].begin, max_depth, nullptr, nullptr);
+    };
+    threads = std::max<std::size_t>(1, std::min(threads, spans.size()));
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        std::size_t first = spans.size() * t / threads, last = spans.size() * (t + 1) / threads;
+        auto task         = [&work, &errors, t, first, last]() {
+            try {
+                work(first, last);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        if (t + 1 < threads)
+            workers.emplace_back(task);
+        else
+            task();
+    }
+    for (auto &worker : workers)
+        worker.join();
+    for (auto &error : errors) {
+        if (error) {
+            for (auto root : roots)
+                delete root;
+            std::rethrow_exception(error);
+        }
+    }
+    return roots;
+}
+
+void parse(const std::string &str, ParseResult &result)
+{
+    delete result.root;
+    result.text = str;
+    result.tokens.clear();
+    result.root = build(str, 0, result.max_depth, &result.tokens, nullptr);
+}
+
+/// @brief Returns the links to the children of the node.
+static std::vector<AstNode **> children_of(AstNode *node)
+{
+    std::vector<AstNode **> children;
+    links_of(node, children);
+    return children;
+}
+
+/// @brief Collects all the nodes of the tree.
+static void collect(AstNode *node, std::vector<AstNode *> &nodes)
+{
+    std::vector<AstNode *> pending(1, node);
+    while (!pending.empty()) {
+        AstNode *current = pending.back();
+        pending.pop_back();
+        if (current == nullptr)
+            continue;
+        nodes.emplace_back(current);
+        for (auto child : children_of(current))
+            pending.emplace_back(*child);
+    }
+}
+
+/// @brief Moves the nodes which lie after the given position. A node which
+///        ends right where some text is inserted does not grow.
+static void shift(AstNode *node, std::size_t position, std::ptrdiff_t delta)
+{
+    std::vector<AstNode *> nodes;
+    collect(node, nodes);
+    for (auto current : nodes) {
+        if (current->begin >= position)
+            current->begin = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(current->begin) + delta);
+        if (current->end > position)
+            current->end = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(current->end) + delta);
+    }
+}
+
+/// @brief Checks if the token is an atom (see value_atom).
+static inline bool is_atom(std::size_t type)
+{
+    return (type == ExparLexer::NUMBER) || (type == ExparLexer::COMPLEX) ||
+           (type == ExparLexer::ID) || (type == ExparLexer::PERCENTAGE);
+}
+
+/// @brief Lexes the text starting at the given position, until the tokens
+///        are again aligned with the old ones.
+/// @param text     the new text.
+/// @param start    where to start lexing, a token boundary in both texts.
+/// @param old      the old tokens.
+/// @param first    the first old token which is lexed again.
+/// @param limit    the new tokens are not aligned before this position.
+/// @param delta    how much the text after the edit has moved.
+/// @param tokens   where the new tokens are stored.
+/// @return The first old token which is reused after the new ones.
+static std::size_t relex(const std::string &text,
+                         std::size_t start,
+                         const std::vector<Token> &old,
+                         std::size_t first,
+                         std::size_t limit,
+                         std::ptrdiff_t delta,
+                         std::vector<Token> &tokens)
+{
+    // Lex a window after the edit, doubling it until the tokens line up.
+    for (std::size_t margin = 64;; margin *= 2) {
+        tokens.clear();
+        std::size_t stop = std::min(text.size(), limit + margin);
+        antlr4::ANTLRInputStream input(text.substr(start, stop - start));
+        ExparLexer lexer(&input);
+        lexer.removeErrorListeners();
+        std::size_t next = first;
+        for (auto token = lexer.nextToken(); token->getType() != antlr4::Token::EOF; token = lexer.nextToken()) {
+            Token current{ token->getType(), start + token->getStartIndex(), start + token->getStopIndex() + 1 };
+            // The last token of the window might be truncated.
+            if ((current.end >= stop) && (stop < text.size()))
+                break;
+            if (current.begin >= limit) {
+                // Skip the old tokens which now lie before the current one.
+                while ((next < old.size()) && (static_cast<std::ptrdiff_t>(old[next].begin) + delta < static_cast<std::ptrdiff_t>(current.begin)))
+                    ++next;
+                if ((next < old.size()) &&
+                    (static_cast<std::ptrdiff_t>(old[next].begin) + delta == static_cast<std::ptrdiff_t>(current.begin)) &&
+                    (old[next].end - old[next].begin == current.end - current.begin) &&
+                    (old[next].type == current.type)) {
+                    return next;
+                }
+            }
+            tokens.emplace_back(current);
+        }
+        if (stop == text.size())
+            return old.size();
+    }
+}
+
+/// @brief Finds the link to the deepest bracketed node (a scope, an array or
+///        a function call) which strictly encloses [begin, end), i.e., whose first and
+///        last tokens are untouched. Also collects its ancestors.
+static AstNode **enclosing(AstNode **link, std::size_t begin, std::size_t end, std::vector<AstNode *> &ancestors)
+{
+    AstNode **found = nullptr;
+    std::vector<AstNode *> path;
+    while (*link) {
+        AstNode *node = *link;
+        if ((node->begin >= begin) || (node->end <= end))
+            break;
+        path.emplace_back(node);
+        if (is_a<AstScope>(node) || is_a<AstArray>(node) || is_a<AstFunction>(node)) {
+            found     = link;
+            ancestors = path;
+            ancestors.pop_back();
+        }
+        AstNode **next = nullptr;
+        for (auto child : children_of(node))
+            if (*child && ((*child)->begin < begin) && ((*child)->end > end))
+                next = child;
+        if (next == nullptr)
+            break;
+        link = next;
+    }
+    return found;
+}
+
+/// @brief Finds the link to the atom which spans exactly [begin, end).
+static AstNode **atom_at(AstNode **link, std::size_t begin, std::size_t end, std::vector<AstNode *> &ancestors)
+{
+    while (*link) {
+        AstNode *node = *link;
+        if ((node->begin == begin) && (node->end == end) && (is_a<AstNumber>(node) || is_a<AstVariable>(node)))
+            return link;
+        ancestors.emplace_back(node);
+        AstNode **next = nullptr;
+        for (auto child : children_of(node))
+            if (*child && ((*child)->begin <= begin) && ((*child)->end >= end))
+                next = child;
+        if (next == nullptr)
+            break;
+        link = next;
+    }
+    ancestors.clear();
+    return nullptr;
+}
+
+std::vector<AstNode *> reparse(ParseResult &result, const TextEdit &edit)
+{
+    if (edit.offset + edit.removed > result.text.size())
+        _error("The edit lies outside of the text!");
+    std::vector<AstNode *> changed;
+    const std::vector<Token> &old = result.tokens;
+    std::string text              = result.text;
+    text.replace(edit.offset, edit.removed, edit.inserted);
+    auto delta = static_cast<std::ptrdiff_t>(edit.inserted.size()) - static_cast<std::ptrdiff_t>(edit.removed);
+    // Start lexing from the token before the edit, which might be extended.
+    std::size_t first = 0;
+    while ((first < old.size()) && (old[first].end < edit.offset))
+        ++first;
+    if (first > 0)
+        --first;
+    std::size_t start = (first < old.size()) ? old[first].begin : edit.offset;
+    start             = std::min(start, edit.offset);
+    std::vector<Token> tokens;
+    std::size_t last = relex(text, start, old, first, edit.offset + edit.inserted.size(), delta, tokens);
+    // Narrow the damaged tokens by dropping the unchanged ones at both ends.
+    std::size_t new_first = 0, new_last = tokens.size();
+    auto same = [&](const Token &a, const Token &b, std::ptrdiff_t shift) {
+        return (a.type == b.type) && (a.end - a.begin == b.end - b.begin) &&
+               (result.text.compare(a.begin, a.end - a.begin, text, static_cast<std::size_t>(static_cast<std::ptrdiff_t>(a.begin) + shift), b.end - b.begin) == 0) &&
+               (static_cast<std::ptrdiff_t>(a.begin) + shift == static_cast<std::ptrdiff_t>(b.begin));
+    };
+    while ((first < last) && (new_first < new_last) && same(old[first], tokens[new_first], 0))
+        ++first, ++new_first;
+    while ((first < last) && (new_first < new_last) && same(old[last - 1], tokens[new_last - 1], delta))
+        --last, --new_last;
+    // Rebuild the list of tokens.
+    std::vector<Token> updated(old.begin(), old.begin() + static_cast<std::ptrdiff_t>(first));
+    updated.insert(updated.end(), tokens.begin() + static_cast<std::ptrdiff_t>(new_first), tokens.begin() + static_cast<std::ptrdiff_t>(new_last));
+    for (std::size_t i = last; i < old.size(); ++i)
+        updated.emplace_back(Token{ old[i].type,
+                                    static_cast<std::size_t>(static_cast<std::ptrdiff_t>(old[i].begin) + delta),
+                                    static_cast<std::size_t>(static_cast<std::ptrdiff_t>(old[i].end) + delta) });
+    // The tokens did not change, only their position did.
+    if ((first == last) && (new_first == new_last)) {
+        shift(result.root, edit.offset + edit.removed, delta);
+        result.text   = std::move(text);
+        result.tokens = std::move(updated);
+        return changed;
+    }
+    // The damaged region, in the old text.
+    std::size_t begin = (first < last) ? old[first].begin : edit.offset;
+    std::size_t end   = (first < last) ? old[last - 1].end : edit.offset + edit.removed;
+    std::vector<AstNode *> ancestors;
+    AstNode **link = nullptr;
+    AstNode *node  = nullptr;
+    // A single atom replaced by another atom.
+    if ((last - first == 1) && (new_last - new_first == 1) && is_atom(old[first].type) && is_atom(tokens[new_first].type))
+        link = atom_at(&result.root, begin, end, ancestors);
+    if (link == nullptr)
+        link = enclosing(&result.root, begin, end, ancestors);
+    if (link) {
+        // Parse again the node, in the new text.
+        std::size_t node_begin = (*link)->begin, node_end = (*link)->end;
+        if (node_begin > edit.offset)
+            node_begin = static_cast<std::size_t>(std::max<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(node_begin) + delta, static_cast<std::ptrdiff_t>(edit.offset)));
+        if (node_end >= edit.offset + edit.removed)
+            node_end = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(node_end) + delta);
+        bool complete          = false;
+        node                   = build(text.substr(node_begin, node_end - node_begin), node_begin, result.max_depth, nullptr, &complete);
+        // The new node must be as self-contained as the old one, otherwise the
+        // structure around it might change.
+        bool compatible = complete && node && (node->begin == node_begin) && (node->end == node_end) &&
+                          ((is_a<AstScope>(*link) && is_a<AstScope>(node)) ||
+                           (is_a<AstArray>(*link) && is_a<AstArray>(node)) ||
+                           (is_a<AstFunction>(*link) && is_a<AstFunction>(node)) ||
+                           (!is_a<AstScope>(*link) && !is_a<AstArray>(*link) && !is_a<AstFunction>(*link) &&
+                            (is_a<AstNumber>(node) || is_a<AstVariable>(node))));
+        if (!compatible) {
+            delete node;
+            node = nullptr;
+        }
+    }
+    if (node) {
+        AstNode *previous = *link;
+        *link             = nullptr;
+        delete previous;
+        shift(result.root, edit.offset + edit.removed, delta);
+        *link = node;
+        // The ancestors must still enclose the new node.
+        for (auto ancestor : ancestors) {
+            ancestor->begin = std::min(ancestor->begin, node->begin);
+            ancestor->end   = std::max(ancestor->end, node->end);
+        }
+        collect(node, changed);
+        changed.insert(changed.end(), ancestors.begin(), ancestors.end());
+        result.text   = std::move(text);
+        result.tokens = std::move(updated);
+        return changed;
+    }
+    // Parse everything again.
+    _debug("Falling back to a full parse...");
+    parse(text, result);
+    collect(result.root, changed);
+    return changed;
+}
+
 } // namespace expar::parser
\ No newline at end of file
@@ -0,0 +1,182 @@
+/// @file   profile.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/profile.hpp"
+#include "expar/enums.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace expar
+{
+/// @brief Returns the label of the node within a path.
+static std::string label_of(AstNode *node)
+{
+    switch (node->kind) {
+    case node_binary:
+        return operator_to_string(static_cast<AstBinary *>(node)->type);
+    case node_unary:
+        return operator_to_string(static_cast<AstUnary *>(node)->type);
+    case node_conditional:
+        return "?:";
+    case node_scope:
+        return "()";
+    case node_array:
+        return "[]";
+    case node_function:
+        return static_cast<AstFunction *>(node)->name + "()";
+    case node_variable:
+        return static_cast<AstVariable *>(node)->name;
+    case node_number: {
+        std::stringstream ss;
+        ss << static_cast<AstNumber *>(node)->value;
+        if (static_cast<AstNumber *>(node)->imaginary)
+            ss << "i";
+        return ss.str();
+    }
+    }
+    return "?";
+}
+
+/// @brief Makes the label usable as a frame of a folded stack, where frames
+///        are separated by semicolons and followed by a space.
+static std::string frame_of(std::string label)
+{
+    std::replace(label.begin(), label.end(), ';', ',');
+    std::replace(label.begin(), label.end(), ' ', '_');
+    return label;
+}
+
+/// @brief Formats nanoseconds as milliseconds.
+static std::string milliseconds(std::uint64_t ns)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3) << (ns * 1e-6) << " ms";
+    return ss.str();
+}
+
+Profile::Profile()
+    : nodes(),
+      roots()
+{
+    // Nothing to do.
+}
+
+void Profile::add(AstNode *node, std::string name, std::string text)
+{
+    if (node == nullptr)
+        _error("Cannot profile an empty expression!");
+    roots.emplace_back(Root{ node, std::move(name), std::move(text) });
+}
+
+std::vector<Profile::HotSpot> Profile::collect(bool folded) const
+{
+    std::vector<HotSpot> spots;
+    std::unordered_map<AstNode *, bool> reached;
+    std::vector<std::pair<AstNode *, std::string>> pending;
+    std::vector<AstNode **> links;
+    for (const Root &root : roots) {
+        pending.emplace_back(root.node, folded ? frame_of(root.name) + ";" + frame_of(label_of(root.node)) : label_of(root.node));
+        while (!pending.empty()) {
+            AstNode *node    = pending.back().first;
+            std::string path = std::move(pending.back().second);
+            pending.pop_back();
+            auto it = nodes.find(node);
+            if ((it != nodes.end()) && !reached[node]) {
+                reached[node] = true;
+                HotSpot spot{ root.name, path, std::string(), it->second.calls, it->second.total_ns, it->second.self_ns };
+                if ((node->begin < node->end) && (node->end <= root.text.size()))
+                    spot.text = root.text.substr(node->begin, node->end - node->begin);
+                spots.emplace_back(std::move(spot));
+            }
+            links.clear();
+            links_of(node, links);
+            for (std::size_t i = links.size(); i > 0; --i) {
+                AstNode *child = *links[i - 1];
+                if (child == nullptr)
+                    continue;
+                if (folded)
+                    pending.emplace_back(child, path + ";" + frame_of(label_of(child)));
+                else
+                    pending.emplace_back(child, path + "/" + std::to_string(i - 1) + ":" + label_of(child));
+            }
+        }
+    }
+    return spots;
+}
+
+std::vector<Profile::HotSpot> Profile::hot_spots(std::size_t count) const
+{
+    std::vector<HotSpot> spots = this->collect(false);
+    std::stable_sort(spots.begin(), spots.end(), [](const HotSpot &a, const HotSpot &b) {
+        return a.self_ns > b.self_ns;
+    });
+    if (spots.size() > count)
+        spots.resize(count);
+    return spots;
+}
+
+std::vector<Profile::HotSpot> Profile::expressions(std::size_t count) const
+{
+    std::vector<HotSpot> spots;
+    for (const Root &root : roots) {
+        auto it = nodes.find(root.node);
+        if (it == nodes.end())
+            continue;
+        spots.emplace_back(HotSpot{ root.name, label_of(root.node), root.text,
+                                    it->second.calls, it->second.total_ns, it->second.self_ns });
+    }
+    std::stable_sort(spots.begin(), spots.end(), [](const HotSpot &a, const HotSpot &b) {
+        return a.total_ns > b.total_ns;
+    });
+    if (spots.size() > count)
+        spots.resize(count);
+    return spots;
+}
+
+void Profile::report(std::ostream &stream, std::size_t count) const
+{
+    std::uint64_t total = 0;
+    for (const auto &entry : nodes)
+        total += entry.second.self_ns;
+    auto share = [total](std::uint64_t ns) {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << std::setw(5) << (total ? 100. * ns / total : 0.) << "%";
+        return ss.str();
+    };
+    stream << "Expressions, by total time:\n";
+    for (const HotSpot &spot : this->expressions(count)) {
+        stream << "  " << share(spot.total_ns) << " " << milliseconds(spot.total_ns) << " "
+               << spot.calls << " calls  " << spot.expression;
+        if (!spot.text.empty())
+            stream << " = " << spot.text;
+        stream << "\n";
+    }
+    stream << "Nodes, by self time:\n";
+    for (const HotSpot &spot : this->hot_spots(count)) {
+        stream << "  " << share(spot.self_ns) << " " << milliseconds(spot.self_ns) << " "
+               << spot.calls << " calls  ";
+        if (!spot.expression.empty())
+            stream << spot.expression << ": ";
+        stream << spot.path;
+        if (!spot.text.empty())
+            stream << " `" << spot.text << "`";
+        stream << "\n";
+    }
+}
+
+void Profile::folded(std::ostream &stream) const
+{
+    for (const HotSpot &spot : this->collect(true))
+        if (spot.self_ns > 0)
+            stream << spot.path << " " << spot.self_ns << "\n";
+}
+
+void Profile::clear()
+{
+    nodes.clear();
+}
+
+} // namespace expar
@@ -0,0 +1,838 @@
+/// @file   program.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/program.hpp"
+#include "expar/trace.hpp"
+#include "logging.hpp"
+#include "operations.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace expar
+{
+/// @brief Number of points evaluated together.
+static const std::size_t chunk_size = 256;
+/// @brief The lookups over which the hit rate of a memoized call is measured.
+static const std::size_t window_size = 64;
+/// @brief The longest suspension of a memoized call.
+static const std::size_t max_backoff = 1 << 16;
+
+/// @brief Applies a binary operation over a chunk, the result goes in a.
+template <Program::Code code, typename T>
+static inline void binary_loop(std::size_t count, T *a, const T *b)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        a[i] = binary<code>(a[i], b[i]);
+}
+
+/// @brief Translates the expression into a Program.
+class ProgramCompiler : public StaticVisitor<ProgramCompiler> {
+public:
+    ProgramCompiler(const std::vector<std::string> &_variables,
+                    const FunctionRegistry &_registry,
+                    std::vector<Function> &_functions,
+                    std::vector<Table> &_tables,
+                    std::vector<Program::Instruction> &_code)
+        : variables(_variables),
+          registry(_registry),
+          functions(_functions),
+          tables(_tables),
+          code(_code),
+          bound(),
+          depth(0),
+          max_depth(0),
+          sites(0)
+    {
+        // Nothing to do.
+    }
+
+    std::size_t get_max_depth() const
+    {
+        return max_depth;
+    }
+
+    void visit(AstBinary &e)
+    {
+        // The value of an assignment is the one of its right-hand side.
+        if (e.type == op_assign) {
+            this->dispatch(e.right);
+            return;
+        }
+        // The chain of left operands is walked down without recursion, then
+        // compiled from the innermost one out.
+        std::vector<AstBinary *> chain;
+        this->dispatch(left_chain(&e, chain));
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            this->complete(**it);
+    }
+
+    void visit(AstUnary &e)
+    {
+        this->dispatch(e.right);
+        if (e.type == op_minus)
+            this->emit(Program::p_neg);
+        else if (e.type == op_not)
+            this->emit(Program::p_not);
+        else if (e.type != op_plus)
+            _error("Cannot compile unary operator '%s'!", operator_to_string(e.type).c_str());
+    }
+
+    void visit(AstConditional &e)
+    {
+        std::size_t start = code.size();
+        this->dispatch(e.condition);
+        // A constant condition selects the branch right away.
+        if ((code.size() == start + 1) && (code[start].code == Program::p_const)) {
+            bool value = (code[start].constant != 0.);
+            code.resize(start), --depth;
+            // The random calls keep their site, as if both branches were
+            // compiled.
+            if (value) {
+                this->dispatch(e.if_true);
+                sites += this->count_random(e.if_false);
+            } else {
+                sites += this->count_random(e.if_true);
+                this->dispatch(e.if_false);
+            }
+            return;
+        }
+        // Single points jump over the branch not taken, batches compute
+        // both and keep the condition on the stack for the selection.
+        std::size_t jump_if = code.size();
+        this->emit(Program::p_if);
+        this->dispatch(e.if_true);
+        std::size_t jump_else = code.size();
+        this->emit(Program::p_else);
+        code[jump_if].index = code.size();
+        this->dispatch(e.if_false);
+        this->emit(Program::p_select);
+        code[jump_else].index = code.size();
+        depth -= 2;
+    }
+
+    void visit(AstScope &e)
+    {
+        this->dispatch(e.content);
+    }
+
+    void visit(AstArray &e)
+    {
+        if (e.content.size() != 1)
+            _error("Cannot compile an array of %lu elements as a single value!", e.content.size());
+        this->dispatch(e.content[0]);
+    }
+
+    void visit(AstFunction &e)
+    {
+        if (((e.name == "pwl") || (e.name == "table")) && (registry.find(e.name) == nullptr)) {
+            this->compile_table(e);
+            return;
+        }
+        // Random calls are numbered in reading order, before their arguments.
+        random::Distribution distribution;
+        if (random::find(e.name, e.content.size(), distribution) && (registry.find(e.name) == nullptr)) {
+            std::size_t site = sites++;
+            for (auto argument : e.content)
+                this->dispatch(argument);
+            this->emit(static_cast<Program::Code>(Program::p_gauss + distribution), site);
+            depth = depth + 1 - e.content.size();
+            return;
+        }
+        const Function &function = registry.bind(e.name, e.content.size());
+        std::size_t start        = code.size();
+        for (auto argument : e.content)
+            this->dispatch(argument);
+        // Calls of pure functions on constants are computed right away.
+        bool constant = function.pure;
+        for (std::size_t i = start; constant && (i < code.size()); ++i)
+            constant = (code[i].code == Program::p_const);
+        if (constant && (code.size() - start == function.arity)) {
+            double args[max_arity];
+            for (std::size_t i = 0; i < function.arity; ++i)
+                args[i] = code[start + i].constant;
+            code.resize(start);
+            depth -= function.arity;
+            this->emit(Program::p_const, 0, function.invoke(args));
+            max_depth = std::max(max_depth, ++depth);
+            return;
+        }
+        std::size_t index = this->index_of(function);
+        if (function.unary)
+            this->emit(Program::p_call1, index);
+        else if (function.binary)
+            this->emit(Program::p_call2, index);
+        else
+            this->emit(Program::p_call, index);
+        depth     = depth + 1 - function.arity;
+        max_depth = std::max(max_depth, depth);
+    }
+
+    void visit(AstVariable &e)
+    {
+        auto it = std::find(variables.begin(), variables.end(), e.name);
+        if (it == variables.end())
+            _error("There is no input for variable '%s'!", e.name.c_str());
+        this->emit(Program::p_load, static_cast<std::size_t>(it - variables.begin()));
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+    void visit(AstNumber &e)
+    {
+        if (e.imaginary)
+            _error("Cannot compile the imaginary number %gi over the real numbers!", e.value);
+        this->emit(Program::p_const, 0, e.value);
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+private:
+    const std::vector<std::string> &variables;
+    const FunctionRegistry &registry;
+    std::vector<Function> &functions;
+    std::vector<Table> &tables;
+    std::vector<Program::Instruction> &code;
+    /// The position of the functions already in the program.
+    std::map<const Function *, std::size_t> bound;
+    std::size_t depth;
+    std::size_t max_depth;
+    /// The random calls met so far.
+    std::size_t sites;
+
+    inline void emit(Program::Code op, std::size_t index = 0, double constant = 0.)
+    {
+        code.emplace_back(Program::Instruction{ op, index, constant });
+    }
+
+    /// @brief Compiles the operator of the node, once its left operand is.
+    inline void complete(AstBinary &e)
+    {
+        // On single points, the right operand is skipped when the left one
+        // decides the result.
+        if ((e.type == op_and) || (e.type == op_or)) {
+            std::size_t jump = code.size();
+            this->emit((e.type == op_and) ? Program::p_and_then : Program::p_or_else);
+            this->dispatch(e.right);
+            this->emit(code_of(e.type));
+            --depth;
+            code[jump].index = code.size();
+            return;
+        }
+        // Exact powers need no call to std::pow.
+        if ((e.type == op_pow) && is_exact_power(e.right)) {
+            this->emit(Program::p_ipow, 0, static_cast<AstNumber *>(e.right)->value);
+            return;
+        }
+        this->dispatch(e.right);
+        this->emit(code_of(e.type));
+        --depth;
+    }
+
+    /// @brief Compiles a piecewise-linear function, `pwl(x, x1, y1, ...)`.
+    inline void compile_table(AstFunction &e)
+    {
+        if ((e.content.size() < 3) || (e.content.size() % 2 == 0))
+            _error("Function '%s' expects the abscissa and pairs of breakpoints, received %lu arguments!",
+                   e.name.c_str(), e.content.size());
+        for (auto argument : e.content)
+            this->dispatch(argument);
+        std::size_t count = (e.content.size() - 1) / 2;
+        std::size_t start = code.size() - 2 * count;
+        bool constant     = true;
+        for (std::size_t i = start; constant && (i < code.size()); ++i)
+            constant = (code[i].code == Program::p_const);
+        depth -= 2 * count;
+        if (!constant) {
+            this->emit(Program::p_pwl, count);
+            return;
+        }
+        // Constant breakpoints become a table, built once.
+        std::vector<double> points(2 * count);
+        for (std::size_t i = 0; i < points.size(); ++i)
+            points[i] = code[start + i].constant;
+        code.resize(start);
+        tables.emplace_back(Table::from_points(points.data(), count));
+        this->emit(Program::p_table, tables.size() - 1);
+    }
+
+    /// @brief Returns the number of random calls inside the expression.
+    inline std::size_t count_random(AstNode *node) const
+    {
+        std::size_t count = 0;
+        std::vector<AstNode **> links;
+        std::vector<AstNode *> pending(1, node);
+        random::Distribution distribution;
+        while (!pending.empty()) {
+            AstNode *next = pending.back();
+            pending.pop_back();
+            if (next == nullptr)
+                continue;
+            if (next->kind == node_function) {
+                auto &function = static_cast<AstFunction &>(*next);
+                count += random::find(function.name, function.content.size(), distribution) &&
+                         (registry.find(function.name) == nullptr);
+            }
+            links.clear();
+            links_of(next, links);
+            for (auto link : links)
+                pending.emplace_back(*link);
+        }
+        return count;
+    }
+
+    /// @brief Returns the position of the function inside the program,
+    ///        which keeps its own copy of each function it calls.
+    inline std::size_t index_of(const Function &function)
+    {
+        auto it = bound.find(&function);
+        if (it != bound.end())
+            return it->second;
+        functions.emplace_back(function);
+        bound[&function] = functions.size() - 1;
+        return functions.size() - 1;
+    }
+};
+
+Program::Program(AstNode *node, std::vector<std::string> _variables, const FunctionRegistry &registry)
+    : variables(std::move(_variables)),
+      functions(),
+      tables(),
+      code(),
+      depth(0)
+{
+    if (node == nullptr)
+        _error("Cannot compile a NULL node!");
+    trace::Scope scope("compile");
+    ProgramCompiler compiler(variables, registry, functions, tables, code);
+    compiler.dispatch(node);
+    depth = compiler.get_max_depth();
+}
+
+double Program::evaluate(const double *values) const
+{
+    return this->evaluate_point<false>(values, nullptr, nullptr);
+}
+
+double Program::evaluate(const double *values, const random::Sample &sample) const
+{
+    return this->evaluate_point<false>(values, nullptr, &sample);
+}
+
+double Program::evaluate(const double *values, Memo &memo) const
+{
+    if (memo.program != this)
+        _error("The memo was built for another program!");
+    return this->evaluate_point<true>(values, &memo, nullptr);
+}
+
+template <bool Memoize>
+double Program::evaluate_point(const double *values, Memo *memo, const random::Sample *sample) const
+{
+    // Small programs keep their stack in place.
+    double local[32];
+    std::vector<double> heap;
+    double *stack = local;
+    if (depth > 32) {
+        heap.resize(depth);
+        stack = heap.data();
+    }
+    std::size_t top = 0;
+    for (std::size_t next = 0; next < code.size();) {
+        const Instruction &instruction = code[next++];
+        switch (instruction.code) {
+        case p_const:
+            stack[top++] = instruction.constant;
+            break;
+        case p_load:
+            stack[top++] = values[instruction.index];
+            break;
+        case p_add:
+            --top, stack[top - 1] = binary<p_add>(stack[top - 1], stack[top]);
+            break;
+        case p_sub:
+            --top, stack[top - 1] = binary<p_sub>(stack[top - 1], stack[top]);
+            break;
+        case p_mul:
+            --top, stack[top - 1] = binary<p_mul>(stack[top - 1], stack[top]);
+            break;
+        case p_div:
+            --top, stack[top - 1] = binary<p_div>(stack[top - 1], stack[top]);
+            break;
+        case p_mod:
+            --top, stack[top - 1] = binary<p_mod>(stack[top - 1], stack[top]);
+            break;
+        case p_pow:
+            --top, stack[top - 1] = binary<p_pow>(stack[top - 1], stack[top]);
+            break;
+        case p_ipow:
+            stack[top - 1] = ipow(stack[top - 1], static_cast<long>(instruction.constant));
+            break;
+        case p_neg:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        case p_not:
+            stack[top - 1] = (stack[top - 1] == 0.) ? 1. : 0.;
+            break;
+        case p_eq:
+            --top, stack[top - 1] = binary<p_eq>(stack[top - 1], stack[top]);
+            break;
+        case p_neq:
+            --top, stack[top - 1] = binary<p_neq>(stack[top - 1], stack[top]);
+            break;
+        case p_lt:
+            --top, stack[top - 1] = binary<p_lt>(stack[top - 1], stack[top]);
+            break;
+        case p_gt:
+            --top, stack[top - 1] = binary<p_gt>(stack[top - 1], stack[top]);
+            break;
+        case p_le:
+            --top, stack[top - 1] = binary<p_le>(stack[top - 1], stack[top]);
+            break;
+        case p_ge:
+            --top, stack[top - 1] = binary<p_ge>(stack[top - 1], stack[top]);
+            break;
+        case p_and:
+            --top, stack[top - 1] = binary<p_and>(stack[top - 1], stack[top]);
+            break;
+        case p_or:
+            --top, stack[top - 1] = binary<p_or>(stack[top - 1], stack[top]);
+            break;
+        case p_xor:
+            --top, stack[top - 1] = binary<p_xor>(stack[top - 1], stack[top]);
+            break;
+        case p_bor:
+            --top, stack[top - 1] = binary<p_bor>(stack[top - 1], stack[top]);
+            break;
+        case p_band:
+            --top, stack[top - 1] = binary<p_band>(stack[top - 1], stack[top]);
+            break;
+        case p_bsl:
+            --top, stack[top - 1] = binary<p_bsl>(stack[top - 1], stack[top]);
+            break;
+        case p_bsr:
+            --top, stack[top - 1] = binary<p_bsr>(stack[top - 1], stack[top]);
+            break;
+        case p_call1:
+            if constexpr (Memoize) {
+                if (memo->find(next - 1, stack + top - 1, stack[top - 1]))
+                    break;
+                double result = functions[instruction.index].unary(stack[top - 1]);
+                memo->store(next - 1, stack + top - 1, result);
+                stack[top - 1] = result;
+                break;
+            }
+            stack[top - 1] = functions[instruction.index].unary(stack[top - 1]);
+            break;
+        case p_call2:
+            --top;
+            if constexpr (Memoize) {
+                if (memo->find(next - 1, stack + top - 1, stack[top - 1]))
+                    break;
+                double result = functions[instruction.index].binary(stack[top - 1], stack[top]);
+                memo->store(next - 1, stack + top - 1, result);
+                stack[top - 1] = result;
+                break;
+            }
+            stack[top - 1] = functions[instruction.index].binary(stack[top - 1], stack[top]);
+            break;
+        case p_call: {
+            const Function &function = functions[instruction.index];
+            top -= function.arity;
+            if constexpr (Memoize) {
+                if (!memo->find(next - 1, stack + top, stack[top])) {
+                    double result = function.invoke(stack + top);
+                    memo->store(next - 1, stack + top, result);
+                    stack[top] = result;
+                }
+                ++top;
+                break;
+            }
+            stack[top] = function.invoke(stack + top);
+            ++top;
+            break;
+        }
+        case p_table:
+            stack[top - 1] = tables[instruction.index].lookup(stack[top - 1]);
+            break;
+        case p_pwl:
+            top -= 2 * instruction.index;
+            stack[top - 1] = Table::interpolate(stack[top - 1], stack + top, instruction.index);
+            break;
+        case p_if:
+            if (stack[--top] == 0.)
+                next = instruction.index;
+            break;
+        case p_else:
+            next = instruction.index;
+            break;
+        case p_select:
+            // Reached only from the second branch, whose value is the result.
+            break;
+        case p_and_then:
+            if (stack[top - 1] == 0.)
+                stack[top - 1] = 0., next = instruction.index;
+            break;
+        case p_or_else:
+            if (stack[top - 1] != 0.)
+                stack[top - 1] = 1., next = instruction.index;
+            break;
+        case p_gauss:
+        case p_agauss:
+        case p_unif:
+        case p_aunif: {
+            auto distribution = static_cast<random::Distribution>(instruction.code - p_gauss);
+            top -= (instruction.code <= p_agauss) ? 3 : 2;
+            // Without a sample, the value is the nominal one.
+            if (sample) {
+                double draw = random::draw(distribution, sample->seed, sample->index, instruction.index);
+                stack[top]  = random::apply(distribution, stack + top, draw);
+            }
+            ++top;
+            break;
+        }
+        }
+    }
+    return stack[0];
+}
+
+template <typename T, typename Input>
+void Program::evaluate_chunk(std::size_t count, const Input *const *values, T *stack, double *points, const random::Sample *sample) const
+{
+    auto slot       = [stack](std::size_t index) { return stack + index * chunk_size; };
+    std::size_t top = 0;
+    // Where values are widened to call the functions on arrays, which work
+    // in double precision.
+    double wide[chunk_size];
+    for (const auto &instruction : code) {
+        // The operation works on [a, b] for binary and on [b] for unary.
+        T *a = (top > 1) ? slot(top - 2) : nullptr;
+        T *b = (top > 0) ? slot(top - 1) : nullptr;
+        switch (instruction.code) {
+        case p_const:
+            std::fill(slot(top), slot(top) + count, static_cast<T>(instruction.constant));
+            ++top;
+            break;
+        case p_load:
+            std::copy(values[instruction.index], values[instruction.index] + count, slot(top));
+            ++top;
+            break;
+        case p_add:
+            binary_loop<p_add>(count, a, b), --top;
+            break;
+        case p_sub:
+            binary_loop<p_sub>(count, a, b), --top;
+            break;
+        case p_mul:
+            binary_loop<p_mul>(count, a, b), --top;
+            break;
+        case p_div:
+            binary_loop<p_div>(count, a, b), --top;
+            break;
+        case p_mod:
+            binary_loop<p_mod>(count, a, b), --top;
+            break;
+        case p_pow:
+            binary_loop<p_pow>(count, a, b), --top;
+            break;
+        case p_ipow: {
+            auto n = static_cast<long>(instruction.constant);
+            for (std::size_t i = 0; i < count; ++i)
+                b[i] = ipow(b[i], n);
+            break;
+        }
+        case p_neg:
+            for (std::size_t i = 0; i < count; ++i)
+                b[i] = -b[i];
+            break;
+        case p_not:
+            for (std::size_t i = 0; i < count; ++i)
+                b[i] = (b[i] == 0) ? T(1) : T(0);
+            break;
+        case p_eq:
+            binary_loop<p_eq>(count, a, b), --top;
+            break;
+        case p_neq:
+            binary_loop<p_neq>(count, a, b), --top;
+            break;
+        case p_lt:
+            binary_loop<p_lt>(count, a, b), --top;
+            break;
+        case p_gt:
+            binary_loop<p_gt>(count, a, b), --top;
+            break;
+        case p_le:
+            binary_loop<p_le>(count, a, b), --top;
+            break;
+        case p_ge:
+            binary_loop<p_ge>(count, a, b), --top;
+            break;
+        case p_and:
+            binary_loop<p_and>(count, a, b), --top;
+            break;
+        case p_or:
+            binary_loop<p_or>(count, a, b), --top;
+            break;
+        case p_xor:
+            binary_loop<p_xor>(count, a, b), --top;
+            break;
+        case p_bor:
+            binary_loop<p_bor>(count, a, b), --top;
+            break;
+        case p_band:
+            binary_loop<p_band>(count, a, b), --top;
+            break;
+        case p_bsl:
+            binary_loop<p_bsl>(count, a, b), --top;
+            break;
+        case p_bsr:
+            binary_loop<p_bsr>(count, a, b), --top;
+            break;
+        case p_call1: {
+            const Function &function = functions[instruction.index];
+            if (function.batch) {
+                if constexpr (std::is_same_v<T, double>) {
+                    function.batch(count, b, b);
+                } else {
+                    std::copy(b, b + count, wide);
+                    function.batch(count, wide, wide);
+                    std::copy(wide, wide + count, b);
+                }
+            } else {
+                for (std::size_t i = 0; i < count; ++i)
+                    b[i] = function.unary(b[i]);
+            }
+            break;
+        }
+        case p_call2: {
+            auto function = functions[instruction.index].binary;
+            for (std::size_t i = 0; i < count; ++i)
+                a[i] = function(a[i], b[i]);
+            --top;
+            break;
+        }
+        case p_call: {
+            const Function &function = functions[instruction.index];
+            double args[max_arity];
+            top -= function.arity;
+            for (std::size_t i = 0; i < count; ++i) {
+                for (std::size_t arg = 0; arg < function.arity; ++arg)
+                    args[arg] = slot(top + arg)[i];
+                slot(top)[i] = function.invoke(args);
+            }
+            ++top;
+            break;
+        }
+        case p_table:
+            if constexpr (std::is_same_v<T, double>) {
+                tables[instruction.index].lookup(count, b, b);
+            } else {
+                std::copy(b, b + count, wide);
+                tables[instruction.index].lookup(count, wide, wide);
+                std::copy(wide, wide + count, b);
+            }
+            break;
+        case p_pwl: {
+            top -= 2 * instruction.index;
+            for (std::size_t i = 0; i < count; ++i) {
+                for (std::size_t k = 0; k < 2 * instruction.index; ++k)
+                    points[k] = slot(top + k)[i];
+                slot(top - 1)[i] = Table::interpolate(slot(top - 1)[i], points, instruction.index);
+            }
+            break;
+        }
+        case p_if:
+        case p_else:
+        case p_and_then:
+        case p_or_else:
+            // Batches do not jump, all the operands are computed.
+            break;
+        case p_select: {
+            // The stack holds the condition and the two branches.
+            T *condition = slot(top - 3);
+            for (std::size_t i = 0; i < count; ++i)
+                condition[i] = (condition[i] != 0) ? a[i] : b[i];
+            top -= 2;
+            break;
+        }
+        case p_gauss:
+        case p_agauss:
+        case p_unif:
+        case p_aunif: {
+            auto distribution = static_cast<random::Distribution>(instruction.code - p_gauss);
+            std::size_t arity = (instruction.code <= p_agauss) ? 3 : 2;
+            top -= arity;
+            if (sample) {
+                random::draw(distribution, sample->seed, sample->index, instruction.index, count, wide);
+                T *value = slot(top), *variation = slot(top + 1), *sigmas = slot(top + arity - 1);
+                for (std::size_t i = 0; i < count; ++i) {
+                    double args[3] = { value[i], variation[i], sigmas[i] };
+                    value[i]       = static_cast<T>(random::apply(distribution, args, wide[i]));
+                }
+            }
+            ++top;
+            break;
+        }
+        }
+    }
+}
+
+template <typename T, typename Input, typename Output>
+void Program::evaluate_batch(std::size_t count, const Input *const *values, Output *out, const random::Sample *sample) const
+{
+    std::vector<T> stack(depth * chunk_size);
+    // The breakpoints of a piecewise-linear function, gathered point by point.
+    std::size_t breakpoints = 0;
+    for (const auto &instruction : code)
+        if (instruction.code == p_pwl)
+            breakpoints = std::max(breakpoints, instruction.index);
+    std::vector<double> points(2 * breakpoints);
+    std::vector<const Input *> chunk(variables.size());
+    random::Sample first;
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t n = std::min(chunk_size, count - begin);
+        for (std::size_t v = 0; v < variables.size(); ++v)
+            chunk[v] = values[v] + begin;
+        if (sample)
+            first = random::Sample{ sample->seed, sample->index + begin };
+        this->evaluate_chunk(n, chunk.data(), stack.data(), points.data(), sample ? &first : nullptr);
+        std::copy(stack.data(), stack.data() + n, out + begin);
+    }
+}
+
+void Program::evaluate(std::size_t count, const double *const *values, double *out) const
+{
+    trace::Scope scope("evaluate");
+    this->evaluate_batch<double>(count, values, out);
+}
+
+void Program::evaluate(std::size_t count, const double *const *values, double *out, const random::Sample &first) const
+{
+    trace::Scope scope("evaluate");
+    this->evaluate_batch<double>(count, values, out, &first);
+}
+
+void Program::evaluate(std::size_t count, const float *const *values, float *out, Precision precision) const
+{
+    trace::Scope scope("evaluate");
+    if (precision == prec_mixed)
+        this->evaluate_batch<double>(count, values, out);
+    else
+        this->evaluate_batch<float>(count, values, out);
+}
+
+Program::PrecisionError Program::estimate_error(std::size_t count, const double *const *values, Precision precision) const
+{
+    // The points are rounded to single precision, as if they were stored
+    // that way, and the results are compared with the ones in double.
+    std::vector<std::vector<float>> narrow(variables.size(), std::vector<float>(count));
+    std::vector<const float *> inputs(variables.size());
+    for (std::size_t v = 0; v < variables.size(); ++v) {
+        std::copy(values[v], values[v] + count, narrow[v].begin());
+        inputs[v] = narrow[v].data();
+    }
+    std::vector<double> reference(count);
+    std::vector<float> results(count);
+    this->evaluate(count, values, reference.data());
+    this->evaluate(count, inputs.data(), results.data(), precision);
+    PrecisionError error{ 0., 0. };
+    for (std::size_t i = 0; i < count; ++i) {
+        double result = results[i], difference = 0.;
+        // Results which differ in kind (e.g., a NaN or an infinity on one
+        // side only) are infinitely wrong.
+        if (std::isnan(result) || std::isnan(reference[i]))
+            difference = (std::isnan(result) == std::isnan(reference[i])) ? 0. : std::numeric_limits<double>::infinity();
+        else if (result != reference[i])
+            difference = std::isinf(result - reference[i]) ? std::numeric_limits<double>::infinity() :
+                                                            std::abs(result - reference[i]);
+        error.absolute = std::max(error.absolute, difference);
+        if (difference > 0.)
+            error.relative = std::max(error.relative, difference / std::abs(reference[i]));
+    }
+    return error;
+}
+
+Program::Memo::Memo(const Program &_program, std::size_t entries, double _min_hit_rate)
+    : program(&_program),
+      site_of(_program.code.size(), static_cast<std::size_t>(-1)),
+      sites(),
+      min_hit_rate(_min_hit_rate),
+      lookups(0),
+      hits(0)
+{
+    if (entries == 0)
+        _error("A memo needs at least one entry for each call!");
+    for (std::size_t position = 0; position < program->code.size(); ++position) {
+        const Instruction &instruction = program->code[position];
+        if ((instruction.code != p_call1) && (instruction.code != p_call2) && (instruction.code != p_call))
+            continue;
+        const Function &function = program->functions[instruction.index];
+        if (!function.pure || (function.arity == 0))
+            continue;
+        Site site{};
+        site.arity = function.arity;
+        site.keys.resize(entries * function.arity);
+        site.results.resize(entries);
+        site.backoff      = window_size;
+        site_of[position] = sites.size();
+        sites.emplace_back(std::move(site));
+    }
+}
+
+std::size_t Program::Memo::get_suspended() const
+{
+    return static_cast<std::size_t>(
+        std::count_if(sites.begin(), sites.end(), [](const Site &site) { return site.suspended > 0; }));
+}
+
+bool Program::Memo::find(std::size_t position, const double *args, double &result)
+{
+    if (site_of[position] == static_cast<std::size_t>(-1))
+        return false;
+    Site &site = sites[site_of[position]];
+    if (site.suspended > 0) {
+        --site.suspended;
+        return false;
+    }
+    std::uint64_t key[max_arity];
+    std::memcpy(key, args, site.arity * sizeof(double));
+    ++lookups, ++site.window_lookups;
+    bool found = false;
+    for (std::size_t entry = 0; !found && (entry < site.used); ++entry) {
+        if (std::equal(key, key + site.arity, site.keys.data() + entry * site.arity)) {
+            result = site.results[entry];
+            found  = true;
+        }
+    }
+    if (found)
+        ++hits, ++site.window_hits;
+    // At the end of each window, calls which do not pay are suspended, for
+    // longer each time it happens in a row.
+    if (site.window_lookups == window_size) {
+        if (static_cast<double>(site.window_hits) < min_hit_rate * static_cast<double>(window_size)) {
+            site.suspended = site.backoff;
+            site.backoff   = std::min(site.backoff * 2, max_backoff);
+        } else {
+            site.backoff = window_size;
+        }
+        site.window_lookups = site.window_hits = 0;
+    }
+    return found;
+}
+
+void Program::Memo::store(std::size_t position, const double *args, double result)
+{
+    if (site_of[position] == static_cast<std::size_t>(-1))
+        return;
+    Site &site = sites[site_of[position]];
+    if (site.suspended > 0)
+        return;
+    // The entries are replaced in turn.
+    std::memcpy(site.keys.data() + site.next * site.arity, args, site.arity * sizeof(double));
+    site.results[site.next] = result;
+    site.used               = std::max(site.used, site.next + 1);
+    site.next               = (site.next + 1) % site.results.size();
+}
+
+} // namespace expar
@@ -0,0 +1,83 @@
+/// @file   random.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/random.hpp"
+#include "expar/vmath.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace expar::random
+{
+/// @brief The samples whose draws are computed together.
+static const std::size_t block_size = 256;
+/// @brief The angle of a full turn.
+static const double two_pi = 6.283185307179586;
+
+bool find(const std::string &name, std::size_t arity, Distribution &distribution)
+{
+    if ((name == "gauss") && (arity == 3))
+        distribution = dist_gauss;
+    else if ((name == "agauss") && (arity == 3))
+        distribution = dist_agauss;
+    else if ((name == "unif") && (arity == 2))
+        distribution = dist_unif;
+    else if ((name == "aunif") && (arity == 2))
+        distribution = dist_aunif;
+    else
+        return false;
+    return true;
+}
+
+/// @brief Computes the random bits of a sample, as two values in [0, 1).
+static inline void bits_of(std::uint64_t seed, std::uint64_t sample, std::uint64_t site, double &u, double &v)
+{
+    std::uint32_t counter[4] = { static_cast<std::uint32_t>(sample), static_cast<std::uint32_t>(sample >> 32),
+                                 static_cast<std::uint32_t>(site), static_cast<std::uint32_t>(site >> 32) };
+    std::uint32_t key[2]     = { static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) };
+    philox(counter, key);
+    // The highest 53 bits of each half.
+    u = static_cast<double>(((std::uint64_t(counter[1]) << 32) | counter[0]) >> 11) * 0x1p-53;
+    v = static_cast<double>(((std::uint64_t(counter[3]) << 32) | counter[2]) >> 11) * 0x1p-53;
+}
+
+double draw(Distribution distribution, std::uint64_t seed, std::uint64_t sample, std::uint64_t site)
+{
+    double u, v;
+    bits_of(seed, sample, site, u, v);
+    if ((distribution == dist_unif) || (distribution == dist_aunif))
+        return 2. * u - 1.;
+    // Box-Muller, with 1 - u in (0, 1].
+    double radius = vmath::sqrt(-2. * vmath::log(1. - u));
+    return radius * vmath::cos(two_pi * v);
+}
+
+void draw(Distribution distribution, std::uint64_t seed, std::uint64_t first, std::uint64_t site, std::size_t count, double *out)
+{
+    double u[block_size], v[block_size];
+    for (std::size_t begin = 0; begin < count; begin += block_size) {
+        std::size_t n = std::min(block_size, count - begin);
+        for (std::size_t i = 0; i < n; ++i)
+            bits_of(seed, first + begin + i, site, u[i], v[i]);
+        double *result = out + begin;
+        if ((distribution == dist_unif) || (distribution == dist_aunif)) {
+            for (std::size_t i = 0; i < n; ++i)
+                result[i] = 2. * u[i] - 1.;
+            continue;
+        }
+        // The same operations of draw(), over whole arrays.
+        for (std::size_t i = 0; i < n; ++i) {
+            u[i] = 1. - u[i];
+            v[i] = two_pi * v[i];
+        }
+        vmath::log(n, u, u);
+        for (std::size_t i = 0; i < n; ++i)
+            u[i] = -2. * u[i];
+        vmath::sqrt(n, u, u);
+        vmath::cos(n, v, v);
+        for (std::size_t i = 0; i < n; ++i)
+            result[i] = u[i] * v[i];
+    }
+}
+
+} // namespace expar::random
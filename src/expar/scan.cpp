@@ -0,0 +1,212 @@
+/// @file   scan.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/scan.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace expar::scan
+{
+#if defined(__AVX2__)
+
+/// @brief The bytes compared at once.
+using Vector = __m256i;
+
+static inline Vector load(const char *data)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+}
+
+static inline Vector splat(char c)
+{
+    return _mm256_set1_epi8(c);
+}
+
+static inline Vector equal(Vector a, char c)
+{
+    return _mm256_cmpeq_epi8(a, splat(c));
+}
+
+/// @brief Checks the bytes within [low, high], as signed values.
+static inline Vector within(Vector a, char low, char high)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(a, splat(static_cast<char>(low - 1))),
+                            _mm256_cmpgt_epi8(splat(static_cast<char>(high + 1)), a));
+}
+
+static inline Vector either(Vector a, Vector b)
+{
+    return _mm256_or_si256(a, b);
+}
+
+static inline std::uint64_t bits(Vector a)
+{
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(a));
+}
+
+#elif defined(__SSE2__)
+
+/// @brief The bytes compared at once.
+using Vector = __m128i;
+
+static inline Vector load(const char *data)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+static inline Vector splat(char c)
+{
+    return _mm_set1_epi8(c);
+}
+
+static inline Vector equal(Vector a, char c)
+{
+    return _mm_cmpeq_epi8(a, splat(c));
+}
+
+/// @brief Checks the bytes within [low, high], as signed values.
+static inline Vector within(Vector a, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(a, splat(static_cast<char>(low - 1))),
+                         _mm_cmpgt_epi8(splat(static_cast<char>(high + 1)), a));
+}
+
+static inline Vector either(Vector a, Vector b)
+{
+    return _mm_or_si128(a, b);
+}
+
+static inline std::uint64_t bits(Vector a)
+{
+    return static_cast<std::uint16_t>(_mm_movemask_epi8(a));
+}
+
+#endif
+
+/// @brief Classifies a whole block of bytes.
+static inline Block classify_block(const char *data)
+{
+    Block block{};
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (std::size_t k = 0; k < block_size; k += sizeof(Vector)) {
+        Vector bytes = load(data + k);
+        // Letters are matched in lower case.
+        Vector lower = either(bytes, splat(0x20));
+        Vector space = either(either(equal(bytes, ' '), equal(bytes, '\t')), equal(bytes, '\r'));
+        Vector digit = within(bytes, '0', '9');
+        Vector ident = either(either(within(lower, 'a', 'z'), equal(bytes, '_')),
+                              either(either(equal(bytes, '$'), equal(bytes, '@')), equal(bytes, '#')));
+        block.whitespace |= bits(space) << k;
+        block.newlines |= bits(equal(bytes, '\n')) << k;
+        block.digits |= bits(digit) << k;
+        block.identifiers |= bits(ident) << k;
+        block.operators |= bits(within(bytes, '!', '~')) << k;
+        block.semicolons |= bits(equal(bytes, ';')) << k;
+        block.slashes |= bits(equal(bytes, '/')) << k;
+    }
+    block.operators &= ~(block.digits | block.identifiers);
+#else
+    for (std::size_t k = 0; k < block_size; ++k) {
+        auto c         = static_cast<unsigned char>(data[k]);
+        unsigned lower = c | 0x20U;
+        std::uint64_t bit = std::uint64_t(1) << k;
+        if ((c == ' ') || (c == '\t') || (c == '\r'))
+            block.whitespace |= bit;
+        else if (c == '\n')
+            block.newlines |= bit;
+        else if ((c >= '0') && (c <= '9'))
+            block.digits |= bit;
+        else if (((lower >= 'a') && (lower <= 'z')) || (c == '_') || (c == '$') || (c == '@') || (c == '#'))
+            block.identifiers |= bit;
+        else if ((c >= '!') && (c <= '~'))
+            block.operators |= bit;
+        if (c == ';')
+            block.semicolons |= bit;
+        if (c == '/')
+            block.slashes |= bit;
+    }
+#endif
+    return block;
+}
+
+Block classify(const char *data, std::size_t count)
+{
+    // The last block of the text is completed with spaces.
+    char padded[block_size];
+    if (count < block_size) {
+        std::memset(padded, ' ', block_size);
+        std::memcpy(padded, data, count);
+        data = padded;
+    }
+    return classify_block(data);
+}
+
+/// @brief Returns the position of the lowest bit set.
+static inline std::size_t lowest(std::uint64_t mask)
+{
+    return static_cast<std::size_t>(__builtin_ctzll(mask));
+}
+
+std::vector<Span> split(const std::string &text)
+{
+    std::vector<Span> spans;
+    const char *data = text.data();
+    std::size_t size = text.size();
+    // The expression being read, and where its comment begins.
+    std::size_t begin = 0, comment = 0;
+    bool content = false, in_comment = false;
+    auto close = [&](std::size_t end, std::size_t next) {
+        while ((end > begin) && ((data[end - 1] == '\r') || (data[end - 1] == ' ') || (data[end - 1] == '\t')))
+            --end;
+        if (content)
+            spans.emplace_back(Span{ begin, end });
+        begin   = next;
+        content = false;
+    };
+    for (std::size_t position = 0; position < size; position += block_size) {
+        std::size_t count = std::min(block_size, size - position);
+        Block block       = (count == block_size) ? classify_block(data + position) : classify(data + position, count);
+        // A comment starts at a slash followed by another one.
+        bool next_slash    = (position + block_size < size) && (data[position + block_size] == '/');
+        std::uint64_t starts = block.slashes & ((block.slashes >> 1) | (std::uint64_t(next_slash) << 63));
+        std::uint64_t events = block.newlines | block.semicolons | starts;
+        std::uint64_t solid  = ~(block.whitespace | block.newlines);
+        for (std::size_t cursor = 0; cursor < count;) {
+            std::uint64_t ahead = ~std::uint64_t(0) << cursor;
+            if (in_comment) {
+                // The comment ends the expression, at the end of the line.
+                std::uint64_t newline = block.newlines & ahead;
+                if (newline == 0)
+                    break;
+                std::size_t i = lowest(newline);
+                in_comment    = false;
+                close(comment, position + i + 1);
+                cursor = i + 1;
+                continue;
+            }
+            std::uint64_t pending = events & ahead;
+            std::uint64_t before  = pending ? ((pending & -pending) - 1) : ~std::uint64_t(0);
+            if (solid & ahead & before)
+                content = true;
+            if (pending == 0)
+                break;
+            std::size_t i = lowest(pending);
+            if ((starts >> i) & 1) {
+                in_comment = true;
+                comment    = position + i;
+            } else {
+                close(position + i, position + i + 1);
+            }
+            cursor = i + 1;
+        }
+    }
+    close(in_comment ? comment : size, size);
+    return spans;
+}
+
+} // namespace expar::scan
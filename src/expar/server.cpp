@@ -0,0 +1,450 @@
+/// @file   server.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/server.hpp"
+#include "expar/parser.hpp"
+#include "logging.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace expar
+{
+/// @brief The requests of the clients.
+enum MessageType : std::uint32_t {
+    msg_map,      ///< Maps the shared memory named in the payload.
+    msg_compile,  ///< Compiles the expression in the payload.
+    msg_evaluate, ///< Evaluates a batch found in the shared memory.
+};
+
+/// @brief What precedes the payload of requests and replies.
+struct Header {
+    /// The request.
+    std::uint32_t type;
+    /// For replies, zero on success, otherwise the payload is the error.
+    std::uint32_t status;
+    /// The identifier of the expression.
+    std::uint64_t id;
+    /// The number of points, or of variables, or of bytes mapped.
+    std::uint64_t count;
+    /// Where the batch is in the shared memory.
+    std::uint64_t offset;
+    /// The bytes of the payload.
+    std::uint64_t size;
+};
+
+/// @brief The largest payload accepted.
+static constexpr std::uint64_t max_payload = 1 << 24;
+
+/// @brief Sends the whole buffer, returns false if the peer is gone.
+static bool send_all(int fd, const void *data, std::size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+/// @brief Receives the whole buffer, returns false if the peer is gone.
+static bool recv_all(int fd, void *data, std::size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t received = ::recv(fd, bytes, size, 0);
+        if (received < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (received == 0)
+            return false;
+        bytes += received;
+        size -= static_cast<std::size_t>(received);
+    }
+    return true;
+}
+
+/// @brief Sends a message with its payload.
+static bool send_message(int fd, Header header, const std::string &payload)
+{
+    header.size = payload.size();
+    return send_all(fd, &header, sizeof(Header)) && send_all(fd, payload.data(), payload.size());
+}
+
+/// @brief Receives a message with its payload.
+static bool recv_message(int fd, Header &header, std::string &payload)
+{
+    if (!recv_all(fd, &header, sizeof(Header)) || (header.size > max_payload))
+        return false;
+    payload.resize(header.size);
+    return recv_all(fd, payload.data(), payload.size());
+}
+
+/// @brief Returns the address of the socket.
+static sockaddr_un address_of(const std::string &path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        _error("The socket path '%s' is too long!", path.c_str());
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+Server::Server(std::string _path, const FunctionRegistry &_registry)
+    : path(std::move(_path)),
+      registry(_registry),
+      listener(-1),
+      stopping(false),
+      programs(),
+      index(),
+      clients(),
+      threads(),
+      finished(),
+      served(0),
+      mutex()
+{
+    sockaddr_un address = address_of(path);
+    listener            = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        _error("Cannot create a socket: %s", std::strerror(errno));
+    ::unlink(path.c_str());
+    if ((::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) ||
+        (::listen(listener, SOMAXCONN) < 0)) {
+        int error = errno;
+        ::close(listener);
+        _error("Cannot listen on '%s': %s", path.c_str(), std::strerror(error));
+    }
+}
+
+Server::~Server()
+{
+    this->stop();
+    for (auto &thread : threads)
+        thread.second.join();
+    ::close(listener);
+    ::unlink(path.c_str());
+}
+
+void Server::run()
+{
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        int error  = errno;
+        std::vector<std::thread> done;
+        bool quit = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // The threads of the clients which left are joined here, so that
+            // a long running server does not keep them.
+            for (std::size_t id : finished) {
+                done.emplace_back(std::move(threads[id]));
+                threads.erase(id);
+            }
+            finished.clear();
+            if (stopping) {
+                if (client >= 0)
+                    ::close(client);
+                quit = true;
+            } else if (client >= 0) {
+                clients.insert(client);
+                threads.emplace(served, std::thread(&Server::serve, this, client, served));
+                ++served;
+            } else if (error != EINTR) {
+                _warning("Cannot accept clients on '%s', stopping: %s", path.c_str(), std::strerror(error));
+                quit = true;
+            }
+        }
+        for (auto &thread : done)
+            thread.join();
+        if (quit)
+            break;
+    }
+    this->stop();
+}
+
+void Server::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    // Wakes up the threads blocked on the sockets.
+    ::shutdown(listener, SHUT_RDWR);
+    for (int client : clients)
+        ::shutdown(client, SHUT_RDWR);
+}
+
+std::size_t Server::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return programs.size();
+}
+
+void Server::serve(int client, std::size_t id)
+{
+    char *memory         = nullptr;
+    std::size_t capacity = 0;
+    Header header;
+    std::string payload;
+    while (recv_message(client, header, payload)) {
+        Header reply = header;
+        std::string message;
+        try {
+            if (header.type == msg_map) {
+                if (memory)
+                    _error("The shared memory is already mapped!");
+                int fd = ::shm_open(payload.c_str(), O_RDWR, 0);
+                if (fd < 0)
+                    _error("Cannot open the shared memory '%s': %s", payload.c_str(), std::strerror(errno));
+                // A mapping past the end of the object would fault on access.
+                struct stat status;
+                if ((::fstat(fd, &status) != 0) || (header.count == 0) ||
+                    (static_cast<std::uint64_t>(status.st_size) < header.count)) {
+                    ::close(fd);
+                    _error("The shared memory '%s' is smaller than %lu bytes!", payload.c_str(), header.count);
+                }
+                void *mapped = ::mmap(nullptr, header.count, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (mapped == MAP_FAILED)
+                    _error("Cannot map the shared memory '%s': %s", payload.c_str(), std::strerror(errno));
+                memory   = static_cast<char *>(mapped);
+                capacity = header.count;
+            } else if (header.type == msg_compile) {
+                // The text, followed by the variables, separated by NULs.
+                std::vector<std::string> parts;
+                for (std::size_t begin = 0, end; begin <= payload.size(); begin = end + 1) {
+                    end = payload.find('\0', begin);
+                    if (end == std::string::npos)
+                        end = payload.size();
+                    parts.emplace_back(payload.substr(begin, end - begin));
+                }
+                reply.id    = this->compile(parts[0], std::vector<std::string>(parts.begin() + 1, parts.end()));
+                reply.count = parts.size() - 1;
+            } else if (header.type == msg_evaluate) {
+                const Program &program = this->get(header.id);
+                std::size_t variables  = program.get_variables().size();
+                // The inputs, one array for each variable, then the outputs.
+                std::uint64_t bytes = (variables + 1) * header.count * sizeof(double);
+                if ((memory == nullptr) || (header.count > capacity) || (header.offset > capacity) ||
+                    (bytes > capacity - header.offset) || (header.offset % sizeof(double)))
+                    _error("The batch does not fit the shared memory!");
+                double *batch = reinterpret_cast<double *>(memory + header.offset);
+                std::vector<const double *> values(variables);
+                for (std::size_t i = 0; i < variables; ++i)
+                    values[i] = batch + i * header.count;
+                program.evaluate(header.count, values.data(), batch + variables * header.count);
+            } else {
+                _error("Unknown request %u!", header.type);
+            }
+            reply.status = 0;
+        } catch (const std::exception &e) {
+            reply.status = 1;
+            message      = e.what();
+        }
+        if (!send_message(client, reply, message))
+            break;
+    }
+    if (memory)
+        ::munmap(memory, capacity);
+    std::lock_guard<std::mutex> lock(mutex);
+    clients.erase(client);
+    finished.emplace_back(id);
+    ::close(client);
+}
+
+std::size_t Server::compile(const std::string &text, const std::vector<std::string> &variables)
+{
+    std::string key = text;
+    for (const auto &variable : variables)
+        key += '\0' + variable;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end())
+            return it->second;
+    }
+    // Compiled outside the lock, two clients asking for the same expression
+    // at once keep the first copy.
+    std::unique_ptr<AstNode> node(parser::parse(text));
+    auto program = std::make_unique<Program>(node.get(), variables, registry);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end())
+        return it->second;
+    programs.emplace_back(std::move(program));
+    index[key] = programs.size() - 1;
+    return programs.size() - 1;
+}
+
+const Program &Server::get(std::size_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (id >= programs.size())
+        _error("There is no expression %lu!", id);
+    return *programs[id];
+}
+
+Client::Client(const std::string &path, std::size_t _capacity)
+    : socket(-1),
+      memory(nullptr),
+      capacity(_capacity - _capacity % sizeof(double)),
+      arity(),
+      pending(),
+      head(0)
+{
+    static std::atomic<unsigned> counter{ 0 };
+    sockaddr_un address = address_of(path);
+    socket              = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0)
+        _error("Cannot create a socket: %s", std::strerror(errno));
+    if (::connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        int error = errno;
+        ::close(socket);
+        _error("Cannot connect to '%s': %s", path.c_str(), std::strerror(error));
+    }
+    // The shared memory is removed once the server has mapped it, and goes
+    // away with the last mapping.
+    std::string name = "/expar-" + std::to_string(::getpid()) + "-" + std::to_string(counter++);
+    int fd           = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    void *mapped     = MAP_FAILED;
+    if ((fd >= 0) && (::ftruncate(fd, static_cast<off_t>(capacity)) == 0))
+        mapped = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    if (fd >= 0)
+        ::close(fd);
+    Header header{ msg_map, 0, 0, capacity, 0, 0 };
+    std::string reply;
+    bool mapped_by_server = (mapped != MAP_FAILED) && send_message(socket, header, name) &&
+                            recv_message(socket, header, reply) && (header.status == 0);
+    ::shm_unlink(name.c_str());
+    if (!mapped_by_server) {
+        if (mapped != MAP_FAILED)
+            ::munmap(mapped, capacity);
+        ::close(socket);
+        _error("Cannot share memory with '%s': %s", path.c_str(),
+               (mapped == MAP_FAILED) ? std::strerror(error) : reply.c_str());
+    }
+    memory = static_cast<char *>(mapped);
+}
+
+Client::~Client()
+{
+    try {
+        this->flush();
+    } catch (const std::exception &) {
+        // The outputs are lost with the server.
+    }
+    ::munmap(memory, capacity);
+    ::close(socket);
+}
+
+std::size_t Client::compile(const std::string &text, const std::vector<std::string> &variables)
+{
+    this->flush();
+    std::string payload = text;
+    for (const auto &variable : variables)
+        payload += '\0' + variable;
+    Header header{ msg_compile, 0, 0, 0, 0, 0 };
+    std::string reply;
+    if (!send_message(socket, header, payload) || !recv_message(socket, header, reply))
+        _error("The server is gone!");
+    if (header.status != 0)
+        _error("The server cannot compile '%s': %s", text.c_str(), reply.c_str());
+    arity[header.id] = header.count;
+    return header.id;
+}
+
+double Client::evaluate(std::size_t id, const double *values)
+{
+    std::size_t variables = arity.count(id) ? arity[id] : 0;
+    std::vector<const double *> pointers(variables);
+    for (std::size_t i = 0; i < variables; ++i)
+        pointers[i] = values + i;
+    double result = 0.;
+    this->evaluate(id, 1, pointers.data(), &result);
+    return result;
+}
+
+void Client::evaluate(std::size_t id, std::size_t count, const double *const *values, double *out)
+{
+    this->submit(id, count, values, out);
+    this->flush();
+}
+
+void Client::submit(std::size_t id, std::size_t count, const double *const *values, double *out)
+{
+    auto it = arity.find(id);
+    if (it == arity.end())
+        _error("There is no expression %lu!", id);
+    if (count == 0)
+        return;
+    std::size_t variables = it->second;
+    std::size_t size      = (variables + 1) * count * sizeof(double);
+    if ((count > capacity) || (size > capacity))
+        _error("A batch of %lu points does not fit %lu bytes!", count, capacity);
+    std::size_t offset = this->reserve(size);
+    double *batch      = reinterpret_cast<double *>(memory + offset);
+    for (std::size_t i = 0; i < variables; ++i)
+        std::memcpy(batch + i * count, values[i], count * sizeof(double));
+    Header header{ msg_evaluate, 0, id, count, offset, 0 };
+    if (!send_message(socket, header, std::string()))
+        _error("The server is gone!");
+    pending.emplace_back(Pending{ offset, size, offset + variables * count * sizeof(double), count, out });
+    head = offset + size;
+}
+
+void Client::flush()
+{
+    while (!pending.empty())
+        this->receive();
+}
+
+void Client::receive()
+{
+    Pending batch = pending.front();
+    pending.pop_front();
+    Header header;
+    std::string reply;
+    if (!recv_message(socket, header, reply))
+        _error("The server is gone!");
+    if (header.status != 0)
+        _error("The server cannot evaluate expression %lu: %s", header.id, reply.c_str());
+    std::memcpy(batch.out, memory + batch.output, batch.count * sizeof(double));
+}
+
+std::size_t Client::reserve(std::size_t size)
+{
+    while (true) {
+        if (pending.empty())
+            return 0;
+        // The batches being evaluated go from the tail up to the head,
+        // possibly wrapping around the end of the buffer.
+        std::size_t tail = pending.front().offset;
+        if (head > tail) {
+            if (capacity - head >= size)
+                return head;
+            if (tail > size)
+                return 0;
+        } else if (tail - head > size) {
+            return head;
+        }
+        this->receive();
+    }
+}
+
+} // namespace expar
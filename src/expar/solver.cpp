@@ -0,0 +1,155 @@
+/// @file   solver.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/solver.hpp"
+#include "expar/derivative.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+Solver::Solver(AstNode *expression,
+               std::string variable,
+               std::vector<std::string> _parameters,
+               const FunctionRegistry &registry)
+    : parameters(_parameters.size()),
+      function(),
+      derivative()
+{
+    std::vector<std::string> variables(1, variable);
+    variables.insert(variables.end(), _parameters.begin(), _parameters.end());
+    function = std::make_unique<Program>(expression, variables, registry);
+    if (is_differentiable(expression)) {
+        std::unique_ptr<AstNode> node(differentiate(expression, variable));
+        derivative = std::make_unique<Program>(node.get(), variables, registry);
+    }
+}
+
+SolverStats Solver::solve(std::size_t count,
+                          const double *targets,
+                          double *roots,
+                          const double *const *values,
+                          const SolverOptions &options,
+                          SolverStatus *status) const
+{
+    SolverStats stats;
+    // The points still going, and their inputs gathered together.
+    std::vector<std::size_t> active(count);
+    for (std::size_t i = 0; i < count; ++i)
+        active[i] = i;
+    std::vector<double> x(count), f(count), d(count), shifted(count), columns(parameters * count);
+    std::vector<const double *> inputs(parameters + 1);
+    auto gather = [&](const double *source) {
+        std::size_t n = active.size();
+        for (std::size_t k = 0; k < n; ++k)
+            x[k] = source ? source[active[k]] : x[k];
+        for (std::size_t j = 0; j < parameters; ++j)
+            for (std::size_t k = 0; k < n; ++k)
+                columns[j * count + k] = values[j][active[k]];
+        inputs[0] = x.data();
+        for (std::size_t j = 0; j < parameters; ++j)
+            inputs[j + 1] = columns.data() + j * count;
+    };
+    // The ends of the bracket of each point, with the sign of the residual
+    // at the first end (NaN where there is no bracket yet).
+    std::vector<double> a(count, NAN), b(count, NAN), sign_a(count, 0.);
+    std::vector<double> previous_x(count, NAN), previous_r(count, NAN);
+    if (!std::isnan(options.lower) && !std::isnan(options.upper) && (count > 0)) {
+        std::vector<double> lower(count);
+        gather(nullptr);
+        std::fill(x.begin(), x.end(), options.lower);
+        function->evaluate(count, inputs.data(), lower.data());
+        std::fill(x.begin(), x.end(), options.upper);
+        function->evaluate(count, inputs.data(), f.data());
+        stats.evaluations += 2 * count;
+        for (std::size_t i = 0; i < count; ++i) {
+            double r_lower = lower[i] - targets[i], r_upper = f[i] - targets[i];
+            if (r_lower == 0.) {
+                roots[i] = options.lower;
+            } else if (r_upper == 0.) {
+                roots[i] = options.upper;
+            } else if ((r_lower < 0.) != (r_upper < 0.)) {
+                a[i] = options.lower, b[i] = options.upper, sign_a[i] = std::copysign(1., r_lower);
+                if (!(roots[i] > std::fmin(a[i], b[i]) && (roots[i] < std::fmax(a[i], b[i]))))
+                    roots[i] = 0.5 * (a[i] + b[i]);
+            }
+        }
+    }
+    if (status)
+        std::fill(status, status + count, solve_stalled);
+    auto finish = [&](std::size_t i, SolverStatus outcome) {
+        if (status)
+            status[i] = outcome;
+        if (outcome == solve_converged)
+            ++stats.converged;
+        else
+            ++stats.failed;
+    };
+    for (; (stats.iterations < options.max_iterations) && !active.empty(); ++stats.iterations) {
+        std::size_t n = active.size();
+        gather(roots);
+        function->evaluate(n, inputs.data(), f.data());
+        if (derivative) {
+            derivative->evaluate(n, inputs.data(), d.data());
+        } else {
+            // Forward differences, with a step scaled to each point.
+            for (std::size_t k = 0; k < n; ++k) {
+                shifted[k] = x[k];
+                x[k] += std::sqrt(std::numeric_limits<double>::epsilon()) * (1. + std::fabs(x[k]));
+            }
+            function->evaluate(n, inputs.data(), d.data());
+            for (std::size_t k = 0; k < n; ++k) {
+                d[k] = (d[k] - f[k]) / (x[k] - shifted[k]);
+                x[k] = shifted[k];
+            }
+        }
+        stats.evaluations += 2 * n;
+        std::size_t kept = 0;
+        for (std::size_t k = 0; k < n; ++k) {
+            std::size_t i = active[k];
+            double r      = f[k] - targets[i];
+            if (std::fabs(r) <= options.tolerance * (1. + std::fabs(targets[i]))) {
+                finish(i, solve_converged);
+                continue;
+            }
+            bool bracketed = !std::isnan(a[i]);
+            if (bracketed && !std::isnan(r)) {
+                // The iterate replaces the end with the same sign.
+                if (std::copysign(1., r) == sign_a[i])
+                    a[i] = x[k];
+                else
+                    b[i] = x[k];
+            } else if (!std::isnan(previous_r[i]) && !std::isnan(r) && ((r < 0.) != (previous_r[i] < 0.))) {
+                // The last step went over the root.
+                a[i] = x[k], b[i] = previous_x[i], sign_a[i] = std::copysign(1., r), bracketed = true;
+            }
+            double next = x[k] - r / d[k];
+            if (bracketed) {
+                if (!(next > std::fmin(a[i], b[i]) && (next < std::fmax(a[i], b[i])))) {
+                    next = 0.5 * (a[i] + b[i]);
+                    ++stats.bisections;
+                } else {
+                    ++stats.newton_steps;
+                }
+            } else if (!std::isfinite(next)) {
+                finish(i, solve_failed);
+                continue;
+            } else {
+                ++stats.newton_steps;
+            }
+            previous_x[i] = x[k], previous_r[i] = r;
+            roots[i]      = next;
+            double scale  = options.step_tolerance * (1. + std::fabs(next));
+            if ((std::fabs(next - x[k]) <= scale) || (bracketed && (std::fabs(a[i] - b[i]) <= scale))) {
+                finish(i, solve_converged);
+                continue;
+            }
+            active[kept++] = i;
+        }
+        active.resize(kept);
+    }
+    stats.stalled = active.size();
+    return stats;
+}
+
+} // namespace expar
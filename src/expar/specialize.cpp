@@ -0,0 +1,183 @@
+/// @file   specialize.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/specialize.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/random.hpp"
+
+#include <cmath>
+#include <memory>
+
+namespace expar
+{
+/// @brief Returns the node if it is a real number, otherwise NULL.
+static inline AstNumber *real_of(AstNode *node)
+{
+    if ((node == nullptr) || (node->kind != node_number) || static_cast<AstNumber *>(node)->imaginary)
+        return nullptr;
+    return static_cast<AstNumber *>(node);
+}
+
+/// @brief Checks if the node is the given real number.
+static inline bool is_value(AstNode *node, double value)
+{
+    AstNumber *number = real_of(node);
+    return number && (number->value == value);
+}
+
+/// @brief Replaces the node with a number, keeping its position.
+static inline AstNode *replace(AstNode *node, double value)
+{
+    auto number   = new AstNumber(value);
+    number->begin = node->begin;
+    number->end   = node->end;
+    delete node;
+    return number;
+}
+
+/// @brief Replaces the node with one of its children.
+static inline AstNode *replace(AstNode *node, AstNode *&child)
+{
+    AstNode *kept = child;
+    child         = nullptr;
+    delete node;
+    return kept;
+}
+
+/// @brief Checks if the expression calls a random function. Such calls are
+///        never dropped, as the draws of each call depend on the position
+///        of the call among all the random calls.
+static bool has_random(AstNode *node, const FunctionRegistry &registry)
+{
+    std::vector<AstNode **> links;
+    std::vector<AstNode *> pending(1, node);
+    random::Distribution distribution;
+    while (!pending.empty()) {
+        AstNode *next = pending.back();
+        pending.pop_back();
+        if (next == nullptr)
+            continue;
+        if (next->kind == node_function) {
+            auto &function = static_cast<AstFunction &>(*next);
+            if (random::find(function.name, function.content.size(), distribution) && (registry.find(function.name) == nullptr))
+                return true;
+        }
+        links.clear();
+        links_of(next, links);
+        for (auto link : links)
+            pending.emplace_back(*link);
+    }
+    return false;
+}
+
+/// @brief Folds a node whose children are already folded. The operations
+///        are applied directly, so that folding is not counted among the
+///        evaluations.
+static AstNode *fold(AstNode *node, const FunctionRegistry &registry)
+{
+    switch (node->kind) {
+    case node_binary: {
+        auto &e = static_cast<AstBinary &>(*node);
+        if (e.type == op_assign)
+            break;
+        AstNumber *l = real_of(e.left), *r = real_of(e.right);
+        if (l && r)
+            return replace(node, apply(e.type, l->value, r->value));
+        // A known operand decides some of the logical operators, unless the
+        // other one has random calls.
+        if (((e.type == op_and) && ((l && (l->value == 0.)) || (r && (r->value == 0.)))) ||
+            ((e.type == op_or) && ((l && (l->value != 0.)) || (r && (r->value != 0.))))) {
+            if (!has_random(node, registry))
+                return replace(node, (e.type == op_and) ? 0. : 1.);
+        }
+        if (((e.type == op_mult) || (e.type == op_div) || (e.type == op_pow)) && is_value(e.right, 1.))
+            return replace(node, e.left);
+        if ((e.type == op_minus) && is_value(e.right, 0.) && !std::signbit(r->value))
+            return replace(node, e.left);
+        if ((e.type == op_mult) && is_value(e.left, 1.))
+            return replace(node, e.right);
+        break;
+    }
+    case node_unary: {
+        auto &e              = static_cast<AstUnary &>(*node);
+        AstNumber *operand = real_of(e.right);
+        if (operand)
+            return replace(node, apply(e.type, operand->value));
+        break;
+    }
+    case node_conditional: {
+        auto &e = static_cast<AstConditional &>(*node);
+        // The branch not taken is dropped, unless it has random calls.
+        AstNumber *condition = real_of(e.condition);
+        if (condition && !has_random((condition->value != 0.) ? e.if_false : e.if_true, registry))
+            return replace(node, (condition->value != 0.) ? e.if_true : e.if_false);
+        break;
+    }
+    case node_scope:
+        if (real_of(static_cast<AstScope *>(node)->content))
+            return replace(node, static_cast<AstScope *>(node)->content);
+        break;
+    case node_function: {
+        auto &e = static_cast<AstFunction &>(*node);
+        // Only calls whose result depends on the arguments alone are folded,
+        // unknown functions are left to the evaluation.
+        const Function *function = registry.find(e.name);
+        bool pure                = function ? (function->pure && (function->arity == e.content.size()))
+                                            : ((e.name == "pwl") || (e.name == "table"));
+        for (auto argument : e.content)
+            pure &= (real_of(argument) != nullptr);
+        if (pure && !e.content.empty()) {
+            std::vector<double> args;
+            for (auto argument : e.content)
+                args.emplace_back(real_of(argument)->value);
+            return replace(node, call(e.name, args.data(), args.size(), registry));
+        }
+        if ((e.name == "pow") && (e.content.size() == 2) && is_value(e.content[1], 1.))
+            return replace(node, e.content[0]);
+        break;
+    }
+    default:
+        break;
+    }
+    return node;
+}
+
+AstNode *specialize(AstNode *node, const std::map<std::string, double> &bindings, const FunctionRegistry &registry)
+{
+    if (node == nullptr)
+        return nullptr;
+    // The copy hangs from a scope, which frees it if folding fails half way
+    // and gives the root a link that can be replaced.
+    std::unique_ptr<AstScope> holder(new AstScope(scp_none, clone(node)));
+    // The links in pre-order, so that walking them backwards visits the
+    // children before their parent.
+    std::vector<AstNode **> order, links;
+    std::vector<AstNode **> pending(1, &holder->content);
+    while (!pending.empty()) {
+        AstNode **link = pending.back();
+        pending.pop_back();
+        AstNode *next = *link;
+        if (next == nullptr)
+            continue;
+        if (next->kind == node_variable) {
+            auto it = bindings.find(static_cast<AstVariable *>(next)->name);
+            if (it != bindings.end())
+                *link = replace(next, it->second);
+            continue;
+        }
+        order.emplace_back(link);
+        links.clear();
+        links_of(next, links);
+        // The target of an assignment stays a variable.
+        if ((next->kind == node_binary) && (static_cast<AstBinary *>(next)->type == op_assign))
+            links.erase(links.begin());
+        pending.insert(pending.end(), links.begin(), links.end());
+    }
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+        **it = fold(**it, registry);
+    AstNode *root   = holder->content;
+    holder->content = nullptr;
+    return root;
+}
+
+} // namespace expar
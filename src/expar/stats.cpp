@@ -0,0 +1,125 @@
+/// @file   stats.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/stats.hpp"
+
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace expar::stats
+{
+std::atomic<bool> active(false);
+
+/// @brief Calls the function on each pair of matching quantities.
+template <typename A, typename B, typename Function>
+static inline void zip(A &a, B &b, Function function)
+{
+    function("parses", a.parses, b.parses);
+    function("tokens", a.tokens, b.tokens);
+    function("parse_tree_nodes", a.parse_tree_nodes, b.parse_tree_nodes);
+    for (std::size_t kind = 0; kind < node_kinds; ++kind)
+        function(nodekind_to_plain_string(static_cast<NodeKind>(kind)).c_str(), a.ast_nodes[kind], b.ast_nodes[kind]);
+    function("node_bytes", a.node_bytes, b.node_bytes);
+    function("lexing_ns", a.lexing_ns, b.lexing_ns);
+    function("parsing_ns", a.parsing_ns, b.parsing_ns);
+    function("building_ns", a.building_ns, b.building_ns);
+    function("evaluations", a.evaluations, b.evaluations);
+    function("evaluation_ns", a.evaluation_ns, b.evaluation_ns);
+}
+
+/// @brief The counters of all the threads.
+struct Registry {
+    std::mutex mutex;
+    /// The counters of the running threads.
+    std::vector<BasicStatistics<Counter> *> threads;
+    /// The totals of the threads which have ended.
+    Statistics retired{};
+    /// The totals at the last reset.
+    Statistics baseline{};
+
+    /// @brief Adds the totals of all the threads, the lock must be held.
+    Statistics total()
+    {
+        Statistics result = retired;
+        for (auto thread : threads)
+            zip(result, *thread, [](const char *, std::uint64_t &into, const Counter &from) { into += from.get(); });
+        return result;
+    }
+};
+
+static Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+/// @brief Registers the counters of a thread, and moves them among the
+///        retired ones when the thread ends.
+struct ThreadCounters {
+    BasicStatistics<Counter> counters;
+
+    ThreadCounters()
+        : counters()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().threads.emplace_back(&counters);
+    }
+
+    ~ThreadCounters()
+    {
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        zip(instance.retired, counters, [](const char *, std::uint64_t &into, const Counter &from) { into += from.get(); });
+        for (auto it = instance.threads.begin(); it != instance.threads.end(); ++it) {
+            if (*it == &counters) {
+                instance.threads.erase(it);
+                break;
+            }
+        }
+    }
+};
+
+void enable(bool enabled)
+{
+    active.store(enabled, std::memory_order_relaxed);
+}
+
+BasicStatistics<Counter> &local()
+{
+    static thread_local ThreadCounters instance;
+    return instance.counters;
+}
+
+Statistics snapshot()
+{
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    Statistics result = instance.total();
+    zip(result, instance.baseline, [](const char *, std::uint64_t &into, const std::uint64_t &from) { into -= from; });
+    return result;
+}
+
+void reset()
+{
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    // The counters belong to their threads, so they are never written here.
+    instance.baseline = instance.total();
+}
+
+void merge(Statistics &into, const Statistics &from)
+{
+    zip(into, from, [](const char *, std::uint64_t &a, const std::uint64_t &b) { a += b; });
+}
+
+std::string to_string(const Statistics &statistics)
+{
+    std::stringstream ss;
+    zip(statistics, statistics, [&ss](const char *name, const std::uint64_t &value, const std::uint64_t &) {
+        ss << name << " " << value << "\n";
+    });
+    return ss.str();
+}
+
+} // namespace expar::stats
@@ -0,0 +1,87 @@
+/// @file   table.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/table.hpp"
+#include "logging.hpp"
+
+#include <cmath>
+
+namespace expar
+{
+Table::Table(std::vector<double> _xs, std::vector<double> _ys)
+    : xs(std::move(_xs)),
+      ys(std::move(_ys)),
+      slopes(),
+      uniform(false),
+      inverse_step(0.)
+{
+    if (xs.empty() || (xs.size() != ys.size()))
+        _error("A table needs the same number (at least one) of abscissas and values!");
+    for (std::size_t k = 1; k < xs.size(); ++k)
+        if (!(xs[k - 1] <= xs[k]))
+            _error("The abscissas of a table must be in non-decreasing order!");
+    slopes.resize(xs.size(), 0.);
+    for (std::size_t k = 0; k + 1 < xs.size(); ++k)
+        if (xs[k + 1] > xs[k])
+            slopes[k] = (ys[k + 1] - ys[k]) / (xs[k + 1] - xs[k]);
+    // Grids whose points are all within rounding of a uniform spacing are
+    // indexed directly.
+    if (xs.size() > 2) {
+        double step = (xs.back() - xs.front()) / static_cast<double>(xs.size() - 1);
+        uniform     = (step > 0.);
+        for (std::size_t k = 1; uniform && (k < xs.size()); ++k)
+            uniform = std::abs(xs[k] - (xs.front() + step * static_cast<double>(k))) <= 1e-9 * step;
+        inverse_step = uniform ? (1. / step) : 0.;
+    }
+}
+
+Table Table::from_points(const double *points, std::size_t count)
+{
+    std::vector<double> xs(count), ys(count);
+    for (std::size_t k = 0; k < count; ++k) {
+        xs[k] = points[2 * k];
+        ys[k] = points[2 * k + 1];
+    }
+    return Table(std::move(xs), std::move(ys));
+}
+
+void Table::lookup(std::size_t count, const double *x, double *out) const
+{
+    std::size_t last = xs.size() - 1;
+    // The segment of the previous point.
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        double value = x[i];
+        if (!(value > xs.front())) {
+            out[i] = ys.front();
+        } else if (!(value < xs.back())) {
+            out[i] = ys.back();
+        } else {
+            if ((k >= last) || !(xs[k] <= value) || !(value < xs[k + 1]))
+                k = this->segment(value);
+            out[i] = ys[k] + slopes[k] * (value - xs[k]);
+        }
+    }
+}
+
+double Table::interpolate(double x, const double *points, std::size_t count)
+{
+    if (count == 0)
+        _error("A table needs at least one breakpoint!");
+    for (std::size_t k = 1; k < count; ++k)
+        if (!(points[2 * k - 2] <= points[2 * k]))
+            _error("The abscissas of a table must be in non-decreasing order!");
+    if (!(x > points[0]))
+        return points[1];
+    for (std::size_t k = 1; k < count; ++k) {
+        double x0 = points[2 * k - 2], x1 = points[2 * k];
+        if (x < x1) {
+            // The same rounding of a table, whose slopes are precomputed.
+            double y0 = points[2 * k - 1], slope = (points[2 * k + 1] - y0) / (x1 - x0);
+            return y0 + slope * (x - x0);
+        }
+    }
+    return points[2 * count - 1];
+}
+
+} // namespace expar
@@ -0,0 +1,208 @@
+/// @file   trace.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/trace.hpp"
+
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace expar::trace
+{
+std::atomic<bool> active(false);
+
+/// @brief An event, its fields are atomic so that they can be read while
+///        the owner thread overwrites them.
+struct Event {
+    std::atomic<const char *> name;
+    std::atomic<std::uint64_t> begin;
+    std::atomic<std::uint64_t> end;
+    /// The position of the event among the events of the thread, plus one,
+    /// or zero while the fields are being written.
+    std::atomic<std::uint64_t> sequence;
+};
+
+/// @brief The last events of a thread. Only the owner thread writes them.
+struct Ring {
+    Ring(std::size_t _id)
+        : events(),
+          written(0),
+          cleared(0),
+          id(_id),
+          ended(false),
+          reported(false)
+    {
+        // Nothing to do.
+    }
+
+    Event events[events_per_thread];
+    /// The number of events written so far.
+    std::atomic<std::uint64_t> written;
+    /// The number of events written at the last clear.
+    std::uint64_t cleared;
+    /// The identifier of the thread in the trace.
+    std::size_t id;
+    /// If the owner thread has ended.
+    bool ended;
+    /// If the events were dumped (or cleared) since the thread ended.
+    bool reported;
+};
+
+/// @brief The rings of all the threads. They are kept after their thread
+///        ends, so that its events can still be written, and then handed
+///        to new threads.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    /// The identifier of the next thread.
+    std::size_t next_id = 1;
+};
+
+static Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+/// @brief Gives back the ring of a thread when the thread ends.
+struct Owner {
+    Ring *ring = nullptr;
+
+    ~Owner()
+    {
+        if (ring == nullptr)
+            return;
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        ring->ended    = true;
+        ring->reported = false;
+    }
+};
+
+/// @brief Returns the ring of the calling thread. The ring of an ended
+///        thread is reused once its events were dumped, or right away when
+///        there are too many rings.
+static Ring &local()
+{
+    static thread_local Owner owner;
+    if (owner.ring == nullptr) {
+        auto &instance = registry();
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        Ring *reused = nullptr;
+        for (auto &ring : instance.rings)
+            if (ring->ended && ring->reported && (reused == nullptr))
+                reused = ring.get();
+        for (auto &ring : instance.rings)
+            if (ring->ended && (reused == nullptr) && (instance.rings.size() >= max_rings))
+                reused = ring.get();
+        if (reused) {
+            reused->written.store(0, std::memory_order_relaxed);
+            reused->cleared  = 0;
+            reused->id       = instance.next_id++;
+            reused->ended    = false;
+            reused->reported = false;
+            owner.ring       = reused;
+        } else {
+            instance.rings.emplace_back(new Ring(instance.next_id++));
+            owner.ring = instance.rings.back().get();
+        }
+    }
+    return *owner.ring;
+}
+
+void enable(bool enabled)
+{
+    active.store(enabled, std::memory_order_relaxed);
+}
+
+void record(const char *name, std::uint64_t begin, std::uint64_t end)
+{
+    Ring &ring         = local();
+    std::uint64_t next = ring.written.load(std::memory_order_relaxed);
+    Event &event       = ring.events[next % events_per_thread];
+    // A dump which reads any of the new fields also sees the event as being
+    // written (see dump).
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.sequence.store(next + 1, std::memory_order_release);
+    ring.written.store(next + 1, std::memory_order_release);
+}
+
+/// @brief Writes the string as a JSON string.
+static void write_string(std::ostream &stream, const char *str)
+{
+    stream << '"';
+    for (; *str; ++str) {
+        if ((*str == '"') || (*str == '\\'))
+            stream << '\\';
+        stream << *str;
+    }
+    stream << '"';
+}
+
+void dump(std::ostream &stream)
+{
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    // The numbers are formatted here, leaving the stream of the caller as it
+    // is.
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    bool first = true;
+    json << "{\"traceEvents\":[";
+    for (const auto &ring : instance.rings) {
+        std::uint64_t written = ring->written.load(std::memory_order_acquire);
+        std::uint64_t from    = ring->cleared;
+        if (written - from > events_per_thread)
+            from = written - events_per_thread;
+        for (std::uint64_t i = from; i < written; ++i) {
+            // The event is skipped if the owner overwrites it meanwhile,
+            // since the fields may then mix the old event and the new one.
+            const Event &event     = ring->events[i % events_per_thread];
+            std::uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+            const char *name       = event.name.load(std::memory_order_relaxed);
+            std::uint64_t begin    = event.begin.load(std::memory_order_relaxed);
+            std::uint64_t end      = event.end.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((sequence != i + 1) || (event.sequence.load(std::memory_order_relaxed) != sequence))
+                continue;
+            json << (first ? "\n" : ",\n") << "{\"name\":";
+            write_string(json, name);
+            // Chrome wants the times in microseconds.
+            json << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+                 << ",\"ts\":" << (begin / 1000.)
+                 << ",\"dur\":" << ((end - begin) / 1000.) << "}";
+            first = false;
+        }
+    }
+    json << "\n]}\n";
+    stream << json.str();
+    for (auto &ring : instance.rings)
+        ring->reported = ring->ended;
+}
+
+std::string dump()
+{
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+void clear()
+{
+    auto &instance = registry();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    // The rings belong to their threads, so only the start is moved.
+    for (auto &ring : instance.rings) {
+        ring->cleared  = ring->written.load(std::memory_order_acquire);
+        ring->reported = ring->ended;
+    }
+}
+
+} // namespace expar::trace
@@ -0,0 +1,263 @@
+/// @file   unparse.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/unparse.hpp"
+#include "logging.hpp"
+
+#include <charconv>
+#include <cmath>
+
+namespace expar
+{
+/// @brief Returns the spelling of the operator, without going through a
+///        std::string as operator_to_string does.
+static inline const char *symbol_of(Operator op)
+{
+    switch (op) {
+    case op_assign:
+        return "=";
+    case op_plus:
+        return "+";
+    case op_minus:
+        return "-";
+    case op_mult:
+        return "*";
+    case op_div:
+        return "/";
+    case op_or:
+        return "||";
+    case op_and:
+        return "&&";
+    case op_xor:
+        return "^^";
+    case op_not:
+        return "!";
+    case op_bor:
+        return "|";
+    case op_band:
+        return "&";
+    case op_bsl:
+        return "<<";
+    case op_bsr:
+        return ">>";
+    case op_eq:
+        return "==";
+    case op_neq:
+        return "!=";
+    case op_lt:
+        return "<";
+    case op_gt:
+        return ">";
+    case op_le:
+        return "<=";
+    case op_ge:
+        return ">=";
+    case op_mod:
+        return "%";
+    case op_pow:
+        return "^";
+    case op_none:
+    default:
+        break;
+    }
+    _error("Cannot write the operator '%s'!", operator_to_plain_string(op).c_str());
+    return "";
+}
+
+/// @brief Something still to write: either a node, or a text.
+struct Task {
+    AstNode *node;
+    unsigned required;
+    const char *text;
+};
+
+/// @brief Writes the text of the expression. The visits write what comes
+///        before the children, and schedule the children together with
+///        the text between and after them, so that the native stack does
+///        not grow with the depth of the tree.
+class Unparser : public StaticVisitor<Unparser> {
+public:
+    Unparser(std::string &_out, std::vector<Task> &_pending)
+        : out(_out),
+          required(0),
+          pending(_pending)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Writes the node, which is in a position where only nodes
+    ///        binding at least as tight as the given precedence can appear
+    ///        without parentheses.
+    inline void write(AstNode *node, unsigned precedence)
+    {
+        this->schedule(node, precedence);
+        while (!pending.empty()) {
+            Task task = pending.back();
+            pending.pop_back();
+            if (task.node) {
+                required = task.required;
+                this->dispatch(task.node);
+            } else {
+                out.append(task.text);
+            }
+        }
+    }
+
+    void visit(AstBinary &e)
+    {
+        unsigned precedence = operator_precedence(e.type);
+        bool wrap           = precedence < required;
+        // The operand on the side where the operator groups can have the
+        // same precedence, the other one must bind tighter.
+        bool right = operator_is_right_associative(e.type);
+        if (wrap) {
+            out.push_back('(');
+            this->schedule(")");
+        }
+        this->schedule(e.right, right ? precedence : precedence + 1);
+        // The spaces are required, e.g., a<b would be read as an identifier.
+        this->schedule(" ");
+        this->schedule(symbol_of(e.type));
+        this->schedule(" ");
+        this->schedule(e.left, right ? precedence + 1 : precedence);
+    }
+
+    void visit(AstUnary &e)
+    {
+        unsigned precedence = operator_precedence(e.type, true);
+        bool wrap           = precedence < required;
+        if (wrap) {
+            out.push_back('(');
+            this->schedule(")");
+        }
+        out.append(symbol_of(e.type));
+        // Otherwise, !x would be read as an identifier.
+        if (e.type == op_not)
+            out.push_back(' ');
+        this->schedule(e.right, precedence);
+    }
+
+    void visit(AstConditional &e)
+    {
+        bool wrap = conditional_precedence < required;
+        if (wrap) {
+            out.push_back('(');
+            this->schedule(")");
+        }
+        // The conditional groups from the right, and anything can appear
+        // between the question mark and the colon.
+        this->schedule(e.if_false, conditional_precedence);
+        this->schedule(" : ");
+        this->schedule(e.if_true, 0);
+        this->schedule(" ? ");
+        this->schedule(e.condition, conditional_precedence + 1);
+    }
+
+    void visit(AstScope &e)
+    {
+        if (e.type == scp_square) {
+            out.push_back('[');
+            this->schedule("]");
+        } else if (e.type == scp_curly) {
+            out.push_back('{');
+            this->schedule("}");
+        } else if (e.type == scp_apex) {
+            out.push_back('\'');
+            this->schedule("'");
+        } else if (e.type == scp_quotes) {
+            out.push_back('"');
+            this->schedule("\"");
+        } else {
+            out.push_back('(');
+            this->schedule(")");
+        }
+        this->schedule(e.content, 0);
+    }
+
+    void visit(AstArray &e)
+    {
+        out.push_back('[');
+        this->schedule("]");
+        for (std::size_t i = e.content.size(); i > 0; --i) {
+            this->schedule(e.content[i - 1], 0);
+            if (i > 1)
+                this->schedule(", ");
+        }
+    }
+
+    void visit(AstFunction &e)
+    {
+        out.append(e.name);
+        out.push_back('(');
+        this->schedule(")");
+        for (std::size_t i = e.content.size(); i > 0; --i) {
+            this->schedule(e.content[i - 1], 0);
+            if (i > 1)
+                this->schedule(", ");
+        }
+    }
+
+    void visit(AstVariable &e)
+    {
+        out.append(e.name);
+    }
+
+    void visit(AstNumber &e)
+    {
+        // There are no literals for infinities and NaNs, write an expression
+        // which evaluates to them.
+        if (!std::isfinite(e.value)) {
+            out.append(std::isnan(e.value) ? "(0 / 0)" : (e.value < 0) ? "(-1 / 0)" : "(1 / 0)");
+            return;
+        }
+        // A negative literal reads back as a negation.
+        bool wrap = std::signbit(e.value) && (operator_precedence(op_minus, true) < required);
+        if (wrap)
+            out.push_back('(');
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), e.value);
+        out.append(buffer, result.ptr);
+        if (e.imaginary)
+            out.push_back('i');
+        if (wrap)
+            out.push_back(')');
+    }
+
+private:
+    /// Where the text is written.
+    std::string &out;
+    /// The precedence required by the position of the current node.
+    unsigned required;
+    /// What is still to write, the next one is at the back.
+    std::vector<Task> &pending;
+
+    inline void schedule(AstNode *node, unsigned precedence)
+    {
+        if (node == nullptr)
+            _error("Cannot write a NULL node!");
+        pending.emplace_back(Task{ node, precedence, nullptr });
+    }
+
+    inline void schedule(const char *text)
+    {
+        pending.emplace_back(Task{ nullptr, 0, text });
+    }
+};
+
+void unparse(AstNode *node, std::string &buffer)
+{
+    // The work stack is kept, so that it is allocated only once per thread.
+    static thread_local std::vector<Task> pending;
+    pending.clear();
+    Unparser unparser(buffer, pending);
+    unparser.write(node, 0);
+}
+
+std::string unparse(AstNode *node)
+{
+    std::string buffer;
+    unparse(node, buffer);
+    return buffer;
+}
+
+} // namespace expar
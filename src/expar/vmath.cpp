@@ -0,0 +1,483 @@
+/// @file   vmath.cpp
+/// @author Enrico Fraccaroli
+
+#include "expar/vmath.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace expar::vmath
+{
+// The kernels are written once, as templates working either on a double or
+// on a pack of four (__m256d, whose arithmetic operators are provided by the
+// compiler). The few operations which differ are the overloads below.
+
+static inline double fma(double a, double b, double c)
+{
+#ifdef __FMA__
+    return std::fma(a, b, c);
+#else
+    return a * b + c;
+#endif
+}
+
+/// @brief Rounds to the nearest integer, ties to even.
+static inline double round(double x)
+{
+    return std::nearbyint(x);
+}
+
+static inline std::uint64_t bits_of(double x)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static inline double from_bits(std::uint64_t bits)
+{
+    double x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/// @brief Returns 2^k, for an integer k in [-1022, 1023].
+static inline double pow2(double k)
+{
+    return from_bits(static_cast<std::uint64_t>(static_cast<std::int64_t>(k) + 1023) << 52);
+}
+
+static inline double select(bool mask, double a, double b)
+{
+    return mask ? a : b;
+}
+
+/// @brief Splits a positive normal value in mantissa, in [1, 2), and
+///        exponent.
+static inline double split(double x, double &exponent)
+{
+    std::uint64_t bits = bits_of(x);
+    exponent           = static_cast<double>(static_cast<std::int64_t>(bits >> 52) - 1023);
+    return from_bits((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+}
+
+/// @brief Returns the two lowest bits of the integer k, as masks.
+static inline void quadrant(double k, bool &odd, bool &negative)
+{
+    auto q   = static_cast<std::int64_t>(k);
+    odd      = (q & 1) != 0;
+    negative = (q & 2) != 0;
+}
+
+static inline double negate_if(bool mask, double x)
+{
+    return mask ? -x : x;
+}
+
+static inline bool greater(double a, double b)
+{
+    return a > b;
+}
+
+#ifdef __AVX2__
+static inline __m256d fma(__m256d a, __m256d b, __m256d c)
+{
+    return _mm256_fmadd_pd(a, b, c);
+}
+
+static inline __m256d round(__m256d x)
+{
+    return _mm256_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+static inline __m256d pow2(__m256d k)
+{
+    // The integer (k + 1023) ends up in the low bits of the mantissa.
+    __m256d biased = k + (4503599627370496. + 1023.);
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(biased), 52));
+}
+
+static inline __m256d select(__m256d mask, __m256d a, __m256d b)
+{
+    return _mm256_blendv_pd(b, a, mask);
+}
+
+static inline __m256d split(__m256d x, __m256d &exponent)
+{
+    __m256i bits = _mm256_castpd_si256(x);
+    // The biased exponent is turned into a double through the mantissa of
+    // 2^52, then the bias is removed.
+    __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000LL));
+    exponent       = _mm256_castsi256_pd(biased) - (4503599627370496. + 1023.);
+    return _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+                                               _mm256_set1_epi64x(0x3ff0000000000000LL)));
+}
+
+static inline void quadrant(__m256d k, __m256d &odd, __m256d &negative)
+{
+    // The integer k ends up in the low bits of the mantissa, also when it
+    // is negative.
+    __m256i q = _mm256_castpd_si256(k + 6755399441055744.);
+    __m256i one = _mm256_set1_epi64x(1), two = _mm256_set1_epi64x(2);
+    odd         = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, one), one));
+    negative    = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, two), two));
+}
+
+static inline __m256d negate_if(__m256d mask, __m256d x)
+{
+    return _mm256_xor_pd(x, _mm256_and_pd(mask, _mm256_set1_pd(-0.)));
+}
+
+static inline __m256d greater(__m256d a, __m256d b)
+{
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+}
+
+static inline __m256d splat(__m256d, double x)
+{
+    return _mm256_set1_pd(x);
+}
+#endif
+
+static inline double splat(double, double x)
+{
+    return x;
+}
+
+/// @brief Evaluates the polynomial c[0] + c[1] x + ... with Horner's rule.
+template <typename V, std::size_t N>
+static inline V horner(V x, const double (&c)[N])
+{
+    V result = splat(x, c[N - 1]);
+    for (std::size_t i = N - 1; i > 0; --i)
+        result = fma(result, x, splat(x, c[i - 1]));
+    return result;
+}
+
+// Constants of the range reductions.
+static const double log2e   = 1.44269504088896338700e+00;
+static const double ln2_hi  = 6.93147180369123816490e-01;
+static const double ln2_lo  = 1.90821492927058770002e-10;
+static const double inv_pio2 = 6.36619772367581382433e-01;
+static const double pio2_1  = 1.57079632673412561417e+00;
+static const double pio2_2  = 6.07710050630396597660e-11;
+static const double pio2_2t = 2.02226624879595063154e-21;
+
+/// The rational approximation of exp on [-ln2/2, ln2/2] (from fdlibm).
+static const double exp_p[] = { 1.66666666666666019037e-01, -2.77777777770155933842e-03, 6.61375632143793436117e-05,
+                                -1.65339022054652515390e-06, 4.13813679705723846039e-08 };
+/// The Taylor polynomial of exp of degree 12, without divisions.
+static const double exp_taylor[] = { 1., 1., 1. / 2, 1. / 6, 1. / 24, 1. / 120, 1. / 720, 1. / 5040, 1. / 40320,
+                                     1. / 362880, 1. / 3628800, 1. / 39916800, 1. / 479001600 };
+/// The approximation of log(1 + f), odd and even terms (from fdlibm).
+static const double log_odd[]  = { 6.666666666666735130e-01, 2.857142874366239149e-01,
+                                   1.818357216161805012e-01, 1.479819860511658591e-01 };
+static const double log_even[] = { 3.999999999940941908e-01, 2.222219843214978396e-01, 1.531383769920937332e-01 };
+/// The approximations of sin and cos on [-pi/4, pi/4] (from fdlibm).
+static const double sin_s1  = -1.66666666666666324348e-01;
+static const double sin_c[] = { 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+                                2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10 };
+static const double cos_c[] = { 4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+                                -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11 };
+
+/// @brief The largest argument of exp handled by the polynomials.
+static const double exp_limit = 708.;
+/// @brief The largest logarithm of the result of pow computed as exp(y log x).
+static const double pow_limit = 2.;
+/// @brief The largest angle handled by the polynomials (2^19 pi / 2).
+static const double angle_limit = 823549.;
+
+/// @brief Computes exp(x) for |x| <= exp_limit. The precise variant uses a
+///        rational approximation, the other one a polynomial.
+template <bool Precise, typename V>
+static inline V exp_kernel(V x)
+{
+    V k  = round(x * log2e);
+    V hi = fma(k, splat(x, -ln2_hi), x);
+    V lo = k * ln2_lo;
+    V r  = hi - lo;
+    V y;
+    if constexpr (Precise) {
+        V z = r * r;
+        V c = r - z * horner(z, exp_p);
+        y   = 1. - ((lo - (r * c) / (2. - c)) - hi);
+    } else {
+        // Estrin's scheme, which shortens the chain of dependent operations.
+        const double *c = exp_taylor;
+        V r2 = r * r, r4 = r2 * r2;
+        V p0 = fma(fma(r, splat(r, c[3]), splat(r, c[2])), r2, fma(r, splat(r, c[1]), splat(r, c[0])));
+        V p1 = fma(fma(r, splat(r, c[7]), splat(r, c[6])), r2, fma(r, splat(r, c[5]), splat(r, c[4])));
+        V p2 = fma(fma(r, splat(r, c[11]), splat(r, c[10])), r2, fma(r, splat(r, c[9]), splat(r, c[8])));
+        y    = fma(fma(r4, splat(r, c[12]), p2), r4 * r4, fma(p1, r4, p0));
+    }
+    return y * pow2(k);
+}
+
+/// @brief Computes log(x) for a positive normal x.
+template <typename V>
+static inline V log_kernel(V x)
+{
+    V e;
+    V m   = split(x, e);
+    // Move the mantissa in [sqrt(2) / 2, sqrt(2)].
+    auto big = greater(m, splat(x, 1.41421356237309504880));
+    m        = select(big, m * 0.5, m);
+    e        = select(big, e + 1., e);
+    V f      = m - 1.;
+    V hfsq   = 0.5 * f * f;
+    V s      = f / (2. + f);
+    V z      = s * s;
+    V w      = z * z;
+    V r      = z * horner(w, log_odd) + w * horner(w, log_even);
+    return e * ln2_hi - ((hfsq - (s * (hfsq + r) + e * ln2_lo)) - f);
+}
+
+/// @brief Computes sin(x) (Cosine false) or cos(x) (Cosine true), for
+///        |x| <= angle_limit.
+template <bool Cosine, typename V>
+static inline V sincos_kernel(V x)
+{
+    V k = round(x * inv_pio2);
+    // The reduced angle is kept as the sum r + lo. The product with the
+    // first part of pi / 2 is exact, and so is the difference, since both
+    // terms are close.
+    V t  = x - k * pio2_1;
+    V w  = k * pio2_2;
+    V hi = t - w;
+    w    = k * pio2_2t - ((t - hi) - w);
+    V r  = hi - w;
+    V lo = (hi - r) - w;
+    V z  = r * r;
+    V v  = z * r;
+    V s  = r - ((z * (0.5 * lo - v * horner(z, sin_c)) - lo) - v * sin_s1);
+    V hz = 0.5 * z;
+    V c  = 1. - hz;
+    c    = c + (((1. - c) - hz) + (z * z * horner(z, cos_c) - r * lo));
+    if constexpr (Cosine)
+        k = k + 1.;
+    decltype(greater(x, x)) odd, negative;
+    quadrant(k, odd, negative);
+    return negate_if(negative, select(odd, c, s));
+}
+
+// Checks of the arguments handled by the polynomials.
+
+static inline bool exp_domain(double x)
+{
+    return std::abs(x) <= exp_limit;
+}
+
+static inline bool log_domain(double x)
+{
+    return (x >= DBL_MIN) && (x <= DBL_MAX);
+}
+
+static inline bool angle_domain(double x)
+{
+    return std::abs(x) <= angle_limit;
+}
+
+#ifdef __AVX2__
+static inline __m256d absolute(__m256d x)
+{
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.), x);
+}
+
+static inline __m256d exp_domain(__m256d x)
+{
+    return _mm256_cmp_pd(absolute(x), _mm256_set1_pd(exp_limit), _CMP_LE_OQ);
+}
+
+static inline __m256d log_domain(__m256d x)
+{
+    return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(DBL_MIN), _CMP_GE_OQ),
+                         _mm256_cmp_pd(x, _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ));
+}
+
+static inline __m256d angle_domain(__m256d x)
+{
+    return _mm256_cmp_pd(absolute(x), _mm256_set1_pd(angle_limit), _CMP_LE_OQ);
+}
+#endif
+
+/// @brief Applies the kernel to the arrays, the values outside its domain
+///        are handed to the C library.
+template <typename Kernel, typename Domain, typename Exact>
+static inline void apply(std::size_t count, const double *x, double *out, Kernel kernel, Domain domain, Exact exact)
+{
+    std::size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= count; i += 4) {
+        __m256d value  = _mm256_loadu_pd(x + i);
+        __m256d result = kernel(value);
+        int valid      = _mm256_movemask_pd(domain(value));
+        if (valid != 0xF) {
+            alignas(32) double values[4], results[4];
+            _mm256_store_pd(values, value);
+            _mm256_store_pd(results, result);
+            for (int lane = 0; lane < 4; ++lane)
+                if (!((valid >> lane) & 1))
+                    results[lane] = exact(values[lane]);
+            result = _mm256_load_pd(results);
+        }
+        _mm256_storeu_pd(out + i, result);
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = domain(x[i]) ? kernel(x[i]) : exact(x[i]);
+}
+
+/// @brief Applies the C library function to the arrays.
+template <typename Exact>
+static inline void exact_loop(std::size_t count, const double *x, double *out, Exact exact)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        out[i] = exact(x[i]);
+}
+
+bool has_avx2()
+{
+#ifdef __AVX2__
+    return true;
+#else
+    return false;
+#endif
+}
+
+double exp(double x, Accuracy accuracy)
+{
+    if ((accuracy == acc_exact) || !exp_domain(x))
+        return std::exp(x);
+    return (accuracy == acc_ulp1) ? exp_kernel<true>(x) : exp_kernel<false>(x);
+}
+
+double log(double x, Accuracy accuracy)
+{
+    if ((accuracy == acc_exact) || !log_domain(x))
+        return std::log(x);
+    return log_kernel(x);
+}
+
+double sqrt(double x, Accuracy)
+{
+    // The instruction is correctly rounded.
+    return std::sqrt(x);
+}
+
+double sin(double x, Accuracy accuracy)
+{
+    if ((accuracy == acc_exact) || !angle_domain(x))
+        return std::sin(x);
+    return sincos_kernel<false>(x);
+}
+
+double cos(double x, Accuracy accuracy)
+{
+    if ((accuracy == acc_exact) || !angle_domain(x))
+        return std::cos(x);
+    return sincos_kernel<true>(x);
+}
+
+/// @brief Computes pow through exp and log, see pow().
+template <typename V>
+static inline V pow_kernel(V x, V y)
+{
+    return exp_kernel<true>(y * log_kernel(x));
+}
+
+double pow(double x, double y, Accuracy accuracy)
+{
+    // Composing exp and log loses accuracy as the result grows, so only the
+    // lowest tier does it, and only for results close to one.
+    if ((accuracy != acc_ulp4) || !log_domain(x) || !(std::abs(y) <= DBL_MAX))
+        return std::pow(x, y);
+    double t = y * log_kernel(x);
+    if (!(std::abs(t) <= pow_limit))
+        return std::pow(x, y);
+    return exp_kernel<true>(t);
+}
+
+void exp(std::size_t count, const double *x, double *out, Accuracy accuracy)
+{
+    auto exact = [](double v) { return std::exp(v); };
+    auto check = [](auto v) { return exp_domain(v); };
+    if (accuracy == acc_exact)
+        exact_loop(count, x, out, exact);
+    else if (accuracy == acc_ulp1)
+        apply(count, x, out, [](auto v) { return exp_kernel<true>(v); }, check, exact);
+    else
+        apply(count, x, out, [](auto v) { return exp_kernel<false>(v); }, check, exact);
+}
+
+void log(std::size_t count, const double *x, double *out, Accuracy accuracy)
+{
+    auto exact = [](double v) { return std::log(v); };
+    if (accuracy == acc_exact)
+        exact_loop(count, x, out, exact);
+    else
+        apply(count, x, out, [](auto v) { return log_kernel(v); }, [](auto v) { return log_domain(v); }, exact);
+}
+
+void sqrt(std::size_t count, const double *x, double *out, Accuracy)
+{
+    std::size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = std::sqrt(x[i]);
+}
+
+void sin(std::size_t count, const double *x, double *out, Accuracy accuracy)
+{
+    auto exact = [](double v) { return std::sin(v); };
+    if (accuracy == acc_exact)
+        exact_loop(count, x, out, exact);
+    else
+        apply(count, x, out, [](auto v) { return sincos_kernel<false>(v); }, [](auto v) { return angle_domain(v); }, exact);
+}
+
+void cos(std::size_t count, const double *x, double *out, Accuracy accuracy)
+{
+    auto exact = [](double v) { return std::cos(v); };
+    if (accuracy == acc_exact)
+        exact_loop(count, x, out, exact);
+    else
+        apply(count, x, out, [](auto v) { return sincos_kernel<true>(v); }, [](auto v) { return angle_domain(v); }, exact);
+}
+
+void pow(std::size_t count, const double *x, const double *y, double *out, Accuracy accuracy)
+{
+    std::size_t i = 0;
+#ifdef __AVX2__
+    if (accuracy == acc_ulp4) {
+        for (; i + 4 <= count; i += 4) {
+            __m256d base = _mm256_loadu_pd(x + i), exponent = _mm256_loadu_pd(y + i);
+            __m256d t    = exponent * log_kernel(base);
+            __m256d result = exp_kernel<true>(t);
+            __m256d small  = _mm256_cmp_pd(absolute(t), _mm256_set1_pd(pow_limit), _CMP_LE_OQ);
+            int valid      = _mm256_movemask_pd(_mm256_and_pd(log_domain(base), small));
+            if (valid != 0xF) {
+                alignas(32) double results[4];
+                _mm256_store_pd(results, result);
+                for (int lane = 0; lane < 4; ++lane)
+                    if (!((valid >> lane) & 1))
+                        results[lane] = vmath::pow(x[i + lane], y[i + lane], accuracy);
+                result = _mm256_load_pd(results);
+            }
+            _mm256_storeu_pd(out + i, result);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = vmath::pow(x[i], y[i], accuracy);
+}
+
+} // namespace expar::vmath
@@ -0,0 +1,35 @@
+/// @file   server.cpp
+/// @author Enrico Fraccaroli
+/// @brief  Keeps the compiled expressions for the processes of the host.
+
+#include "expar/server.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s <socket>\n", argv[0]);
+        return 1;
+    }
+    // The signals are waited for by this thread, the others never see them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    try {
+        expar::Server server(argv[1]);
+        std::thread runner(&expar::Server::run, &server);
+        int signal = 0;
+        sigwait(&signals, &signal);
+        server.stop();
+        runner.join();
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+/// @file   check.hpp
+/// @author Enrico Fraccaroli
+/// @brief  The report of the checks, shared by the tests.
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+/// @brief Prints the outcome of each check of a test, and counts the ones
+///        which failed.
+class Checks {
+public:
+    /// The number of failed checks.
+    int failures = 0;
+
+    /// @brief Prints the outcome of the check.
+    /// @param name the name of the check.
+    /// @param ok   if the check passed.
+    void operator()(const std::string &name, bool ok)
+    {
+        printf("%-50s %s\n", name.c_str(), ok ? "OK" : "FAILED");
+        failures += !ok;
+    }
+};
@@ -76,6 +76,8 @@ public:
     {
         std::cout << "AstNumber[";
         std::cout << e.value;
+        if (e.imaginary)
+            std::cout << "i";
         std::cout << "]";
     }
 };
@@ -146,6 +148,8 @@ public:
     void visit(expar::AstNumber &e) override
     {
         std::cout << e.value;
+        if (e.imaginary)
+            std::cout << "i";
     }
 };
 
@@ -193,4 +197,5 @@ int main(int argc, char *argv[])
     Test("1 ** 2.5");
     Test("1 / 2.5");
     Test("A(1, 2, 3)");
+    Test("1 + 2.5i");
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/complex.hpp"
+#include "expar/trace.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+/// @brief Counts the occurrences of the text.
+static std::size_t count(const std::string &text, const std::string &what)
+{
+    std::size_t result = 0;
+    for (auto at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+        ++result;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::map<std::string, double> bindings = { { "x", 2. } };
+    Checks check;
+    // Nothing is recorded while disabled.
+    delete expar::parser::parse("x + 1");
+    check("(disabled)", count(expar::trace::dump(), "\"ph\"") == 0);
+    // Record the stages of a parse, and the evaluation.
+    expar::trace::enable();
+    auto node = expar::parser::parse("x * (x + 1)");
+    expar::Evaluator(bindings).evaluate(node);
+    expar::ComplexProgram program(node, { "x" });
+    delete node;
+    std::string json = expar::trace::dump();
+    for (const char *name : { "parse", "input stream", "lexer", "tokens.fill", "parser", "visitor", "evaluate", "compile" }) {
+        std::string event = std::string("{\"name\":\"") + name + "\"";
+        check(name, count(json, event) == 1);
+    }
+    check("(format)", (json.rfind("{\"traceEvents\":[", 0) == 0) && (json.find("\"dur\":") != std::string::npos));
+    // Each thread gets its own track, and the events survive the thread.
+    expar::trace::clear();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i)
+        threads.emplace_back([]() { delete expar::parser::parse("x - 1"); });
+    for (auto &thread : threads)
+        thread.join();
+    json = expar::trace::dump();
+    check("(threads)", count(json, "{\"name\":\"parse\"") == 3);
+    check("(clear)", count(json, "{\"name\":\"evaluate\"") == 0);
+    // Old events are overwritten.
+    expar::trace::clear();
+    for (std::size_t i = 0; i < expar::trace::events_per_thread + 10; ++i)
+        expar::trace::record("tick", i + 1, i + 2);
+    check("(ring)", count(expar::trace::dump(), "{\"name\":\"tick\"") == expar::trace::events_per_thread);
+    // The rings of ended threads are reused, so many short threads do not
+    // grow the trace without bound.
+    expar::trace::clear();
+    for (std::size_t i = 0; i < 3 * expar::trace::max_rings; ++i)
+        std::thread([]() { expar::trace::record("spawned", 1, 2); }).join();
+    json = expar::trace::dump();
+    check("(recycled)", (count(json, "{\"name\":\"spawned\"") > 0) &&
+                            (count(json, "{\"name\":\"spawned\"") <= expar::trace::max_rings));
+    // Dumps taken while a thread overwrites its events only hold whole
+    // events, and leave the format of the stream as it is.
+    {
+        expar::trace::clear();
+        std::atomic<bool> stop(false);
+        std::thread writer([&stop]() {
+            for (std::uint64_t i = 1; !stop.load(); ++i)
+                expar::trace::record("busy", 1000 * i, 1000 * i + 1000);
+        });
+        bool whole = true;
+        for (int i = 0; i < 20; ++i) {
+            json = expar::trace::dump();
+            whole &= (count(json, "\"dur\":") == count(json, "\"dur\":1.000}"));
+        }
+        stop = true;
+        writer.join();
+        std::ostringstream stream;
+        expar::trace::dump(stream);
+        stream << 0.5;
+        check("(concurrent dump)", whole);
+        check("(stream format)", stream.str().substr(stream.str().size() - 3) == "0.5");
+    }
+    expar::trace::enable(false);
+    return check.failures;
+}
@@ -0,0 +1,109 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/program.hpp"
+#include "expar/kernel.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    // A registry with a callable which keeps a state, and an impure function.
+    expar::FunctionRegistry registry = expar::FunctionRegistry::standard();
+    double gain                      = 3.;
+    registry.add<3>("lerp", [gain](double a, double b, double t) { return gain * (a + (b - a) * t); });
+    static int ticks = 0;
+    registry.add<0>("tick", []() { return static_cast<double>(++ticks); }, false);
+    registry.add("twice", [](double x) { return 2. * x; });
+    // Compare the program with the tree walking evaluator.
+    std::map<std::string, double> bindings = { { "x", 0.75 }, { "y", -2. } };
+    std::vector<std::string> expressions   = {
+        "x + y * 2",
+        "-x ^ 2 + y ^ -3",
+        "2 ^ x ^ 2",
+        "sqrt(x) * exp(-y) + log(x) - atan2(y, x)",
+        "max(x, y) - min(x, y) / 4 + hypot(x, y)",
+        "(x > y) + (x <= 1) * 10 + (x == y) + (x != y)",
+        "(x > y) && (y > 0) || ! (x < 0)",
+        "7 % 4 + (6 | 1) + (5 & 4) + (1 << 3) + (16 >> 2)",
+        "lerp(x, y, 0.25) + twice(y)",
+        "a = x - y",
+    };
+    std::vector<std::string> variables = { "x", "y" };
+    double values[]                    = { 0.75, -2. };
+    for (const auto &text : expressions) {
+        auto node       = expar::parser::parse(text);
+        double expected = expar::Evaluator(bindings, registry).evaluate(node);
+        expar::Program program(node, variables, registry);
+        check(text, program.evaluate(values) == expected);
+        delete node;
+    }
+    // Powers give the bits of the evaluator, on single points and batches,
+    // whatever the exponent.
+    for (const char *text : { "x ^ 3", "x ^ -7", "x ^ 64", "x ^ 2", "x ^ -1", "x ^ 1", "x ^ 0", "x ^ 0.5" }) {
+        auto node = expar::parser::parse(text);
+        expar::Program program(node, variables, registry);
+        std::vector<double> xs(500), ys(500, 0.), out(500);
+        for (std::size_t i = 0; i < xs.size(); ++i)
+            xs[i] = 0.037 * i - 2.1;
+        const double *inputs[] = { xs.data(), ys.data() };
+        program.evaluate(xs.size(), inputs, out.data());
+        expar::Kernel kernel({ node }, variables, registry);
+        std::vector<double> batch(xs.size());
+        kernel.evaluate(xs.size(), inputs, batch.data());
+        bool same = true;
+        for (std::size_t i = 0; i < xs.size(); ++i) {
+            double point[]  = { xs[i], 0. };
+            double expected = expar::Evaluator({ { "x", xs[i] }, { "y", 0. } }, registry).evaluate(node);
+            same &= (std::isnan(expected) && std::isnan(out[i])) ||
+                    ((program.evaluate(point) == expected) && (out[i] == expected) && (batch[i] == expected));
+        }
+        check(std::string("(power) ") + text, same);
+        delete node;
+    }
+    // Calls of pure functions on constants are folded.
+    auto node = expar::parser::parse("sqrt(4) * x + max(1, 2)");
+    expar::Program folded(node, variables, registry);
+    std::size_t calls = 0;
+    for (const auto &instruction : folded.get_code())
+        calls += (instruction.code >= expar::Program::p_call1);
+    check("(fold pure calls)", (calls == 0) && (folded.evaluate(values) == 2. * 0.75 + 2.));
+    delete node;
+    // Impure functions are called at every evaluation.
+    node = expar::parser::parse("tick() + 0 * x");
+    expar::Program impure(node, variables, registry);
+    impure.evaluate(values);
+    check("(keep impure calls)", (impure.evaluate(values) == 2.) && (ticks == 2));
+    delete node;
+    // Arity and names are checked when binding.
+    for (const char *text : { "sqrt(x, y)", "unknown(x)", "lerp(x)" }) {
+        node       = expar::parser::parse(text);
+        bool error = false;
+        try {
+            expar::Program program(node, variables, registry);
+        } catch (const std::exception &) {
+            error = true;
+        }
+        check(std::string("(reject) ") + text, error);
+        delete node;
+    }
+    // The batch evaluation gives the same results of the scalar one.
+    node = expar::parser::parse("sin(x) * y ^ 2 + lerp(x, y, x) - (x > y)");
+    expar::Program program(node, variables, registry);
+    std::size_t count = 1000;
+    std::vector<double> xs(count), ys(count), out(count);
+    for (std::size_t i = 0; i < count; ++i)
+        xs[i] = 0.01 * i, ys[i] = 1. - 0.003 * i;
+    const double *inputs[] = { xs.data(), ys.data() };
+    program.evaluate(count, inputs, out.data());
+    bool ok = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        double point[] = { xs[i], ys[i] };
+        ok &= (out[i] == program.evaluate(point));
+    }
+    check("(batch)", ok);
+    delete node;
+    return check.failures;
+}
@@ -0,0 +1,81 @@
+#include "expar/parser.hpp"
+#include "expar/macros.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <algorithm>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    expar::MacroTable macros;
+    macros.define("sq(a) = a * a");
+    macros.define("lin(a, b, t) = a + (b - a) * t");
+    macros.define("nest(x) = sq(lin(x, 1, k)) + sq(x)");
+    macros.define("same(a) = a");
+    macros.define("shift(b) = b + a");
+    macros.define("twice(a) = shift(2 * a)");
+    // Calls are replaced by the bodies, arguments by their expressions.
+    std::vector<std::pair<std::string, std::string>> tests = {
+        { "sq(x + 1) * 2", "(x + 1) * (x + 1) * 2" },
+        { "lin(y, 2 * y, t)", "y + (2 * y - y) * t" },
+        { "sq(sq(z))", "z * z * (z * z)" },
+        { "nest(w) - sin(w)", "(w + (1 - w) * k) * (w + (1 - w) * k) + w * w - sin(w)" },
+        { "same(sq(b))", "b * b" },
+        { "lin(a, b, t)", "a + (b - a) * t" },
+        // The parameters of a function do not capture the names used by the
+        // functions it calls.
+        { "twice(5)", "2 * 5 + a" },
+        { "twice(same(twice(c)))", "2 * (2 * c + a) + a" },
+    };
+    for (const auto &test : tests) {
+        auto node        = macros.expand(expar::parser::parse(test.first));
+        std::string text = expar::unparse(node);
+        check(test.first + " -> " + text, text == test.second);
+        delete node;
+    }
+    // The nodes of the body take the position of the call.
+    auto node    = macros.expand(expar::parser::parse("1 + sq(x)"));
+    auto product = static_cast<expar::AstBinary *>(node)->right;
+    check("(positions)", (product->begin == 4) && (product->end == 9) &&
+                             (static_cast<expar::AstBinary *>(product)->left->begin == 7));
+    delete node;
+    // Errors: recursion, arity and size.
+    macros.define("loop(x) = 1 + loop(x)");
+    macros.define("ping(x) = pong(x) * 2");
+    macros.define("pong(x) = ping(x) / 2");
+    macros.define("d1(x) = x + x");
+    macros.define("d2(x) = d1(d1(x))");
+    macros.define("d3(x) = d2(d2(x))");
+    macros.define("d4(x) = d3(d3(x))");
+    std::vector<std::pair<std::string, std::size_t>> errors = {
+        { "loop(1)", expar::default_expansion_budget },
+        { "2 * ping(y)", expar::default_expansion_budget },
+        { "sq(1, 2)", expar::default_expansion_budget },
+        { "d4(x)", 1000 },
+    };
+    for (const auto &test : errors) {
+        bool error = false;
+        try {
+            delete macros.expand(expar::parser::parse(test.first), test.second);
+        } catch (const std::exception &) {
+            error = true;
+        }
+        check("(reject) " + test.first, error);
+    }
+    node = macros.expand(expar::parser::parse("d3(x)"), 1000);
+    std::string text = expar::unparse(node);
+    check("(budget)", std::count(text.begin(), text.end(), 'x') == 16);
+    delete node;
+    // Malformed definitions.
+    for (const char *text : { "f(x) + 1", "f(x + 1) = x", "f(x, x) = x" }) {
+        bool error = false;
+        try {
+            macros.define(text);
+        } catch (const std::exception &) {
+            error = true;
+        }
+        check(std::string("(reject) ") + text, error);
+    }
+    return check.failures;
+}
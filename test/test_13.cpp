@@ -0,0 +1,121 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/program.hpp"
+#include "expar/table.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> uniform(-1., 11.);
+    // Tables on a uniform grid, on a random grid and with steps.
+    std::vector<std::pair<std::string, std::vector<double>>> grids = {
+        { "(uniform)", { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 } },
+        { "(random)", { 0, 0.1, 0.5, 0.55, 2, 3.7, 4, 8, 9.99, 10 } },
+        { "(steps)", { 0, 1, 1, 4, 4, 4, 10 } },
+        { "(single)", { 5 } },
+    };
+    for (const auto &grid : grids) {
+        std::vector<double> points;
+        for (std::size_t k = 0; k < grid.second.size(); ++k)
+            points.insert(points.end(), { grid.second[k], std::sin(static_cast<double>(k)) });
+        auto table = expar::Table::from_points(points.data(), grid.second.size());
+        // Random points, and a sweep going through the breakpoints in order.
+        std::vector<double> xs(2000), out(xs.size());
+        for (std::size_t i = 0; i < 1000; ++i)
+            xs[i] = uniform(generator);
+        for (std::size_t i = 1000; i < xs.size(); ++i)
+            xs[i] = -1. + 12. * static_cast<double>(i - 1000) / 1000.;
+        xs.insert(xs.end(), grid.second.begin(), grid.second.end());
+        out.resize(xs.size());
+        table.lookup(xs.size(), xs.data(), out.data());
+        bool ok = true;
+        for (std::size_t i = 0; i < xs.size(); ++i) {
+            double expected = expar::Table::interpolate(xs[i], points.data(), grid.second.size());
+            ok &= (std::abs(table.lookup(xs[i]) - expected) <= 1e-12) && (out[i] == table.lookup(xs[i]));
+        }
+        check(grid.first, ok);
+    }
+    check("(uniform detection)", expar::Table({ 0, 0.25, 0.5, 0.75 }, { 1, 2, 3, 4 }).is_uniform() &&
+                                     !expar::Table({ 0, 0.25, 0.6, 0.75 }, { 1, 2, 3, 4 }).is_uniform());
+    // Constant breakpoints become a table, the others are interpolated on
+    // the fly, and the results match the evaluator.
+    std::vector<std::string> variables     = { "x", "y" };
+    std::map<std::string, double> bindings = { { "x", 0.3 }, { "y", 2. } };
+    double values[]                        = { 0.3, 2. };
+    std::vector<std::pair<std::string, expar::Program::Code>> tests = {
+        { "pwl(x, 0, 0, 1, 10, 2, 0) * 2", expar::Program::p_table },
+        { "table(x * y, 0, 1, sqrt(4), 3) + 1", expar::Program::p_table },
+        { "pwl(x, 0, y, 1, -y)", expar::Program::p_pwl },
+    };
+    for (const auto &test : tests) {
+        auto node = expar::parser::parse(test.first);
+        expar::Program program(node, variables);
+        bool found = false;
+        for (const auto &instruction : program.get_code())
+            found |= (instruction.code == test.second);
+        double expected = expar::Evaluator(bindings).evaluate(node);
+        std::vector<double> xs(300, 0.3), ys(300, 2.), out(300);
+        const double *inputs[] = { xs.data(), ys.data() };
+        program.evaluate(300, inputs, out.data());
+        check(test.first, found && (program.evaluate(values) == expected) && (out[299] == expected));
+        delete node;
+    }
+    // Breakpoints known only when evaluating round as the constant ones.
+    {
+        auto constant = expar::parser::parse("pwl(x, 0, 0.1, 0.7, 2.3, 3, -1.1)");
+        auto runtime  = expar::parser::parse("pwl(x, 0, 0.1, 0.7 * y, 2.3, 3, -1.1)");
+        expar::Program table(constant, variables), pwl(runtime, variables);
+        bool same = true;
+        for (int i = -10; i < 400; ++i) {
+            double point[] = { i / 113., 1. };
+            double value   = table.evaluate(point);
+            same &= (pwl.evaluate(point) == value) &&
+                    (expar::Evaluator({ { "x", point[0] }, { "y", 1. } }).evaluate(runtime) == value);
+        }
+        check("(same rounding)", same);
+        delete constant;
+        delete runtime;
+    }
+    // Wrong breakpoints are rejected, whether compiled or evaluated.
+    for (const char *text : { "pwl(x, 0, 1, 2)", "pwl(x)", "pwl(x, 1, 0, 0, 1)", "pwl(x, 1, 0, y - 2, 1)" }) {
+        auto node     = expar::parser::parse(text);
+        bool compiled = false, evaluated = false;
+        try {
+            expar::Program program(node, variables);
+            program.evaluate(values);
+        } catch (const std::exception &) {
+            compiled = true;
+        }
+        try {
+            expar::Evaluator(bindings).evaluate(node);
+        } catch (const std::exception &) {
+            evaluated = true;
+        }
+        check(std::string("(reject) ") + text, compiled && evaluated);
+        delete node;
+    }
+    // Compare the lookup with the scan of the breakpoints (not asserted).
+    std::vector<double> points;
+    for (std::size_t k = 0; k < 256; ++k)
+        points.insert(points.end(), { std::pow(static_cast<double>(k), 1.5), std::cos(static_cast<double>(k)) });
+    auto table = expar::Table::from_points(points.data(), 256);
+    std::vector<double> xs(100000), out(xs.size());
+    for (std::size_t i = 0; i < xs.size(); ++i)
+        xs[i] = 4096. * static_cast<double>(i) / static_cast<double>(xs.size());
+    double sum  = 0.;
+    auto start  = std::chrono::steady_clock::now();
+    for (double x : xs)
+        sum += expar::Table::interpolate(x, points.data(), 256);
+    auto middle = std::chrono::steady_clock::now();
+    table.lookup(xs.size(), xs.data(), out.data());
+    auto stop = std::chrono::steady_clock::now();
+    printf("%-50s scan %.4fs, table %.4fs (%g)\n", "(timing)",
+           std::chrono::duration<double>(middle - start).count(),
+           std::chrono::duration<double>(stop - middle).count(), sum);
+    return check.failures;
+}
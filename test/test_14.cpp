@@ -0,0 +1,158 @@
+#include "expar/parser.hpp"
+#include "expar/program.hpp"
+#include "expar/vmath.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+
+/// @brief Returns the distance, in units in the last place, of two values.
+static inline std::uint64_t ulp_distance(double a, double b)
+{
+    if (std::isnan(a) || std::isnan(b))
+        return (std::isnan(a) && std::isnan(b)) ? 0 : std::numeric_limits<std::uint64_t>::max();
+    std::int64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    // Map the values on a line of integers.
+    ia = (ia < 0) ? (std::numeric_limits<std::int64_t>::min() - ia) : ia;
+    ib = (ib < 0) ? (std::numeric_limits<std::int64_t>::min() - ib) : ib;
+    return (ia > ib) ? static_cast<std::uint64_t>(ia - ib) : static_cast<std::uint64_t>(ib - ia);
+}
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::mt19937_64 generator(11);
+    auto uniform = [&generator](double a, double b) {
+        return std::uniform_real_distribution<double>(a, b)(generator);
+    };
+    const std::size_t samples = 100000;
+    // Each function is compared with the C library on random arguments.
+    struct Kernel {
+        std::string name;
+        double (*scalar)(double, vmath::Accuracy);
+        void (*batch)(std::size_t, const double *, double *, vmath::Accuracy);
+        double (*exact)(double);
+        std::function<double()> argument;
+    };
+    std::vector<Kernel> kernels = {
+        { "exp", vmath::exp, vmath::exp, std::exp, [&]() { return uniform(-708., 708.); } },
+        { "exp (small)", vmath::exp, vmath::exp, std::exp, [&]() { return uniform(-1., 1.); } },
+        { "log", vmath::log, vmath::log, std::log, [&]() { return std::exp(uniform(-700., 700.)); } },
+        { "log (near 1)", vmath::log, vmath::log, std::log, [&]() { return uniform(0.5, 2.); } },
+        { "sqrt", vmath::sqrt, vmath::sqrt, std::sqrt, [&]() { return uniform(0., 1e10); } },
+        { "sin", vmath::sin, vmath::sin, std::sin, [&]() { return uniform(-10., 10.); } },
+        { "sin (large)", vmath::sin, vmath::sin, std::sin, [&]() { return uniform(-8e5, 8e5); } },
+        { "cos", vmath::cos, vmath::cos, std::cos, [&]() { return uniform(-10., 10.); } },
+        { "cos (large)", vmath::cos, vmath::cos, std::cos, [&]() { return uniform(-8e5, 8e5); } },
+    };
+    for (const auto &kernel : kernels) {
+        std::vector<double> x(samples), out(samples);
+        for (auto &value : x)
+            value = kernel.argument();
+        for (auto accuracy : { vmath::acc_exact, vmath::acc_ulp1, vmath::acc_ulp4 }) {
+            std::uint64_t bound = (accuracy == vmath::acc_exact) ? 0 : ((accuracy == vmath::acc_ulp1) ? 1 : 4);
+            std::uint64_t worst = 0;
+            bool same           = true;
+            kernel.batch(samples, x.data(), out.data(), accuracy);
+            for (std::size_t i = 0; i < samples; ++i) {
+                double value = kernel.scalar(x[i], accuracy);
+                worst        = std::max(worst, ulp_distance(value, kernel.exact(x[i])));
+                same &= (ulp_distance(value, out[i]) == 0);
+            }
+            check(kernel.name + " (" + std::to_string(bound) + " ulp, worst " + std::to_string(worst) + ")",
+                  (worst <= bound) && same);
+        }
+    }
+    // The composition of exp and log, for results within [e^-2, e^2] and
+    // around them.
+    {
+        std::vector<double> x(samples), y(samples), out(samples);
+        for (std::size_t i = 0; i < samples; ++i) {
+            x[i] = std::exp(uniform(-20., 20.));
+            y[i] = uniform(-3., 3.) / std::abs(std::log(x[i]));
+        }
+        vmath::pow(samples, x.data(), y.data(), out.data(), vmath::acc_ulp4);
+        std::uint64_t worst = 0;
+        bool same           = true;
+        for (std::size_t i = 0; i < samples; ++i) {
+            double value = vmath::pow(x[i], y[i], vmath::acc_ulp4);
+            worst        = std::max(worst, ulp_distance(value, std::pow(x[i], y[i])));
+            same &= (ulp_distance(value, out[i]) == 0);
+        }
+        check("pow (4 ulp, worst " + std::to_string(worst) + ")", (worst <= 4) && same);
+    }
+    // Special values follow the C library.
+    const double inf = std::numeric_limits<double>::infinity(), nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> specials = { 0., -0., inf, -inf, nan, 1e-310, -1e-310, 709.9, -745., 1e300, -1., 1e6 };
+    bool ok                      = true;
+    for (auto accuracy : { vmath::acc_ulp1, vmath::acc_ulp4 }) {
+        std::uint64_t bound = (accuracy == vmath::acc_ulp1) ? 1 : 4;
+        for (const auto &kernel : kernels) {
+            std::vector<double> out(specials.size());
+            kernel.batch(specials.size(), specials.data(), out.data(), accuracy);
+            for (std::size_t i = 0; i < specials.size(); ++i) {
+                ok &= ulp_distance(kernel.scalar(specials[i], accuracy), kernel.exact(specials[i])) <= bound;
+                ok &= ulp_distance(out[i], kernel.exact(specials[i])) <= bound;
+            }
+        }
+        for (double x : specials)
+            for (double y : specials)
+                ok &= ulp_distance(vmath::pow(x, y, accuracy), std::pow(x, y)) <= bound;
+    }
+    check("(special values)", ok);
+    // The output can be the input.
+    {
+        std::vector<double> x(1003), expected(x.size());
+        for (auto &value : x)
+            value = uniform(-5., 5.);
+        vmath::sin(x.size(), x.data(), expected.data());
+        vmath::sin(x.size(), x.data(), x.data());
+        check("(in place)", x == expected);
+    }
+    // Programs use the kernels on arrays, with the same results.
+    {
+        auto node = parser::parse("exp(-x) * sin(x) + sqrt(log(x + 1)) * cos(x)");
+        Program program(node, { "x" });
+        std::vector<double> x(1000), out(x.size());
+        for (auto &value : x)
+            value = uniform(0., 10.);
+        const double *inputs[] = { x.data() };
+        program.evaluate(x.size(), inputs, out.data());
+        bool same = true;
+        for (std::size_t i = 0; i < x.size(); ++i)
+            same &= (program.evaluate(&x[i]) == out[i]);
+        check("(program)", same);
+        delete node;
+    }
+    // Compare the timings with the C library.
+    {
+        std::vector<double> x(1 << 16), out(x.size());
+        for (auto &value : x)
+            value = uniform(-10., 10.);
+        auto time = [&](const std::function<void()> &function) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int repeat = 0; repeat < 20; ++repeat)
+                function();
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+        std::cout << "AVX2 : " << (vmath::has_avx2() ? "yes" : "no") << "\n";
+        for (const auto &kernel : kernels) {
+            if (kernel.name.find('(') != std::string::npos)
+                continue;
+            double exact = time([&]() {
+                for (std::size_t i = 0; i < x.size(); ++i)
+                    out[i] = kernel.exact(x[i]);
+            });
+            double ulp1 = time([&]() { kernel.batch(x.size(), x.data(), out.data(), vmath::acc_ulp1); });
+            double ulp4 = time([&]() { kernel.batch(x.size(), x.data(), out.data(), vmath::acc_ulp4); });
+            printf("%-6s libm %8.2f ms, 1 ulp %8.2f ms, 4 ulp %8.2f ms\n", kernel.name.c_str(), exact, ulp1, ulp4);
+        }
+    }
+    return check.failures;
+}
@@ -0,0 +1,123 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/complex.hpp"
+#include "expar/interval.hpp"
+#include "expar/program.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    // Both spellings build a conditional, which groups from the right and
+    // binds looser than the logical operators.
+    std::vector<std::pair<std::string, std::string>> spellings = {
+        { "x > 0 ? x : -x", "x > 0 ? x : -x" },
+        { "if(x > 0, x, -x)", "x > 0 ? x : -x" },
+        { "a ? b : c ? d : e", "a ? b : c ? d : e" },
+        { "(a ? b : c) ? d : e", "(a ? b : c) ? d : e" },
+        { "a || b ? c = 1 : d", "a || b ? c = 1 : d" },
+        { "1 + (a ? b : c)", "1 + (a ? b : c)" },
+        { "y = a ? b : c", "y = a ? b : c" },
+    };
+    for (const auto &spelling : spellings) {
+        auto node  = parser::parse(spelling.first);
+        auto copy  = clone(node);
+        bool built = (node->kind == node_conditional) || (node->kind == node_binary);
+        check(spelling.first, built && (unparse(node) == spelling.second) && (unparse(copy) == spelling.second));
+        delete copy;
+        delete node;
+    }
+    {
+        auto node = parser::parse("if(x, 1)");
+        check("(if with two arguments is a call)", node->kind == node_function);
+        delete node;
+    }
+    // Evaluations on single points compute only the branch taken, and skip
+    // the right operand of the logical operators when they can.
+    static int ticks = 0;
+    FunctionRegistry registry = FunctionRegistry::standard();
+    registry.add<0>("tick", []() { return static_cast<double>(++ticks); }, false);
+    std::vector<std::string> variables     = { "x", "y" };
+    std::map<std::string, double> bindings = { { "x", -1. }, { "y", 2. } };
+    double values[]                        = { -1., 2. };
+    for (const char *text : { "x > 0 ? tick() : y", "if(x < 0, y, tick())", "(x > 0) && tick()", "(y > 0) || tick()",
+                              "x > 0 ? tick() : (y > 0 ? y : tick())" }) {
+        auto node = parser::parse(text);
+        ticks     = 0;
+        double a  = Evaluator(bindings, registry).evaluate(node);
+        Program program(node, variables, registry);
+        double b = program.evaluate(values);
+        check(std::string("(short circuit) ") + text, (ticks == 0) && (a == b));
+        delete node;
+    }
+    // Batches compute both branches, and select the results point by point,
+    // also where the branch not taken is not defined.
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> uniform(-2., 2.);
+    std::vector<double> xs(1000), ys(1000), out(1000);
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        xs[i] = uniform(generator);
+        ys[i] = (i % 7 == 0) ? 0. : uniform(generator);
+    }
+    const double *inputs[] = { xs.data(), ys.data() };
+    for (const char *text : { "x >= 0 ? sqrt(x) : log(-x)", "x > y ? x * 2 : y * y", "if(x < 0, -1, if(x > 1, 1, x))",
+                              "(x > 0) && (y > 0) || x < -1", "(y != 0) && (1 / y > 0)", "!(x > 0) || y",
+                              "(x > 0 ? x : y) + (y > 0 ? sqrt(y) : 0) * (x < y ? 1 : 2)" }) {
+        auto node = parser::parse(text);
+        Program program(node, variables);
+        program.evaluate(xs.size(), inputs, out.data());
+        bool ok = true;
+        for (std::size_t i = 0; i < xs.size(); ++i) {
+            std::map<std::string, double> point = { { "x", xs[i] }, { "y", ys[i] } };
+            double point_values[]               = { xs[i], ys[i] };
+            double expected                     = Evaluator(point).evaluate(node);
+            ok &= (out[i] == expected) && (program.evaluate(point_values) == expected);
+        }
+        check(std::string("(batch) ") + text, ok);
+        delete node;
+    }
+    // Constant conditions are resolved when compiling.
+    {
+        auto node = parser::parse("1 ? x : y");
+        Program program(node, variables);
+        check("(constant condition)", (program.get_code().size() == 1) && (program.evaluate(values) == -1.));
+        delete node;
+    }
+    // Intervals take the hull of the branches which can be taken.
+    {
+        auto node                                 = parser::parse("x > 0 ? x : 0");
+        std::map<std::string, Interval> positive  = { { "x", Interval(1., 2.) } };
+        std::map<std::string, Interval> undecided = { { "x", Interval(-1., 3.) } };
+        Interval a                                = IntervalEvaluator(positive).evaluate(node);
+        Interval b                                = IntervalEvaluator(undecided).evaluate(node);
+        check("(intervals)", (a.lower == 1.) && (a.upper == 2.) && (b.lower == -1.) && (b.upper == 3.));
+        delete node;
+    }
+    // Complex conditions are true when not zero.
+    {
+        auto node                              = parser::parse("z ? 1 : 2");
+        std::map<std::string, Complex> zero    = { { "z", Complex(0., 0.) } };
+        std::map<std::string, Complex> nonzero = { { "z", Complex(0., 1.) } };
+        check("(complex)", (ComplexEvaluator(zero).evaluate(node) == Complex(2.)) &&
+                               (ComplexEvaluator(nonzero).evaluate(node) == Complex(1.)));
+        delete node;
+    }
+    // A missing expression has no value.
+    {
+        std::map<std::string, double> none;
+        bool thrown = false;
+        try {
+            Evaluator(none).evaluate(nullptr);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check("(null node)", thrown);
+    }
+    return check.failures;
+}
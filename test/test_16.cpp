@@ -0,0 +1,89 @@
+#include "expar/parser.hpp"
+#include "expar/program.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> uniform(0.5, 2.);
+    const std::size_t samples = 10000;
+    std::vector<double> xs(samples), ys(samples);
+    std::vector<float> xf(samples), yf(samples), single(samples), mixed(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+        xf[i] = static_cast<float>(xs[i] = uniform(generator));
+        yf[i] = static_cast<float>(ys[i] = uniform(generator));
+    }
+    const double *inputs[]       = { xs.data(), ys.data() };
+    const float *float_inputs[] = { xf.data(), yf.data() };
+    std::vector<std::string> variables = { "x", "y" };
+    // The results stay close to the evaluation in double (the relative error
+    // grows near the zeros, where the rounding of the inputs dominates), and
+    // computing in double is at least as accurate.
+    for (const char *text : { "x * y + x / y", "sqrt(x) * exp(-y) + log(x + y)", "x > y ? sin(x) : cos(y)",
+                              "(x - y) ^ 2 + 3 * x ^ 3 - y % 1", "pwl(x, 0, 0, 1, 1, 2, 4) + y" }) {
+        auto node = parser::parse(text);
+        Program program(node, variables);
+        auto single_error = program.estimate_error(samples, inputs, Program::prec_single);
+        auto mixed_error  = program.estimate_error(samples, inputs, Program::prec_mixed);
+        program.evaluate(samples, float_inputs, single.data());
+        program.evaluate(samples, float_inputs, mixed.data(), Program::prec_mixed);
+        bool ok = (single_error.absolute < 1e-4) && (mixed_error.absolute < 1e-4) &&
+                  (mixed_error.absolute <= single_error.absolute);
+        // The evaluation in mixed precision only rounds the result.
+        for (std::size_t i = 0; i < samples; ++i) {
+            double point[] = { xf[i], yf[i] };
+            ok &= (mixed[i] == static_cast<float>(program.evaluate(point)));
+            ok &= (std::abs(single[i] - mixed[i]) <= 1e-5 * std::abs(mixed[i]) + 1e-6);
+        }
+        check(text, ok);
+        delete node;
+    }
+    // Cancellation is flagged by the estimate.
+    {
+        auto node = parser::parse("(x + 100000000) - 100000000");
+        Program program(node, variables);
+        auto error = program.estimate_error(samples, inputs, Program::prec_single);
+        check("(cancellation)", error.relative > 1e-2);
+        delete node;
+    }
+    // Values which are not numbers only in one precision are infinitely wrong.
+    {
+        auto node = parser::parse("exp(x * 100)");
+        Program program(node, variables);
+        auto error = program.estimate_error(samples, inputs, Program::prec_single);
+        check("(overflow)", std::isinf(error.absolute) && std::isinf(error.relative));
+        delete node;
+    }
+    // Compare the timings of the precisions.
+    {
+        auto node = parser::parse("x * y + (x - y) * (x + y) / (x * x + 1) - y * 0.5");
+        Program program(node, variables);
+        const std::size_t count = 1000000;
+        std::vector<double> xd(count), yd(count), outd(count);
+        std::vector<float> xs1(count), ys1(count), outf(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            xs1[i] = static_cast<float>(xd[i] = uniform(generator));
+            ys1[i] = static_cast<float>(yd[i] = uniform(generator));
+        }
+        const double *double_points[] = { xd.data(), yd.data() };
+        const float *float_points[]   = { xs1.data(), ys1.data() };
+        auto time                     = [](const std::function<void()> &function) {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+        double d = time([&]() { program.evaluate(count, double_points, outd.data()); });
+        double s = time([&]() { program.evaluate(count, float_points, outf.data()); });
+        double m = time([&]() { program.evaluate(count, float_points, outf.data(), Program::prec_mixed); });
+        printf("double %8.2f ms, single %8.2f ms, mixed %8.2f ms\n", d, s, m);
+        delete node;
+    }
+    return check.failures;
+}
@@ -0,0 +1,111 @@
+#include "expar/parser.hpp"
+#include "expar/array.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    // Square brackets keep all their elements.
+    {
+        auto node = parser::parse("[1, x + 2, [3, 4]]");
+        auto copy = clone(node);
+        bool ok   = (node->kind == node_array) && (static_cast<AstArray *>(node)->content.size() == 3);
+        check("(parse)", ok && (unparse(node) == "[1, x + 2, [3, 4]]") && (unparse(copy) == unparse(node)));
+        delete copy;
+        delete node;
+    }
+    Array sweep(1000);
+    for (std::size_t i = 0; i < sweep.size(); ++i)
+        sweep[i] = 0.01 * static_cast<double>(i);
+    std::map<std::string, Array> bindings = { { "x", sweep }, { "a", { 1., 2., 3. } }, { "b", { 4., 5., 6. } }, { "k", { 2. } } };
+    // Each expression is compared, element by element, with the evaluation
+    // on single values.
+    std::vector<std::pair<std::string, std::vector<std::pair<std::string, Array>>>> elementwise = {
+        { "[1, 2, 3] * k + a", {} },
+        { "a ^ 2 - b / k", {} },
+        { "sin(x) * exp(-x) + max(x, 3)", {} },
+        { "x > 5 ? sqrt(x) : -x", {} },
+        { "pwl(x, 0, 0, 5, 1, 10, 0)", {} },
+        { "hypot(x, k) + (x < 1 || x > 9)", {} },
+    };
+    for (const auto &test : elementwise) {
+        auto node     = parser::parse(test.first);
+        Array result  = ArrayEvaluator(bindings).evaluate(node);
+        std::size_t n = (test.first.find('x') != std::string::npos) ? sweep.size() : 3;
+        bool ok       = (result.size() == n);
+        for (std::size_t i = 0; ok && (i < n); ++i) {
+            std::map<std::string, double> point;
+            for (const auto &binding : bindings)
+                point[binding.first] = binding.second[(binding.second.size() == 1) ? 0 : (i % binding.second.size())];
+            if (n == 3)
+                point["x"] = 0.;
+            // The literal array is replaced by its element.
+            std::string text = test.first;
+            if (text.rfind("[1, 2, 3]", 0) == 0)
+                text.replace(0, 9, std::to_string(i + 1));
+            auto scalar = parser::parse(text);
+            ok &= (std::abs(result[i] - Evaluator(point).evaluate(scalar)) <= 1e-12 * std::abs(result[i]));
+            delete scalar;
+        }
+        check(test.first, ok);
+        delete node;
+    }
+    // Reductions.
+    std::vector<std::pair<std::string, double>> reductions = {
+        { "sum(a)", 6. },
+        { "prod(b)", 120. },
+        { "max([3, -1, 7, 2])", 7. },
+        { "min(a - b)", -3. },
+        { "mean([a, b])", 3.5 },
+        { "dot(a, b)", 32. },
+        { "dot(a, k)", 12. },
+        { "sum(x >= 5)", 500. },
+        { "max(a) + min(1, 2)", 4. },
+        { "[k, 1] == 1 ? 10 : 20", 0. },
+    };
+    for (const auto &test : reductions) {
+        auto node    = parser::parse(test.first);
+        Array result = ArrayEvaluator(bindings).evaluate(node);
+        if (test.first[0] == '[')
+            check(test.first, (result == Array{ 20., 10. }));
+        else
+            check(test.first, (result.size() == 1) && (result[0] == test.second));
+        delete node;
+    }
+    // Arrays of different lengths cannot be combined.
+    for (const char *text : { "a + x", "dot(a, x)", "max(a, x)" }) {
+        bool thrown = false;
+        try {
+            auto node = parser::parse(text);
+            try {
+                ArrayEvaluator(bindings).evaluate(node);
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            delete node;
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check(std::string("(error) ") + text, thrown);
+    }
+    // Single values are read from arrays of one element.
+    {
+        auto node = parser::parse("[2] * 3");
+        auto many = parser::parse("[2, 3] * 3");
+        bool thrown = false;
+        try {
+            Evaluator({}).evaluate(many);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check("(scalar)", (Evaluator({}).evaluate(node) == 6.) && thrown);
+        delete many;
+        delete node;
+    }
+    return check.failures;
+}
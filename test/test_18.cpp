@@ -0,0 +1,117 @@
+#include "expar/parser.hpp"
+#include "expar/program.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+static int calls = 0;
+
+/// @brief A function which is expensive to compute.
+static double slow(double x)
+{
+    ++calls;
+    double result = x;
+    for (int i = 0; i < 200; ++i)
+        result = std::sin(result) + x;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    FunctionRegistry registry = FunctionRegistry::standard();
+    registry.add("slow", slow);
+    registry.add<3>("slow3", [](double a, double b, double c) { return slow(a) + b * c; });
+    registry.add("noisy", [](double x) { return static_cast<double>(++calls) + x; }, false);
+    std::vector<std::string> variables = { "a", "b", "x" };
+    // In a sweep over x, the calls on a and b are skipped after the first
+    // evaluation, while the calls on x are suspended.
+    {
+        auto node = parser::parse("slow(a) * x + slow3(a, b, 2) - slow(x) + hypot(a, b)");
+        Program program(node, variables, registry);
+        Program::Memo memo(program);
+        bool same = true;
+        int plain = 0, cached = 0;
+        for (int i = 0; i < 10000; ++i) {
+            double values[] = { 0.5, -1.5, 0.001 * i };
+            calls           = 0;
+            double expected = program.evaluate(values);
+            plain += calls;
+            calls = 0;
+            same &= (program.evaluate(values, memo) == expected);
+            cached += calls;
+        }
+        check("(same results)", same);
+        check("(calls skipped)", cached < plain / 2);
+        check("(suspended)", (memo.get_suspended() == 1) && (memo.get_hits() > 0));
+        printf("calls %d plain, %d cached, %lu lookups, %lu hits\n", plain, cached, memo.get_lookups(), memo.get_hits());
+        delete node;
+    }
+    // Keys are the bits of the arguments, so that signed zeros and NaNs are
+    // told apart from the other values.
+    {
+        auto node = parser::parse("atan2(a, b) + slow(x)");
+        Program program(node, variables, registry);
+        Program::Memo memo(program, 2);
+        bool same = true;
+        std::vector<double> choices = { 0., -0., 1., std::nan(""), -1. };
+        std::mt19937 generator(7);
+        for (int i = 0; i < 1000; ++i) {
+            double values[] = { choices[generator() % 5], choices[generator() % 5], choices[generator() % 5] };
+            double a = program.evaluate(values), b = program.evaluate(values, memo);
+            same &= (std::memcmp(&a, &b, sizeof(double)) == 0) || (std::isnan(a) && std::isnan(b));
+        }
+        check("(bit patterns)", same);
+        delete node;
+    }
+    // Functions which are not pure are always called.
+    {
+        auto node = parser::parse("noisy(a)");
+        Program program(node, variables, registry);
+        Program::Memo memo(program);
+        double values[] = { 1., 2., 3. };
+        calls           = 0;
+        double first    = program.evaluate(values, memo);
+        double second   = program.evaluate(values, memo);
+        check("(impure)", (first != second) && (calls == 2) && (memo.get_lookups() == 0));
+        delete node;
+    }
+    // A memo is built for a program.
+    {
+        auto node = parser::parse("slow(a)");
+        Program first(node, variables, registry), second(node, variables, registry);
+        Program::Memo memo(first);
+        double values[] = { 1., 2., 3. };
+        bool thrown     = false;
+        try {
+            second.evaluate(values, memo);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check("(other program)", thrown);
+        delete node;
+    }
+    // Compare the timings of a sweep over one of the inputs.
+    {
+        auto node = parser::parse("slow(a) + slow(b) * x");
+        Program program(node, variables, registry);
+        Program::Memo memo(program);
+        auto time = [&](bool memoize) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < 100000; ++i) {
+                double values[] = { 0.25, 0.75, 0.001 * i };
+                memoize ? program.evaluate(values, memo) : program.evaluate(values);
+            }
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+        double plain  = time(false);
+        double cached = time(true);
+        printf("sweep %8.2f ms, memoized %8.2f ms\n", plain, cached);
+        delete node;
+    }
+    return check.failures;
+}
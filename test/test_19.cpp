@@ -0,0 +1,141 @@
+#include "expar/parser.hpp"
+#include "expar/scan.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+
+/// @brief Splits the text one character at a time.
+static std::vector<std::string> reference(const std::string &text)
+{
+    std::vector<std::string> result;
+    std::string current;
+    bool comment = false;
+    auto close   = [&]() {
+        while (!current.empty() && ((current.back() == ' ') || (current.back() == '\t') || (current.back() == '\r')))
+            current.pop_back();
+        if (current.find_first_not_of(" \t\r") != std::string::npos)
+            result.emplace_back(current);
+        current.clear();
+    };
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (comment) {
+            if (text[i] == '\n')
+                comment = false, close();
+        } else if ((text[i] == '/') && (i + 1 < text.size()) && (text[i + 1] == '/')) {
+            comment = true;
+        } else if ((text[i] == '\n') || (text[i] == ';')) {
+            close();
+        } else {
+            current.push_back(text[i]);
+        }
+    }
+    close();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::mt19937 generator(13);
+    // Every byte falls in its class.
+    {
+        std::string bytes(scan::block_size, ' ');
+        bool ok = true;
+        for (int first = 0; first < 256; first += scan::block_size) {
+            for (std::size_t k = 0; k < bytes.size(); ++k)
+                bytes[k] = static_cast<char>(first + static_cast<int>(k));
+            scan::Block block = scan::classify(bytes.data(), bytes.size());
+            for (std::size_t k = 0; k < bytes.size(); ++k) {
+                int c         = first + static_cast<int>(k);
+                bool space    = (c == ' ') || (c == '\t') || (c == '\r');
+                bool digit    = (c >= '0') && (c <= '9');
+                bool letter   = ((c | 0x20) >= 'a') && ((c | 0x20) <= 'z');
+                bool ident    = letter || (c == '_') || (c == '$') || (c == '@') || (c == '#');
+                bool printable = (c >= '!') && (c <= '~');
+                ok &= (((block.whitespace >> k) & 1) == space);
+                ok &= (((block.newlines >> k) & 1) == (c == '\n'));
+                ok &= (((block.digits >> k) & 1) == digit);
+                ok &= (((block.identifiers >> k) & 1) == ident);
+                ok &= (((block.operators >> k) & 1) == (printable && !digit && !ident));
+                ok &= (((block.semicolons >> k) & 1) == (c == ';'));
+                ok &= (((block.slashes >> k) & 1) == (c == '/'));
+            }
+        }
+        check("(classify)", ok);
+    }
+    // Texts of separators, comments and whitespace, across the blocks.
+    {
+        const std::string alphabet = "ab1+ \t\r\n;//";
+        bool ok                    = true;
+        for (int repeat = 0; repeat < 2000; ++repeat) {
+            std::string text(generator() % 300, ' ');
+            for (auto &c : text)
+                c = alphabet[generator() % alphabet.size()];
+            std::vector<std::string> found;
+            for (auto span : scan::split(text))
+                found.emplace_back(text.substr(span.begin, span.end - span.begin));
+            ok &= (found == reference(text));
+        }
+        check("(split)", ok);
+    }
+    // The expressions are parsed on their own, with positions in the text.
+    {
+        std::string text = "a = 1 + b\r\n\n// The second one.\nc = sin(a); d = (a + c) * 2 // Last.\n  \n[1, 2] * e";
+        std::vector<std::string> expected = { "a = 1 + b", "c = sin(a)", "d = (a + c) * 2", "[1, 2] * e" };
+        auto roots                        = parser::parse_all(text);
+        bool ok                           = (roots.size() == expected.size());
+        for (std::size_t i = 0; ok && (i < roots.size()); ++i)
+            ok &= (unparse(roots[i]) == expected[i]) &&
+                  (text.substr(roots[i]->begin, roots[i]->end - roots[i]->begin) == expected[i]);
+        check("(parse all)", ok);
+        for (auto root : roots)
+            delete root;
+    }
+    // Many threads give the same expressions.
+    std::string text;
+    for (int line = 0; line < 4000; ++line)
+        text += "v" + std::to_string(line) + " = sqrt(x * " + std::to_string(line) + ") + y / 3; // Line.\n";
+    {
+        auto one  = parser::parse_all(text, 1);
+        auto four = parser::parse_all(text, 4);
+        bool ok   = (one.size() == 4000) && (four.size() == one.size());
+        for (std::size_t i = 0; ok && (i < one.size()); ++i)
+            ok &= (unparse(one[i]) == unparse(four[i])) && (one[i]->begin == four[i]->begin);
+        check("(threads)", ok);
+        for (auto root : one)
+            delete root;
+        for (auto root : four)
+            delete root;
+    }
+    // Errors raised by a thread are reported.
+    {
+        std::string deep = "a = 1\n" + std::string(2000, '(') + "b" + std::string(2000, ')') + "\nc = 2\n";
+        bool thrown      = false;
+        try {
+            parser::parse_all(deep, 2);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        check("(errors)", thrown);
+    }
+    // Compare the timings of the split and of the parse.
+    {
+        std::string large;
+        while (large.size() < (64U << 20))
+            large += text;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto spans = scan::split(large);
+        double ms  = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        printf("split %8.2f ms, %8.1f MB/s, %lu expressions\n", ms, static_cast<double>(large.size()) / (ms * 1e3), spans.size());
+        start = std::chrono::high_resolution_clock::now();
+        auto roots = parser::parse_all(text, 4);
+        ms         = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        printf("parse %8.2f ms, %lu expressions with 4 threads\n", ms, roots.size());
+        for (auto root : roots)
+            delete root;
+    }
+    return check.failures;
+}
@@ -0,0 +1,71 @@
+#include "expar/parser.hpp"
+#include "expar/interval.hpp"
+#include <cstdio>
+#include <iostream>
+#include <cmath>
+
+using Ranges = std::map<std::string, expar::Interval>;
+
+int failures = 0;
+
+/// @brief Checks that the bounds enclose a grid of samples of the expression.
+void TestBounds(const std::string &text, const Ranges &ranges)
+{
+    auto node     = expar::parser::parse(text);
+    auto analysis = expar::analyze_range(node, ranges);
+    bool ok       = true;
+    // Sample the expression on a grid, using degenerate intervals.
+    std::vector<std::pair<std::string, expar::Interval>> vars(ranges.begin(), ranges.end());
+    std::size_t samples = 1;
+    for (std::size_t i = 0; i < vars.size(); ++i) samples *= 9;
+    for (std::size_t s = 0; s < samples; ++s) {
+        Ranges point;
+        std::size_t index = s;
+        for (const auto &var : vars) {
+            double t = static_cast<double>(index % 9) / 8.;
+            index /= 9;
+            point[var.first] = expar::Interval(var.second.lower + t * var.second.width());
+        }
+        double value = expar::IntervalEvaluator(point).evaluate(node).lower;
+        if (!analysis.bounds.contains(value))
+            ok = false;
+    }
+    printf("%-30s [%g, %g] %s\n", text.c_str(), analysis.bounds.lower, analysis.bounds.upper, ok ? "OK" : "FAILED");
+    failures += !ok;
+    delete node;
+}
+
+/// @brief Checks the monotonicity w.r.t. the given variable.
+void TestMonotonicity(const std::string &text, const Ranges &ranges, const std::string &var, expar::Monotonicity expected)
+{
+    auto node     = expar::parser::parse(text);
+    auto analysis = expar::analyze_range(node, ranges);
+    bool ok       = analysis.monotonicity[var] == expected;
+    printf("%-30s %-4s %-16s %s\n", text.c_str(), var.c_str(), expar::monotonicity_to_plain_string(analysis.monotonicity[var]).c_str(), ok ? "OK" : "FAILED");
+    failures += !ok;
+    delete node;
+}
+
+int main(int argc, char *argv[])
+{
+    Ranges ranges = {
+        { "x", expar::Interval(0.5, 3.) },
+        { "y", expar::Interval(-1., 2.) },
+        { "w", expar::Interval(1e-6, 1e-5) },
+    };
+    TestBounds("x + y", ranges);
+    TestBounds("(x * y) - (y * y)", ranges);
+    TestBounds("x / (y + 2)", ranges);
+    TestBounds("sqrt(x) * exp(y)", ranges);
+    TestBounds("sin(x * 3) + cos(y)", ranges);
+    TestBounds("pow(x, y) - log(x)", ranges);
+    TestBounds("max(x, y) - min(x, y)", ranges);
+    TestBounds("w / (x * 1e-6)", ranges);
+    TestMonotonicity("x + y", ranges, "x", expar::mono_increasing);
+    TestMonotonicity("x - exp(y)", ranges, "y", expar::mono_decreasing);
+    TestMonotonicity("x * 2", ranges, "y", expar::mono_constant);
+    TestMonotonicity("y * y", ranges, "y", expar::mono_unknown);
+    TestMonotonicity("sqrt(w) / x", ranges, "w", expar::mono_increasing);
+    TestMonotonicity("sqrt(w) / x", ranges, "x", expar::mono_decreasing);
+    return failures;
+}
@@ -0,0 +1,115 @@
+#include "expar/parser.hpp"
+#include "expar/engine.hpp"
+#include "expar/evaluator.hpp"
+#include "check.hpp"
+#include <filesystem>
+#include <iostream>
+#include <cmath>
+
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::vector<std::string> texts = {
+        "x + (y * 2)",
+        "sqrt(x) * exp(-y) + (x > y ? 1 : 2)",
+        "pow(x, 3) - (y / x)",
+    };
+    std::vector<AstNode *> expressions;
+    for (const auto &text : texts)
+        expressions.emplace_back(parser::parse(text));
+    std::vector<std::string> variables = { "x", "y" };
+    // The value of each expression, walking the tree.
+    auto expected = [&](std::size_t i, const double *values) {
+        std::map<std::string, double> bindings = { { "x", values[0] }, { "y", values[1] } };
+        return Evaluator(bindings).evaluate(expressions[i]);
+    };
+    // A cache of this run only, which does not depend on the working directory.
+    std::filesystem::path cache = std::filesystem::temp_directory_path() / ("expar-cache-" + std::to_string(getpid()));
+    EngineOptions options;
+    options.native_options.cache_dir = cache.string();
+    options.bytecode_threshold       = 4;
+    options.native_threshold         = 16;
+    // Promotions carried out on the spot: expressions go through each tier
+    // as their evaluations reach the thresholds.
+    {
+        options.background = false;
+        Engine engine(variables, options);
+        for (auto expression : expressions)
+            engine.add(expression);
+        bool same = true, tiers = true;
+        for (int n = 1; n <= 32; ++n) {
+            for (std::size_t i = 0; i < expressions.size(); ++i) {
+                // Only the first expression is hot.
+                if ((i > 0) && (n > 8))
+                    continue;
+                double values[] = { 0.25 * n, 1. - 0.1 * n };
+                double value    = engine.evaluate(i, values);
+                same &= std::abs(value - expected(i, values)) <= 1e-12 * (1. + std::abs(value));
+                Tier tier = (n >= 16) ? tier_native : (n >= 4) ? tier_bytecode : tier_tree;
+                tiers &= (engine.get_tier(i) == tier);
+            }
+        }
+        check("(same results)", same);
+        check("(tiers)", tiers);
+        check("(hot)", (engine.get_tier(0) == tier_native) && (engine.get_tier(1) == tier_bytecode));
+        check("(counted)", (engine.get_evaluations(0) == 16) && (engine.get_evaluations(2) == 8));
+    }
+    // Promotions carried out in the background, while the evaluations go on.
+    {
+        options.background = true;
+        Engine engine(variables, options);
+        for (auto expression : expressions)
+            engine.add(expression);
+        bool same = true;
+        for (int n = 1; n <= 1000; ++n) {
+            for (std::size_t i = 0; i < expressions.size(); ++i) {
+                double values[] = { 0.01 * n, 0.5 };
+                double value    = engine.evaluate(i, values);
+                same &= std::abs(value - expected(i, values)) <= 1e-12 * (1. + std::abs(value));
+            }
+        }
+        engine.wait();
+        bool native = true;
+        for (std::size_t i = 0; i < expressions.size(); ++i)
+            native &= (engine.get_tier(i) == tier_native);
+        check("(background, same results)", same);
+        check("(background, native)", native);
+    }
+    // Zero thresholds promote the expressions when they are added.
+    {
+        options.background         = true;
+        options.bytecode_threshold = 0;
+        options.native_threshold   = 0;
+        Engine engine(variables, options);
+        engine.add(expressions[2]);
+        engine.wait();
+        double values[] = { 2., 1. };
+        check("(eager)", (engine.get_tier(0) == tier_native) && (engine.evaluate(0, values) == 7.5));
+    }
+    // User functions have no native code, so their expressions stop at the
+    // bytecode.
+    {
+        FunctionRegistry registry = FunctionRegistry::standard();
+        registry.add("twice", [](double x) { return 2. * x; });
+        auto node                  = parser::parse("twice(x) + y");
+        options.background         = false;
+        options.bytecode_threshold = 2;
+        options.native_threshold   = 4;
+        Engine engine(variables, options, registry);
+        engine.add(node);
+        bool same = true;
+        for (int n = 0; n < 10; ++n) {
+            double values[] = { 1. * n, 3. };
+            same &= (engine.evaluate(0, values) == 2. * n + 3.);
+        }
+        check("(user functions)", same && (engine.get_tier(0) == tier_bytecode));
+        delete node;
+    }
+    for (auto expression : expressions)
+        delete expression;
+    std::filesystem::remove_all(cache);
+    return check.failures;
+}
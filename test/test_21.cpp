@@ -0,0 +1,134 @@
+#include "expar/parser.hpp"
+#include "expar/server.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// @brief The header of the requests, as sent by a Client.
+struct Header {
+    std::uint32_t type, status;
+    std::uint64_t id, count, offset, size;
+};
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::string path = "/tmp/expar-test-" + std::to_string(::getpid()) + ".sock";
+    Server server(path);
+    std::thread runner(&Server::run, &server);
+    std::vector<std::string> variables = { "x", "y" };
+    auto node = parser::parse("sqrt(x) * exp(-y) + (x > y ? 1 : 2)");
+    Program program(node, variables);
+    // A batch goes through the shared memory and gives the same results of
+    // the program in this process.
+    {
+        Client client(path);
+        std::size_t id = client.compile("sqrt(x) * exp(-y) + (x > y ? 1 : 2)", variables);
+        std::vector<double> x(1000), y(1000), out(1000), expected(1000);
+        for (std::size_t i = 0; i < x.size(); ++i)
+            x[i] = 0.01 * i, y[i] = 5. - 0.01 * i;
+        const double *values[] = { x.data(), y.data() };
+        client.evaluate(id, x.size(), values, out.data());
+        program.evaluate(x.size(), values, expected.data());
+        check("(batch)", out == expected);
+        double point[] = { 2., 1. };
+        check("(single point)", client.evaluate(id, point) == program.evaluate(point));
+    }
+    // Expressions are compiled once for all the clients.
+    {
+        Client a(path), b(path);
+        std::size_t first  = a.compile("x * y + 1", variables);
+        std::size_t second = b.compile("x * y + 1", variables);
+        std::size_t third  = b.compile("x * y + 1", { "y", "x" });
+        check("(shared)", (first == second) && (first != third) && (server.size() == 3));
+    }
+    // Many batches queued at once wrap around the ring buffer, and are
+    // received in order.
+    {
+        Client client(path, 8192);
+        std::size_t id = client.compile("x - 2 * y", variables);
+        std::vector<std::vector<double>> outs(50, std::vector<double>(100));
+        std::vector<double> x(100), y(100);
+        for (std::size_t i = 0; i < x.size(); ++i)
+            x[i] = i, y[i] = 0.5 * i;
+        bool same = true;
+        for (std::size_t k = 0; k < outs.size(); ++k) {
+            std::vector<double> shifted(x);
+            for (auto &value : shifted)
+                value += k;
+            const double *values[] = { shifted.data(), y.data() };
+            client.submit(id, x.size(), values, outs[k].data());
+        }
+        client.flush();
+        for (std::size_t k = 0; k < outs.size(); ++k)
+            for (std::size_t i = 0; i < x.size(); ++i)
+                same &= (outs[k][i] == x[i] + k - 2 * y[i]);
+        check("(ring buffer)", same);
+    }
+    // Errors are reported to the client, which can go on.
+    {
+        Client client(path, 1024);
+        bool caught = false;
+        try {
+            client.compile("x + z", variables);
+        } catch (const std::exception &) {
+            caught = true;
+        }
+        check("(unknown variable)", caught);
+        caught = false;
+        std::size_t id = client.compile("x + y", variables);
+        std::vector<double> x(1000);
+        const double *values[] = { x.data(), x.data() };
+        try {
+            client.evaluate(id, x.size(), values, x.data());
+        } catch (const std::exception &) {
+            caught = true;
+        }
+        double point[] = { 2., 3. };
+        check("(batch too large)", caught && (client.evaluate(id, point) == 5.));
+    }
+    // A client claiming more shared memory than it has gets an error, and
+    // the server goes on.
+    {
+        std::string name = "/expar-test-" + std::to_string(::getpid());
+        int memory       = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        bool created     = (memory >= 0) && (::ftruncate(memory, 4096) == 0);
+        int fd           = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        Header request{ 0, 0, 0, std::uint64_t(1) << 30, 0, name.size() }, reply{};
+        bool refused = created && (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) &&
+                       (::send(fd, &request, sizeof(request), 0) == sizeof(request)) &&
+                       (::send(fd, name.data(), name.size(), 0) == static_cast<ssize_t>(name.size())) &&
+                       (::recv(fd, &reply, sizeof(reply), MSG_WAITALL) == sizeof(reply)) && (reply.status != 0);
+        ::close(fd);
+        if (memory >= 0)
+            ::close(memory), ::shm_unlink(name.c_str());
+        Client client(path);
+        double point[] = { 2., 3. };
+        check("(shared memory too small)", refused && (client.evaluate(client.compile("x + y", variables), point) == 5.));
+    }
+    // Clients come and go.
+    {
+        bool served = true;
+        for (int k = 0; k < 20; ++k) {
+            Client client(path, 4096);
+            double point[] = { 1. * k, 1. };
+            served &= (client.evaluate(client.compile("x * y", variables), point) == k);
+        }
+        check("(many clients)", served);
+    }
+    server.stop();
+    runner.join();
+    delete node;
+    return check.failures;
+}
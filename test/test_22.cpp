@@ -0,0 +1,93 @@
+#include "expar/parser.hpp"
+#include "expar/program.hpp"
+#include "expar/specialize.hpp"
+#include "expar/stats.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+#include <stdexcept>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    // The residual text of each expression, with w and l known.
+    std::map<std::string, double> bindings = { { "w", 2. }, { "l", 0.5 }, { "zero", 0. } };
+    std::vector<std::pair<std::string, std::string>> cases = {
+        { "w * l", "1" },
+        { "x * (w / l) + sqrt(w * 2)", "x * 4 + 2" },
+        { "x * (w - 1) + y / (l * 2)", "x + y" },
+        { "(w > 1) ? x : y", "x" },
+        { "if(l > 1, x, y) + w", "y + 2" },
+        { "pow(x, w - 1) - zero", "x" },
+        { "max(w, l) * x", "2 * x" },
+        { "(x > 1) && zero", "0" },
+        { "(x > 1) || (w > 1)", "1" },
+        { "-w + x", "-2 + x" },
+        { "rand() * w", "rand() * 2" },
+        { "w = x * l", "w = x * 0.5" },
+        { "[w, x, l]", "[2, x, 0.5]" },
+        { "x - (-zero)", "x - -0" },
+    };
+    for (const auto &test : cases) {
+        auto node     = parser::parse(test.first);
+        auto residual = specialize(node, bindings);
+        std::string text = unparse(residual);
+        bool ok          = (text == test.second) && (unparse(node) != text);
+        printf("%-30s -> %-20s", test.first.c_str(), text.c_str());
+        check("", ok);
+        delete residual;
+        delete node;
+    }
+    // The residual expression, evaluated on the varying variables, gives
+    // the same values as the whole expression.
+    {
+        auto node = parser::parse("x * exp(-w / l) + (w > 1 ? sin(x * l) : cos(y)) * y + pwl(w, 0, 0, 4, 8) - y / w");
+        auto residual = specialize(node, bindings);
+        Program whole(node, { "x", "y", "w", "l" });
+        Program specialized(residual, { "x", "y" });
+        bool same = true;
+        for (int i = 0; i < 100; ++i) {
+            double all[]  = { 0.1 * i, 1. - 0.05 * i, 2., 0.5 };
+            double a = whole.evaluate(all), b = specialized.evaluate(all);
+            same &= std::abs(a - b) <= 1e-12 * (1. + std::abs(a));
+        }
+        printf("%s\n", unparse(residual).c_str());
+        check("(same values)", same);
+        delete residual;
+        delete node;
+    }
+    // User functions are folded only when they are pure.
+    {
+        FunctionRegistry registry = FunctionRegistry::standard();
+        registry.add("twice", [](double x) { return 2. * x; });
+        registry.add("noisy", [](double x) { return x; }, false);
+        auto node     = parser::parse("twice(w) + noisy(w)");
+        auto residual = specialize(node, bindings, registry);
+        check("(pure user functions)", unparse(residual) == "4 + noisy(2)");
+        delete residual;
+        delete node;
+    }
+    // A fold which fails leaves the expression untouched, and folding is not
+    // counted among the evaluations.
+    {
+        auto broken = parser::parse("x + pwl(w, 2, 3, 4)");
+        auto node   = parser::parse("x * sqrt(w * 8)");
+        bool thrown = false;
+        try {
+            delete specialize(broken, bindings);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        stats::enable();
+        auto residual = specialize(node, bindings);
+        stats::enable(false);
+        check("(failed fold)", thrown && (unparse(broken) == "x + pwl(w, 2, 3, 4)"));
+        check("(no evaluations)", (unparse(residual) == "x * 4") && (stats::snapshot().evaluations == 0));
+        delete residual;
+        delete broken;
+        delete node;
+    }
+    return check.failures;
+}
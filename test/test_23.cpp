@@ -0,0 +1,134 @@
+#include "expar/parser.hpp"
+#include "expar/derivative.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/solver.hpp"
+#include "expar/unparse.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    // Derivatives match central differences.
+    std::vector<std::string> texts = {
+        "x * x * y + 3 * x",
+        "sin(x) * exp(-x / y) + sqrt(x)",
+        "pow(x, 3) - pow(2, x) + x ^ y",
+        "log(x) / (1 + tanh(x))",
+        "atan2(x, y) + hypot(x, y) + max(x, 2 * y)",
+        "(x > 1 ? cos(x) : acos(x / 4)) - abs(-x) + fmod(x, 0.3)",
+        "cbrt(x) + log10(x) * asin(x / 10) + atan(x) * cosh(x) - sinh(-x)",
+    };
+    for (const auto &text : texts) {
+        auto node = parser::parse(text);
+        auto dx   = differentiate(node, "x");
+        bool ok   = true;
+        for (double x : { 0.7, 1.3, 2.9 }) {
+            double h = 1e-6, y = 1.7;
+            std::map<std::string, double> at = { { "x", x }, { "y", y } }, plus = { { "x", x + h }, { "y", y } },
+                                          minus = { { "x", x - h }, { "y", y } };
+            double numeric = (Evaluator(plus).evaluate(node) - Evaluator(minus).evaluate(node)) / (2 * h);
+            double exact   = Evaluator(at).evaluate(dx);
+            ok &= std::abs(numeric - exact) <= 1e-6 * (1. + std::abs(exact));
+        }
+        printf("%-40s -> %s\n", text.c_str(), unparse(dx).c_str());
+        check("(derivative of " + text + ")", ok);
+        delete dx;
+        delete node;
+    }
+    {
+        auto node = parser::parse("2 * y + 1");
+        auto dx   = differentiate(node, "x");
+        check("(constant)", unparse(dx) == "0");
+        delete dx;
+        delete node;
+        node        = parser::parse("pwl(x, 0, 0, 1, 1)");
+        bool caught = false;
+        try {
+            differentiate(node, "x");
+        } catch (const std::exception &) {
+            caught = true;
+        }
+        check("(not differentiable)", caught && !is_differentiable(node));
+        delete node;
+    }
+    // Many targets at once: the W giving each current.
+    {
+        auto node = parser::parse("k * (W / L) * (vgs - vt) ^ 2");
+        Solver solver(node, "W", { "k", "L", "vgs", "vt" });
+        std::size_t count = 10000;
+        std::vector<double> targets(count), roots(count, 1e-6), k(count, 2e-5), l(count, 1e-6), vgs(count), vt(count, 0.4);
+        for (std::size_t i = 0; i < count; ++i) {
+            targets[i] = 1e-6 * (1 + i % 100);
+            vgs[i]     = 0.8 + 0.001 * (i % 500);
+        }
+        const double *values[] = { k.data(), l.data(), vgs.data(), vt.data() };
+        std::vector<SolverStatus> status(count);
+        auto start = std::chrono::steady_clock::now();
+        SolverStats stats = solver.solve(count, targets.data(), roots.data(), values, SolverOptions(), status.data());
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool ok      = solver.has_derivative() && (stats.converged == count);
+        for (std::size_t i = 0; i < count; ++i) {
+            double expected = targets[i] * l[i] / (k[i] * std::pow(vgs[i] - vt[i], 2));
+            ok &= (status[i] == solve_converged) && (std::abs(roots[i] - expected) <= 1e-9 * expected);
+        }
+        printf("%lu points, %lu iterations, %lu newton steps, %lu evaluations, %.2f ms\n", count, stats.iterations,
+               stats.newton_steps, stats.evaluations, elapsed);
+        check("(linear in W)", ok);
+        delete node;
+    }
+    // Newton diverges from far away on atan: the bracket, given or found
+    // when a step goes over the root, keeps it going.
+    {
+        auto node = parser::parse("atan(x - c)");
+        Solver solver(node, "x", { "c" });
+        std::vector<double> targets = { 0., 0.5, -0.5 }, c = { 1., 2., 3. };
+        const double *values[]      = { c.data() };
+        SolverOptions options;
+        options.lower = -20.;
+        options.upper = 20.;
+        for (const auto &bounds : { SolverOptions(), options }) {
+            std::vector<double> roots = { 10., 10., -10. };
+            SolverStats stats         = solver.solve(3, targets.data(), roots.data(), values, bounds);
+            bool ok                   = (stats.converged == 3) && (stats.bisections > 0);
+            for (std::size_t i = 0; i < 3; ++i)
+                ok &= std::abs(roots[i] - (c[i] + std::tan(targets[i]))) <= 1e-10;
+            check(std::isnan(bounds.lower) ? "(bracket found)" : "(bracket given)", ok);
+        }
+        delete node;
+    }
+    // A zero derivative breaks Newton's method, unless there is a bracket.
+    {
+        auto node = parser::parse("x ^ 2");
+        Solver solver(node, "x");
+        std::vector<double> targets = { 4. }, roots = { 0. };
+        std::vector<SolverStatus> status(1);
+        SolverStats stats = solver.solve(1, targets.data(), roots.data(), nullptr, SolverOptions(), status.data());
+        check("(zero derivative)", (stats.failed == 1) && (status[0] == solve_failed));
+        SolverOptions options;
+        options.lower = 0.;
+        options.upper = 5.;
+        roots         = { 0. };
+        stats         = solver.solve(1, targets.data(), roots.data(), nullptr, options, status.data());
+        check("(zero derivative, bracketed)", (status[0] == solve_converged) && (std::abs(roots[0] - 2.) < 1e-12));
+        delete node;
+    }
+    // Functions without a derivative use finite differences.
+    {
+        FunctionRegistry registry = FunctionRegistry::standard();
+        registry.add("cube", [](double x) { return x * x * x; });
+        auto node = parser::parse("cube(x) + x");
+        Solver solver(node, "x", {}, registry);
+        std::vector<double> targets = { 2., 10., 30. }, roots = { 1., 1., 1. };
+        SolverStats stats           = solver.solve(3, targets.data(), roots.data());
+        bool ok                     = !solver.has_derivative() && (stats.converged == 3);
+        for (std::size_t i = 0; i < 3; ++i)
+            ok &= std::abs(roots[i] * roots[i] * roots[i] + roots[i] - targets[i]) <= 1e-9;
+        check("(finite differences)", ok);
+        delete node;
+    }
+    return check.failures;
+}
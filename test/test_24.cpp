@@ -0,0 +1,134 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/program.hpp"
+#include "expar/specialize.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+/// @brief Returns the mean and the standard deviation of the values.
+static std::pair<double, double> moments(const std::vector<double> &values)
+{
+    double mean = 0., square = 0.;
+    for (double value : values)
+        mean += value;
+    mean /= static_cast<double>(values.size());
+    for (double value : values)
+        square += (value - mean) * (value - mean);
+    return { mean, std::sqrt(square / static_cast<double>(values.size() - 1)) };
+}
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::vector<std::string> variables = { "w" };
+    // Outside of Monte Carlo runs, the values are the nominal ones.
+    {
+        auto node = parser::parse("gauss(w, 0.1, 3) + agauss(1, 0.5, 3) * unif(2, 0.1) - aunif(w, 1)");
+        Program program(node, variables);
+        double values[] = { 4. };
+        std::map<std::string, double> bindings = { { "w", 4. } };
+        check("(nominal)", (program.evaluate(values) == 2.) && (Evaluator(bindings).evaluate(node) == 2.));
+        delete node;
+    }
+    // Batches, single points and chunks spread over threads give the same
+    // values for each sample.
+    {
+        auto node = parser::parse("gauss(w, 0.1, 3) * (1 + agauss(0, 0.01, 1)) + unif(w, 0.2) - aunif(0, 1) * w");
+        Program program(node, variables);
+        std::size_t count = 10000;
+        std::vector<double> w(count, 2.), batch(count), single(count), threaded(count);
+        const double *values[] = { w.data() };
+        random::Sample first{ 42, 1000 };
+        program.evaluate(count, values, batch.data(), first);
+        for (std::size_t i = 0; i < count; ++i)
+            single[i] = program.evaluate(values[0] + i, random::Sample{ 42, 1000 + i });
+        std::vector<std::thread> threads;
+        for (std::size_t begin = 0; begin < count; begin += 777) {
+            threads.emplace_back([&, begin]() {
+                std::size_t n          = std::min<std::size_t>(777, count - begin);
+                const double *chunk[] = { w.data() + begin };
+                program.evaluate(n, chunk, threaded.data() + begin, random::Sample{ 42, 1000 + begin });
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        bool same = (std::memcmp(batch.data(), single.data(), count * sizeof(double)) == 0) &&
+                    (std::memcmp(batch.data(), threaded.data(), count * sizeof(double)) == 0);
+        check("(reproducible)", same);
+        std::vector<double> other(count);
+        program.evaluate(count, values, other.data(), random::Sample{ 43, 1000 });
+        check("(seeds)", other != batch);
+        delete node;
+    }
+    // The distributions.
+    {
+        std::size_t count = 200000;
+        std::vector<double> w(count, 10.), out(count);
+        const double *values[] = { w.data() };
+        struct Case {
+            const char *text;
+            double mean, deviation;
+        };
+        for (const auto &test : std::vector<Case>{
+                 { "agauss(0, 1, 1)", 0., 1. },
+                 { "gauss(w, 0.1, 3)", 10., 1. / 3. },
+                 { "agauss(w, 3, 3)", 10., 1. },
+                 { "aunif(0, 1)", 0., 1. / std::sqrt(3.) },
+                 { "unif(w, 0.5)", 10., 5. / std::sqrt(3.) },
+                 { "agauss(0, 1, 1) - agauss(0, 1, 1)", 0., std::sqrt(2.) },
+             }) {
+            auto node = parser::parse(test.text);
+            Program program(node, variables);
+            auto start = std::chrono::steady_clock::now();
+            program.evaluate(count, values, out.data(), random::Sample{ 7, 0 });
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            auto [mean, deviation] = moments(out);
+            bool ok = (std::abs(mean - test.mean) < 0.02 * (test.deviation + std::abs(test.mean) * 0.1)) &&
+                      (std::abs(deviation - test.deviation) < 0.01 * test.deviation);
+            printf("%-35s mean %-10.5f deviation %-10.5f %.2f ms\n", test.text, mean, deviation, elapsed);
+            check(std::string("(") + test.text + ")", ok);
+            delete node;
+        }
+    }
+    // Call sites are numbered in reading order, also in branches left out.
+    {
+        auto a = parser::parse("0 ? agauss(0, 1, 1) : agauss(0, 1, 1)");
+        auto b = parser::parse("(w > 100) ? agauss(0, 1, 1) : agauss(0, 1, 1)");
+        auto c = parser::parse("agauss(0, 1, 1)");
+        Program pa(a, variables), pb(b, variables), pc(c, variables);
+        bool same = true, different = true;
+        for (std::uint64_t i = 0; i < 100; ++i) {
+            double values[] = { 1. };
+            random::Sample sample{ 1, i };
+            same &= (pa.evaluate(values, sample) == pb.evaluate(values, sample));
+            different &= (pa.evaluate(values, sample) != pc.evaluate(values, sample));
+        }
+        check("(call sites)", same && different);
+        delete a;
+        delete b;
+        delete c;
+    }
+    // Specializing keeps the random calls, so the residual expression draws
+    // the same deviations of the original one.
+    {
+        auto node = parser::parse("(k > 1 ? gauss(a, 0.1, 3) : unif(a, 0.2)) + "
+                                  "(k < 0 && gauss(x, 0.1, 3) > 0) + (k > 0 || aunif(x, 1) > 0) + agauss(x, 0.5, 3)");
+        auto residual = specialize(node, { { "k", 2. }, { "a", 1. } });
+        Program original(node, { "x", "k", "a" }), specialized(residual, { "x" });
+        bool same = true;
+        for (std::uint64_t i = 0; i < 100; ++i) {
+            double all[] = { 0.5, 2., 1. }, values[] = { 0.5 };
+            random::Sample sample{ 3, i };
+            same &= (original.evaluate(all, sample) == specialized.evaluate(values, sample));
+        }
+        check("(specialized draws)", same);
+        delete node;
+        delete residual;
+    }
+    return check.failures;
+}
@@ -0,0 +1,93 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/profile.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <sstream>
+#include <cmath>
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::string cheap = "x + 1 - y";
+    std::string heavy = "y * exp(sin(x) + cos(x))";
+    AstNode *first    = parser::parse(cheap);
+    AstNode *second   = parser::parse(heavy);
+    Profile profile;
+    profile.add(first, "cheap", cheap);
+    profile.add(second, "heavy", heavy);
+    std::map<std::string, double> bindings = { { "x", 0. }, { "y", 2. } };
+    bool same = true;
+    for (int n = 0; n < 100; ++n) {
+        bindings["x"] = 0.01 * n;
+        same &= (Evaluator(bindings, FunctionRegistry::standard(), &profile).evaluate(first) == Evaluator(bindings).evaluate(first));
+        same &= (Evaluator(bindings, FunctionRegistry::standard(), &profile).evaluate(second) == Evaluator(bindings).evaluate(second));
+    }
+    check("(same results)", same);
+    // Every node is measured at each evaluation.
+    auto spots = profile.hot_spots();
+    bool calls = (spots.size() == 5 + 8);
+    for (const auto &spot : spots)
+        calls &= (spot.calls == 100);
+    check("(all nodes)", calls);
+    // The time of a node covers the one of its children.
+    auto expressions = profile.expressions();
+    std::uint64_t self = 0;
+    for (const auto &spot : spots)
+        self += spot.self_ns;
+    check("(expressions)", (expressions.size() == 2) &&
+                               (expressions[0].total_ns + expressions[1].total_ns == self));
+    bool covered = true;
+    for (const auto &spot : spots)
+        covered &= (spot.self_ns <= spot.total_ns);
+    check("(self within total)", covered);
+    // Nodes are found by their path, with the text they were parsed from.
+    bool found = false;
+    for (const auto &spot : spots) {
+        if (spot.path == "*/1:exp()/0:+/0:sin()")
+            found = (spot.expression == "heavy") && (spot.text == "sin(x)");
+    }
+    check("(path)", found);
+    // The report lists both sections.
+    std::stringstream report;
+    profile.report(report, 3);
+    std::string text = report.str();
+    check("(report)", (text.find("heavy") != std::string::npos) && (text.find("Nodes, by self time:") != std::string::npos));
+    // Folded stacks start from the name of the expression.
+    std::stringstream folded;
+    profile.folded(folded);
+    bool stacks = true;
+    std::string line;
+    std::size_t lines = 0;
+    while (std::getline(folded, line)) {
+        stacks &= (line.rfind("cheap;", 0) == 0) || (line.rfind("heavy;", 0) == 0);
+        stacks &= (line.find(' ') == line.rfind(' '));
+        ++lines;
+    }
+    check("(folded)", stacks && (lines > 0) && (folded.str().find("heavy;*;exp();+;sin();x ") != std::string::npos));
+    // Expressions which were not added are not reported, even once deleted,
+    // and failed evaluations leave the profile usable.
+    {
+        AstNode *other = parser::parse("x * x");
+        AstNode *wrong = parser::parse("x + z");
+        Evaluator(bindings, FunctionRegistry::standard(), &profile).evaluate(other);
+        delete other;
+        bool thrown = false;
+        try {
+            Evaluator(bindings, FunctionRegistry::standard(), &profile).evaluate(wrong);
+        } catch (const std::exception &) {
+            thrown = true;
+        }
+        delete wrong;
+        std::stringstream again;
+        profile.report(again);
+        profile.folded(again);
+        check("(other expressions)", thrown && (profile.hot_spots().size() == spots.size()));
+    }
+    profile.clear();
+    check("(clear)", profile.hot_spots().empty());
+    delete first;
+    delete second;
+    return check.failures;
+}
@@ -0,0 +1,92 @@
+#include "expar/parser.hpp"
+#include "expar/kernel.hpp"
+#include "expar/program.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <cmath>
+
+static int calls = 0;
+
+static double tick(double x)
+{
+    ++calls;
+    return x;
+}
+
+int main(int argc, char *argv[])
+{
+    Checks check;
+    using namespace expar;
+    std::vector<std::string> texts = {
+        "sin(x) * y + 1",
+        "y * sin(x) - 2",
+        "sin(x) + (x > y ? x * y : y * x)",
+        "pow(x, 3) + pwl(x, 0, 0, 1, 2, 2, 3)",
+        "pwl(y, 0, 0, 1, 2, 2, 3) + x ^ 3",
+        "hypot(x, y) + max(x, y) * sqrt(2)",
+        "3 + 4",
+        "x",
+        "gauss(x, 0.1, 3) + (1 > 0 ? y : x)",
+        "(x > 0) && (y > 1) || (x < -1)",
+        "(y << 2) % 3 + x / y",
+    };
+    std::vector<AstNode *> expressions;
+    for (const auto &text : texts)
+        expressions.emplace_back(parser::parse(text));
+    std::vector<std::string> variables = { "x", "y" };
+    Kernel kernel(expressions, variables);
+    check("(outputs)", kernel.get_outputs() == texts.size());
+    // Each variable is loaded once, and sin(x) is computed once.
+    std::size_t loads = 0, unary = 0;
+    for (const auto &step : kernel.get_steps()) {
+        loads += (step.code == Program::p_load);
+        unary += (step.code == Program::p_call1);
+    }
+    check("(loads)", loads == 2);
+    check("(shared sin)", unary == 1);
+    check("(registers reused)", kernel.get_registers() < kernel.get_steps().size());
+    // Same results of the programs of each expression, on single points
+    // and on batches.
+    std::vector<Program> programs;
+    for (auto expression : expressions)
+        programs.emplace_back(expression, variables);
+    const std::size_t count = 1000;
+    std::vector<double> xs(count), ys(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        xs[i] = -2. + 4. * i / count;
+        ys[i] = 0.5 + std::cos(0.01 * i);
+    }
+    const double *inputs[] = { xs.data(), ys.data() };
+    std::vector<double> out(count * texts.size());
+    kernel.evaluate(count, inputs, out.data());
+    bool point = true, batch = true;
+    std::vector<double> results(texts.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        double values[] = { xs[i], ys[i] };
+        kernel.evaluate(values, results.data());
+        for (std::size_t e = 0; e < texts.size(); ++e) {
+            double expected = programs[e].evaluate(values);
+            point &= (results[e] == expected);
+            batch &= (out[e * count + i] == expected);
+        }
+    }
+    check("(single points)", point);
+    check("(batches)", batch);
+    // Calls of impure functions are not shared.
+    {
+        FunctionRegistry registry = FunctionRegistry::standard();
+        registry.add("tick", tick, false);
+        AstNode *first  = parser::parse("tick(x) + 1");
+        AstNode *second = parser::parse("tick(x) * 2");
+        Kernel impure({ first, second }, variables, registry);
+        double values[] = { 3., 0. };
+        double pair[2];
+        impure.evaluate(values, pair);
+        check("(impure)", (calls == 2) && (pair[0] == 4.) && (pair[1] == 6.));
+        delete first;
+        delete second;
+    }
+    for (auto expression : expressions)
+        delete expression;
+    return check.failures;
+}
@@ -0,0 +1,53 @@
+#include "expar/parser.hpp"
+#include "expar/complex.hpp"
+#include <cstdio>
+#include <iostream>
+#include <cmath>
+
+int failures = 0;
+
+/// @brief Checks the tree walk, the scalar and the batch (split and
+///        interleaved) evaluation against the expected value.
+void Test(const std::string &text, expar::Complex s, expar::Complex expected)
+{
+    auto node = expar::parser::parse(text);
+    std::map<std::string, expar::Complex> bindings = { { "s", s } };
+    expar::ComplexProgram program(node, { "s" });
+    // Evaluate a batch, the point of interest is the last one.
+    const std::size_t count = 1000;
+    std::vector<double> re(count, 0.), im(count, 0.), out_re(count), out_im(count);
+    std::vector<expar::Complex> values(count), out(count);
+    re.back() = s.real(), im.back() = s.imag(), values.back() = s;
+    const double *inputs_re[] = { re.data() };
+    const double *inputs_im[] = { im.data() };
+    const expar::Complex *inputs[] = { values.data() };
+    program.evaluate(count, inputs_re, inputs_im, out_re.data(), out_im.data());
+    program.evaluate(count, inputs, out.data());
+    expar::Complex results[] = {
+        expar::ComplexEvaluator(bindings).evaluate(node),
+        program.evaluate(&s),
+        expar::Complex(out_re.back(), out_im.back()),
+        out.back()
+    };
+    bool ok = true;
+    for (auto result : results)
+        ok &= std::abs(result - expected) <= 1e-12 * (1. + std::abs(expected));
+    printf("%-30s (%g, %g) %s\n", text.c_str(), results[0].real(), results[0].imag(), ok ? "OK" : "FAILED");
+    failures += !ok;
+    delete node;
+}
+
+int main(int argc, char *argv[])
+{
+    expar::Complex j(0., 1.);
+    expar::Complex s = 2. * M_PI * 1e3 * j;
+    Test("1 + 2.5i", s, expar::Complex(1., 2.5));
+    Test("s * 2i", s, s * 2. * j);
+    Test("1 / (1 + (s * 1e-3))", s, 1. / (1. + s * 1e-3));
+    Test("(s ^ 2) + (s * 3) + 2", s, s * s + s * 3. + 2.);
+    Test("abs(1 / (1 + (s / 6283.185307179586)))", s, std::abs(1. / (1. + s / 6283.185307179586)));
+    Test("exp(s * 1e-4) - conj(s)", s, std::exp(s * 1e-4) - std::conj(s));
+    Test("sqrt(-1)", s, j);
+    Test("imag(s) - real(s)", s, expar::Complex(s.imag(), 0.));
+    return failures;
+}
@@ -0,0 +1,138 @@
+#include "expar/parser.hpp"
+#include "expar/codegen.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/program.hpp"
+#include <atomic>
+#include <climits>
+#include <filesystem>
+#include <cstdio>
+#include <iostream>
+#include <cmath>
+#include <thread>
+
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> texts = {
+        "x + (y * 2)",
+        "sqrt(x) * exp(-y)",
+        "pow(x, 3) - (y / x)",
+        "(x > y) + (x <= 1)",
+        "max(x, y) - 0.1",
+    };
+    std::vector<expar::AstNode *> expressions;
+    for (const auto &text : texts)
+        expressions.emplace_back(expar::parser::parse(text));
+    double x = 1.5, y = -0.25;
+    double expected[] = {
+        x + (y * 2),
+        std::sqrt(x) * std::exp(-y),
+        std::pow(x, 3) - (y / x),
+        static_cast<double>((x > y) + (x <= 1)),
+        std::max(x, y) - 0.1,
+    };
+    // A cache of this run only, which does not depend on the working directory.
+    std::filesystem::path cache = std::filesystem::temp_directory_path() / ("expar-cache-" + std::to_string(getpid()));
+    std::filesystem::remove_all(cache);
+    expar::NativeOptions options;
+    options.cache_dir = cache.string();
+    int failures      = 0;
+    // The second time around the module must come from the cache.
+    for (int run = 0; run < 2; ++run) {
+        auto module = expar::compile_native(expressions, { "x", "y" }, options);
+        std::cout << module->get_path() << (module->is_cached() ? " (cached)" : " (built)") << "\n";
+        if (module->is_cached() != (run == 1))
+            ++failures;
+        double inputs[] = { x, y }, outputs[5];
+        module->get_kernel()(inputs, outputs);
+        for (std::size_t i = 0; i < texts.size(); ++i) {
+            double value = module->get_function(i)(inputs);
+            bool ok      = (value == outputs[i]) && (std::abs(value - expected[i]) <= 1e-15 * (1. + std::abs(expected[i])));
+            printf("%-30s %-12g %s\n", texts[i].c_str(), value, ok ? "OK" : "FAILED");
+            failures += !ok;
+        }
+        delete module;
+    }
+    // Threads building the same module at once all get a working one.
+    {
+        expar::NativeOptions fresh = options;
+        fresh.cache_dir            = (std::filesystem::path(options.cache_dir) / "concurrent").string();
+        std::vector<std::thread> threads;
+        std::atomic<int> working(0);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&]() {
+                auto module     = expar::compile_native(expressions, { "x", "y" }, fresh);
+                double inputs[] = { x, y };
+                working += (module->get_function(0)(inputs) == expected[0]);
+                delete module;
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        printf("%-30s %-12d %s\n", "(concurrent builds)", working.load(), (working == 4) ? "OK" : "FAILED");
+        failures += (working != 4);
+    }
+    // A cache which others can write to is never trusted.
+    {
+        std::filesystem::path shared = std::filesystem::path(options.cache_dir) / "shared";
+        std::filesystem::create_directories(shared);
+        std::filesystem::permissions(shared, std::filesystem::perms::all);
+        expar::NativeOptions open = options;
+        open.cache_dir            = shared.string();
+        bool refused              = false;
+        try {
+            delete expar::compile_native(expressions, { "x", "y" }, open);
+        } catch (const std::exception &) {
+            refused = true;
+        }
+        printf("%-30s %-12s %s\n", "(shared cache)", "", refused ? "OK" : "FAILED");
+        failures += !refused;
+    }
+    // Products and sums are not fused, so they round as in the Evaluator.
+    {
+        std::vector<expar::AstNode *> sums = { expar::parser::parse("x * y + x * 0.1 - y * y * 3.3") };
+        auto module = expar::compile_native(sums, { "x", "y" }, options);
+        bool same   = true;
+        for (int i = 1; i < 1000; ++i) {
+            double point[] = { 1. / i, 0.7 * i + 1e-3 };
+            same &= (module->get_function(0)(point) == expar::Evaluator({ { "x", point[0] }, { "y", point[1] } }).evaluate(sums[0]));
+        }
+        printf("%-30s %-12s %s\n", "(no contraction)", "", same ? "OK" : "FAILED");
+        failures += !same;
+        delete module;
+        delete sums[0];
+    }
+    // The bitwise operators give the same results everywhere, also on
+    // operands which are not integers and on counts out of range.
+    {
+        std::vector<expar::AstNode *> bitwise = {
+            expar::parser::parse("x << y"),
+            expar::parser::parse("x >> y"),
+            expar::parser::parse("x | y"),
+            expar::parser::parse("x & y"),
+        };
+        auto module = expar::compile_native(bitwise, { "x", "y" }, options);
+        double points[][2] = {
+            { 1, 70 }, { 1, -3 }, { -8, 2 }, { -8, 64 }, { -2.5, 1 }, { NAN, 1 }, { 1e300, 1 }, { -1e300, 3 }, { 5, 1e300 }, { 5, -1e300 }, { 3, -INFINITY }
+        };
+        bool ok = (module->get_function(0)(points[0]) == 0.) && (module->get_function(1)(points[2]) == -2.) &&
+                  (module->get_function(1)(points[6]) == static_cast<double>(LLONG_MAX >> 1));
+        for (std::size_t i = 0; i < bitwise.size(); ++i) {
+            expar::Program program(bitwise[i], { "x", "y" });
+            for (auto point : points) {
+                double value = expar::Evaluator({ { "x", point[0] }, { "y", point[1] } }).evaluate(bitwise[i]);
+                ok &= (module->get_function(i)(point) == value) && (program.evaluate(point) == value);
+            }
+        }
+        printf("%-30s %-12s %s\n", "(bitwise)", "", ok ? "OK" : "FAILED");
+        failures += !ok;
+        delete module;
+        for (auto expression : bitwise)
+            delete expression;
+    }
+    for (auto expression : expressions)
+        delete expression;
+    std::filesystem::remove_all(cache);
+    return failures;
+}
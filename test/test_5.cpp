@@ -0,0 +1,112 @@
+#include "expar/parser.hpp"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+/// @brief Prints the tree together with the position of each node.
+class ExpSpanPrinter : public expar::ExpBaseVisitor {
+public:
+    std::ostringstream out;
+
+    void visit(expar::AstBinary &e) override
+    {
+        out << "B" << e.begin << ":" << e.end << "[";
+        e.left->accept(*this);
+        out << expar::operator_to_string(e.type);
+        e.right->accept(*this);
+        out << "]";
+    }
+
+    void visit(expar::AstUnary &e) override
+    {
+        out << "U" << e.begin << ":" << e.end << "[" << expar::operator_to_string(e.type);
+        e.right->accept(*this);
+        out << "]";
+    }
+
+    void visit(expar::AstScope &e) override
+    {
+        out << "S" << e.begin << ":" << e.end << "[";
+        e.content->accept(*this);
+        out << "]";
+    }
+
+    void visit(expar::AstFunction &e) override
+    {
+        out << "F" << e.begin << ":" << e.end << "[" << e.name;
+        for (auto it : e.content) {
+            out << " ";
+            it->accept(*this);
+        }
+        out << "]";
+    }
+
+    void visit(expar::AstVariable &e) override
+    {
+        out << "V" << e.begin << ":" << e.end << "[" << e.name << "]";
+    }
+
+    void visit(expar::AstNumber &e) override
+    {
+        out << "N" << e.begin << ":" << e.end << "[" << e.value << (e.imaginary ? "i" : "") << "]";
+    }
+};
+
+static std::string print(expar::AstNode *node)
+{
+    ExpSpanPrinter printer;
+    node->accept(printer);
+    return printer.out.str();
+}
+
+/// @brief Applies the edit both incrementally and from scratch, and checks
+///        that the two trees match.
+static int Test(const std::string &text, const expar::parser::TextEdit &edit, bool expect_local)
+{
+    expar::parser::ParseResult result;
+    expar::parser::parse(text, result);
+    auto changed = expar::parser::reparse(result, edit);
+    expar::parser::ParseResult expected;
+    expar::parser::parse(result.text, expected);
+    bool ok = (print(result.root) == print(expected.root)) && (result.tokens.size() == expected.tokens.size());
+    for (std::size_t i = 0; ok && (i < result.tokens.size()); ++i) {
+        ok = (result.tokens[i].type == expected.tokens[i].type) &&
+             (result.tokens[i].begin == expected.tokens[i].begin) &&
+             (result.tokens[i].end == expected.tokens[i].end);
+    }
+    // Count the nodes, to check if the update was local.
+    std::size_t total = 0;
+    std::string dump  = print(expected.root);
+    for (char c : dump)
+        total += (c == '[');
+    bool local = changed.size() < total;
+    ok         = ok && (!expect_local || local);
+    printf("%-24s -> %-24s %2lu/%2lu %s\n", text.c_str(), result.text.c_str(), changed.size(), total, ok ? "OK" : "FAILED");
+    if (!ok) {
+        std::cout << "    got      " << print(result.root) << "\n";
+        std::cout << "    expected " << print(expected.root) << "\n";
+    }
+    return !ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    // Changes inside an atom.
+    failures += Test("a + (b * 2) - c", { 9, 1, "25" }, true);
+    failures += Test("a + (b * 2) - c", { 5, 1, "beta" }, true);
+    failures += Test("a + (b * 2) - c", { 14, 1, "x1" }, true);
+    // Changes inside brackets.
+    failures += Test("a + (b * 2) - c", { 6, 4, " / 3 + d" }, true);
+    failures += Test("x * sin(y + 1) + 2", { 10, 1, "-" }, true);
+    failures += Test("x * sin(y + 1) + 2", { 13, 0, ", z" }, true);
+    failures += Test("max(a, (b + c)) * 4", { 12, 1, "c * c" }, true);
+    // Changes to the whitespace only.
+    failures += Test("a + (b * 2) - c", { 1, 1, "   " }, true);
+    // Changes which need a full parse.
+    failures += Test("a + (b * 2) - c", { 2, 1, "*" }, false);
+    failures += Test("a + (b * 2) - c", { 4, 1, "" }, false);
+    failures += Test("a + b", { 5, 0, " + c" }, false);
+    failures += Test("(a + b)", { 0, 0, "f" }, false);
+    return failures;
+}
@@ -0,0 +1,74 @@
+#include "expar/parser.hpp"
+#include "expar/unparse.hpp"
+#include <cstdio>
+#include <iostream>
+#include <cmath>
+
+/// @brief Checks that the text of the tree is the expected one, and that it
+///        reads back to a tree with the same text.
+static int Test(expar::AstNode *node, const std::string &expected)
+{
+    std::string text = expar::unparse(node);
+    auto reparsed    = expar::parser::parse(text);
+    std::string again;
+    expar::unparse(reparsed, again);
+    bool ok = (text == expected) && (again == text);
+    printf("%-32s %-32s %s\n", expected.c_str(), text.c_str(), ok ? "OK" : "FAILED");
+    delete node;
+    delete reparsed;
+    return !ok;
+}
+
+/// @brief Checks that parsing and writing the text gives it back unchanged.
+static int Test(const std::string &text)
+{
+    return Test(expar::parser::parse(text), text);
+}
+
+int main(int argc, char *argv[])
+{
+    expar::Factory f;
+    auto a = [&]() { return f.astVariable("a"); };
+    auto b = [&]() { return f.astVariable("b"); };
+    auto c = [&]() { return f.astVariable("c"); };
+
+    int failures = 0;
+    // Parentheses are added only where needed.
+    failures += Test(f.astBinary(expar::op_mult, f.astBinary(expar::op_plus, a(), b()), c()), "(a + b) * c");
+    failures += Test(f.astBinary(expar::op_plus, a(), f.astBinary(expar::op_mult, b(), c())), "a + b * c");
+    failures += Test(f.astBinary(expar::op_minus, f.astBinary(expar::op_minus, a(), b()), c()), "a - b - c");
+    failures += Test(f.astBinary(expar::op_minus, a(), f.astBinary(expar::op_minus, b(), c())), "a - (b - c)");
+    failures += Test(f.astBinary(expar::op_pow, a(), f.astBinary(expar::op_pow, b(), c())), "a ^ b ^ c");
+    failures += Test(f.astBinary(expar::op_pow, f.astBinary(expar::op_pow, a(), b()), c()), "(a ^ b) ^ c");
+    failures += Test(f.astUnary(expar::op_minus, f.astBinary(expar::op_pow, a(), f.astNumber(2))), "-a ^ 2");
+    failures += Test(f.astBinary(expar::op_pow, f.astUnary(expar::op_minus, a()), f.astNumber(2)), "(-a) ^ 2");
+    failures += Test(f.astBinary(expar::op_pow, f.astNumber(-2), f.astNumber(2)), "(-2) ^ 2");
+    failures += Test(f.astBinary(expar::op_mult, a(), f.astUnary(expar::op_minus, b())), "a * -b");
+    failures += Test(f.astBinary(expar::op_lt, a(), f.astBinary(expar::op_and, b(), c())), "a < (b && c)");
+    failures += Test(f.astUnary(expar::op_not, f.astBinary(expar::op_eq, a(), b())), "! (a == b)");
+    // Numbers are written in their shortest form.
+    failures += Test(f.astNumber(0.1), "0.1");
+    failures += Test(f.astNumber(1. / 3.), "0.3333333333333333");
+    failures += Test(f.astNumber(1e-300), "1e-300");
+    failures += Test(f.astNumber(2.5, true), "2.5i");
+    failures += Test(f.astNumber(INFINITY), "(1 / 0)");
+    // Text which is already minimal comes back unchanged.
+    failures += Test("x * sin(y + 1) - 2");
+    failures += Test("max(a, b) / (a - b) ^ 2");
+    failures += Test("a = b + c");
+    failures += Test("{a} + [b - c]");
+    // Reusing the buffer.
+    auto node = expar::parser::parse("a + b * c");
+    std::string buffer;
+    buffer.reserve(64);
+    auto data = buffer.data();
+    for (int i = 0; i < 4; ++i) {
+        buffer.clear();
+        expar::unparse(node, buffer);
+    }
+    bool ok = (buffer == "a + b * c") && (buffer.data() == data);
+    printf("%-32s %-32s %s\n", "(reused buffer)", buffer.c_str(), ok ? "OK" : "FAILED");
+    failures += !ok;
+    delete node;
+    return failures;
+}
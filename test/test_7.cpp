@@ -0,0 +1,109 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+/// @brief The same evaluator, written with the virtual visitor, to compare
+///        the cost of the two dispatch mechanisms.
+class VirtualEvaluator : public expar::ExpBaseVisitor {
+public:
+    VirtualEvaluator(const std::map<std::string, double> &_bindings)
+        : bindings(_bindings),
+          value()
+    {
+        // Nothing to do.
+    }
+
+    double evaluate(expar::AstNode *node)
+    {
+        node->accept(*this);
+        return value;
+    }
+
+    void visit(expar::AstBinary &e) override
+    {
+        double l = this->evaluate(e.left);
+        double r = this->evaluate(e.right);
+        if (e.type == expar::op_plus)
+            value = l + r;
+        else if (e.type == expar::op_minus)
+            value = l - r;
+        else if (e.type == expar::op_mult)
+            value = l * r;
+        else if (e.type == expar::op_div)
+            value = l / r;
+    }
+
+    void visit(expar::AstUnary &e) override
+    {
+        value = -this->evaluate(e.right);
+    }
+
+    void visit(expar::AstScope &e) override
+    {
+        e.content->accept(*this);
+    }
+
+    void visit(expar::AstVariable &e) override
+    {
+        value = bindings.find(e.name)->second;
+    }
+
+    void visit(expar::AstNumber &e) override
+    {
+        value = e.value;
+    }
+
+private:
+    const std::map<std::string, double> &bindings;
+    double value;
+};
+
+int main(int argc, char *argv[])
+{
+    std::map<std::string, double> bindings = { { "x", 1.5 }, { "y", -0.25 } };
+    double x = 1.5, y = -0.25;
+    std::vector<std::pair<std::string, double>> tests = {
+        { "x + y * 2", x + y * 2 },
+        { "-x ^ 2", -std::pow(x, 2) },
+        { "2 ^ 3 ^ 2", std::pow(2, std::pow(3, 2)) },
+        { "sqrt(x) * exp(-y)", std::sqrt(x) * std::exp(-y) },
+        { "max(x, y) - min(x, y) / 4", std::fmax(x, y) - std::fmin(x, y) / 4 },
+        { "(x > y) + (x <= 1) * 10", 1. },
+        { "(x > y) && (y > 0)", 0. },
+        { "! (x == 1.5)", 0. },
+        { "7 % 4 + (6 | 1) + (5 & 4) + (1 << 3)", 3 + 7 + 4 + 8 },
+        { "a = x - y", x - y },
+    };
+    int failures = 0;
+    for (const auto &test : tests) {
+        auto node    = expar::parser::parse(test.first);
+        double value = expar::Evaluator(bindings).evaluate(node);
+        bool ok      = std::abs(value - test.second) <= 1e-15 * (1. + std::abs(test.second));
+        printf("%-40s %-12g %s\n", test.first.c_str(), value, ok ? "OK" : "FAILED");
+        failures += !ok;
+        delete node;
+    }
+    // Compare the static dispatch with the virtual one.
+    auto node = expar::parser::parse("((x + y) * (x - y) / (x * y + 1) - -x) * (y + (x - 2.5) * (y / x))");
+    expar::Evaluator evaluator(bindings);
+    VirtualEvaluator baseline(bindings);
+    double sum[2] = { 0, 0 };
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200000; ++i)
+        sum[0] += evaluator.evaluate(node);
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200000; ++i)
+        sum[1] += baseline.evaluate(node);
+    auto stop = std::chrono::steady_clock::now();
+    bool ok   = (sum[0] == sum[1]);
+    printf("%-40s static %.3fs, virtual %.3fs %s\n", "(dispatch)",
+           std::chrono::duration<double>(middle - start).count(),
+           std::chrono::duration<double>(stop - middle).count(),
+           ok ? "OK" : "FAILED");
+    failures += !ok;
+    delete node;
+    return failures;
+}
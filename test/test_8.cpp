@@ -0,0 +1,223 @@
+#include "expar/codegen.hpp"
+#include "expar/complex.hpp"
+#include "expar/derivative.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/interval.hpp"
+#include "expar/kernel.hpp"
+#include "expar/parser.hpp"
+#include "expar/program.hpp"
+#include "expar/unparse.hpp"
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+/// @brief Counts the nodes, without recursion.
+class ExpCounter : public expar::ExpWalker {
+public:
+    std::size_t count = 0;
+
+    void visit(expar::AstBinary &e) override
+    {
+        ++count;
+        expar::ExpWalker::visit(e);
+    }
+
+    void visit(expar::AstUnary &e) override
+    {
+        ++count;
+        expar::ExpWalker::visit(e);
+    }
+
+    void visit(expar::AstScope &e) override
+    {
+        ++count;
+        expar::ExpWalker::visit(e);
+    }
+
+    void visit(expar::AstFunction &e) override
+    {
+        ++count;
+        expar::ExpWalker::visit(e);
+    }
+
+    void visit(expar::AstVariable &e) override
+    {
+        ++count;
+    }
+
+    void visit(expar::AstNumber &e) override
+    {
+        ++count;
+    }
+};
+
+/// @brief Counts the nodes, and stops at the variable named `stop`.
+class StoppingCounter : public ExpCounter {
+public:
+    void visit(expar::AstVariable &e) override
+    {
+        if (e.name == "stop")
+            throw std::runtime_error("stop");
+        ExpCounter::visit(e);
+    }
+};
+
+/// @brief Writes the expression in postfix notation, which needs the visit
+///        of the base class to visit the children before it returns.
+class ExpPostfix : public expar::ExpBaseVisitor {
+public:
+    std::string text;
+
+    void visit(expar::AstBinary &e) override
+    {
+        expar::ExpBaseVisitor::visit(e);
+        text += expar::operator_to_string(e.type);
+    }
+
+    void visit(expar::AstVariable &e) override
+    {
+        text += e.name;
+    }
+};
+
+static std::size_t count(expar::AstNode *node)
+{
+    ExpCounter counter;
+    node->accept(counter);
+    return counter.count;
+}
+
+static int Check(const char *name, bool ok)
+{
+    printf("%-48s %s\n", name, ok ? "OK" : "FAILED");
+    return !ok;
+}
+
+/// @brief Checks that parsing the text fails because of the depth limit.
+static int Reject(const char *name, const std::string &text)
+{
+    bool rejected = false;
+    try {
+        delete expar::parser::parse(text);
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    return Check(name, rejected);
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    // A long sum, which gives a left-deep tree.
+    {
+        const std::size_t terms = 100000;
+        std::string text        = "x0";
+        for (std::size_t i = 1; i < terms; ++i)
+            text += " + x" + std::to_string(i);
+        auto node = expar::parser::parse(text);
+        failures += Check("sum: parse", node && (count(node) == 2 * terms - 1));
+        failures += Check("sum: unparse", expar::unparse(node) == text);
+        delete node;
+    }
+    // A long sum of a single variable, which every evaluator and compiler
+    // visits without recursing along the chain.
+    {
+        const std::size_t terms = 100000;
+        std::string text        = "x";
+        for (std::size_t i = 1; i < terms; ++i)
+            text += " + x";
+        auto node       = expar::parser::parse(text);
+        double x        = 0.5, expected = 0.5 * terms, kernel = 0.;
+        auto derivative = expar::differentiate(node, "x");
+        expar::Kernel({ node }, { "x" }).evaluate(&x, &kernel);
+        failures += Check("sum: evaluator", expar::Evaluator({ { "x", x } }).evaluate(node) == expected);
+        failures += Check("sum: program", expar::Program(node, { "x" }).evaluate(&x) == expected);
+        failures += Check("sum: complex evaluator", expar::ComplexEvaluator({ { "x", x } }).evaluate(node) == expected);
+        failures += Check("sum: complex", expar::ComplexProgram(node, { "x" }).evaluate(std::vector<expar::Complex>(1, x).data()) == expected);
+        auto range      = expar::IntervalEvaluator({ { "x", x } }).evaluate(node);
+        failures += Check("sum: interval", (range.lower <= expected) && (expected <= range.upper));
+        failures += Check("sum: kernel", kernel == expected);
+        failures += Check("sum: derivative", expar::Evaluator({ { "x", x } }).evaluate(derivative) == terms);
+        failures += Check("sum: code", !expar::CodeGenerator({ "x" }).generate(node).empty());
+        delete derivative;
+        delete node;
+    }
+    // A long chain of conjunctions, evaluated whole (x = 1) and cut short
+    // (x = 0).
+    {
+        std::string text = "x";
+        for (std::size_t i = 1; i < 100000; ++i)
+            text += " && x";
+        auto node = expar::parser::parse(text);
+        double x  = 0.;
+        failures += Check("and: evaluator", expar::Evaluator({ { "x", 1. } }).evaluate(node) == 1.);
+        failures += Check("and: program", expar::Program(node, { "x" }).evaluate(&x) == 0.);
+        delete node;
+    }
+    // A long chain of negations, built directly.
+    {
+        const std::size_t length = 1000000;
+        expar::Factory factory;
+        expar::AstNode *node = factory.astVariable("x");
+        for (std::size_t i = 0; i < length; ++i)
+            node = factory.astUnary(expar::op_minus, node);
+        failures += Check("negations: traversal", count(node) == length + 1);
+        failures += Check("negations: unparse", expar::unparse(node).size() == length + 1);
+        delete node;
+    }
+    // Nesting below and above the limit.
+    {
+        const std::size_t depth = 500;
+        std::string text        = std::string(depth, '(') + "x" + std::string(depth, ')');
+        auto node               = expar::parser::parse(text);
+        failures += Check("brackets: below the limit", node && (count(node) == depth + 1));
+        delete node;
+    }
+    failures += Reject("brackets: above the limit", std::string(5000, '(') + "x" + std::string(5000, ')'));
+    failures += Reject("functions: above the limit", [] {
+        std::string text;
+        for (int i = 0; i < 5000; ++i)
+            text += "sin(";
+        return text + "x" + std::string(5000, ')');
+    }());
+    failures += Reject("negations: above the limit", std::string(5000, '-') + "x");
+    failures += Reject("powers: above the limit", [] {
+        std::string text = "x";
+        for (int i = 0; i < 5000; ++i)
+            text += " ^ x";
+        return text;
+    }());
+    // A visit which throws leaves the visitor ready for the next one.
+    {
+        auto stopped = expar::parser::parse("(stop + x) * y");
+        auto node    = expar::parser::parse("a + b");
+        StoppingCounter counter;
+        bool thrown = false;
+        try {
+            stopped->accept(counter);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        counter.count = 0;
+        node->accept(counter);
+        failures += Check("traversal: after an exception", thrown && (counter.count == 3));
+        delete stopped;
+        delete node;
+    }
+    // The visits of the base visitor return once the children are visited.
+    {
+        auto node = expar::parser::parse("a - b * c - d");
+        ExpPostfix postfix;
+        node->accept(postfix);
+        failures += Check("traversal: postfix", postfix.text == "abc*-d-");
+        delete node;
+    }
+    // The limit can be raised.
+    {
+        std::string text = std::string(1500, '-') + "x";
+        auto node        = expar::parser::parse(text, 2000);
+        failures += Check("negations: raised limit", node && (count(node) == 1501));
+        delete node;
+    }
+    return failures;
+}
@@ -0,0 +1,58 @@
+#include "expar/parser.hpp"
+#include "expar/evaluator.hpp"
+#include "expar/stats.hpp"
+#include "check.hpp"
+#include <iostream>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    std::map<std::string, double> bindings = { { "x", 2. } };
+    Checks check;
+    // Nothing is counted while disabled.
+    auto node = expar::parser::parse("sin(x) + 2 * -x");
+    expar::Evaluator(bindings).evaluate(node);
+    delete node;
+    auto statistics = expar::stats::snapshot();
+    check("(disabled)", (statistics.parses == 0) && (statistics.evaluations == 0));
+    // Count a single parse.
+    expar::stats::enable();
+    node = expar::parser::parse("sin(x) + 2 * -x");
+    expar::Evaluator(bindings).evaluate(node);
+    delete node;
+    statistics = expar::stats::snapshot();
+    check("(parses)", statistics.parses == 1);
+    check("(tokens)", statistics.tokens == 9);
+    check("(binary nodes)", statistics.ast_nodes[expar::node_binary] == 2);
+    check("(unary nodes)", statistics.ast_nodes[expar::node_unary] == 1);
+    check("(function nodes)", statistics.ast_nodes[expar::node_function] == 1);
+    check("(variable nodes)", statistics.ast_nodes[expar::node_variable] == 2);
+    check("(number nodes)", statistics.ast_nodes[expar::node_number] == 1);
+    check("(parse tree nodes)", statistics.parse_tree_nodes >= 7);
+    check("(bytes)", statistics.node_bytes >= 7 * sizeof(expar::AstNode));
+    check("(evaluations)", statistics.evaluations == 1);
+    // Merge the counters of several threads, also after they have ended.
+    expar::stats::reset();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&bindings]() {
+            for (int j = 0; j < 100; ++j) {
+                auto node = expar::parser::parse("x * x + 1");
+                expar::Evaluator(bindings).evaluate(node);
+                delete node;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    statistics = expar::stats::snapshot();
+    check("(threads)", (statistics.parses == 400) && (statistics.evaluations == 400));
+    check("(threads nodes)", statistics.ast_nodes[expar::node_binary] == 800);
+    expar::Statistics total{};
+    expar::stats::merge(total, statistics);
+    expar::stats::merge(total, statistics);
+    check("(merge)", total.tokens == 2 * statistics.tokens);
+    std::cout << expar::stats::to_string(statistics);
+    expar::stats::enable(false);
+    return check.failures;
+}